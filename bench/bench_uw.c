@@ -0,0 +1,907 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/uw.h"
+#include "include/uw_arena.h"
+#include "include/uw_cbor.h"
+#include "include/uw_datetime.h"
+#include "include/uw_from_json.h"
+#include "include/uw_json_doc.h"
+#include "include/uw_json_sax.h"
+#include "include/uw_msgpack.h"
+#include "include/uw_snapshot.h"
+#include "include/uw_to_json.h"
+#include "include/uw_value_path.h"
+
+/*
+ * Throughput benchmarks.
+ *
+ * Run from the source directory: ./build/bench_uw
+ */
+
+double elapsed_seconds(UwValuePtr start_time)
+{
+    UwValue end_time = uw_monotonic();
+    UwValue timediff = uw_timestamp_diff(&end_time, start_time);
+    return (double) timediff.ts_seconds + (double) timediff.ts_nanoseconds / 1e9;
+}
+
+void report(char* name, double seconds, size_t bytes, unsigned iterations)
+{
+    double mbytes = (double) bytes * iterations / (1024 * 1024);
+    fprintf(stderr, "%-40s %10.3f s  %10.1f MB/s\n", name, seconds, mbytes / seconds);
+}
+
+void bench_allocator()
+{
+    // allocate and release batches of small blocks, then create and destroy maps
+    struct {
+        char*      name;
+        Allocator* allocator;
+    } allocators[] = {
+        { "default_allocator", &default_allocator },
+        { "uw_slab_allocator", &uw_slab_allocator }
+    };
+    unsigned sizes[] = { 48, 96, 160 };
+    unsigned batch_size = 10000;
+    unsigned num_batches = 100;
+    void** blocks = malloc(batch_size * sizeof(void*));
+    if (!blocks) {
+        perror("malloc");
+        return;
+    }
+    for (unsigned i = 0; i < UW_LENGTH(allocators); i++) {
+        Allocator* allocator = allocators[i].allocator;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < num_batches; j++) {
+            unsigned size = sizes[j % UW_LENGTH(sizes)];
+            for (unsigned k = 0; k < batch_size; k++) {
+                blocks[k] = allocator->allocate(size, true);
+            }
+            for (unsigned k = 0; k < batch_size; k++) {
+                allocator->release(&blocks[k], size);
+            }
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "1M blocks, %s", allocators[i].name);
+        fprintf(stderr, "%-40s %10.3f s\n", name, elapsed_seconds(&start_time));
+    }
+    free(blocks);
+
+    UwType* map_type = _uw_types[UwTypeId_Map];
+    Allocator* saved_allocator = map_type->allocator;
+    for (unsigned i = 0; i < UW_LENGTH(allocators); i++) {{
+        map_type->allocator = allocators[i].allocator;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < 1000000; j++) {{
+            UwValue map = UwMap(UwCharPtr("id"), UwUnsigned(j));
+            if (uw_error(&map)) {
+                uw_print_status(stderr, &map);
+                break;
+            }
+        }}
+        char name[64];
+        snprintf(name, sizeof(name), "1M maps, %s", allocators[i].name);
+        fprintf(stderr, "%-40s %10.3f s\n", name, elapsed_seconds(&start_time));
+    }}
+    map_type->allocator = saved_allocator;
+
+    // strings of different lengths, from 40 to 300 chars, grown by appending
+    struct {
+        char*      name;
+        Allocator* allocator;
+    } string_allocators[] = {
+        { "default_allocator",        &default_allocator },
+        { "uw_string_pool_allocator", &uw_string_pool_allocator }
+    };
+    UwType* string_type = _uw_types[UwTypeId_String];
+    saved_allocator = string_type->allocator;
+    for (unsigned i = 0; i < UW_LENGTH(string_allocators); i++) {{
+        string_type->allocator = string_allocators[i].allocator;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < 1000000; j++) {{
+            UwValue str = uw_create_string("a string that does not fit into value");
+            for (unsigned k = j % 27; k; k--) {
+                if (!uw_string_append(&str, "0123456789")) {
+                    fprintf(stderr, "string append failed\n");
+                    break;
+                }
+            }
+        }}
+        char name[64];
+        snprintf(name, sizeof(name), "1M strings, %s", string_allocators[i].name);
+        fprintf(stderr, "%-40s %10.3f s\n", name, elapsed_seconds(&start_time));
+    }}
+    string_type->allocator = saved_allocator;
+}
+
+typedef struct {
+    unsigned           index;
+    unsigned           num_threads;
+    pthread_barrier_t* barrier;
+    UwValuePtr         batches;  // one per thread, released by the next thread
+} ScalingThreadArgs;
+
+void* scaling_thread(void* arg)
+{
+    ScalingThreadArgs* args = arg;
+    UwValuePtr batch = &args->batches[args->index];
+    UwValuePtr prev_batch = &args->batches[(args->index + args->num_threads - 1) % args->num_threads];
+
+    for (unsigned i = 0; i < 20; i++) {
+        // short-lived values
+        for (unsigned j = 0; j < 5000; j++) {{
+            UwValue array = UwArray();
+            UwValue str = uw_create_string("a string that does not fit into value");
+            UwValue status = uw_array_append(&array, &str);
+        }}
+        // values released by another thread
+        for (unsigned j = 0; j < 1000; j++) {{
+            UwValue str = uw_create_string("a string that does not fit into value");
+            UwValue status = uw_array_append(batch, &str);
+        }}
+        pthread_barrier_wait(args->barrier);
+        uw_array_clean(prev_batch);
+        pthread_barrier_wait(args->barrier);
+    }
+    return nullptr;
+}
+
+void bench_scaling()
+{
+    // same work per thread, so ideal scaling keeps time constant up to the number of cores
+    struct {
+        char*      name;
+        Allocator* allocator;
+        Allocator* string_allocator;
+    } allocators[] = {
+        { "default_allocator", &default_allocator, &default_allocator },
+        { "thread caches",     &uw_slab_allocator, &uw_string_pool_allocator }
+    };
+    unsigned thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    UwType* array_type = _uw_types[UwTypeId_Array];
+    UwType* string_type = _uw_types[UwTypeId_String];
+    Allocator* saved_allocator = array_type->allocator;
+    Allocator* saved_string_allocator = string_type->allocator;
+
+    for (unsigned i = 0; i < UW_LENGTH(allocators); i++) {
+        array_type->allocator = allocators[i].allocator;
+        string_type->allocator = allocators[i].string_allocator;
+        for (unsigned j = 0; j < UW_LENGTH(thread_counts); j++) {
+            unsigned num_threads = thread_counts[j];
+            pthread_t threads[num_threads];
+            ScalingThreadArgs args[num_threads];
+            _UwValue batches[num_threads];
+            pthread_barrier_t barrier;
+            pthread_barrier_init(&barrier, nullptr, num_threads);
+            for (unsigned k = 0; k < num_threads; k++) {
+                batches[k] = UwArray();
+                args[k] = (ScalingThreadArgs) {
+                    .index       = k,
+                    .num_threads = num_threads,
+                    .barrier     = &barrier,
+                    .batches     = batches
+                };
+            }
+            UwValue start_time = uw_monotonic();
+            for (unsigned k = 0; k < num_threads; k++) {
+                if (pthread_create(&threads[k], nullptr, scaling_thread, &args[k])) {
+                    perror("pthread_create");
+                    exit(1);
+                }
+            }
+            for (unsigned k = 0; k < num_threads; k++) {
+                pthread_join(threads[k], nullptr);
+            }
+            char name[64];
+            snprintf(name, sizeof(name), "%u threads, %s", num_threads, allocators[i].name);
+            fprintf(stderr, "%-40s %10.3f s\n", name, elapsed_seconds(&start_time));
+
+            for (unsigned k = 0; k < num_threads; k++) {
+                uw_destroy(&batches[k]);
+            }
+            pthread_barrier_destroy(&barrier);
+        }
+    }
+    array_type->allocator = saved_allocator;
+    string_type->allocator = saved_string_allocator;
+}
+
+UwResult make_json_value(unsigned num_records)
+/*
+ * Make a value with a mix of short and long strings, numbers, and nested containers.
+ */
+{
+    UwValue records = UwArray();
+    uw_return_if_error(&records);
+    for (unsigned i = 0; i < num_records; i++) {{
+        UwValue record = UwMap(
+            UwCharPtr("id"),      UwUnsigned(i),
+            UwCharPtr("name"),    UwCharPtr("record name"),
+            UwCharPtr("score"),   UwFloat(i * 0.25),
+            UwCharPtr("active"),  UwBool(i & 1),
+            UwCharPtr("comment"), UwCharPtr(u8"Lorem ipsum dolor sit amet, consectetur adipiscing elit \"quoted\"\n"),
+            UwCharPtr("unicode"), UwCharPtr(u8"Съешь же ещё этих мягких французских булок"),
+            UwCharPtr("tags"),    UwArray(UwCharPtr("one"), UwCharPtr("two"), UwSigned(-3), UwNull())
+        );
+        uw_return_if_error(&record);
+        uw_expect_ok( uw_array_append(&records, &record) );
+    }}
+    return uw_move(&records);
+}
+
+UwResult make_json_document(unsigned num_records)
+{
+    UwValue value = make_json_value(num_records);
+    uw_return_if_error(&value);
+    return uw_to_json(&value, 2);
+}
+
+void bench_arena()
+{
+    // parse 1 MB documents and release them, with and without arena
+    UwValue json = make_json_document(3000);
+    if (uw_error(&json)) {
+        uw_print_status(stderr, &json);
+        return;
+    }
+    unsigned iterations = 100;
+    for (unsigned use_arena = 0; use_arena < 2; use_arena++) {{
+        double release_time = 0;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            if (use_arena) {
+                UwValue status = uw_arena_begin();
+                if (uw_error(&status)) {
+                    uw_print_status(stderr, &status);
+                    return;
+                }
+            }
+            UwValue value = uw_from_json(&json);
+            if (uw_error(&value)) {
+                uw_print_status(stderr, &value);
+                if (use_arena) {
+                    uw_arena_end();
+                }
+                return;
+            }
+            UwValue release_start = uw_monotonic();
+            uw_destroy(&value);
+            if (use_arena) {
+                uw_arena_end();
+            }
+            release_time += elapsed_seconds(&release_start);
+        }}
+        fprintf(stderr, "%-40s %10.3f s, release %.3f s\n",
+                use_arena? "parse 1 MB x 100, arena" : "parse 1 MB x 100, destroy",
+                elapsed_seconds(&start_time), release_time);
+    }}
+}
+
+void bench_refcount()
+{
+    // clone and destroy values in a single thread to measure the cost of refcount mode
+#ifdef UW_ATOMIC_REFCOUNT
+    char* mode = "atomic refcount";
+#else
+    char* mode = "plain refcount";
+#endif
+    UwValue str = uw_create_string("this string is too long to be embedded");
+    UwValue list = UwArray(UwSigned(1), UwSigned(2), UwSigned(3));
+    UwValuePtr values[] = { &str, &list };
+    char* names[] = { "string", "array" };
+    unsigned iterations = 10'000'000;
+
+    for (unsigned i = 0; i < UW_LENGTH(values); i++) {{
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            UwValue copy = uw_clone(values[i]);
+        }}
+        double seconds = elapsed_seconds(&start_time);
+        char name[64];
+        snprintf(name, sizeof(name), "clone/destroy %s, %s", names[i], mode);
+        fprintf(stderr, "%-40s %10.3f s  %10.1f M/s\n", name, seconds, iterations / 1e6 / seconds);
+    }}
+}
+
+typedef struct {
+    unsigned dummy;
+} BenchMapData;
+
+static UwType bench_map_type;
+static UwTypeId UwTypeId_BenchMap = 0;
+
+void bench_type_checks()
+{
+    // type checks alone, with deep subtype, and in a loop of API calls
+    if (UwTypeId_BenchMap == 0) {
+        UwTypeId_BenchMap = uw_subtype(&bench_map_type, "BenchMap", UwTypeId_Map, BenchMapData);
+    }
+    _UwValue values[] = {
+        UwSigned(1),
+        uw_create_string("this string is too long to be embedded"),
+        UwArray(),
+        UwMap(),
+        uw_create(UwTypeId_BenchMap)
+    };
+    unsigned iterations = 10'000'000;
+    unsigned num_found = 0;
+
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {
+        UwValuePtr v = &values[j % UW_LENGTH(values)];
+        num_found += uw_is_string(v) + uw_is_struct(v) + uw_is_compound(v)
+                     + uw_is_map(v) + uw_is_status(v) + uw_is_int(v);
+    }
+    fprintf(stderr, "%-40s %10.3f s\n", "60M type checks", elapsed_seconds(&start_time));
+
+    UwValue records = make_json_value(1000);
+    if (uw_error(&records)) {
+        uw_print_status(stderr, &records);
+        return;
+    }
+    start_time = uw_monotonic();
+    for (unsigned j = 0; j < 2000; j++) {
+        for (unsigned i = 0, n = uw_array_length(&records); i < n; i++) {{
+            UwValue record = uw_array_item(&records, i);
+            UwValue name = uw_map_get(&record, "name");
+            UwValue tags = uw_map_get(&record, "tags");
+            num_found += uw_is_string(&name) + uw_map_has_key(&record, "id") + uw_array_length(&tags);
+        }}
+    }
+    fprintf(stderr, "%-40s %10.3f s\n", "2M records, map_get/array_item", elapsed_seconds(&start_time));
+
+    if (num_found == 0) {
+        fprintf(stderr, "type checks: wrong number of results\n");
+    }
+    for (unsigned i = 0; i < UW_LENGTH(values); i++) {
+        uw_destroy(&values[i]);
+    }
+}
+
+void bench_line_reader()
+{
+    // read short lines with shorthand methods and with interface looked up once
+    unsigned num_lines = 1'000'000;
+    UwValue text = uw_create_empty_string(num_lines * 4, 1);
+    for (unsigned i = 0; i < num_lines; i++) {
+        if (!uw_string_append(&text, "abc\n")) {
+            fputs("OOM\n", stderr);
+            return;
+        }
+    }
+    UwValue sio = uw_create_string_io(&text);
+    if (uw_error(&sio)) {
+        uw_print_status(stderr, &sio);
+        return;
+    }
+    unsigned iterations = 10;
+    for (unsigned cached = 0; cached < 2; cached++) {{
+        UwInterface_LineReader* line_reader = uw_interface(sio.type_id, LineReader);
+        unsigned n = 0;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            UwValue started = uw_start_read_lines(&sio);
+            if (uw_error(&started)) {
+                uw_print_status(stderr, &started);
+                return;
+            }
+            for (;;) {{
+                UwLineView view;
+                UwValue status = cached? line_reader->read_line_view(&sio, &view)
+                                       : uw_read_line_view(&sio, &view);
+                if (uw_error(&status)) {
+                    break;
+                }
+                n += cached? line_reader->get_line_number(&sio) > 0 : uw_get_line_number(&sio) > 0;
+            }}
+            uw_stop_read_lines(&sio);
+        }}
+        if (n != num_lines * iterations) {
+            fprintf(stderr, "line_reader: wrong number of lines %u\n", n);
+        }
+        fprintf(stderr, "%-40s %10.3f s\n", cached? "10M lines, cached interface" : "10M lines, uw_read_line_view",
+                elapsed_seconds(&start_time));
+    }}
+}
+
+void bench_trivial_items()
+{
+    // copy and destroy arrays of integral values
+    UwValue array = UwArray();
+    for (unsigned i = 0; i < 1000; i++) {{
+        UwValue item = (i & 1)? UwSigned(i) : UwFloat(i * 0.5);
+        UwValue status = uw_array_append(&array, &item);
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            return;
+        }
+    }}
+    unsigned iterations = 100'000;
+
+    UwValue start_time = uw_monotonic();
+    for (unsigned i = 0; i < iterations; i++) {{
+        UwValue copy = uw_deepcopy(&array);
+    }}
+    fprintf(stderr, "%-40s %10.3f s\n", "100K deepcopy/destroy, 1000 numbers", elapsed_seconds(&start_time));
+
+    start_time = uw_monotonic();
+    for (unsigned i = 0; i < iterations; i++) {{
+        UwValue slice = uw_array_slice(&array, 100, 900);
+    }}
+    fprintf(stderr, "%-40s %10.3f s\n", "100K slice/destroy, 800 numbers", elapsed_seconds(&start_time));
+}
+
+void bench_small_containers()
+{
+    // many live arrays that fit in inline items
+    unsigned num_arrays = 1'000'000;
+
+    UwValue start_time = uw_monotonic();
+    UwValue arrays = UwArray();
+    UwValue status = uw_array_resize(&arrays, num_arrays);
+    if (uw_error(&status)) {
+        uw_print_status(stderr, &status);
+        return;
+    }
+    for (unsigned i = 0; i < num_arrays; i++) {{
+        UwValue array = UwArray();
+        for (unsigned j = 0; j < 3; j++) {
+            uw_array_append(&array, i + j);
+        }
+        status = uw_array_append(&arrays, &array);
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            return;
+        }
+    }}
+    fprintf(stderr, "%-40s %10.3f s\n", "create 1M arrays, 3 items", elapsed_seconds(&start_time));
+
+    start_time = uw_monotonic();
+    uint64_t sum = 0;
+    for (unsigned n = 0; n < 10; n++) {
+        for (unsigned i = 0; i < num_arrays; i++) {{
+            UwValue array = uw_array_item(&arrays, i);
+            for (unsigned j = 0; j < 3; j++) {{
+                UwValue item = uw_array_item(&array, j);
+                sum += item.unsigned_value;
+            }}
+        }}
+    }
+    if (sum != 10 * (3 * (uint64_t) num_arrays * (num_arrays - 1) / 2 + 3 * (uint64_t) num_arrays)) {
+        fprintf(stderr, "small_containers: wrong sum %zu\n", (size_t) sum);
+    }
+    fprintf(stderr, "%-40s %10.3f s\n", "10x sum of 1M arrays, 3 items", elapsed_seconds(&start_time));
+
+    start_time = uw_monotonic();
+    uw_destroy(&arrays);
+    fprintf(stderr, "%-40s %10.3f s\n", "destroy 1M arrays, 3 items", elapsed_seconds(&start_time));
+
+    // create and destroy maps that keep their pairs inline
+    unsigned iterations = 1'000'000;
+    start_time = uw_monotonic();
+    for (unsigned i = 0; i < iterations; i++) {{
+        UwValue map = UwMap();
+        for (unsigned j = 0; j < 2; j++) {
+            UwValue status = uw_map_update_va(&map, UwUnsigned(j), UwUnsigned(i));
+        }
+    }}
+    fprintf(stderr, "%-40s %10.3f s\n", "1M maps, 2 pairs", elapsed_seconds(&start_time));
+}
+
+void bench_to_json()
+{
+    struct {
+        char*    name;
+        unsigned num_records;
+        unsigned iterations;
+    } documents[] = {
+        { "to_json, 1 MB",   3000,   100 },
+        { "to_json, 100 MB", 300000, 2 }
+    };
+    for (unsigned i = 0; i < UW_LENGTH(documents); i++) {{
+        UwValue value = make_json_value(documents[i].num_records);
+        if (uw_error(&value)) {
+            uw_print_status(stderr, &value);
+            return;
+        }
+        UwValue json = UwNull();
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < documents[i].iterations; j++) {
+            uw_destroy(&json);
+            json = uw_to_json(&value, 2);
+            if (uw_error(&json)) {
+                uw_print_status(stderr, &json);
+                return;
+            }
+        }
+        double seconds = elapsed_seconds(&start_time);
+        report(documents[i].name, seconds, uw_strlen_in_utf8(&json), documents[i].iterations);
+    }}
+}
+
+void bench_to_json_write()
+{
+    // write 100 MB document to temporary file, memory use is bounded by sink buffer
+    UwValue value = make_json_value(300000);
+    if (uw_error(&value)) {
+        uw_print_status(stderr, &value);
+        return;
+    }
+    FILE* fp = tmpfile();
+    if (!fp) {
+        perror("tmpfile");
+        return;
+    }
+    UwSink sink;
+    uw_sink_init_stdio(&sink, fp);
+    unsigned iterations = 2;
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {{
+        rewind(fp);
+        UwValue status = uw_to_json_write(&value, 2, &sink);
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            fclose(fp);
+            return;
+        }
+    }}
+    double seconds = elapsed_seconds(&start_time);
+    report("to_json_write, 100 MB", seconds, ftell(fp), iterations);
+    fclose(fp);
+}
+
+void bench_json_plan()
+{
+    // compact output of fixed-shape records, generic path vs encoder plan
+    UwValue value = make_json_value(300000);
+    if (uw_error(&value)) {
+        uw_print_status(stderr, &value);
+        return;
+    }
+    UwValue template = uw_array_item(&value, 0);
+    UwValue plan = uw_json_plan(&template);
+    if (uw_error(&plan)) {
+        uw_print_status(stderr, &plan);
+        return;
+    }
+    UwSink sink;
+    uw_sink_init_buffer(&sink);
+    unsigned iterations = 4;
+    for (unsigned use_plan = 0; use_plan < 2; use_plan++) {
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            sink.size = 0;
+            UwValue status = use_plan? uw_json_plan_write(&plan, &value, &sink)
+                                     : uw_to_json_write(&value, 0, &sink);
+            if (uw_error(&status)) {
+                uw_print_status(stderr, &status);
+                uw_sink_fini(&sink);
+                return;
+            }
+        }}
+        double seconds = elapsed_seconds(&start_time);
+        report(use_plan? "json_plan_write, compact" : "to_json_write, compact", seconds, sink.size, iterations);
+    }
+    uw_sink_fini(&sink);
+}
+
+void bench_from_json()
+{
+    // sample files
+
+    char* sample_files[] = {
+        "./test/data/sample.json",
+        "./test/data/sample-no-trailing-lf.json"
+    };
+    for (unsigned i = 0; i < UW_LENGTH(sample_files); i++) {{
+        UwValue file = uw_file_open(sample_files[i], O_RDONLY, 0);
+        if (uw_error(&file)) {
+            uw_print_status(stderr, &file);
+            return;
+        }
+        char data[4096];
+        unsigned size;
+        UwValue status = uw_file_read(&file, data, sizeof(data), &size);
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            return;
+        }
+        unsigned iterations = 100000;
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            UwValue result = uw_from_json_buffer((char8_t*) data, size);
+            if (uw_error(&result)) {
+                uw_print_status(stderr, &result);
+                return;
+            }
+        }}
+        report(sample_files[i], elapsed_seconds(&start_time), size, iterations);
+    }}
+
+    // generated document
+
+    UwValue json = make_json_document(20000);
+    if (uw_error(&json)) {
+        uw_print_status(stderr, &json);
+        return;
+    }
+    unsigned size = uw_strlen_in_utf8(&json);
+    char8_t* data = allocate(size + 1, false);
+    uw_string_to_utf8_buf(&json, (char*) data);
+
+    unsigned iterations = 20;
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {{
+        UwValue result = uw_from_json_buffer(data, size);
+        if (uw_error(&result)) {
+            uw_print_status(stderr, &result);
+            break;
+        }
+    }}
+    report("generated document, from_json", elapsed_seconds(&start_time), size, iterations);
+    release((void**) &data, size + 1);
+}
+
+void bench_json_document()
+{
+    // read a few fields from the middle of generated document
+    UwValue json = make_json_document(20000);
+    if (uw_error(&json)) {
+        uw_print_status(stderr, &json);
+        return;
+    }
+    unsigned size = uw_strlen_in_utf8(&json);
+    char8_t* data = allocate(size + 1, false);
+    uw_string_to_utf8_buf(&json, (char*) data);
+
+    unsigned iterations = 20;
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {{
+        UwValue value = uw_from_json_buffer(data, size);
+        UwValue record = uw_array_item(&value, 10000);
+        UwValue id = uw_map_get(&record, "id");
+        UwValue name = uw_map_get(&record, "name");
+        UwValue tags = uw_map_get(&record, "tags");
+        if (!uw_equal(&id, 10000)) {
+            fprintf(stderr, "from_json: bad id\n");
+            break;
+        }
+    }}
+    report("3 fields, from_json", elapsed_seconds(&start_time), size, iterations);
+
+    start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {{
+        UwValue doc = uw_json_document(data);
+        UwValue id = uw_json_get(&doc, UwUnsigned(10000), UwCharPtr("id"));
+        UwValue name = uw_json_get(&doc, UwUnsigned(10000), UwCharPtr("name"));
+        UwValue tags = uw_json_get(&doc, UwUnsigned(10000), UwCharPtr("tags"));
+        if (!uw_equal(&id, 10000)) {
+            fprintf(stderr, "json_document: bad id\n");
+            break;
+        }
+    }}
+    report("3 fields, json_document", elapsed_seconds(&start_time), size, iterations);
+    release((void**) &data, size + 1);
+}
+
+void bench_value_path()
+{
+    UwValue value = make_json_value(1000);
+    if (uw_error(&value)) {
+        uw_print_status(stderr, &value);
+        return;
+    }
+    unsigned iterations = 2000;
+    unsigned num_found = 0;
+
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {
+        for (unsigned i = 0; i < 1000; i++) {{
+            UwValue record = uw_array_item(&value, i);
+            UwValue tags = uw_map_get(&record, "tags");
+            UwValue tag = uw_array_item(&tags, 1);
+            num_found += uw_is_string(&tag);
+        }}
+    }
+    fprintf(stderr, "%-40s %10.3f s\n", "2M lookups, map_get/array_item", elapsed_seconds(&start_time));
+
+    UwValue paths = UwArray();
+    for (unsigned i = 0; i < 1000; i++) {{
+        char expr[32];
+        sprintf(expr, "[%u].tags[1]", i);
+        UwValue path = uw_value_path(expr);
+        uw_array_append(&paths, &path);
+    }}
+    start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {
+        for (unsigned i = 0; i < 1000; i++) {{
+            UwValue path = uw_array_item(&paths, i);
+            UwValuePtr tag = uw_value_path_get(&path, &value);
+            num_found += tag && uw_is_string(tag);
+        }}
+    }
+    fprintf(stderr, "%-40s %10.3f s\n", "2M lookups, value_path", elapsed_seconds(&start_time));
+    if (num_found != 2 * iterations * 1000) {
+        fprintf(stderr, "value_path: wrong number of results\n");
+    }
+}
+
+unsigned count_json_values(unsigned event, UwValuePtr value, unsigned depth, void* arg)
+{
+    if (event == UW_JSON_VALUE) {
+        (*(unsigned*) arg)++;
+    }
+    return UW_JSON_CONTINUE;
+}
+
+void bench_json_events()
+{
+    UwValue json = make_json_document(20000);
+    if (uw_error(&json)) {
+        uw_print_status(stderr, &json);
+        return;
+    }
+    UwValue sio = uw_create_string_io(&json);
+    if (uw_error(&sio)) {
+        uw_print_status(stderr, &sio);
+        return;
+    }
+    unsigned size = uw_strlen_in_utf8(&json);
+    unsigned iterations = 20;
+    unsigned num_values = 0;
+    UwValue start_time = uw_monotonic();
+    for (unsigned j = 0; j < iterations; j++) {{
+        UwValue status = uw_json_parse_events(&sio, count_json_values, &num_values);
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            return;
+        }
+    }}
+    report("generated document, json events", elapsed_seconds(&start_time), size, iterations);
+}
+
+UwResult to_json_compact(UwValuePtr value, UwSink* sink)
+{
+    return uw_to_json_write(value, 0, sink);
+}
+
+UwResult from_json_buffer(uint8_t* data, size_t size)
+{
+    return uw_from_json_buffer(data, size);
+}
+
+void bench_binary()
+{
+    // encode and decode the same value as JSON, CBOR, and MessagePack in memory
+    UwValue value = make_json_value(30000);
+    if (uw_error(&value)) {
+        uw_print_status(stderr, &value);
+        return;
+    }
+    struct {
+        char*    encode_name;
+        char*    decode_name;
+        UwResult (*encode)(UwValuePtr value, UwSink* sink);
+        UwResult (*decode)(uint8_t* data, size_t size);
+    } formats[] = {
+        { "to_json_write, 10 MB",  "from_json_buffer, 10 MB",    to_json_compact,     from_json_buffer },
+        { "to_cbor_write, 10 MB",  "from_cbor_buffer, 10 MB",    uw_to_cbor_write,    uw_from_cbor_buffer },
+        { "to_msgpack_write, 10 MB", "from_msgpack_buffer, 10 MB", uw_to_msgpack_write, uw_from_msgpack_buffer }
+    };
+    unsigned iterations = 10;
+    for (unsigned i = 0; i < UW_LENGTH(formats); i++) {{
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            sink.size = 0;
+            UwValue status = formats[i].encode(&value, &sink);
+            if (uw_error(&status)) {
+                uw_print_status(stderr, &status);
+                uw_sink_fini(&sink);
+                return;
+            }
+        }}
+        report(formats[i].encode_name, elapsed_seconds(&start_time), sink.size, iterations);
+
+        start_time = uw_monotonic();
+        for (unsigned j = 0; j < iterations; j++) {{
+            UwValue result = formats[i].decode(sink.data, sink.size);
+            if (uw_error(&result)) {
+                uw_print_status(stderr, &result);
+                uw_sink_fini(&sink);
+                return;
+            }
+        }}
+        report(formats[i].decode_name, elapsed_seconds(&start_time), sink.size, iterations);
+        uw_sink_fini(&sink);
+    }}
+}
+
+void bench_snapshot()
+{
+    // open the same value from CBOR file and from snapshot
+    UwValue value = make_json_value(100000);
+    if (uw_error(&value)) {
+        uw_print_status(stderr, &value);
+        return;
+    }
+    char* cbor_file_name = "/tmp/uw_bench_snapshot.cbor";
+    char* snapshot_file_name = "/tmp/uw_bench_snapshot.bin";
+    size_t cbor_size = 0;
+    size_t snapshot_size = 0;
+    for (unsigned i = 0; i < 2; i++) {{
+        UwValue file_name = UwCharPtr(i? snapshot_file_name : cbor_file_name);
+        UwValue file = uw_file_open(&file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        UwSink sink;
+        UwValue status = uw_sink_init_writer(&sink, &file);
+        if (uw_ok(&status)) {
+            status = i? uw_snapshot_write(&value, &sink) : uw_to_cbor_write(&value, &sink);
+        }
+        if (uw_error(&status)) {
+            uw_print_status(stderr, &status);
+            return;
+        }
+        UwValue size = uw_file_size(&file_name);
+        *(i? &snapshot_size : &cbor_size) = size.unsigned_value;
+    }}
+
+    unsigned iterations = 10;
+    UwValue start_time = uw_monotonic();
+    for (unsigned i = 0; i < iterations; i++) {{
+        UwValue file = uw_file_open(cbor_file_name, O_RDONLY, 0);
+        UwValue result = uw_from_cbor(&file);
+        if (uw_error(&result)) {
+            uw_print_status(stderr, &result);
+            return;
+        }
+    }}
+    report("from_cbor, file", elapsed_seconds(&start_time), cbor_size, iterations);
+
+    start_time = uw_monotonic();
+    for (unsigned i = 0; i < iterations; i++) {{
+        UwValue file = uw_file_open(snapshot_file_name, O_RDONLY, 0);
+        UwValue snapshot = uw_snapshot_open(&file);
+        if (uw_error(&snapshot)) {
+            uw_print_status(stderr, &snapshot);
+            return;
+        }
+        // touch the data
+        UwValue item = uw_array_item(uw_snapshot_root(&snapshot), 12345);
+        if (uw_error(&item)) {
+            uw_print_status(stderr, &item);
+            return;
+        }
+    }}
+    report("snapshot_open, file", elapsed_seconds(&start_time), snapshot_size, iterations);
+
+    unlink(cbor_file_name);
+    unlink(snapshot_file_name);
+}
+
+int main(int argc, char* argv[])
+{
+    bench_allocator();
+    bench_arena();
+    bench_scaling();
+    bench_refcount();
+    bench_type_checks();
+    bench_line_reader();
+    bench_trivial_items();
+    bench_small_containers();
+    bench_from_json();
+    bench_json_document();
+    bench_json_events();
+    bench_to_json();
+    bench_to_json_write();
+    bench_json_plan();
+    bench_value_path();
+    bench_binary();
+    bench_snapshot();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * Request-scoped arenas.
+ *
+ * Between uw_arena_begin() and uw_arena_end() strings, arrays and maps
+ * created by the thread are allocated from a bump allocator instead of
+ * type allocators. Destroying such values does nothing, the whole graph
+ * is released by uw_arena_end() at once, in time proportional to the number
+ * of memory chunks the arena has used, not to the number of values.
+ *
+ * Arenas nest. Containers grow in the arena they were created in,
+ * regardless of which arena is current.
+ *
+ * Values from outside, i.e. allocated strings, arrays and maps created
+ * before uw_arena_begin() or in a nested arena, are deeply copied
+ * when stored into arena containers. Values of other types that have
+ * allocated data, such as files, cannot be stored into arena containers.
+ *
+ * Values must not outlive their arena. Use uw_arena_export() to make
+ * a copy for the outer world. Debug builds detect escaped values:
+ * storing arena value into a container from outside panics, and when
+ * an arena ends, all its memory is made inaccessible, so accessing
+ * escaped values faults immediately instead of reading garbage.
+ * Release builds keep up to UW_ARENA_RETAIN_SIZE bytes of memory
+ * for the next arena to avoid page faults.
+ *
+ * Arena values are single-threaded: they must not be used by threads
+ * other than the one which created the arena.
+ *
+ * Arenas are carved from a single reserved address range,
+ * at most UW_ARENA_MAX_ARENAS at a time, UW_ARENA_SIZE bytes each.
+ * Memory is committed in UW_ARENA_CHUNK_SIZE chunks as the arena grows.
+ */
+
+#include <uw_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UW_ARENA_SIZE        (1UL << 30)
+#define UW_ARENA_MAX_ARENAS  256
+#define UW_ARENA_CHUNK_SIZE  (1024 * 1024)
+#define UW_ARENA_RETAIN_SIZE (64 * 1024 * 1024)
+
+UwResult uw_arena_begin();
+/*
+ * Start new arena and make it current for the calling thread.
+ *
+ * Return OOM if address space cannot be reserved or all arenas are in use.
+ */
+
+void uw_arena_end();
+/*
+ * Release current arena with all values allocated in it
+ * and make the enclosing one current.
+ */
+
+bool uw_in_arena(UwValuePtr value);
+/*
+ * Return true if value data is allocated in an arena.
+ */
+
+UwResult uw_arena_export(UwValuePtr value);
+/*
+ * Return deep copy of value allocated outside of arenas.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+ * Asynchronous reads for batch processing of many files.
+ *
+ * AsyncReader submits positional reads in batches and reaps completions
+ * in batches. It works on top of io_uring when the kernel supports it
+ * and falls back to a pool of threads doing pread otherwise.
+ * Readiness-based polling (epoll) is not an option for the fallback
+ * because it does not work with regular files.
+ *
+ * AsyncReader is not thread safe, it should be used by a single thread.
+ */
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UwTypeId UwTypeId_AsyncReader;
+
+typedef struct {
+    unsigned queue_depth;  // max number of reads in flight, default is 64
+    unsigned num_threads;  // number of threads for the fallback, default is 4
+    bool     no_io_uring;  // force using the fallback
+} UwAsyncReaderCtorArgs;
+
+typedef struct _UwAsyncRead UwAsyncRead;
+
+struct _UwAsyncRead {
+    /*
+     * Read request.
+     * The caller owns requests and buffers, they must stay valid
+     * until reaped.
+     */
+
+    // input fields
+    void*    buffer;
+    unsigned size;
+    uint64_t offset;
+    void*    user_data;
+
+    // output fields, set upon completion
+    unsigned bytes_read;  // less than size on end of file or error
+    int      error;       // errno, zero if succeeded
+
+    // private fields
+    int          _fd;
+    UwAsyncRead* _next;
+};
+
+UwResult uw_create_async_reader(unsigned queue_depth);
+/*
+ * Create AsyncReader with default parameters except queue_depth.
+ * For other parameters use uw_create2(UwTypeId_AsyncReader, &ctor_args)
+ */
+
+UwResult uw_async_read_submit(UwValuePtr reader, UwValuePtr file, UwAsyncRead* request);
+/*
+ * Queue read request for the file, which must support File interface.
+ * The file must be kept open until the request is reaped.
+ *
+ * Requests are passed to the kernel or worker threads in batches,
+ * by uw_async_read_flush or uw_async_read_reap.
+ *
+ * Return UW_ERROR_ASYNC_QUEUE_FULL if queue_depth requests are pending.
+ * In this case some requests should be reaped first.
+ */
+
+UwResult uw_async_read_flush(UwValuePtr reader);
+/*
+ * Start all queued requests without waiting for completion.
+ */
+
+UwResult uw_async_read_reap(UwValuePtr reader, UwAsyncRead** completed, unsigned max_completed,
+                            unsigned min_completed, unsigned* num_completed);
+/*
+ * Start queued requests and wait until at least min_completed requests are completed.
+ * min_completed is capped by the number of pending requests.
+ * If min_completed is zero, do not wait, just collect what's already completed.
+ *
+ * Store at most max_completed pointers to completed requests in `completed`
+ * and their number in `num_completed`.
+ *
+ * Completed requests are returned in arbitrary order.
+ *
+ * If waiting fails, return the error. Requests completed so far
+ * are still stored in `completed` and counted in `num_completed`.
+ */
+
+unsigned uw_async_read_pending(UwValuePtr reader);
+/*
+ * Return the number of requests submitted and not reaped yet.
+ */
+
+bool uw_async_read_uses_io_uring(UwValuePtr reader);
+/*
+ * Return true if reader works on top of io_uring.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * CBOR (RFC 8949) serialization.
+ *
+ * Values are mapped as follows:
+ *
+ *   Null              <-> null, undefined is decoded as Null too
+ *   Bool              <-> false, true
+ *   Signed, Unsigned  <-> unsigned and negative integers;
+ *                         decoded as Signed if they fit int64, as Unsigned otherwise
+ *   Float             <-> float; encoded as single precision if lossless,
+ *                         half precision is decoded too
+ *   String, CharPtr   <-> text string, any char size is encoded as UTF-8;
+ *                         decoded strings have the narrowest char size
+ *   Array             <-> array
+ *   Map               <-> map, keys can be of any supported type
+ *   DateTime          <-> tag 0, RFC 3339 date/time string
+ *   Timestamp         <-> tag 1, epoch seconds, if nanoseconds are zero,
+ *                         tag 1001 (RFC 9581) with seconds and nanoseconds otherwise;
+ *                         tag 1 with float is decoded too
+ *
+ * Indefinite length strings, arrays, and maps are decoded.
+ * Other tags are ignored, the enclosed item is decoded as is.
+ * Byte strings and unassigned simple values are not supported.
+ */
+
+#include <uw.h>
+#include <uw_sink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+UwResult uw_to_cbor_write(UwValuePtr value, UwSink* sink);
+/*
+ * Encode `value` and write it to the sink.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if `value` contains
+ * anything but the types listed above.
+ * On error, some output may have been written already.
+ */
+
+UwResult uw_from_cbor(UwValuePtr file);
+/*
+ * Decode CBOR data item from File.
+ *
+ * Files are memory mapped and decoded entirely, regardless of current position,
+ * so they must be regular files.
+ */
+
+UwResult uw_from_cbor_buffer(uint8_t* data, size_t size);
+/*
+ * Decode CBOR data item from memory.
+ *
+ * Malformed data is reported as UW_ERROR_MALFORMED_DATA status
+ * with the offset in the description.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,6 +33,7 @@ typedef void     (*UwMethodCloseFile)        (UwValuePtr self);
 typedef bool     (*UwMethodSetFileDescriptor)(UwValuePtr self, int fd);
 typedef UwResult (*UwMethodGetFileName)      (UwValuePtr self);
 typedef bool     (*UwMethodSetFileName)      (UwValuePtr self, UwValuePtr file_name);
+typedef int      (*UwMethodGetFileDescriptor)(UwValuePtr self);
 
 // XXX other fd operation: seek, tell, etc.
 
@@ -42,6 +43,7 @@ typedef struct {
     UwMethodSetFileDescriptor set_fd;
     UwMethodGetFileName       get_name;
     UwMethodSetFileName       set_name;
+    UwMethodGetFileDescriptor get_fd;  // return -1 if file is not opened
 
 } UwInterface_File;
 
@@ -51,10 +53,18 @@ typedef struct {
 
 extern unsigned UwInterfaceId_FileReader;
 
-typedef UwResult (*UwMethodReadFile)(UwValuePtr self, void* buffer, unsigned buffer_size, unsigned* bytes_read);
+typedef UwResult (*UwMethodReadFile)    (UwValuePtr self, void* buffer, unsigned buffer_size, unsigned* bytes_read);
+typedef UwResult (*UwMethodPreadFile)   (UwValuePtr self, void* buffer, unsigned buffer_size, uint64_t offset, unsigned* bytes_read);
+typedef void     (*UwMethodSetLineRange)(UwValuePtr self, uint64_t start, uint64_t end);
+typedef void     (*UwMethodSetReadahead)(UwValuePtr self, bool enable);
 
 typedef struct {
-    UwMethodReadFile read;
+    UwMethodReadFile     read;
+    UwMethodPreadFile    pread;           // positional read, does not change file position
+    UwMethodSetLineRange set_line_range;  // limit LineReader to the range of bytes [start, end),
+                                          // zero end means the end of file
+    UwMethodSetReadahead set_readahead;   // LineReader reads next chunk in background thread,
+                                          // takes effect on next start of reading lines
 
 } UwInterface_FileReader;
 
@@ -98,12 +108,28 @@ static inline void     uw_file_close   (UwValuePtr file)         { uw_interface(
 static inline bool     uw_file_set_fd  (UwValuePtr file, int fd) { return uw_interface(file->type_id, File)->set_fd(file, fd); }
 static inline UwResult uw_file_get_name(UwValuePtr file)         { return uw_interface(file->type_id, File)->get_name(file); }
 static inline bool     uw_file_set_name(UwValuePtr file, UwValuePtr file_name)  { return uw_interface(file->type_id, File)->set_name(file, file_name); }
+static inline int      uw_file_get_fd  (UwValuePtr file)         { return uw_interface(file->type_id, File)->get_fd(file); }
 
 static inline UwResult uw_file_read(UwValuePtr file, void* buffer, unsigned buffer_size, unsigned* bytes_read)
 {
     return uw_interface(file->type_id, FileReader)->read(file, buffer, buffer_size, bytes_read);
 }
 
+static inline UwResult uw_file_pread(UwValuePtr file, void* buffer, unsigned buffer_size, uint64_t offset, unsigned* bytes_read)
+{
+    return uw_interface(file->type_id, FileReader)->pread(file, buffer, buffer_size, offset, bytes_read);
+}
+
+static inline void uw_file_set_line_range(UwValuePtr file, uint64_t start, uint64_t end)
+{
+    uw_interface(file->type_id, FileReader)->set_line_range(file, start, end);
+}
+
+static inline void uw_file_set_readahead(UwValuePtr file, bool enable)
+{
+    uw_interface(file->type_id, FileReader)->set_readahead(file, enable);
+}
+
 static inline UwResult uw_file_write(UwValuePtr file, void* data, unsigned size, unsigned* bytes_written)
 {
     return uw_interface(file->type_id, FileWriter)->write(file, data, size, bytes_written);
@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * Frozen values.
+ *
+ * uw_freeze() makes strings, arrays and maps, along with everything they
+ * contain, immortal, the same way as values loaded from snapshot:
+ * their data has UW_REFCOUNT_IMMORTAL reference count, clone and destroy
+ * do nothing and do not write to memory, mutators return UW_ERROR_READ_ONLY,
+ * and strings are copied before modification.
+ *
+ * Because reference counts are never written, pages of frozen values
+ * remain shared between processes after fork, and frozen values can be used
+ * by multiple threads without atomic reference counts.
+ *
+ * Frozen values are never released. Their memory is returned to the system
+ * only when the process exits, or when their arena ends.
+ */
+
+#include <uw_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+UwResult uw_freeze(UwValuePtr value);
+/*
+ * Freeze `value` and all values it contains.
+ * Circular references and already frozen values are allowed.
+ *
+ * Freezing must be done before sharing the value with other threads.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if the graph contains values of types
+ * other than integral, strings, arrays and maps. In this case, as well as on OOM,
+ * nothing is frozen.
+ */
+
+#ifdef __cplusplus
+}
+#endif
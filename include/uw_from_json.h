@@ -0,0 +1,47 @@
+#pragma once
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define uw_from_json(input) _Generic((input), \
+             char*: _uw_from_json_u8_wrapper,  \
+          char8_t*: _uw_from_json_u8,          \
+         char32_t*: _uw_from_json_u32,         \
+        UwValuePtr: _uw_from_json              \
+    )((input))
+/*
+ * Parse JSON from C string, String, CharPtr, or File.
+ *
+ * Files are memory mapped and parsed entirely, regardless of current position,
+ * so they must be regular files.
+ *
+ * Objects are converted to Map, arrays to Array, strings to String
+ * of the narrowest char size, integers to Signed if they fit int64 or to Unsigned otherwise,
+ * all other numbers to Float.
+ * Duplicate keys are allowed, the last value wins.
+ *
+ * Syntax errors are returned as UW_ERROR_JSON_SYNTAX status
+ * with line and column in the description.
+ */
+
+UwResult _uw_from_json(UwValuePtr input);
+
+static inline UwResult _uw_from_json_u8 (char8_t*  input) { __UWDECL_CharPtr  (v, input); return _uw_from_json(&v); }
+static inline UwResult _uw_from_json_u32(char32_t* input) { __UWDECL_Char32Ptr(v, input); return _uw_from_json(&v); }
+
+static inline UwResult _uw_from_json_u8_wrapper(char* input)
+{
+    return _uw_from_json_u8((char8_t*) input);
+}
+
+UwResult uw_from_json_buffer(char8_t* data, size_t size);
+/*
+ * Parse JSON from UTF-8 buffer.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,7 +20,9 @@ typedef struct __UwInterface _UwInterface;
 /*
  * Built-in interfaces
  */
-#define UwInterfaceId_LineReader    0  // iterator interface
+#define UwInterfaceId_LineReader    0  // iterator interfaces
+#define UwInterfaceId_ByteReader    1
+#define UwInterfaceId_CharReader    2
 
 /*
 // TBD, TODO
@@ -65,28 +67,34 @@ char* uw_get_interface_name(unsigned interface_id);
  * Get registered interface name by id.
  */
 
-static inline _UwInterface* _uw_lookup_interface(UwTypeId type_id, unsigned interface_id)
+static inline void** _uw_lookup_interface(UwTypeId type_id, unsigned interface_id)
+/*
+ * Return pointer to interface methods or nullptr if type does not implement the interface.
+ */
 {
     UwType* type = _uw_types[type_id];
-    _UwInterface* iface = type->interfaces;
-    if (iface) {
-        unsigned i = 0;
-        do {
-            if (iface->interface_id == interface_id) {
-                return iface;
-            }
-            iface++;
-            i++;
-        } while (i < type->num_interfaces);
+    if (_uw_likely(interface_id < type->interface_table_size)) {
+        return type->interface_table[interface_id];
+    }
+    _UwInterface* hash = type->interface_hash;
+    if (!hash) {
+        return nullptr;
+    }
+    for (unsigned i = interface_id & type->interface_hash_mask;; i = (i + 1) & type->interface_hash_mask) {
+        if (!hash[i].interface_methods) {
+            return nullptr;
+        }
+        if (hash[i].interface_id == interface_id) {
+            return hash[i].interface_methods;
+        }
     }
-    return nullptr;
 }
 
 static inline void* _uw_get_interface(UwTypeId type_id, unsigned interface_id)
 {
-    _UwInterface* result = _uw_lookup_interface(type_id, interface_id);
-    if (result) {
-        return result->interface_methods;
+    void** result = _uw_lookup_interface(type_id, interface_id);
+    if (_uw_likely(result)) {
+        return result;
     }
     _uw_panic_no_interface(type_id, interface_id);
 }
@@ -108,6 +116,15 @@ static inline bool _uw_has_interface(UwTypeId type_id, unsigned interface_id)
  * Calling super method:
  *
  * uw_interface(UwTypeId_AncestorOfReader, LineReader)->read_line(reader);
+ *
+ * Interface methods never change once the type is created, so loops
+ * can look them up once and keep the pointer:
+ *
+ * UwInterface_LineReader* line_reader = uw_interface(reader->type_id, LineReader);
+ * for (;;) {{
+ *     UwValue line = line_reader->read_line(reader);
+ *     ...
+ * }}
  */
 #define uw_interface(type_id, interface_name)  \
     (  \
@@ -40,6 +40,30 @@ typedef UwResult (*UwMethodReadLineInPlace)(UwValuePtr self, UwValuePtr line);
  * On the contrary, existing line is a pre-allocated buffer for the next one.
  */
 
+typedef struct {
+    /*
+     * Borrowed line returned by read_line_view.
+     * Characters are stored in the native format of strings:
+     * `char_size` bytes per character, little endian.
+     */
+    uint8_t* ptr;
+    unsigned length;     // in characters
+    uint8_t  char_size;  // 1-based
+} UwLineView;
+
+typedef UwResult (*UwMethodReadLineView)(UwValuePtr self, UwLineView* view);
+/*
+ * Read next line without copying it, if possible.
+ *
+ * The view points either to reader's internal buffer or to the line
+ * stored in the iterable and remains valid until the next read
+ * or until the reader is stopped.
+ *
+ * Lines that cannot be referenced directly, e.g. lines of a File
+ * that cross buffer boundaries or contain non-ASCII characters,
+ * are decoded into reader's internal string and the view points to it.
+ */
+
 typedef bool (*UwMethodUnreadLine)(UwValuePtr self, UwValuePtr line);
 /*
  * Push line back to the reader.
@@ -61,6 +85,7 @@ typedef struct {
     UwMethodStartReadLines  start;
     UwMethodReadLine        read_line;
     UwMethodReadLineInPlace read_line_inplace;
+    UwMethodReadLineView    read_line_view;
     UwMethodUnreadLine      unread_line;
     UwMethodGetLineNumber   get_line_number;
     UwMethodStopReadLines   stop;
@@ -74,10 +99,92 @@ typedef struct {
 static inline UwResult uw_start_read_lines (UwValuePtr reader) { return uw_interface(reader->type_id, LineReader)->start(reader); }
 static inline UwResult uw_read_line        (UwValuePtr reader) { return uw_interface(reader->type_id, LineReader)->read_line(reader); }
 static inline UwResult uw_read_line_inplace(UwValuePtr reader, UwValuePtr line) { return uw_interface(reader->type_id, LineReader)->read_line_inplace(reader, line); }
+static inline UwResult uw_read_line_view   (UwValuePtr reader, UwLineView* view) { return uw_interface(reader->type_id, LineReader)->read_line_view(reader, view); }
 static inline bool     uw_unread_line      (UwValuePtr reader, UwValuePtr line) { return uw_interface(reader->type_id, LineReader)->unread_line(reader, line); }
 static inline unsigned uw_get_line_number  (UwValuePtr reader) { return uw_interface(reader->type_id, LineReader)->get_line_number(reader); }
 static inline void     uw_stop_read_lines  (UwValuePtr reader) { uw_interface(reader->type_id, LineReader)->stop(reader); }
 
+/****************************************************************
+ * ByteReader interface
+ *
+ * Values that implement more than one reader interface
+ * may share the state between them. In this case calling
+ * any start method resets all readers.
+ */
+
+typedef UwResult (*UwMethodStartReadBytes)(UwValuePtr self);
+/*
+ * Prepare to read bytes.
+ * Calling this method again should reset byte reader.
+ */
+
+typedef UwResult (*UwMethodReadBytes)(UwValuePtr self, void* buffer, unsigned buffer_size, unsigned* bytes_read);
+/*
+ * Read up to `buffer_size` bytes into `buffer`.
+ * Write the number of bytes read to `bytes_read`, it can be less than
+ * buffer_size only if the end of data is reached.
+ *
+ * Return UW_ERROR_EOF if no more data.
+ */
+
+typedef void (*UwMethodStopReadBytes)(UwValuePtr self);
+/*
+ * Free internal buffers.
+ */
+
+typedef struct {
+    UwMethodStartReadBytes start;
+    UwMethodReadBytes      read_bytes;
+    UwMethodStopReadBytes  stop;
+
+} UwInterface_ByteReader;
+
+static inline UwResult uw_start_read_bytes(UwValuePtr reader) { return uw_interface(reader->type_id, ByteReader)->start(reader); }
+static inline void     uw_stop_read_bytes (UwValuePtr reader) { uw_interface(reader->type_id, ByteReader)->stop(reader); }
+
+static inline UwResult uw_read_bytes(UwValuePtr reader, void* buffer, unsigned buffer_size, unsigned* bytes_read)
+{
+    return uw_interface(reader->type_id, ByteReader)->read_bytes(reader, buffer, buffer_size, bytes_read);
+}
+
+/****************************************************************
+ * CharReader interface
+ */
+
+typedef UwResult (*UwMethodStartReadChars)(UwValuePtr self);
+/*
+ * Prepare to read characters.
+ * Calling this method again should reset character reader.
+ */
+
+typedef UwResult (*UwMethodReadChars)(UwValuePtr self, UwValuePtr dest, unsigned max_chars);
+/*
+ * Truncate `dest` string and read up to `max_chars` characters into it.
+ * Less than max_chars characters can be read only if the end of data is reached.
+ *
+ * Return UW_ERROR_EOF if no more data.
+ */
+
+typedef void (*UwMethodStopReadChars)(UwValuePtr self);
+/*
+ * Free internal buffers.
+ */
+
+typedef struct {
+    UwMethodStartReadChars start;
+    UwMethodReadChars      read_chars;
+    UwMethodStopReadChars  stop;
+
+} UwInterface_CharReader;
+
+static inline UwResult uw_start_read_chars(UwValuePtr reader) { return uw_interface(reader->type_id, CharReader)->start(reader); }
+static inline void     uw_stop_read_chars (UwValuePtr reader) { uw_interface(reader->type_id, CharReader)->stop(reader); }
+
+static inline UwResult uw_read_chars(UwValuePtr reader, UwValuePtr dest, unsigned max_chars)
+{
+    return uw_interface(reader->type_id, CharReader)->read_chars(reader, dest, max_chars);
+}
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * Lazily materialized JSON document.
+ *
+ * Parsing builds only a compact structural tape, one 64-bit entry
+ * per container start and end, string, number, and literal.
+ * Container start entries hold the index of the next sibling,
+ * so unneeded subtrees are skipped in constant time.
+ *
+ * Values are created only for the leaves and subtrees requested
+ * by uw_json_get.
+ */
+
+#include <stdarg.h>
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UwTypeId UwTypeId_JsonDocument;
+
+typedef struct {
+    UwValuePtr input;  // C string, String, CharPtr, or File
+} UwJsonDocumentCtorArgs;
+
+#define uw_json_document(input) _Generic((input), \
+             char*: _uw_json_document_u8_wrapper,  \
+          char8_t*: _uw_json_document_u8,          \
+         char32_t*: _uw_json_document_u32,         \
+        UwValuePtr: _uw_json_document              \
+    )((input))
+/*
+ * Parse JSON from the same inputs as uw_from_json and return JsonDocument.
+ *
+ * The document keeps a copy of input in UTF-8, files are kept memory mapped.
+ *
+ * The structure is fully validated. Strings and numbers are validated
+ * when they are materialized, so uw_json_get may return UW_ERROR_JSON_SYNTAX.
+ */
+
+UwResult _uw_json_document(UwValuePtr input);
+
+static inline UwResult _uw_json_document_u8 (char8_t*  input) { __UWDECL_CharPtr  (v, input); return _uw_json_document(&v); }
+static inline UwResult _uw_json_document_u32(char32_t* input) { __UWDECL_Char32Ptr(v, input); return _uw_json_document(&v); }
+
+static inline UwResult _uw_json_document_u8_wrapper(char* input)
+{
+    return _uw_json_document_u8((char8_t*) input);
+}
+
+#define uw_json_get(doc, ...)  _uw_json_get((doc) __VA_OPT__(,) __VA_ARGS__, UwVaEnd())
+/*
+ * Walk the path and materialize the value at its end.
+ *
+ * Path items are passed by value: strings (or CharPtr) for object keys
+ * and integers for array indices, e.g.
+ *
+ *   uw_json_get(&doc, UwCharPtr("a"), UwCharPtr("b"), UwUnsigned(3))
+ *
+ * Empty path materializes the whole document.
+ * Duplicate keys are resolved as in uw_from_json, the last one wins.
+ *
+ * Return UW_ERROR_KEY_NOT_FOUND or UW_ERROR_INDEX_OUT_OF_RANGE
+ * if the path does not exist, and UW_ERROR_INCOMPATIBLE_TYPE
+ * if a key is applied to non-object or an index to non-array.
+ */
+
+UwResult _uw_json_get(UwValuePtr doc, ...);
+UwResult uw_json_get_ap(UwValuePtr doc, va_list ap);
+
+unsigned uw_json_tape_length(UwValuePtr doc);
+/*
+ * Return the number of tape entries.
+ */
+
+#ifdef __cplusplus
+}
+#endif
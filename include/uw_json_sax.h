@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+ * Streaming JSON parser.
+ *
+ * Unlike uw_from_json, it reads input in chunks from any value
+ * that provides ByteReader interface, i.e. File or StringIO,
+ * and reports parsed items to the handler as they go,
+ * so memory use does not depend on the size of input.
+ */
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// events
+#define UW_JSON_START_OBJECT  1
+#define UW_JSON_END_OBJECT    2
+#define UW_JSON_START_ARRAY   3
+#define UW_JSON_END_ARRAY     4
+#define UW_JSON_KEY           5
+#define UW_JSON_VALUE         6
+
+// actions returned by event handler
+#define UW_JSON_CONTINUE      0
+#define UW_JSON_SKIP          1
+#define UW_JSON_MATERIALIZE   2
+#define UW_JSON_STOP          3
+
+typedef unsigned (*UwJsonEventHandler)(unsigned event, UwValuePtr value, unsigned depth, void* arg);
+/*
+ * Event handler.
+ *
+ * `value` is the key for UW_JSON_KEY, the item for UW_JSON_VALUE,
+ * and nullptr for other events. The handler may take it with uw_move.
+ *
+ * `depth` is the nesting level: top-level value is at depth 0,
+ * members of top-level object or array and their keys are at depth 1, and so on.
+ * Start and end events have the depth of the container.
+ *
+ * The handler returns one of actions:
+ *
+ * UW_JSON_CONTINUE:    proceed with the next event.
+ * UW_JSON_SKIP:        after UW_JSON_START_OBJECT or UW_JSON_START_ARRAY
+ *                      skip the container without further events, including its end;
+ *                      after UW_JSON_KEY skip the value of that key.
+ * UW_JSON_MATERIALIZE: after UW_JSON_START_OBJECT or UW_JSON_START_ARRAY
+ *                      build the container and report it with UW_JSON_VALUE
+ *                      instead of its contents and end event;
+ *                      after UW_JSON_KEY do the same for the value of that key.
+ * UW_JSON_STOP:        stop parsing, uw_json_parse_events returns success.
+ *
+ * SKIP and MATERIALIZE have no effect on other events.
+ */
+
+UwResult uw_json_parse_events(UwValuePtr reader, UwJsonEventHandler handler, void* arg);
+/*
+ * Parse JSON from `reader` and call `handler` for each event.
+ *
+ * The reader is started with uw_start_read_bytes and stopped when parsing is done.
+ *
+ * Values are converted the same way as in uw_from_json.
+ * Skipped strings are not decoded, only the structure is validated.
+ *
+ * Syntax errors are returned as UW_ERROR_JSON_SYNTAX status
+ * with line and column in the description.
+ * Events emitted before the error are not revoked.
+ */
+
+#ifdef __cplusplus
+}
+#endif
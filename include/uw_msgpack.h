@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * MessagePack serialization.
+ *
+ * Values are mapped as follows:
+ *
+ *   Null              <-> nil
+ *   Bool              <-> false, true
+ *   Signed, Unsigned  <-> int and uint families, the shortest form is used;
+ *                         decoded as Signed if they fit int64, as Unsigned otherwise
+ *   Float             <-> float 32 if lossless, float 64 otherwise
+ *   String, CharPtr   <-> str, any char size is encoded as UTF-8;
+ *                         decoded strings have the narrowest char size
+ *   Array             <-> array
+ *   Map               <-> map, keys can be of any supported type
+ *   Timestamp         <-> timestamp extension type (-1), the shortest form is used
+ *   DateTime          <-> timestamp extension type, converted to UTC;
+ *                         MessagePack has no type for local time, so it is decoded
+ *                         as Timestamp, or as UTC DateTime if it's before 1970
+ *
+ * bin and other extension types are not supported.
+ */
+
+#include <uw.h>
+#include <uw_sink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+UwResult uw_to_msgpack_write(UwValuePtr value, UwSink* sink);
+/*
+ * Encode `value` and write it to the sink.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if `value` contains
+ * anything but the types listed above.
+ * On error, some output may have been written already.
+ */
+
+UwResult uw_from_msgpack(UwValuePtr file);
+/*
+ * Decode MessagePack object from File.
+ *
+ * Files are memory mapped and decoded entirely, regardless of current position,
+ * so they must be regular files.
+ */
+
+UwResult uw_from_msgpack_buffer(uint8_t* data, size_t size);
+/*
+ * Decode MessagePack object from memory.
+ *
+ * Malformed data is reported as UW_ERROR_MALFORMED_DATA status
+ * with the offset in the description.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * Reader for newline-delimited JSON (NDJSON, JSON Lines).
+ *
+ * Lines are read on the calling thread and passed in batches
+ * to a pool of workers that parse them in parallel.
+ * Records are returned in order of lines.
+ *
+ * The number of batches in flight is limited by the queue size,
+ * so reading stops when workers or the consumer fall behind.
+ *
+ * NdjsonReader is not thread safe, it should be used by a single thread.
+ */
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UwTypeId UwTypeId_NdjsonReader;
+
+typedef struct {
+    UwValuePtr line_reader;  // value that supports LineReader interface, e.g. File
+    unsigned   num_workers;  // zero means the number of online CPUs
+    unsigned   queue_size;   // max number of batches in flight, default is twice the number of workers
+    unsigned   batch_size;   // max number of lines in a batch, default is 256
+} UwNdjsonReaderCtorArgs;
+
+UwResult uw_create_ndjson_reader(UwValuePtr line_reader);
+/*
+ * Create NdjsonReader with default parameters.
+ * For other parameters use uw_create2(UwTypeId_NdjsonReader, &ctor_args)
+ *
+ * The reader keeps a clone of line_reader and starts reading lines
+ * from the beginning. The line reader must not be used by anyone else
+ * until NdjsonReader is destroyed.
+ */
+
+UwResult uw_ndjson_read(UwValuePtr reader);
+/*
+ * Return next record.
+ *
+ * Empty lines are skipped.
+ * If a line is not valid JSON, return UW_ERROR_JSON_SYNTAX status
+ * with line and column in the description; reading can be continued.
+ *
+ * Return UW_ERROR_EOF if no more records.
+ * Other errors are fatal.
+ */
+
+unsigned uw_ndjson_line_number(UwValuePtr reader);
+/*
+ * Return line number of the last record returned by uw_ndjson_read.
+ */
+
+UwResult uw_ndjson_read_batch(UwValuePtr reader, unsigned max_records, UwValuePtr errors);
+/*
+ * Return Array of up to `max_records` next records.
+ *
+ * Lines that are not valid JSON are not included in the result.
+ * If `errors` is not nullptr, it must be a Map; line numbers of such lines
+ * are added to it as keys, with error descriptions as values.
+ *
+ * Return UW_ERROR_EOF if no more records.
+ */
+
+typedef UwResult (*UwNdjsonHandler)(UwValuePtr record, unsigned line_number, void* arg);
+/*
+ * Process record. The handler may take it with uw_move.
+ *
+ * `record` is UW_ERROR_JSON_SYNTAX status if the line is not valid JSON.
+ *
+ * Return error to abort processing.
+ */
+
+UwResult uw_ndjson_process(UwValuePtr reader, UwNdjsonHandler handler, void* arg);
+/*
+ * Call `handler` for all remaining records.
+ *
+ * Return OK when all records are processed, otherwise the status
+ * returned by handler or fatal error.
+ */
+
+#ifdef __cplusplus
+}
+#endif
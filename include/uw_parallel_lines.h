@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * Parallel processing of lines of a single large file.
+ *
+ * The file is split into byte ranges aligned to line boundaries
+ * and each range is processed on its own worker thread.
+ */
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef UwResult (*UwProcessChunk)(UwValuePtr line_reader, UwValuePtr partial, void* arg);
+/*
+ * Process lines of a chunk.
+ *
+ * `line_reader` is a File limited to the chunk with uw_file_set_line_range.
+ * It is already opened and ready for uw_read_line, uw_read_line_inplace or uw_read_line_view.
+ * Line numbers returned by uw_get_line_number are counted from the start of chunk.
+ *
+ * `partial` is per-worker Array or Map to store results to.
+ *
+ * Return error to abort processing.
+ */
+
+typedef UwResult (*UwMergeValues)(UwValuePtr key, UwValuePtr merged_value, UwValuePtr value, void* arg);
+/*
+ * Merge value from partial Map with already merged value for the same key.
+ * Return new value for the key.
+ */
+
+typedef struct {
+    unsigned       num_workers;   // zero means the number of online CPUs
+    UwTypeId       partial_type;  // UwTypeId_Array or UwTypeId_Map, default is Array
+    UwProcessChunk process_chunk;
+    UwMergeValues  merge_values;  // for maps only, if null, the value from the latter chunk wins
+    void*          arg;           // passed to callbacks
+} UwParallelLines;
+
+UwResult uw_file_split_lines(UwValuePtr file_name, unsigned num_chunks);
+/*
+ * Split regular file into `num_chunks` byte ranges aligned to line boundaries.
+ *
+ * Return array of num_chunks + 1 Unsigned offsets, the first one is always 0,
+ * the last one is file size. Some ranges may be empty, that's the case
+ * for small files or very long lines.
+ */
+
+UwResult uw_file_process_lines_parallel(UwValuePtr file_name, UwParallelLines* params);
+/*
+ * Split file into chunks and call params->process_chunk for each one on its own thread.
+ * Callbacks must not share UW values across threads.
+ *
+ * Partial results are merged on the calling thread in order of chunks:
+ * arrays are concatenated, maps are updated.
+ *
+ * Return merged result or the status of the first failed chunk.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * Sink is a destination for serialized data.
+ *
+ * It's not a value, it's a small structure that is usually
+ * allocated on the stack and wraps one of the following:
+ *
+ *   - a value that supports FileWriter interface, i.e. File or StringIO;
+ *   - stdio FILE*;
+ *   - growable memory buffer.
+ */
+
+#include <stdio.h>
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _UwSink UwSink;
+
+typedef UwResult (*UwMethodSinkWrite)(UwSink* sink, void* data, unsigned size);
+
+struct _UwSink {
+    UwMethodSinkWrite write;
+
+    UwValuePtr writer;    // for FileWriter sink
+    FILE*      fp;        // for stdio sink
+
+    // for memory buffer sink
+    char8_t*   data;
+    unsigned   size;
+    unsigned   capacity;
+};
+
+UwResult uw_sink_init_writer(UwSink* sink, UwValuePtr writer);
+/*
+ * Initialize sink for a value that supports FileWriter interface.
+ * The sink does not own the value, it must outlive the sink.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if the value does not support FileWriter.
+ */
+
+void uw_sink_init_stdio(UwSink* sink, FILE* fp);
+/*
+ * Initialize sink for stdio stream.
+ */
+
+void uw_sink_init_buffer(UwSink* sink);
+/*
+ * Initialize sink for memory buffer.
+ * Written data is available as `data` and `size` fields.
+ */
+
+void uw_sink_fini(UwSink* sink);
+/*
+ * Release memory buffer.
+ * Other kinds of sink are not closed.
+ */
+
+static inline UwResult uw_sink_write(UwSink* sink, void* data, unsigned size)
+/*
+ * Write all `size` bytes of `data` to the sink.
+ */
+{
+    return sink->write(sink, data, size);
+}
+
+void uw_dump_sink(UwSink* sink, UwValuePtr value);
+/*
+ * Same as uw_dump, but write to the sink.
+ */
+
+#ifdef __cplusplus
+}
+#endif
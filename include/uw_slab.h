@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Slab allocator for fixed-size blocks.
+ *
+ * Blocks up to UW_SLAB_MAX_BLOCK_SIZE bytes are rounded up to size classes,
+ * which are multiples of UW_SLAB_GRANULARITY up to 128 bytes and then
+ * four classes per power of two.
+ *
+ * Each thread has its own cache with a free list and a slab to carve
+ * new blocks from per size class, so allocations and releases take
+ * no locks. Released blocks are returned to the cache that owns their
+ * slab: directly, if released by the same thread, or through lock-free
+ * remote queue, which the owner takes when its free list is exhausted.
+ * Thus blocks allocated by one thread and released by another
+ * are reused by the former. Caches of exited threads are adopted
+ * by new threads.
+ *
+ * Larger blocks are passed to default_allocator.
+ *
+ * Slabs are mapped directly from the system and never returned,
+ * so the memory is retained at the peak number of blocks per class.
+ * Stats are not updated on every call, use uw_slab_update_stats()
+ * before reading them.
+ *
+ * Built-in struct types use uw_slab_allocator by default.
+ * String data is allocated from a separate pool, uw_string_pool_allocator,
+ * with size classes up to UW_STRING_POOL_MAX_BLOCK_SIZE.
+ */
+
+#include <libpussy/allocator.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UW_SLAB_GRANULARITY     16
+#define UW_SLAB_MAX_BLOCK_SIZE  512
+#define UW_SLAB_SIZE            (64 * 1024)
+
+#define UW_STRING_POOL_MAX_BLOCK_SIZE  1024
+
+extern Allocator uw_slab_allocator;
+extern Allocator uw_string_pool_allocator;
+
+void uw_slab_update_stats();
+/*
+ * Set blocks_allocated in stats of uw_slab_allocator and uw_string_pool_allocator
+ * to the number of blocks currently allocated from slabs.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * Native snapshots.
+ *
+ * Snapshot is a file that contains values laid out exactly as they are
+ * in memory: strings keep their char size, arrays and maps keep their items
+ * and prebuilt hash tables. Opening a snapshot maps the file into memory
+ * and returns values backed by the mapping, without parsing and without
+ * allocating anything per value, so loading time does not depend
+ * on the size of data.
+ *
+ * Supported types are Null, Bool, Signed, Unsigned, Float, DateTime, Timestamp,
+ * String, CharPtr (stored as String), Array and Map. Shared strings and containers
+ * are stored once and remain shared. Zone info index of DateTime is not preserved.
+ *
+ * Values loaded from snapshot are immortal: their data has UW_REFCOUNT_IMMORTAL
+ * reference count, clone and destroy do nothing, mutators return UW_ERROR_READ_ONLY,
+ * and strings are copied before modification.
+ * The memory is mapped read-only, so the values can't be damaged by accident.
+ * Deep copy makes ordinary mutable values.
+ *
+ * Values are valid until the Snapshot value is destroyed.
+ *
+ * Snapshots are meant for the same build of the library on the same platform
+ * and are trusted, i.e. not validated beyond the header.
+ */
+
+#include <uw.h>
+#include <uw_sink.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UwTypeId UwTypeId_Snapshot;
+
+UwResult uw_snapshot_write(UwValuePtr value, UwSink* sink);
+/*
+ * Write snapshot of `value` to the sink.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if `value` contains
+ * anything but the types listed above.
+ * On error, some output may have been written already.
+ */
+
+UwResult uw_snapshot_open(UwValuePtr file);
+/*
+ * Map snapshot file into memory and return Snapshot value.
+ * The file must be regular and may be closed after this call.
+ *
+ * Snapshots are written for a preferred address so they need
+ * no relocation when mapped at it. If the address is taken,
+ * for example when the same snapshot is opened twice, pointers
+ * are relocated, touching all pages of the file.
+ * Otherwise, only map headers are touched, to set hash table
+ * functions, the rest of data is paged in on access.
+ *
+ * Return UW_ERROR_MALFORMED_DATA if the file is not a snapshot
+ * or was written by an incompatible version.
+ */
+
+UwValuePtr uw_snapshot_root(UwValuePtr snapshot);
+/*
+ * Return borrowed pointer to the root value of snapshot.
+ */
+
+#ifdef __cplusplus
+}
+#endif
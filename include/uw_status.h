@@ -32,6 +32,21 @@ extern "C" {
 // StringIO errors
 #define UW_ERROR_UNREAD_FAILED        14
 
+// AsyncReader errors
+#define UW_ERROR_ASYNC_QUEUE_FULL     15
+
+// JSON errors
+#define UW_ERROR_JSON_SYNTAX          16
+
+// ValuePath errors
+#define UW_ERROR_BAD_PATH             17
+
+// Binary serialization errors
+#define UW_ERROR_MALFORMED_DATA       18
+
+// Immortal values
+#define UW_ERROR_READ_ONLY            19
+
 uint16_t uw_define_status(char* status);
 /*
  * Define status in the global table.
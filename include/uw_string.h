@@ -3,6 +3,7 @@
 #include <ctype.h>
 
 #include <uw_assert.h>
+#include <uw_iterator.h>
 #include <uw_types.h>
 
 #ifdef UW_WITH_ICU
@@ -676,6 +677,22 @@ UwResult uw_string_to_float(UwValuePtr str);
         v;  \
     })
 
+/****************************************************************
+ * Iterator
+ */
+
+extern UwTypeId UwTypeId_StringIterator;
+
+static inline UwResult uw_string_iterator(UwValuePtr str)
+/*
+ * Return StringIterator that supports CharReader interface.
+ * `str` can be either String or CharPtr.
+ */
+{
+    UwIteratorCtorArgs args = { .iterable = str };
+    return uw_create2(UwTypeId_StringIterator, &args);
+}
+
 /****************************************************************
  * C strings
  */
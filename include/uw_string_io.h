@@ -1,8 +1,11 @@
 #pragma once
 
 /*
- * StringIO provides LineReader interface.
+ * StringIO provides LineReader, ByteReader and CharReader interfaces.
  * It's a singleton iterator for self.
+ *
+ * It also provides FileWriter interface that appends UTF-8 data
+ * to the string.
  */
 
 #include <uw.h>
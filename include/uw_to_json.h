@@ -1,6 +1,7 @@
 #pragma once
 
 #include <uw.h>
+#include <uw_sink.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +12,59 @@ UwResult uw_to_json(UwValuePtr value, unsigned indent);
  * Convert `value` to JSON string.
  *
  * If `indent` is nonzero, the result is formatted with indentation.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if `value` contains anything
+ * but Null, Bool, numbers, strings, Array, and Map with string keys.
+ */
+
+UwResult uw_to_json_write(UwValuePtr value, unsigned indent, UwSink* sink);
+/*
+ * Same as uw_to_json, but write UTF-8 output to the sink in chunks
+ * instead of building the whole string in memory.
+ *
+ * On error, some output may have been written already.
+ */
+
+/*
+ * Encoder plans for records of fixed shape.
+ *
+ * A plan holds pre-escaped key fragments and writers specialized
+ * for value types, so records that match it are written without
+ * escaping keys and checking types of values.
+ * Records that do not match are written by the generic path,
+ * so the output is always the same as of uw_to_json(value, 0).
+ */
+
+extern UwTypeId UwTypeId_JsonPlan;
+
+typedef struct {
+    UwValuePtr shape;  // template Map or Array of keys
+} UwJsonPlanCtorArgs;
+
+UwResult uw_json_plan(UwValuePtr shape);
+/*
+ * Compile plan from `shape`, which is either a template Map
+ * or an Array of keys.
+ *
+ * Types of values in the template map select value writers.
+ * Plans compiled from keys use the generic writer for values.
+ *
+ * Return UW_ERROR_INCOMPATIBLE_TYPE if keys are not strings.
+ */
+
+UwResult uw_json_plan_to_json(UwValuePtr plan, UwValuePtr value);
+/*
+ * Convert `value` to compact JSON string using the plan.
+ *
+ * The plan applies to `value` if it is a Map or to items of `value`
+ * if it is an Array of records. A map matches the plan when it has
+ * the same keys in the same order; values may have any type,
+ * values of types other than in the template are written by the generic path.
+ */
+
+UwResult uw_json_plan_write(UwValuePtr plan, UwValuePtr value, UwSink* sink);
+/*
+ * Same as uw_json_plan_to_json, but write to the sink.
  */
 
 #ifdef __cplusplus
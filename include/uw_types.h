@@ -8,6 +8,7 @@
 #include <libpussy/allocator.h>
 
 #include <uw_helpers.h>
+#include <uw_slab.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -127,6 +128,52 @@ typedef struct {
     };
 } _UwStructData;
 
+#define UW_REFCOUNT_IMMORTAL  0xFFFF'FFFFU
+/*
+ * Reference count of struct and string data that is never released,
+ * such as data of values loaded from snapshot.
+ * Such data is read-only: clone and destroy do not modify the reference count
+ * and mutators return UW_ERROR_READ_ONLY.
+ */
+
+/*
+ * Reference counts are updated with the following functions.
+ *
+ * If UW_ATOMIC_REFCOUNT is defined, they are atomic: increments are relaxed
+ * and decrements are acq_rel, so values can be cloned and destroyed
+ * by different threads. Otherwise they are plain loads and stores.
+ */
+
+static inline unsigned _uw_refcount_load(unsigned* refcount)
+{
+#ifdef UW_ATOMIC_REFCOUNT
+    return __atomic_load_n(refcount, __ATOMIC_ACQUIRE);
+#else
+    return *refcount;
+#endif
+}
+
+static inline void _uw_refcount_inc(unsigned* refcount)
+{
+#ifdef UW_ATOMIC_REFCOUNT
+    __atomic_fetch_add(refcount, 1, __ATOMIC_RELAXED);
+#else
+    (*refcount)++;
+#endif
+}
+
+static inline unsigned _uw_refcount_dec(unsigned* refcount)
+/*
+ * Decrement reference count and return new value.
+ */
+{
+#ifdef UW_ATOMIC_REFCOUNT
+    return __atomic_sub_fetch(refcount, 1, __ATOMIC_ACQ_REL);
+#else
+    return --(*refcount);
+#endif
+}
+
 // make sure largest C type fits into 64 bits
 static_assert( sizeof(long long) <= sizeof(uint64_t) );
 
@@ -312,6 +359,11 @@ typedef UwResult (*UwMethodInit)(UwValuePtr self, void* ctor_args);
 typedef void     (*UwMethodFini)(UwValuePtr self);
 
 
+#define UW_MAX_TYPE_DEPTH  8
+/*
+ * Maximal length of the chain of ancestors, including the type itself.
+ */
+
 typedef struct {
     /*
      * UW type
@@ -319,6 +371,14 @@ typedef struct {
     UwTypeId id;
     UwTypeId ancestor_id;
     char* name;
+
+    // Ancestry display for subtype checks in constant time,
+    // initialized when type is added:
+    // ancestors[depth] is the type itself, ancestors[0] is the root of hierarchy,
+    // the rest of items is zero.
+    unsigned depth;
+    UwTypeId ancestors[UW_MAX_TYPE_DEPTH];
+
     Allocator* allocator;
 
     // basic interface
@@ -334,6 +394,13 @@ typedef struct {
     UwMethodEqual    equal_sametype;  // mandatory
     UwMethodEqual    equal;     // mandatory
 
+    // Traits computed from basic methods when type is added:
+    // trivially destructible types have no destroy method,
+    // values of trivially clonable types are copied as is by clone and deepcopy.
+    // Containers take advantage of them for bulk operations.
+    bool trivially_destructible;
+    bool trivially_clonable;
+
     // struct data offset and size
     unsigned data_offset;
     unsigned data_size;
@@ -354,6 +421,15 @@ typedef struct {
     // other interfaces
     unsigned num_interfaces;
     _UwInterface* interfaces;
+
+    // Dispatch tables built from interfaces, see _uw_lookup_interface:
+    // methods of interfaces with id less than interface_table_size
+    // are indexed directly by interface id, the rest are in a small
+    // open addressing hash table, empty slots have nullptr methods.
+    unsigned interface_table_size;
+    void*** interface_table;
+    unsigned interface_hash_mask;
+    _UwInterface* interface_hash;
 } UwType;
 
 
@@ -381,15 +457,11 @@ extern UwType** _uw_types;
 static inline bool uw_is_subtype(UwValuePtr value, UwTypeId type_id)
 {
     UwTypeId t = value->type_id;
-    for (;;) {
-        if (_uw_likely(t == type_id)) {
-            return true;
-        }
-        t = _uw_types[t]->ancestor_id;
-        if (_uw_likely(t == UwTypeId_Null)) {
-            return false;
-        }
+    if (_uw_likely(t == type_id)) {
+        return true;
     }
+    // type_id is an ancestor if it's found at its own depth in the ancestry display of t
+    return _uw_types[t]->ancestors[_uw_types[type_id]->depth] == type_id;
 }
 
 UwTypeId _uw_add_type(UwType* type, ...);
@@ -784,6 +856,15 @@ static inline UwResult uw_deepcopy(UwValuePtr value)
     }
 }
 
+static inline bool _uw_is_trivial(UwValuePtr value)
+/*
+ * Check if value can be copied with memcpy and dropped without destroy.
+ */
+{
+    UwType* t = uw_typeof(value);
+    return t->trivially_destructible && t->trivially_clonable;
+}
+
 static inline bool uw_is_true(UwValuePtr value)
 {
     return uw_typeof(value)->is_true(value);
@@ -816,6 +897,43 @@ static inline void* _uw_get_data_ptr(UwValuePtr v, UwTypeId type_id)
     }
 }
 
+static inline bool _uw_is_immortal(UwValuePtr value)
+/*
+ * Check if struct data is immortal.
+ */
+{
+    return value->struct_data && _uw_refcount_load(&value->struct_data->refcount) == UW_REFCOUNT_IMMORTAL;
+}
+
+/****************************************************************
+ * Arenas, see uw_arena.h
+ */
+
+extern uintptr_t _uw_arena_region_start;
+extern uintptr_t _uw_arena_region_size;
+
+static inline bool _uw_in_arena(void* data)
+/*
+ * Check if data is allocated in an arena.
+ */
+{
+    return (uintptr_t) data - _uw_arena_region_start < _uw_arena_region_size;
+}
+
+bool _uw_arena_import(UwValuePtr parent, UwValuePtr child);
+/*
+ * Prepare child for storing into arena container:
+ * replace values from outside with their deep copies.
+ *
+ * Return false if OOM.
+ */
+
+void _uw_arena_check_escape(UwValuePtr child);
+/*
+ * Panic if child is allocated in an arena.
+ * Used by debug builds when storing values into containers outside of arenas.
+ */
+
 /****************************************************************
  * API for compound types
  */
@@ -848,8 +966,29 @@ bool _uw_need_break_cyclic_refs(UwValuePtr value);
  * Check if all parents have zero refcount and there are cyclic references.
  */
 
+static inline bool _uw_arena_store(UwValuePtr parent, UwValuePtr child)
+/*
+ * Arena checks for values stored into containers without adopting.
+ */
+{
+    if (_uw_in_arena(parent->struct_data)) {
+        return _uw_arena_import(parent, child);
+    }
+#ifdef DEBUG
+    _uw_arena_check_escape(child);
+#endif
+    return true;
+}
+
 static inline bool _uw_embrace(UwValuePtr parent, UwValuePtr child)
 {
+    if (_uw_in_arena(parent->struct_data)) {
+        // arena containers do not track parents
+        return _uw_arena_import(parent, child);
+    }
+#ifdef DEBUG
+    _uw_arena_check_escape(child);
+#endif
     if (uw_is_compound(child)) {
         return _uw_adopt(parent, child);
     } else {
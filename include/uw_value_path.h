@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+ * Compiled paths for drilling into nested Map and Array values.
+ *
+ * Path expression is compiled once into a sequence of steps
+ * with prehashed keys and then evaluated against any number of values.
+ * Evaluation does not clone anything, results are borrowed pointers
+ * into the value, valid until it is modified or destroyed.
+ *
+ * Two syntaxes are supported:
+ *
+ *   JSON Pointer (RFC 6901), if expression starts with slash:
+ *
+ *       /a/b/3/c~1d
+ *
+ *   dotted names and brackets, otherwise:
+ *
+ *       a.b[3].c
+ *       a["key with . and ]"].b
+ *
+ * Numeric names, like `3` in JSON pointer or `a.3`, work both
+ * as array indices and as map keys, depending on the value.
+ * Bracketed numbers are array indices only, quoted names are map keys only.
+ * Empty expression refers to the value itself.
+ */
+
+#include <uw.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UwTypeId UwTypeId_ValuePath;
+
+typedef struct {
+    UwValuePtr expression;
+} UwValuePathCtorArgs;
+
+#define uw_value_path(expression) _Generic((expression), \
+             char*: _uw_value_path_u8_wrapper,  \
+          char8_t*: _uw_value_path_u8,          \
+         char32_t*: _uw_value_path_u32,         \
+        UwValuePtr: _uw_value_path              \
+    )((expression))
+/*
+ * Compile path expression.
+ * Return UW_ERROR_BAD_PATH status with position in the description
+ * if expression is malformed.
+ */
+
+UwResult _uw_value_path(UwValuePtr expression);
+
+static inline UwResult _uw_value_path_u8 (char8_t*  expression) { __UWDECL_CharPtr  (v, expression); return _uw_value_path(&v); }
+static inline UwResult _uw_value_path_u32(char32_t* expression) { __UWDECL_Char32Ptr(v, expression); return _uw_value_path(&v); }
+
+static inline UwResult _uw_value_path_u8_wrapper(char* expression)
+{
+    return _uw_value_path_u8((char8_t*) expression);
+}
+
+unsigned uw_value_path_length(UwValuePtr path);
+/*
+ * Return the number of steps.
+ */
+
+UwValuePtr uw_value_path_get(UwValuePtr path, UwValuePtr value);
+/*
+ * Evaluate path against `value`.
+ * Return borrowed pointer or nullptr if path does not exist.
+ */
+
+unsigned uw_value_path_get_many(UwValuePtr paths, UwValuePtr value, UwValuePtr* results);
+/*
+ * Evaluate Array of paths against `value` in one traversal:
+ * common prefix with the previous path is not walked again,
+ * so paths sharing prefixes should be adjacent.
+ *
+ * `results` must have room for all paths, nullptr is written for missing ones.
+ *
+ * Return the number of paths found.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,305 @@
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "include/uw.h"
+#include "src/uw_arena_internal.h"
+
+#define UW_ARENA_ALIGNMENT  16
+
+struct _UwArena {
+    struct _UwArena* prev;   // enclosing arena of the same thread
+    char*    ptr;            // next block to allocate
+    char*    last_block;     // last allocated block, can be extended in place
+    char*    committed;      // end of accessible memory
+    char*    dirty_end;      // memory below may contain data from previous use of the slot
+    char*    end;
+    unsigned slot;
+};
+
+typedef struct _UwArena _UwArena;
+
+uintptr_t _uw_arena_region_start = 0;
+uintptr_t _uw_arena_region_size = 0;
+
+thread_local _UwArena* _uw_current_arena = nullptr;
+
+static pthread_once_t region_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned free_slots[UW_ARENA_MAX_ARENAS];
+static unsigned num_free_slots = 0;
+
+// memory retained by free slots
+static size_t slot_committed[UW_ARENA_MAX_ARENAS];
+static size_t slot_dirty[UW_ARENA_MAX_ARENAS];
+
+static void reserve_region()
+/*
+ * Reserve address space for all arenas, without committing any memory.
+ */
+{
+    size_t size = UW_ARENA_SIZE * UW_ARENA_MAX_ARENAS;
+    void* region = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        return;
+    }
+    for (unsigned i = 0; i < UW_ARENA_MAX_ARENAS; i++) {
+        free_slots[i] = UW_ARENA_MAX_ARENAS - 1 - i;
+    }
+    num_free_slots = UW_ARENA_MAX_ARENAS;
+
+    _uw_arena_region_start = (uintptr_t) region;
+    _uw_arena_region_size = size;
+}
+
+static bool commit(_UwArena* arena, char* new_committed)
+/*
+ * Make memory up to `new_committed`, rounded to chunk size, accessible.
+ * Freshly committed memory is zero-filled.
+ */
+{
+    size_t size = align_unsigned(new_committed - arena->committed, UW_ARENA_CHUNK_SIZE);
+    if (size > (size_t) (arena->end - arena->committed)) {
+        return false;
+    }
+    if (mprotect(arena->committed, size, PROT_READ | PROT_WRITE)) {
+        return false;
+    }
+    arena->committed += size;
+    return true;
+}
+
+static void* bump(_UwArena* arena, unsigned nbytes)
+{
+    char* block = arena->ptr;
+    size_t size = align_unsigned(nbytes, UW_ARENA_ALIGNMENT);
+    if (size > (size_t) (arena->end - block)) {
+        return nullptr;
+    }
+    char* new_ptr = block + size;
+    if (new_ptr > arena->committed && !commit(arena, new_ptr)) {
+        return nullptr;
+    }
+    if (block < arena->dirty_end) {
+        memset(block, 0, ((new_ptr < arena->dirty_end)? new_ptr : arena->dirty_end) - block);
+    }
+    arena->ptr = new_ptr;
+    arena->last_block = block;
+    return block;
+}
+
+_UwArena* _uw_arena_of(void* data)
+{
+    uintptr_t offset = (uintptr_t) data - _uw_arena_region_start;
+    return (_UwArena*) (_uw_arena_region_start + offset / UW_ARENA_SIZE * UW_ARENA_SIZE);
+}
+
+void* _uw_arena_allocate(void* owner, unsigned nbytes)
+{
+    _UwArena* arena = owner? _uw_arena_of(owner) : _uw_current_arena;
+    return bump(arena, nbytes);
+}
+
+bool _uw_arena_reallocate(void* owner, void** block_ptr, unsigned old_nbytes, unsigned new_nbytes)
+{
+    _UwArena* arena = _uw_arena_of(owner);
+    char* block = *block_ptr;
+
+    if (!block) {
+        block = bump(arena, new_nbytes);
+        if (!block) {
+            return false;
+        }
+        *block_ptr = block;
+        return true;
+    }
+    if (new_nbytes <= old_nbytes) {
+        // arena blocks never shrink
+        return true;
+    }
+    if (block == arena->last_block) {
+        // extend in place
+        size_t size = align_unsigned(new_nbytes, UW_ARENA_ALIGNMENT);
+        if (size > (size_t) (arena->end - block)) {
+            return false;
+        }
+        char* new_ptr = block + size;
+        if (new_ptr > arena->committed && !commit(arena, new_ptr)) {
+            return false;
+        }
+        if (new_ptr > arena->ptr) {
+            arena->ptr = new_ptr;
+        }
+    } else {
+        char* new_block = bump(arena, new_nbytes);
+        if (!new_block) {
+            return false;
+        }
+        memcpy(new_block, block, old_nbytes);
+        block = new_block;
+        *block_ptr = block;
+    }
+    // the tail may contain leftovers from previous use of memory
+    memset(block + old_nbytes, 0, new_nbytes - old_nbytes);
+    return true;
+}
+
+static void* allocated_data(UwValuePtr value)
+/*
+ * Return pointer to allocated data of value or nullptr.
+ */
+{
+    if (uw_is_string(value)) {
+        return value->str_embedded? nullptr : value->string_data;
+    }
+    if (uw_is_struct(value)) {
+        return value->struct_data;
+    }
+    return nullptr;
+}
+
+static bool is_immortal(UwValuePtr value)
+{
+    if (uw_is_string(value)) {
+        return _uw_refcount_load(&value->string_data->refcount) == UW_REFCOUNT_IMMORTAL;
+    } else {
+        return _uw_refcount_load(&value->struct_data->refcount) == UW_REFCOUNT_IMMORTAL;
+    }
+}
+
+bool _uw_arena_import(UwValuePtr parent, UwValuePtr child)
+{
+    void* data = allocated_data(child);
+    if (!data) {
+        return true;
+    }
+    _UwArena* arena = _uw_arena_of(parent->struct_data);
+
+    if (_uw_in_arena(data)) {
+        // values from the same or enclosing arena live longer than parent
+        _UwArena* child_arena = _uw_arena_of(data);
+        for (_UwArena* a = arena; a; a = a->prev) {
+            if (a == child_arena) {
+                return true;
+            }
+        }
+    } else if (is_immortal(child)) {
+        return true;
+    }
+    if (!(uw_is_string(child) || uw_is_array(child) || uw_is_map(child))) {
+        uw_panic("Cannot store %s in arena container\n", uw_typeof(child)->name);
+    }
+
+    // make a copy in the arena of parent
+
+    _UwArena* saved_arena = _uw_current_arena;
+    _uw_current_arena = arena;
+    UwValue copy = uw_deepcopy(child);
+    _uw_current_arena = saved_arena;
+
+    if (uw_error(&copy)) {
+        return false;
+    }
+    uw_destroy(child);
+    *child = uw_move(&copy);
+    return true;
+}
+
+void _uw_arena_check_escape(UwValuePtr child)
+{
+    if (_uw_in_arena(allocated_data(child))) {
+        uw_panic("Arena value %s stored into container outside of arena\n", uw_typeof(child)->name);
+    }
+}
+
+/****************************************************************
+ * Public API
+ */
+
+UwResult uw_arena_begin()
+{
+    pthread_once(&region_once, reserve_region);
+    if (_uw_arena_region_size == 0) {
+        return UwOOM();
+    }
+
+    pthread_mutex_lock(&slots_lock);
+    if (num_free_slots == 0) {
+        pthread_mutex_unlock(&slots_lock);
+        return UwOOM();
+    }
+    unsigned slot = free_slots[--num_free_slots];
+    pthread_mutex_unlock(&slots_lock);
+
+    char* start = (char*) (_uw_arena_region_start + slot * UW_ARENA_SIZE);
+    size_t committed = slot_committed[slot];
+    if (committed == 0) {
+        if (mprotect(start, UW_ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE)) {
+            pthread_mutex_lock(&slots_lock);
+            free_slots[num_free_slots++] = slot;
+            pthread_mutex_unlock(&slots_lock);
+            return UwOOM();
+        }
+        committed = UW_ARENA_CHUNK_SIZE;
+    }
+
+    // arena header is placed at the beginning of its own memory
+    _UwArena* arena = (_UwArena*) start;
+    arena->prev       = _uw_current_arena;
+    arena->ptr        = start + align_unsigned(sizeof(_UwArena), UW_ARENA_ALIGNMENT);
+    arena->last_block = nullptr;
+    arena->committed  = start + committed;
+    arena->dirty_end  = start + slot_dirty[slot];
+    arena->end        = start + UW_ARENA_SIZE;
+    arena->slot       = slot;
+
+    _uw_current_arena = arena;
+    return UwOK();
+}
+
+void uw_arena_end()
+{
+    _UwArena* arena = _uw_current_arena;
+    uw_assert(arena != nullptr);
+
+    _uw_current_arena = arena->prev;
+    unsigned slot = arena->slot;
+    char* start = (char*) arena;
+    size_t committed = arena->committed - start;
+    size_t dirty = ((arena->ptr > arena->dirty_end)? arena->ptr : arena->dirty_end) - start;
+
+#ifdef DEBUG
+    // release everything to make escaped values fault on access
+    size_t retain = 0;
+#else
+    // keep some memory to avoid page faults on next use of the slot
+    size_t retain = (committed < UW_ARENA_RETAIN_SIZE)? committed : UW_ARENA_RETAIN_SIZE;
+#endif
+    if (committed > retain) {
+        // Replace memory with fresh inaccessible mapping.
+        // This returns it to the system and makes escaped values fault on access.
+        void* result = mmap(start + retain, committed - retain, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        uw_assert(result != MAP_FAILED);
+    }
+    slot_committed[slot] = retain;
+    slot_dirty[slot] = (dirty < retain)? dirty : retain;
+
+    pthread_mutex_lock(&slots_lock);
+    free_slots[num_free_slots++] = slot;
+    pthread_mutex_unlock(&slots_lock);
+}
+
+bool uw_in_arena(UwValuePtr value)
+{
+    return _uw_in_arena(allocated_data(value));
+}
+
+UwResult uw_arena_export(UwValuePtr value)
+{
+    _UwArena* saved_arena = _uw_current_arena;
+    _uw_current_arena = nullptr;
+    UwValue result = uw_deepcopy(value);
+    _uw_current_arena = saved_arena;
+    return uw_move(&result);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "include/uw_arena.h"
+#include "src/uw_charptr_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _UwArena;
+
+extern thread_local struct _UwArena* _uw_current_arena;
+
+void* _uw_arena_allocate(void* owner, unsigned nbytes);
+/*
+ * Allocate zero-filled block in the arena `owner` belongs to
+ * or in the current arena if `owner` is nullptr.
+ *
+ * Return nullptr if out of memory.
+ */
+
+bool _uw_arena_reallocate(void* owner, void** block_ptr, unsigned old_nbytes, unsigned new_nbytes);
+/*
+ * Reallocate block in the arena `owner` belongs to.
+ * If `*block_ptr` is nullptr, allocate new block.
+ * New memory is zero-filled. The last allocated block is extended in place.
+ */
+
+struct _UwArena* _uw_arena_of(void* data);
+/*
+ * Return arena that contains `data`.
+ */
+
+static inline struct _UwArena* _uw_switch_arena(void* data)
+/*
+ * Make the arena that contains `data` current, or no arena if `data`
+ * is not allocated in arena. Return previous current arena.
+ *
+ * Used for values the library creates on behalf of a container,
+ * such as copies of keys and strings made of CharPtr,
+ * so they are allocated where the container lives.
+ */
+{
+    struct _UwArena* saved_arena = _uw_current_arena;
+    _uw_current_arena = _uw_in_arena(data)? _uw_arena_of(data) : nullptr;
+    return saved_arena;
+}
+
+static inline UwResult _uw_clone_into(UwValuePtr parent, UwValuePtr value)
+/*
+ * Clone `value` for storing into `parent` container.
+ */
+{
+    if (!_uw_current_arena) {
+        return uw_clone(value);
+    }
+    struct _UwArena* saved_arena = _uw_switch_arena(parent->struct_data);
+    _UwValue result = uw_clone(value);
+    _uw_current_arena = saved_arena;
+    return result;
+}
+
+static inline UwResult _uw_deepcopy_into(UwValuePtr parent, UwValuePtr value)
+/*
+ * Make deep copy of `value` for storing into `parent` container.
+ */
+{
+    if (!_uw_current_arena) {
+        return uw_deepcopy(value);
+    }
+    struct _UwArena* saved_arena = _uw_switch_arena(parent->struct_data);
+    _UwValue result = uw_deepcopy(value);
+    _uw_current_arena = saved_arena;
+    return result;
+}
+
+static inline bool _uw_charptr_to_string_into(UwValuePtr parent, UwValuePtr value)
+/*
+ * Convert CharPtr `value` to string for storing into `parent` container.
+ */
+{
+    if (!_uw_current_arena) {
+        return uw_charptr_to_string_inplace(value);
+    }
+    struct _UwArena* saved_arena = _uw_switch_arena(parent->struct_data);
+    bool success = uw_charptr_to_string_inplace(value);
+    _uw_current_arena = saved_arena;
+    return success;
+}
+
+#ifdef __cplusplus
+}
+#endif
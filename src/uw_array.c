@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "include/uw.h"
+#include "src/uw_arena_internal.h"
 #include "src/uw_charptr_internal.h"
 #include "src/uw_array_internal.h"
 #include "src/uw_string_internal.h"
@@ -51,12 +52,22 @@ static UwResult array_deepcopy(UwValuePtr self)
 
     uw_expect_ok( _uw_array_resize(dest.type_id, dest_array, src_array->length) );
 
+    if (src_array->trivial_items) {
+        memcpy(dest_array->items, src_array->items, src_array->length * sizeof(_UwValue));
+        dest_array->length = src_array->length;
+        return uw_move(&dest);
+    }
+    dest_array->trivial_items = false;
+
     UwValuePtr src_item_ptr = src_array->items;
     UwValuePtr dest_item_ptr = dest_array->items;
     for (unsigned i = 0; i < src_array->length; i++) {
         *dest_item_ptr = uw_deepcopy(src_item_ptr);
         uw_return_if_error(dest_item_ptr);
-        _uw_embrace(&dest, dest_item_ptr);
+        if (!_uw_embrace(&dest, dest_item_ptr)) {
+            uw_destroy(dest_item_ptr);
+            return UwOOM();
+        }
         src_item_ptr++;
         dest_item_ptr++;
         dest_array->length++;
@@ -126,7 +137,7 @@ UwType _uw_array_type = {
     .id             = UwTypeId_Array,
     .ancestor_id    = UwTypeId_Compound,
     .name           = "Array",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_compound_destroy,
@@ -140,7 +151,7 @@ UwType _uw_array_type = {
     .equal          = array_equal,
 
     .data_offset    = sizeof(_UwCompoundData),
-    .data_size      = sizeof(_UwArray),
+    .data_size      = UWARRAY_DATA_SIZE,
 
     .init           = array_init,
     .fini           = array_fini
@@ -185,10 +196,22 @@ UwResult _uw_alloc_array(UwTypeId type_id, _UwArray* array_data, unsigned capaci
     }
 
     array_data->length = 0;
+    array_data->trivial_items = true;
+
+    if (capacity <= UWARRAY_INLINE_CAPACITY) {
+        array_data->capacity = UWARRAY_INLINE_CAPACITY;
+        array_data->items = _uw_array_inline_items(array_data);
+        memset(array_data->items, 0, UWARRAY_INLINE_CAPACITY * sizeof(_UwValue));
+        return UwOK();
+    }
     array_data->capacity = round_capacity(capacity);
 
     unsigned memsize = array_data->capacity * sizeof(_UwValue);
-    array_data->items = _uw_types[type_id]->allocator->allocate(memsize, true);
+    if (_uw_in_arena(array_data)) {
+        array_data->items = _uw_arena_allocate(array_data, memsize);
+    } else {
+        array_data->items = _uw_types[type_id]->allocator->allocate(memsize, true);
+    }
 
     if (array_data->items) {
         return UwOK();
@@ -201,14 +224,20 @@ void _uw_destroy_array(UwTypeId type_id, _UwArray* array_data, UwValuePtr parent
 {
     if (array_data->items) {
         UwValuePtr item_ptr = array_data->items;
-        for (unsigned n = array_data->length; n; n--, item_ptr++) {
+        unsigned n = array_data->trivial_items? 0 : array_data->length;
+        for (; n; n--, item_ptr++) {
+            if (uw_typeof(item_ptr)->trivially_destructible) {
+                continue;
+            }
             if (uw_is_compound(item_ptr)) {
                 _uw_abandon(parent, item_ptr);
             }
             uw_destroy(item_ptr);
         }
-        unsigned memsize = array_data->capacity * sizeof(_UwValue);
-        _uw_types[type_id]->allocator->release((void**) &array_data->items, memsize);
+        if (!(_uw_array_is_inline(array_data) || _uw_in_arena(array_data->items))) {
+            unsigned memsize = array_data->capacity * sizeof(_UwValue);
+            _uw_types[type_id]->allocator->release((void**) &array_data->items, memsize);
+        }
     }
 }
 
@@ -226,7 +255,27 @@ UwResult _uw_array_resize(UwTypeId type_id, _UwArray* array_data, unsigned desir
     unsigned old_memsize = array_data->capacity * sizeof(_UwValue);
     unsigned new_memsize = new_capacity * sizeof(_UwValue);
 
-    if (!allocator->reallocate((void**) &array_data->items, old_memsize, new_memsize, true, nullptr)) {
+    if (_uw_array_is_inline(array_data)) {
+        if (new_capacity <= UWARRAY_INLINE_CAPACITY) {
+            return UwOK();
+        }
+        // move items to allocated block
+        UwValuePtr items;
+        if (_uw_in_arena(array_data)) {
+            items = _uw_arena_allocate(array_data, new_memsize);
+        } else {
+            items = allocator->allocate(new_memsize, true);
+        }
+        if (!items) {
+            return UwOOM();
+        }
+        memcpy(items, array_data->items, array_data->length * sizeof(_UwValue));
+        array_data->items = items;
+    } else if (_uw_in_arena(array_data)) {
+        if (!_uw_arena_reallocate(array_data, (void**) &array_data->items, old_memsize, new_memsize)) {
+            return UwOOM();
+        }
+    } else if (!allocator->reallocate((void**) &array_data->items, old_memsize, new_memsize, true, nullptr)) {
         return UwOOM();
     }
     array_data->capacity = new_capacity;
@@ -237,6 +286,9 @@ UwResult uw_array_resize(UwValuePtr array, unsigned desired_capacity)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -275,10 +327,13 @@ UwResult _uw_array_append(UwValuePtr array, UwValuePtr item)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
-    UwValue v = uw_clone(item);
+    UwValue v = _uw_clone_into(array, item);
     return _uw_array_append_item(array->type_id, array_data, &v, array);
 }
 
@@ -305,7 +360,10 @@ UwResult _uw_array_append_item(UwTypeId type_id, _UwArray* array_data, UwValuePt
         panic_status();
     }
     uw_expect_ok( grow_array(type_id, array_data) );
-    _uw_embrace(parent, item);
+    if (!_uw_embrace(parent, item)) {
+        return UwOOM();
+    }
+    _uw_array_note_item(array_data, item);
     array_data->items[array_data->length] = uw_move(item);
     array_data->length++;
     return UwOK();
@@ -324,6 +382,9 @@ UwResult uw_array_append_ap(UwValuePtr dest, va_list ap)
 {
     uw_assert_array(dest);
     _UwArray* array_data = get_array_data_ptr(dest);
+    if (_uw_is_immortal(dest)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -340,7 +401,7 @@ UwResult uw_array_append_ap(UwValuePtr dest, va_list ap)
             error = uw_move(&arg);
             goto failure;
         }
-        if (!uw_charptr_to_string_inplace(&arg)) {
+        if (!_uw_charptr_to_string_into(dest, &arg)) {
             goto failure;
         }
         UwValue status = _uw_array_append_item(type_id, array_data, &arg, dest);
@@ -371,6 +432,9 @@ UwResult _uw_array_insert(UwValuePtr array, unsigned index, UwValuePtr item)
     }
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -379,11 +443,15 @@ UwResult _uw_array_insert(UwValuePtr array, unsigned index, UwValuePtr item)
     }
     uw_expect_ok( grow_array(array->type_id, array_data) );
 
-    _uw_embrace(array, item);
+    UwValue v = _uw_clone_into(array, item);
+    if (!_uw_embrace(array, &v)) {
+        return UwOOM();
+    }
     if (index < array_data->length) {
         memmove(&array_data->items[index + 1], &array_data->items[index], (array_data->length - index) * sizeof(_UwValue));
     }
-    array_data->items[index] = uw_clone(item);
+    _uw_array_note_item(array_data, &v);
+    array_data->items[index] = uw_move(&v);
     array_data->length++;
     return UwOK();
 }
@@ -420,6 +488,9 @@ UwResult _uw_array_set_item_signed(UwValuePtr array, ssize_t index, UwValuePtr i
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -432,8 +503,13 @@ UwResult _uw_array_set_item_signed(UwValuePtr array, ssize_t index, UwValuePtr i
         return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
     }
 
+    UwValue v = _uw_clone_into(array, item);
+    if (!_uw_arena_store(array, &v)) {
+        return UwOOM();
+    }
     uw_destroy(&array_data->items[index]);
-    array_data->items[index] = uw_clone(item);
+    _uw_array_note_item(array_data, &v);
+    array_data->items[index] = uw_move(&v);
     return UwOK();
 }
 
@@ -441,12 +517,20 @@ UwResult _uw_array_set_item(UwValuePtr array, unsigned index, UwValuePtr item)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
     if (index < array_data->length) {
+        UwValue v = _uw_clone_into(array, item);
+        if (!_uw_arena_store(array, &v)) {
+            return UwOOM();
+        }
         uw_destroy(&array_data->items[index]);
-        array_data->items[index] = uw_clone(item);
+        _uw_array_note_item(array_data, &v);
+        array_data->items[index] = uw_move(&v);
         return UwOK();
     } else {
         return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
@@ -457,6 +541,9 @@ UwResult uw_array_pull(UwValuePtr array)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -472,6 +559,9 @@ UwResult uw_array_pop(UwValuePtr array)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
+    if (_uw_is_immortal(array)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -484,6 +574,9 @@ UwResult _uw_array_pop(_UwArray* array_data)
         return UwError(UW_ERROR_EXTRACT_FROM_EMPTY_ARRAY);
     }
     array_data->length--;
+    if (array_data->length == 0) {
+        array_data->trivial_items = true;
+    }
     return uw_move(&array_data->items[array_data->length]);
 }
 
@@ -491,7 +584,7 @@ void uw_array_del(UwValuePtr array, unsigned start_index, unsigned end_index)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
-    if (array_data->itercount) {
+    if (_uw_is_immortal(array) || array_data->itercount) {
         return; // UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
     _uw_array_del(array_data, start_index, end_index);
@@ -501,7 +594,7 @@ void uw_array_clean(UwValuePtr array)
 {
     uw_assert_array(array);
     _UwArray* array_data = get_array_data_ptr(array);
-    if (array_data->itercount) {
+    if (_uw_is_immortal(array) || array_data->itercount) {
         return; // UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
     _uw_array_del(array_data, 0, UINT_MAX);
@@ -519,9 +612,11 @@ void _uw_array_del(_UwArray* array_data, unsigned start_index, unsigned end_inde
         return;
     }
 
-    UwValuePtr item_ptr = &array_data->items[start_index];
-    for (unsigned i = start_index; i < end_index; i++, item_ptr++) {
-        uw_destroy(item_ptr);
+    if (!array_data->trivial_items) {
+        UwValuePtr item_ptr = &array_data->items[start_index];
+        for (unsigned i = start_index; i < end_index; i++, item_ptr++) {
+            uw_destroy(item_ptr);
+        }
     }
     unsigned new_length = array_data->length - (end_index - start_index);
     unsigned tail_length = array_data->length - end_index;
@@ -530,6 +625,9 @@ void _uw_array_del(_UwArray* array_data, unsigned start_index, unsigned end_inde
         memset(&array_data->items[new_length], 0, (array_data->length - new_length) * sizeof(_UwValue));
     }
     array_data->length = new_length;
+    if (new_length == 0) {
+        array_data->trivial_items = true;
+    }
 }
 
 UwResult uw_array_slice(UwValuePtr array, unsigned start_index, unsigned end_index)
@@ -553,6 +651,13 @@ UwResult uw_array_slice(UwValuePtr array, unsigned start_index, unsigned end_ind
 
     _UwArray* dest_array = get_array_data_ptr(&dest);
 
+    if (src_array->trivial_items) {
+        memcpy(dest_array->items, &src_array->items[start_index], slice_len * sizeof(_UwValue));
+        dest_array->length = slice_len;
+        return uw_move(&dest);
+    }
+    dest_array->trivial_items = false;
+
     UwValuePtr src_item_ptr = &src_array->items[start_index];
     UwValuePtr dest_item_ptr = dest_array->items;
     for (unsigned i = start_index; i < end_index; i++) {
@@ -665,6 +770,9 @@ UwResult uw_array_dedent(UwValuePtr lines)
     // dedent inplace, so access items directly to avoid cloning
     _UwArray* array_data = get_array_data_ptr(lines);
 
+    if (_uw_is_immortal(lines)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
     if (array_data->itercount) {
         return UwError(UW_ERROR_ITERATION_IN_PROGRESS);
     }
@@ -15,12 +15,24 @@ extern "C" {
 #define UWARRAY_INITIAL_CAPACITY    4
 #define UWARRAY_CAPACITY_INCREMENT  16
 
+// must be multiple of UWARRAY_INITIAL_CAPACITY
+#define UWARRAY_INLINE_CAPACITY     4
+
 typedef struct {
     UwValuePtr items;
     unsigned length;
     unsigned capacity;
     unsigned itercount;  // number of iterations in progress
+    bool trivial_items;  // all items are trivially clonable and destructible,
+                         // this enables bulk copying and skipping destructors
 } _UwArray;
+/*
+ * _UwArray is always followed by UWARRAY_INLINE_CAPACITY items.
+ * Small arrays keep items there, without separate allocation,
+ * and move them to allocated block when they grow beyond.
+ */
+
+#define UWARRAY_DATA_SIZE  (sizeof(_UwArray) + UWARRAY_INLINE_CAPACITY * sizeof(_UwValue))
 
 #define get_array_data_ptr(value)  ((_UwArray*) _uw_get_data_ptr((value), UwTypeId_Array))
 
@@ -40,11 +52,33 @@ static inline unsigned _uw_array_capacity(_UwArray* array_data)
     return array_data->capacity;
 }
 
+static inline UwValuePtr _uw_array_inline_items(_UwArray* array_data)
+{
+    return (UwValuePtr) (array_data + 1);
+}
+
+static inline bool _uw_array_is_inline(_UwArray* array_data)
+{
+    return array_data->items == _uw_array_inline_items(array_data);
+}
+
+static inline void _uw_array_note_item(_UwArray* array_data, UwValuePtr item)
+/*
+ * Update trivial_items flag for item stored into array.
+ * The flag is reset only when array becomes empty.
+ */
+{
+    if (!_uw_is_trivial(item)) {
+        array_data->trivial_items = false;
+    }
+}
+
 UwResult _uw_alloc_array(UwTypeId type_id, _UwArray* array_data, unsigned capacity);
 /*
- * - allocate array items
+ * - allocate array items unless capacity fits inline items
  * - set array->length = 0
  * - set array->capacity = rounded capacity
+ * - set array->trivial_items = true
  *
  * Return status.
  */
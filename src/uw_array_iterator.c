@@ -24,10 +24,12 @@ static bool start_iteration(UwValuePtr self)
     data->increment = 1;
     data->iteration_in_progress = true;
 
-    // increment itercount
+    // increment itercount, immortal arrays are read-only and never change
     _UwIterator* iter_data = get_iterator_data_ptr(self);
-    _UwArray* array_data = get_array_data_ptr(&iter_data->iterable);
-    array_data->itercount++;
+    if (!_uw_is_immortal(&iter_data->iterable)) {
+        _UwArray* array_data = get_array_data_ptr(&iter_data->iterable);
+        array_data->itercount++;
+    }
     return true;
 }
 
@@ -36,8 +38,10 @@ static void stop_iteration(UwValuePtr self)
     _UwArrayIterator* data = get_data_ptr(self);
     if (data->iteration_in_progress) {
         _UwIterator* iter_data = get_iterator_data_ptr(self);
-        _UwArray* array_data = get_array_data_ptr(&iter_data->iterable);
-        array_data->itercount--;
+        if (!_uw_is_immortal(&iter_data->iterable)) {
+            _UwArray* array_data = get_array_data_ptr(&iter_data->iterable);
+            array_data->itercount--;
+        }
         data->iteration_in_progress = false;
     }
 }
@@ -91,6 +95,26 @@ static UwResult read_line_inplace(UwValuePtr self, UwValuePtr line)
     return UwError(UW_ERROR_EOF);
 }
 
+static UwResult read_line_view(UwValuePtr self, UwLineView* view)
+{
+    _UwArrayIterator* data = get_data_ptr(self);
+    _UwIterator* iter_data = get_iterator_data_ptr(self);
+    _UwArray* array_data = get_array_data_ptr(&iter_data->iterable);
+
+    // the array cannot be modified while iteration is in progress,
+    // so the view may point to the item directly
+    while (data->index < array_data->length) {
+        UwValuePtr item = &array_data->items[data->index++];
+        if (uw_is_string(item)) {
+            view->ptr = _uw_string_start_length(item, &view->length);
+            view->char_size = _uw_string_char_size(item);
+            data->line_number++;
+            return UwOK();
+        }
+    }
+    return UwError(UW_ERROR_EOF);
+}
+
 static bool unread_line(UwValuePtr self, UwValuePtr line)
 {
     _UwArrayIterator* data = get_data_ptr(self);
@@ -122,6 +146,7 @@ static UwInterface_LineReader line_reader_interface = {
     .start             = start_read_lines,
     .read_line         = read_line,
     .read_line_inplace = read_line_inplace,
+    .read_line_view    = read_line_view,
     .get_line_number   = get_line_number,
     .unread_line       = unread_line,
     .stop              = stop_read_lines
@@ -0,0 +1,599 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include "include/uw_async_read.h"
+#include "src/uw_struct_internal.h"
+
+#define DEFAULT_QUEUE_DEPTH  64
+#define DEFAULT_NUM_THREADS  4
+
+typedef struct {
+    unsigned queue_depth;
+    unsigned num_pending;  // submitted and not reaped yet
+    bool use_io_uring;
+
+    // io_uring
+    int ring_fd;
+    void*    sq_ring;
+    unsigned sq_ring_size;
+    void*    cq_ring;
+    unsigned cq_ring_size;
+    struct io_uring_sqe* sqes;
+    unsigned sqes_size;
+    _Atomic unsigned* sq_head;
+    _Atomic unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned  sq_mask;
+    _Atomic unsigned* cq_head;
+    _Atomic unsigned* cq_tail;
+    struct io_uring_cqe* cqes;
+    unsigned  cq_mask;
+    unsigned  to_submit;  // number of SQEs not passed to the kernel yet
+
+    // thread pool fallback
+    pthread_t* threads;
+    unsigned   num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t  request_cond;
+    pthread_cond_t  completion_cond;
+    UwAsyncRead* queued_head;  // not handed to the pool yet
+    UwAsyncRead* queued_tail;
+    UwAsyncRead* pool_head;    // waiting for a worker
+    UwAsyncRead* pool_tail;
+    UwAsyncRead* completed;
+    unsigned     num_completed;
+    bool shutdown;
+} _UwAsyncReader;
+
+#define get_data_ptr(value)  ((_UwAsyncReader*) _uw_get_data_ptr((value), UwTypeId_AsyncReader))
+
+/****************************************************************
+ * io_uring backend
+ *
+ * Raw system calls are used to avoid dependency on liburing.
+ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static void uring_fini(_UwAsyncReader* r)
+{
+    if (r->sqes) {
+        munmap(r->sqes, r->sqes_size);
+        r->sqes = nullptr;
+    }
+    if (r->cq_ring && r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_size);
+    }
+    r->cq_ring = nullptr;
+    if (r->sq_ring) {
+        munmap(r->sq_ring, r->sq_ring_size);
+        r->sq_ring = nullptr;
+    }
+    if (r->ring_fd != -1) {
+        close(r->ring_fd);
+        r->ring_fd = -1;
+    }
+}
+
+static bool uring_init(_UwAsyncReader* r)
+/*
+ * Return false if io_uring is not available.
+ */
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    r->ring_fd = sys_io_uring_setup(r->queue_depth, &params);
+    if (r->ring_fd < 0) {
+        // ENOSYS on old kernels, EPERM if disabled by sysctl or seccomp
+        r->ring_fd = -1;
+        return false;
+    }
+    if ( ! (params.features & IORING_FEAT_RW_CUR_POS)) {
+        // IORING_OP_READ appeared in the same kernel version as this feature
+        uring_fini(r);
+        return false;
+    }
+
+    r->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        if (r->cq_ring_size > r->sq_ring_size) {
+            r->sq_ring_size = r->cq_ring_size;
+        }
+        r->cq_ring_size = r->sq_ring_size;
+    }
+
+    void* ptr = mmap(nullptr, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED) {
+        uring_fini(r);
+        return false;
+    }
+    r->sq_ring = ptr;
+
+    if (single_mmap) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        ptr = mmap(nullptr, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED) {
+            uring_fini(r);
+            return false;
+        }
+        r->cq_ring = ptr;
+    }
+
+    r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED) {
+        uring_fini(r);
+        return false;
+    }
+    r->sqes = ptr;
+
+    char* sq = r->sq_ring;
+    r->sq_head  = (_Atomic unsigned*) (sq + params.sq_off.head);
+    r->sq_tail  = (_Atomic unsigned*) (sq + params.sq_off.tail);
+    r->sq_mask  = *(unsigned*) (sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned*) (sq + params.sq_off.array);
+
+    char* cq = r->cq_ring;
+    r->cq_head = (_Atomic unsigned*) (cq + params.cq_off.head);
+    r->cq_tail = (_Atomic unsigned*) (cq + params.cq_off.tail);
+    r->cq_mask = *(unsigned*) (cq + params.cq_off.ring_mask);
+    r->cqes    = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    // the kernel may round entries up
+    r->queue_depth = params.sq_entries;
+    return true;
+}
+
+static void uring_queue(_UwAsyncReader* r, UwAsyncRead* request)
+{
+    // we are the only producer, plain load of tail is fine
+    unsigned tail = atomic_load_explicit(r->sq_tail, memory_order_relaxed);
+    unsigned index = tail & r->sq_mask;
+
+    struct io_uring_sqe* sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = request->_fd;
+    // continue after the part already read, if any
+    sqe->addr      = (uint64_t) ((char*) request->buffer + request->bytes_read);
+    sqe->len       = request->size - request->bytes_read;
+    sqe->off       = request->offset + request->bytes_read;
+    sqe->user_data = (uint64_t) request;
+
+    r->sq_array[index] = index;
+
+    // make SQE visible to the kernel before the new tail
+    atomic_store_explicit(r->sq_tail, tail + 1, memory_order_release);
+    r->to_submit++;
+}
+
+static unsigned uring_num_ready(_UwAsyncReader* r)
+{
+    return atomic_load_explicit(r->cq_tail, memory_order_acquire)
+           - atomic_load_explicit(r->cq_head, memory_order_relaxed);
+}
+
+static UwResult uring_enter(_UwAsyncReader* r, unsigned min_complete)
+/*
+ * Submit queued SQEs and wait for `min_complete` completions.
+ *
+ * If the kernel pushes back with EAGAIN or EBUSY, stop submitting
+ * and wait only for requests already in flight, so the caller
+ * can reap them before submitting the rest.
+ */
+{
+    bool congested = false;
+    while (r->to_submit || min_complete) {
+        unsigned to_submit = r->to_submit;
+        if (congested) {
+            to_submit = 0;
+            unsigned ready = uring_num_ready(r);
+            unsigned in_flight = r->num_pending - r->to_submit - ready;
+            if (min_complete > in_flight) {
+                min_complete = in_flight;
+            }
+            if (min_complete == 0) {
+                if (ready == 0 && in_flight == 0) {
+                    // nothing will free resources
+                    return UwErrno(EAGAIN);
+                }
+                return UwOK();
+            }
+        }
+        unsigned flags = min_complete? IORING_ENTER_GETEVENTS : 0;
+        int rc = sys_io_uring_enter(r->ring_fd, to_submit, min_complete, flags);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EBUSY) && !congested) {
+                congested = true;
+                continue;
+            }
+            return UwErrno(errno);
+        }
+        r->to_submit -= (unsigned) rc;
+        if (min_complete) {
+            // the kernel has waited for completions
+            break;
+        }
+    }
+    return UwOK();
+}
+
+static unsigned uring_harvest(_UwAsyncReader* r, UwAsyncRead** completed, unsigned max_completed)
+/*
+ * Short reads are queued again for the remaining part
+ * and are not returned until end of file or error.
+ */
+{
+    unsigned n = 0;
+    unsigned head = atomic_load_explicit(r->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+
+    while (head != tail && n < max_completed) {
+        struct io_uring_cqe* cqe = &r->cqes[head & r->cq_mask];
+        UwAsyncRead* request = (UwAsyncRead*) cqe->user_data;
+        head++;
+        if (cqe->res < 0) {
+            // keep what has been read before, same as thread pool backend
+            request->error = -cqe->res;
+        } else {
+            request->bytes_read += (unsigned) cqe->res;
+            if (cqe->res > 0 && request->bytes_read < request->size) {
+                // the SQE of this request is consumed, so there's room for it
+                uring_queue(r, request);
+                continue;
+            }
+        }
+        completed[n++] = request;
+    }
+    // release CQEs to the kernel
+    atomic_store_explicit(r->cq_head, head, memory_order_release);
+    return n;
+}
+
+/****************************************************************
+ * Thread pool backend
+ */
+
+static void do_pread(UwAsyncRead* request)
+{
+    char* buffer = request->buffer;
+    unsigned remaining = request->size;
+    uint64_t offset = request->offset;
+
+    request->bytes_read = 0;
+    request->error = 0;
+
+    while (remaining) {
+        ssize_t result = pread(request->_fd, buffer, remaining, (off_t) offset);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            request->error = errno;
+            return;
+        }
+        if (result == 0) {
+            // end of file
+            return;
+        }
+        request->bytes_read += (unsigned) result;
+        buffer    += result;
+        offset    += result;
+        remaining -= (unsigned) result;
+    }
+}
+
+static void* pool_worker(void* arg)
+{
+    _UwAsyncReader* r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (r->pool_head == nullptr && !r->shutdown) {
+            pthread_cond_wait(&r->request_cond, &r->lock);
+        }
+        UwAsyncRead* request = r->pool_head;
+        if (!request) {
+            // shutdown
+            break;
+        }
+        r->pool_head = request->_next;
+        if (!r->pool_head) {
+            r->pool_tail = nullptr;
+        }
+        pthread_mutex_unlock(&r->lock);
+
+        do_pread(request);
+
+        pthread_mutex_lock(&r->lock);
+        request->_next = r->completed;
+        r->completed = request;
+        r->num_completed++;
+        pthread_cond_signal(&r->completion_cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return nullptr;
+}
+
+static void pool_fini(_UwAsyncReader* r)
+{
+    if (!r->threads) {
+        return;
+    }
+    pthread_mutex_lock(&r->lock);
+    r->shutdown = true;
+    pthread_cond_broadcast(&r->request_cond);
+    pthread_mutex_unlock(&r->lock);
+
+    for (unsigned i = 0; i < r->num_threads; i++) {
+        pthread_join(r->threads[i], nullptr);
+    }
+    release((void**) &r->threads, r->num_threads * sizeof(pthread_t));
+    r->threads = nullptr;
+
+    pthread_cond_destroy(&r->completion_cond);
+    pthread_cond_destroy(&r->request_cond);
+    pthread_mutex_destroy(&r->lock);
+}
+
+static UwResult pool_init(_UwAsyncReader* r)
+{
+    r->threads = allocate(r->num_threads * sizeof(pthread_t), false);
+    if (!r->threads) {
+        return UwOOM();
+    }
+    pthread_mutex_init(&r->lock, nullptr);
+    pthread_cond_init(&r->request_cond, nullptr);
+    pthread_cond_init(&r->completion_cond, nullptr);
+
+    for (unsigned i = 0; i < r->num_threads; i++) {
+        int rc = pthread_create(&r->threads[i], nullptr, pool_worker, r);
+        if (rc) {
+            // shut down threads created so far
+            r->num_threads = i;
+            pool_fini(r);
+            return UwErrno(rc);
+        }
+    }
+    return UwOK();
+}
+
+static void pool_flush(_UwAsyncReader* r)
+{
+    if (!r->queued_head) {
+        return;
+    }
+    pthread_mutex_lock(&r->lock);
+    if (r->pool_tail) {
+        r->pool_tail->_next = r->queued_head;
+    } else {
+        r->pool_head = r->queued_head;
+    }
+    r->pool_tail = r->queued_tail;
+    pthread_cond_broadcast(&r->request_cond);
+    pthread_mutex_unlock(&r->lock);
+
+    r->queued_head = nullptr;
+    r->queued_tail = nullptr;
+}
+
+static unsigned pool_reap(_UwAsyncReader* r, UwAsyncRead** completed, unsigned max_completed, unsigned min_completed)
+{
+    unsigned n = 0;
+    pthread_mutex_lock(&r->lock);
+    while (r->num_completed < min_completed) {
+        pthread_cond_wait(&r->completion_cond, &r->lock);
+    }
+    while (r->completed && n < max_completed) {
+        completed[n++] = r->completed;
+        r->completed = r->completed->_next;
+        r->num_completed--;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return n;
+}
+
+/****************************************************************
+ * Basic interface methods
+ */
+
+static UwResult async_reader_init(UwValuePtr self, void* ctor_args)
+{
+    UwAsyncReaderCtorArgs* args = ctor_args;
+    _UwAsyncReader* r = get_data_ptr(self);
+
+    r->ring_fd = -1;
+    r->queue_depth = DEFAULT_QUEUE_DEPTH;
+    r->num_threads = DEFAULT_NUM_THREADS;
+
+    bool no_io_uring = false;
+    if (args) {
+        if (args->queue_depth) {
+            r->queue_depth = args->queue_depth;
+        }
+        if (args->num_threads) {
+            r->num_threads = args->num_threads;
+        }
+        no_io_uring = args->no_io_uring;
+    }
+
+    if (!no_io_uring && uring_init(r)) {
+        r->use_io_uring = true;
+        return UwOK();
+    }
+    return pool_init(r);
+}
+
+static void async_reader_fini(UwValuePtr self)
+{
+    _UwAsyncReader* r = get_data_ptr(self);
+
+    if (r->use_io_uring) {
+        // buffers of requests in flight belong to the caller,
+        // so wait until the kernel is done with them
+        UwAsyncRead* completed[16];
+        while (r->num_pending) {
+            UwValue status = uring_enter(r, 1);
+            if (uw_error(&status)) {
+                // cannot wait for the rest
+                break;
+            }
+            r->num_pending -= uring_harvest(r, completed, UW_LENGTH(completed));
+        }
+        uring_fini(r);
+    } else {
+        pool_flush(r);
+        pool_fini(r);
+    }
+}
+
+/****************************************************************
+ * AsyncReader type
+ */
+
+static UwType async_reader_type;
+
+UwTypeId UwTypeId_AsyncReader = 0;
+
+[[ gnu::constructor ]]
+static void init_async_reader_type()
+{
+    if (UwTypeId_AsyncReader == 0) {
+        UwTypeId_AsyncReader = uw_subtype(
+            &async_reader_type, "AsyncReader", UwTypeId_Struct, _UwAsyncReader
+        );
+        async_reader_type.init = async_reader_init;
+        async_reader_type.fini = async_reader_fini;
+    }
+}
+
+/****************************************************************
+ * AsyncReader functions
+ */
+
+UwResult uw_create_async_reader(unsigned queue_depth)
+{
+    UwAsyncReaderCtorArgs args = { .queue_depth = queue_depth };
+    return uw_create2(UwTypeId_AsyncReader, &args);
+}
+
+UwResult uw_async_read_submit(UwValuePtr reader, UwValuePtr file, UwAsyncRead* request)
+{
+    _UwAsyncReader* r = get_data_ptr(reader);
+
+    if (r->num_pending >= r->queue_depth) {
+        return UwError(UW_ERROR_ASYNC_QUEUE_FULL);
+    }
+    int fd = uw_file_get_fd(file);
+    if (fd == -1) {
+        return UwErrno(EBADF);
+    }
+    request->_fd = fd;
+    request->_next = nullptr;
+    request->bytes_read = 0;
+    request->error = 0;
+
+    if (r->use_io_uring) {
+        uring_queue(r, request);
+    } else {
+        if (r->queued_tail) {
+            r->queued_tail->_next = request;
+        } else {
+            r->queued_head = request;
+        }
+        r->queued_tail = request;
+    }
+    r->num_pending++;
+    return UwOK();
+}
+
+UwResult uw_async_read_flush(UwValuePtr reader)
+{
+    _UwAsyncReader* r = get_data_ptr(reader);
+
+    if (r->use_io_uring) {
+        return uring_enter(r, 0);
+    } else {
+        pool_flush(r);
+        return UwOK();
+    }
+}
+
+UwResult uw_async_read_reap(UwValuePtr reader, UwAsyncRead** completed, unsigned max_completed,
+                            unsigned min_completed, unsigned* num_completed)
+{
+    _UwAsyncReader* r = get_data_ptr(reader);
+
+    if (min_completed > r->num_pending) {
+        min_completed = r->num_pending;
+    }
+    if (min_completed > max_completed) {
+        min_completed = max_completed;
+    }
+
+    unsigned n = 0;
+    UwValue status = UwOK();
+    if (r->use_io_uring) {
+        for (;;) {
+            unsigned ready = uring_num_ready(r);
+            status = uring_enter(r, (n + ready < min_completed)? min_completed - n - ready : 0);
+            if (uw_error(&status)) {
+                break;
+            }
+            // harvest what is ready even if the kernel has returned early
+            unsigned harvested = uring_harvest(r, completed + n, max_completed - n);
+            r->num_pending -= harvested;
+            n += harvested;
+            if (n >= min_completed) {
+                break;
+            }
+        }
+        if (r->to_submit && uw_ok(&status)) {
+            // submit the rest of short reads
+            status = uring_enter(r, 0);
+        }
+    } else {
+        pool_flush(r);
+        n = pool_reap(r, completed, max_completed, min_completed);
+        r->num_pending -= n;
+    }
+    // harvested requests are returned even if waiting for more has failed
+    *num_completed = n;
+    return uw_move(&status);
+}
+
+unsigned uw_async_read_pending(UwValuePtr reader)
+{
+    return get_data_ptr(reader)->num_pending;
+}
+
+bool uw_async_read_uses_io_uring(UwValuePtr reader)
+{
+    return get_data_ptr(reader)->use_io_uring;
+}
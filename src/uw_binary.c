@@ -0,0 +1,410 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "src/uw_binary_internal.h"
+#include "src/uw_charptr_internal.h"
+#include "src/uw_string_internal.h"
+
+/****************************************************************
+ * Output
+ */
+
+bool _uw_binary_output_init(_UwBinaryOutput* out, UwSink* sink)
+{
+    *out = (_UwBinaryOutput) {
+        .data     = allocate(UW_BINARY_BUFFER_SIZE, false),
+        .capacity = UW_BINARY_BUFFER_SIZE,
+        .sink     = sink
+    };
+    if (!out->data) {
+        out->error = UwOOM();
+        return false;
+    }
+    return true;
+}
+
+void _uw_binary_output_fini(_UwBinaryOutput* out)
+{
+    if (out->data) {
+        release((void**) &out->data, out->capacity);
+    }
+    uw_destroy(&out->error);
+}
+
+bool _uw_binary_flush(_UwBinaryOutput* out)
+{
+    if (out->size) {
+        out->error = uw_sink_write(out->sink, out->data, out->size);
+        if (uw_error(&out->error)) {
+            return false;
+        }
+        out->size = 0;
+    }
+    return true;
+}
+
+bool _uw_binary_write(_UwBinaryOutput* out, void* data, unsigned n)
+{
+    if (out->capacity - out->size < n) {
+        if (!_uw_binary_flush(out)) {
+            return false;
+        }
+        if (n > out->capacity / 2) {
+            // large chunk: bypass the buffer
+            out->error = uw_sink_write(out->sink, data, n);
+            return uw_ok(&out->error);
+        }
+    }
+    memcpy(out->data + out->size, data, n);
+    out->size += n;
+    return true;
+}
+
+unsigned _uw_binary_utf8_size(UwValuePtr str)
+{
+    if (uw_is_string(str)) {
+        return uw_strlen_in_utf8(str);
+    }
+    switch (str->charptr_subtype) {
+        case UW_CHARPTR:
+            return strlen((char*) str->charptr);
+        case UW_CHAR32PTR: {
+            unsigned size = 0;
+            for (char32_t* s = str->char32ptr; *s; s++) {
+                char buf[4];
+                size += uw_char32_to_utf8(*s, buf) - buf;
+            }
+            return size;
+        }
+        default:
+            _uw_panic_bad_charptr_subtype(str);
+    }
+}
+
+bool _uw_binary_write_utf8(_UwBinaryOutput* out, UwValuePtr str)
+{
+    if (uw_is_charptr(str)) {
+        switch (str->charptr_subtype) {
+            case UW_CHARPTR:
+                return _uw_binary_write(out, str->charptr, strlen((char*) str->charptr));
+            case UW_CHAR32PTR:
+                for (char32_t* s = str->char32ptr; *s; s++) {
+                    if (!_uw_binary_reserve(out, 4)) {
+                        return false;
+                    }
+                    out->size = (uint8_t*) uw_char32_to_utf8(*s, (char*) out->data + out->size) - out->data;
+                }
+                return true;
+            default:
+                _uw_panic_bad_charptr_subtype(str);
+        }
+    }
+    unsigned length;
+    uint8_t* ptr = _uw_string_start_length(str, &length);
+    uint8_t char_size = _uw_string_char_size(str);
+
+    // convert in chunks of up to 1024 characters, 4 bytes max each
+    while (length) {
+        unsigned n = (length > 1024)? 1024 : length;
+        if (!_uw_binary_reserve(out, n * 4)) {
+            return false;
+        }
+        uint8_t* p = out->data + out->size;
+        if (char_size == 1) {
+            for (unsigned i = 0; i < n; i++) {
+                uint8_t c = ptr[i];
+                if (c < 0x80) {
+                    *p++ = c;
+                } else {
+                    *p++ = 0xC0 | (c >> 6);
+                    *p++ = 0x80 | (c & 0x3F);
+                }
+            }
+            ptr += n;
+        } else {
+            for (unsigned i = 0; i < n; i++) {
+                p = (uint8_t*) uw_char32_to_utf8(_uw_get_char(ptr, char_size), (char*) p);
+                ptr += char_size;
+            }
+        }
+        out->size = p - out->data;
+        length -= n;
+    }
+    return true;
+}
+
+unsigned _uw_binary_format_datetime(UwValuePtr datetime, char8_t* buffer)
+{
+    char* p = (char*) buffer;
+    p += sprintf(p, "%04u-%02u-%02uT%02u:%02u:%02u",
+                 datetime->year, datetime->month, datetime->day,
+                 datetime->hour, datetime->minute, datetime->second);
+    if (datetime->nanosecond) {
+        // strip trailing zeros from the fraction
+        unsigned fraction = datetime->nanosecond;
+        unsigned num_digits = 9;
+        while (fraction % 10 == 0) {
+            fraction /= 10;
+            num_digits--;
+        }
+        p += sprintf(p, ".%0*u", num_digits, fraction);
+    }
+    if (datetime->gmt_offset) {
+        int offset = datetime->gmt_offset;
+        char sign = '+';
+        if (offset < 0) {
+            sign = '-';
+            offset = -offset;
+        }
+        p += sprintf(p, "%c%02d:%02d", sign, offset / 60, offset % 60);
+    } else {
+        *p++ = 'Z';
+    }
+    return (char8_t*) p - buffer;
+}
+
+static int64_t days_from_civil(int64_t year, unsigned month, unsigned day)
+/*
+ * Return the number of days since 1970-01-01 in proleptic Gregorian calendar.
+ */
+{
+    year -= month <= 2;
+    int64_t era = ((year >= 0)? year : year - 399) / 400;
+    unsigned year_of_era = (unsigned) (year - era * 400);
+    unsigned day_of_year = (153 * (month > 2? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + (int64_t) day_of_era - 719468;
+}
+
+int64_t _uw_binary_datetime_to_epoch(UwValuePtr datetime)
+{
+    return days_from_civil(datetime->year, datetime->month, datetime->day) * 86400
+           + datetime->hour * 3600 + datetime->minute * 60 + datetime->second
+           - datetime->gmt_offset * 60;
+}
+
+bool _uw_binary_epoch_to_datetime(int64_t seconds, uint32_t nanoseconds, UwValuePtr result)
+{
+    int64_t days = seconds / 86400;
+    int64_t seconds_of_day = seconds % 86400;
+    if (seconds_of_day < 0) {
+        seconds_of_day += 86400;
+        days--;
+    }
+    // inverse of days_from_civil
+    days += 719468;
+    int64_t era = ((days >= 0)? days : days - 146096) / 146097;
+    unsigned day_of_era = (unsigned) (days - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned mp = (5 * day_of_year + 2) / 153;
+    unsigned month = (mp < 10)? mp + 3 : mp - 9;
+    int64_t year = (int64_t) year_of_era + era * 400 + (month <= 2);
+
+    if (year < 0 || year > UINT16_MAX) {
+        return false;
+    }
+    *result = UwDateTime();
+    result->year   = (uint16_t) year;
+    result->month  = (uint8_t) month;
+    result->day    = (uint8_t) (day_of_year - (153 * mp + 2) / 5 + 1);
+    result->hour   = (uint8_t) (seconds_of_day / 3600);
+    result->minute = (uint8_t) (seconds_of_day / 60 % 60);
+    result->second = (uint8_t) (seconds_of_day % 60);
+    result->nanosecond = nanoseconds;
+    return true;
+}
+
+/****************************************************************
+ * Input
+ */
+
+UwResult _uw_binary_error(_UwBinaryInput* input, size_t position, char* message)
+{
+    if (position > input->size) {
+        position = input->size;
+    }
+    UwValue status = UwError(UW_ERROR_MALFORMED_DATA);
+    _uw_set_status_desc(&status, "offset %zu: %s", position, message);
+    return uw_move(&status);
+}
+
+UwResult _uw_binary_decode_string(_UwBinaryInput* input, size_t position, size_t size)
+{
+    if (size > UINT_MAX) {
+        return UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+    }
+    char8_t* start = input->data + position;
+    char8_t* end = start + size;
+
+    // pass 1: validate and calculate length and char size
+
+    unsigned length = 0;
+    uint8_t width = 0;
+    bool ascii = true;
+    for (char8_t* p = start; p < end;) {
+        if (*p < 0x80) {
+            p++;
+        } else {
+            char8_t* char_start = p;
+            unsigned remaining = end - p;
+            char32_t c;
+            if (!read_utf8_buffer(&p, &remaining, &c) || c == 0xFFFFFFFF) {
+                return _uw_binary_error(input, char_start - input->data, "bad UTF-8 sequence");
+            }
+            width = update_char_width(width, c);
+            ascii = false;
+        }
+        length++;
+    }
+
+    // pass 2: make string of the exact char size and length
+
+    uint8_t char_size = char_width_to_char_size(width);
+    UwValue result = uw_create_empty_string(length, char_size);
+    uw_return_if_error(&result);
+
+    uint8_t* dest = _uw_string_start(&result);
+    if (ascii) {
+        memcpy(dest, start, size);
+    } else {
+        for (char8_t* p = start; p < end;) {
+            char32_t c;
+            if (*p < 0x80) {
+                c = *p++;
+            } else {
+                unsigned remaining = end - p;
+                read_utf8_buffer(&p, &remaining, &c);
+            }
+            _uw_put_char(dest, c, char_size);
+            dest += char_size;
+        }
+    }
+    _uw_string_set_length(&result, length);
+    return uw_move(&result);
+}
+
+static bool parse_digits(char8_t** ptr, char8_t* end, unsigned num_digits, unsigned* result)
+{
+    char8_t* p = *ptr;
+    if ((size_t) (end - p) < num_digits) {
+        return false;
+    }
+    unsigned n = 0;
+    for (unsigned i = 0; i < num_digits; i++) {
+        char8_t c = *p++;
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        n = n * 10 + c - '0';
+    }
+    *ptr = p;
+    *result = n;
+    return true;
+}
+
+static inline bool parse_char(char8_t** ptr, char8_t* end, char8_t c)
+{
+    if (*ptr < end && **ptr == c) {
+        (*ptr)++;
+        return true;
+    }
+    return false;
+}
+
+bool _uw_binary_parse_datetime(char8_t* str, size_t size, UwValuePtr result)
+{
+    char8_t* p = str;
+    char8_t* end = str + size;
+    unsigned year, month, day, hour, minute, second;
+
+    if (!(parse_digits(&p, end, 4, &year) && parse_char(&p, end, '-') &&
+          parse_digits(&p, end, 2, &month) && parse_char(&p, end, '-') &&
+          parse_digits(&p, end, 2, &day) &&
+          (parse_char(&p, end, 'T') || parse_char(&p, end, 't')) &&
+          parse_digits(&p, end, 2, &hour) && parse_char(&p, end, ':') &&
+          parse_digits(&p, end, 2, &minute) && parse_char(&p, end, ':') &&
+          parse_digits(&p, end, 2, &second))) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    unsigned nanosecond = 0;
+    if (parse_char(&p, end, '.')) {
+        unsigned num_digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (num_digits < 9) {
+                nanosecond = nanosecond * 10 + *p - '0';
+            }
+            num_digits++;
+            p++;
+        }
+        if (num_digits == 0) {
+            return false;
+        }
+        for (; num_digits < 9; num_digits++) {
+            nanosecond *= 10;
+        }
+    }
+    int gmt_offset = 0;
+    if (!(parse_char(&p, end, 'Z') || parse_char(&p, end, 'z'))) {
+        if (p == end || (*p != '+' && *p != '-')) {
+            return false;
+        }
+        bool negative = *p++ == '-';
+        unsigned offset_hours, offset_minutes;
+        if (!(parse_digits(&p, end, 2, &offset_hours) && parse_char(&p, end, ':') &&
+              parse_digits(&p, end, 2, &offset_minutes))) {
+            return false;
+        }
+        if (offset_hours > 23 || offset_minutes > 59) {
+            return false;
+        }
+        gmt_offset = offset_hours * 60 + offset_minutes;
+        if (negative) {
+            gmt_offset = -gmt_offset;
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+    *result = UwDateTime();
+    result->year       = year;
+    result->month      = month;
+    result->day        = day;
+    result->hour       = hour;
+    result->minute     = minute;
+    result->second     = second;
+    result->nanosecond = nanosecond;
+    result->gmt_offset = gmt_offset;
+    return true;
+}
+
+UwResult _uw_binary_decode_file(UwValuePtr file, _UwBinaryDecoder decode)
+{
+    int fd = uw_file_get_fd(file);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return UwErrno(errno);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return UwError(UW_ERROR_NOT_REGULAR_FILE);
+    }
+    if (st.st_size == 0) {
+        return decode(nullptr, 0);
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return UwErrno(errno);
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    UwValue result = decode(data, st.st_size);
+    munmap(data, st.st_size);
+    return uw_move(&result);
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+/*
+ * Internals shared by binary serialization formats, CBOR and MessagePack.
+ *
+ * Both formats are big-endian and prefix strings with their size in bytes,
+ * so the encoders share a fixed size output buffer that is flushed to the sink,
+ * and the decoders share string and file handling.
+ */
+
+#include "include/uw.h"
+#include "include/uw_sink.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UW_BINARY_BUFFER_SIZE  65536
+#define UW_BINARY_MAX_DEPTH    1024
+
+/****************************************************************
+ * Output
+ */
+
+typedef struct {
+    uint8_t* data;
+    unsigned size;
+    unsigned capacity;
+    UwSink*  sink;
+    _UwValue error;  // set when output functions return false
+} _UwBinaryOutput;
+
+bool _uw_binary_output_init(_UwBinaryOutput* out, UwSink* sink);
+/*
+ * Allocate buffer.
+ */
+
+void _uw_binary_output_fini(_UwBinaryOutput* out);
+/*
+ * Release buffer, unflushed data is discarded.
+ */
+
+bool _uw_binary_flush(_UwBinaryOutput* out);
+/*
+ * Write buffered data to the sink.
+ */
+
+static inline bool _uw_binary_reserve(_UwBinaryOutput* out, unsigned n)
+/*
+ * Make sure at least `n` bytes, no more than buffer capacity, can be written.
+ */
+{
+    if (out->capacity - out->size >= n) {
+        return true;
+    }
+    return _uw_binary_flush(out);
+}
+
+bool _uw_binary_write(_UwBinaryOutput* out, void* data, unsigned n);
+/*
+ * Write `n` bytes, large chunks bypass the buffer.
+ */
+
+static inline uint8_t* _uw_binary_put_be16(uint8_t* p, uint16_t n)
+{
+    n = __builtin_bswap16(n);
+    __builtin_memcpy(p, &n, 2);
+    return p + 2;
+}
+
+static inline uint8_t* _uw_binary_put_be32(uint8_t* p, uint32_t n)
+{
+    n = __builtin_bswap32(n);
+    __builtin_memcpy(p, &n, 4);
+    return p + 4;
+}
+
+static inline uint8_t* _uw_binary_put_be64(uint8_t* p, uint64_t n)
+{
+    n = __builtin_bswap64(n);
+    __builtin_memcpy(p, &n, 8);
+    return p + 8;
+}
+
+unsigned _uw_binary_utf8_size(UwValuePtr str);
+/*
+ * Return the size of String or CharPtr in UTF-8.
+ */
+
+bool _uw_binary_write_utf8(_UwBinaryOutput* out, UwValuePtr str);
+/*
+ * Write String or CharPtr in UTF-8.
+ */
+
+unsigned _uw_binary_format_datetime(UwValuePtr datetime, char8_t* buffer);
+/*
+ * Format DateTime as RFC 3339 string, up to 40 bytes.
+ * Return the size of string.
+ */
+
+int64_t _uw_binary_datetime_to_epoch(UwValuePtr datetime);
+/*
+ * Convert DateTime to the number of seconds since 1970-01-01T00:00:00Z.
+ */
+
+bool _uw_binary_epoch_to_datetime(int64_t seconds, uint32_t nanoseconds, UwValuePtr result);
+/*
+ * Convert the number of seconds since 1970-01-01T00:00:00Z to UTC DateTime.
+ * Return false if the year is out of DateTime range.
+ */
+
+/****************************************************************
+ * Input
+ */
+
+typedef struct {
+    uint8_t* data;
+    size_t   size;
+    size_t   position;
+} _UwBinaryInput;
+
+static inline uint16_t _uw_binary_get_be16(uint8_t* p)
+{
+    uint16_t n;
+    __builtin_memcpy(&n, p, 2);
+    return __builtin_bswap16(n);
+}
+
+static inline uint32_t _uw_binary_get_be32(uint8_t* p)
+{
+    uint32_t n;
+    __builtin_memcpy(&n, p, 4);
+    return __builtin_bswap32(n);
+}
+
+static inline uint64_t _uw_binary_get_be64(uint8_t* p)
+{
+    uint64_t n;
+    __builtin_memcpy(&n, p, 8);
+    return __builtin_bswap64(n);
+}
+
+UwResult _uw_binary_error(_UwBinaryInput* input, size_t position, char* message);
+/*
+ * Return UW_ERROR_MALFORMED_DATA with offset and message in the description.
+ */
+
+UwResult _uw_binary_decode_string(_UwBinaryInput* input, size_t position, size_t size);
+/*
+ * Decode UTF-8 string of `size` bytes at `position`.
+ * The string is created with the narrowest char size.
+ */
+
+bool _uw_binary_parse_datetime(char8_t* str, size_t size, UwValuePtr result);
+/*
+ * Parse RFC 3339 date/time string.
+ */
+
+typedef UwResult (*_UwBinaryDecoder)(uint8_t* data, size_t size);
+
+UwResult _uw_binary_decode_file(UwValuePtr file, _UwBinaryDecoder decode);
+/*
+ * Memory map file and decode it.
+ */
+
+#ifdef __cplusplus
+}
+#endif
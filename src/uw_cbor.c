@@ -0,0 +1,575 @@
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "include/uw_cbor.h"
+
+#include "src/uw_binary_internal.h"
+
+// major types
+#define MAJOR_UNSIGNED  0
+#define MAJOR_NEGATIVE  1
+#define MAJOR_BYTES     2
+#define MAJOR_TEXT      3
+#define MAJOR_ARRAY     4
+#define MAJOR_MAP       5
+#define MAJOR_TAG       6
+#define MAJOR_SIMPLE    7
+
+// additional information
+#define INFO_UINT8        24
+#define INFO_UINT16       25
+#define INFO_UINT32       26
+#define INFO_UINT64       27
+#define INFO_INDEFINITE   31
+
+// simple values and floats
+#define SIMPLE_FALSE      20
+#define SIMPLE_TRUE       21
+#define SIMPLE_NULL       22
+#define SIMPLE_UNDEFINED  23
+#define SIMPLE_FLOAT16    25
+#define SIMPLE_FLOAT32    26
+#define SIMPLE_FLOAT64    27
+
+#define BREAK  0xFF
+
+// tags
+#define TAG_DATETIME_STRING   0
+#define TAG_EPOCH_DATETIME    1
+#define TAG_EXTENDED_TIME  1001
+
+// keys of extended time map
+#define ETIME_SECONDS        1
+#define ETIME_MILLISECONDS  -3
+#define ETIME_MICROSECONDS  -6
+#define ETIME_NANOSECONDS   -9
+
+/****************************************************************
+ * Encoder
+ */
+
+// forward declaration
+static bool encode_value(_UwBinaryOutput* out, UwValuePtr value);
+
+static inline bool put_head(_UwBinaryOutput* out, uint8_t major, uint64_t n)
+/*
+ * Write initial byte and argument in the shortest form.
+ */
+{
+    if (!_uw_binary_reserve(out, 9)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    major <<= 5;
+    if (n < INFO_UINT8) {
+        *p++ = major | (uint8_t) n;
+    } else if (n <= UINT8_MAX) {
+        *p++ = major | INFO_UINT8;
+        *p++ = (uint8_t) n;
+    } else if (n <= UINT16_MAX) {
+        *p++ = major | INFO_UINT16;
+        p = _uw_binary_put_be16(p, (uint16_t) n);
+    } else if (n <= UINT32_MAX) {
+        *p++ = major | INFO_UINT32;
+        p = _uw_binary_put_be32(p, (uint32_t) n);
+    } else {
+        *p++ = major | INFO_UINT64;
+        p = _uw_binary_put_be64(p, n);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static inline bool put_byte(_UwBinaryOutput* out, uint8_t b)
+{
+    if (!_uw_binary_reserve(out, 1)) {
+        return false;
+    }
+    out->data[out->size++] = b;
+    return true;
+}
+
+static bool encode_float(_UwBinaryOutput* out, double f)
+{
+    if (!_uw_binary_reserve(out, 9)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    float f32 = (float) f;
+    if ((double) f32 == f) {
+        uint32_t bits;
+        memcpy(&bits, &f32, 4);
+        *p++ = (MAJOR_SIMPLE << 5) | SIMPLE_FLOAT32;
+        p = _uw_binary_put_be32(p, bits);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &f, 8);
+        *p++ = (MAJOR_SIMPLE << 5) | SIMPLE_FLOAT64;
+        p = _uw_binary_put_be64(p, bits);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static bool encode_string(_UwBinaryOutput* out, UwValuePtr str)
+{
+    return put_head(out, MAJOR_TEXT, _uw_binary_utf8_size(str))
+        && _uw_binary_write_utf8(out, str);
+}
+
+static bool encode_datetime(_UwBinaryOutput* out, UwValuePtr value)
+{
+    char8_t buf[40];
+    unsigned size = _uw_binary_format_datetime(value, buf);
+    return put_head(out, MAJOR_TAG, TAG_DATETIME_STRING)
+        && put_head(out, MAJOR_TEXT, size)
+        && _uw_binary_write(out, buf, size);
+}
+
+static bool encode_timestamp(_UwBinaryOutput* out, UwValuePtr value)
+{
+    if (value->ts_nanoseconds == 0) {
+        return put_head(out, MAJOR_TAG, TAG_EPOCH_DATETIME)
+            && put_head(out, MAJOR_UNSIGNED, value->ts_seconds);
+    }
+    return put_head(out, MAJOR_TAG, TAG_EXTENDED_TIME)
+        && put_head(out, MAJOR_MAP, 2)
+        && put_head(out, MAJOR_UNSIGNED, ETIME_SECONDS)
+        && put_head(out, MAJOR_UNSIGNED, value->ts_seconds)
+        && put_head(out, MAJOR_NEGATIVE, -1 - ETIME_NANOSECONDS)
+        && put_head(out, MAJOR_UNSIGNED, value->ts_nanoseconds);
+}
+
+static bool encode_array(_UwBinaryOutput* out, UwValuePtr value)
+{
+    unsigned num_items = uw_array_length(value);
+    if (!put_head(out, MAJOR_ARRAY, num_items)) {
+        return false;
+    }
+    for (unsigned i = 0; i < num_items; i++) {{
+        UwValue item = uw_array_item(value, i);
+        if (!encode_value(out, &item)) {
+            return false;
+        }
+    }}
+    return true;
+}
+
+static bool encode_map(_UwBinaryOutput* out, UwValuePtr value)
+{
+    unsigned num_items = uw_map_length(value);
+    if (!put_head(out, MAJOR_MAP, num_items)) {
+        return false;
+    }
+    for (unsigned i = 0; i < num_items; i++) {{
+        UwValue k = UwNull();
+        UwValue v = UwNull();
+        uw_map_item(value, i, &k, &v);
+        if (!encode_value(out, &k) || !encode_value(out, &v)) {
+            return false;
+        }
+    }}
+    return true;
+}
+
+static bool encode_value(_UwBinaryOutput* out, UwValuePtr value)
+{
+    if (uw_is_null(value)) {
+        return put_byte(out, (MAJOR_SIMPLE << 5) | SIMPLE_NULL);
+    }
+    if (uw_is_bool(value)) {
+        return put_byte(out, (MAJOR_SIMPLE << 5) | (value->bool_value? SIMPLE_TRUE : SIMPLE_FALSE));
+    }
+    if (uw_is_signed(value)) {
+        if (value->signed_value < 0) {
+            return put_head(out, MAJOR_NEGATIVE, (uint64_t) (-1 - value->signed_value));
+        }
+        return put_head(out, MAJOR_UNSIGNED, (uint64_t) value->signed_value);
+    }
+    if (uw_is_unsigned(value)) {
+        return put_head(out, MAJOR_UNSIGNED, value->unsigned_value);
+    }
+    if (uw_is_float(value)) {
+        return encode_float(out, value->float_value);
+    }
+    if (uw_is_charptr(value) || uw_is_string(value)) {
+        return encode_string(out, value);
+    }
+    if (uw_is_array(value)) {
+        return encode_array(out, value);
+    }
+    if (uw_is_map(value)) {
+        return encode_map(out, value);
+    }
+    if (uw_is_datetime(value)) {
+        return encode_datetime(out, value);
+    }
+    if (uw_is_timestamp(value)) {
+        return encode_timestamp(out, value);
+    }
+    out->error = UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    return false;
+}
+
+UwResult uw_to_cbor_write(UwValuePtr value, UwSink* sink)
+{
+    _UwBinaryOutput out;
+    if (_uw_binary_output_init(&out, sink)
+        && encode_value(&out, value)
+        && _uw_binary_flush(&out)) {
+
+        _uw_binary_output_fini(&out);
+        return UwOK();
+    }
+    UwValue status = uw_move(&out.error);
+    _uw_binary_output_fini(&out);
+    return uw_move(&status);
+}
+
+/****************************************************************
+ * Decoder
+ */
+
+// forward declaration
+static UwResult decode_item(_UwBinaryInput* in, unsigned depth);
+
+static UwResult read_head(_UwBinaryInput* in, uint8_t* major, uint8_t* info, uint64_t* argument)
+/*
+ * Read initial byte and argument.
+ * Argument is zero for indefinite length items.
+ */
+{
+    if (in->position >= in->size) {
+        return _uw_binary_error(in, in->position, "unexpected end of data");
+    }
+    uint8_t initial_byte = in->data[in->position++];
+    *major = initial_byte >> 5;
+    *info = initial_byte & 31;
+    if (*info < INFO_UINT8) {
+        *argument = *info;
+        return UwOK();
+    }
+    if (*info == INFO_INDEFINITE) {
+        *argument = 0;
+        return UwOK();
+    }
+    if (*info > INFO_UINT64) {
+        return _uw_binary_error(in, in->position - 1, "reserved additional information");
+    }
+    unsigned n = 1 << (*info - INFO_UINT8);
+    if (in->size - in->position < n) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    uint8_t* p = in->data + in->position;
+    switch (n) {
+        case 1: *argument = *p; break;
+        case 2: *argument = _uw_binary_get_be16(p); break;
+        case 4: *argument = _uw_binary_get_be32(p); break;
+        default: *argument = _uw_binary_get_be64(p); break;
+    }
+    in->position += n;
+    return UwOK();
+}
+
+static inline bool at_break(_UwBinaryInput* in)
+/*
+ * Check for break code and consume it.
+ */
+{
+    if (in->position < in->size && in->data[in->position] == BREAK) {
+        in->position++;
+        return true;
+    }
+    return false;
+}
+
+static UwResult decode_text(_UwBinaryInput* in, uint64_t size)
+{
+    if (size > in->size - in->position) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    UwValue result = _uw_binary_decode_string(in, in->position, size);
+    uw_return_if_error(&result);
+    in->position += size;
+    return uw_move(&result);
+}
+
+static UwResult decode_indefinite_text(_UwBinaryInput* in)
+/*
+ * Decode and concatenate chunks of indefinite length string.
+ */
+{
+    UwValue result = UwString();
+    while (!at_break(in)) {{
+        size_t chunk_position = in->position;
+        uint8_t major, info;
+        uint64_t size;
+        uw_expect_ok( read_head(in, &major, &info, &size) );
+        if (major != MAJOR_TEXT || info == INFO_INDEFINITE) {
+            return _uw_binary_error(in, chunk_position, "bad chunk of indefinite length string");
+        }
+        UwValue chunk = decode_text(in, size);
+        uw_return_if_error(&chunk);
+        if (!uw_string_append(&result, &chunk)) {
+            return UwOOM();
+        }
+    }}
+    return uw_move(&result);
+}
+
+static UwResult decode_array(_UwBinaryInput* in, uint8_t info, uint64_t num_items, unsigned depth)
+{
+    UwValue result = UwArray();
+    uw_return_if_error(&result);
+
+    if (info == INFO_INDEFINITE) {
+        while (!at_break(in)) {{
+            UwValue item = decode_item(in, depth + 1);
+            uw_return_if_error(&item);
+            uw_expect_ok( uw_array_append_va(&result, uw_move(&item)) );
+        }}
+        return uw_move(&result);
+    }
+    // each item takes at least one byte
+    if (num_items > in->size - in->position) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    if (num_items > UINT_MAX) {
+        return UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+    }
+    if (num_items) {
+        uw_expect_ok( uw_array_resize(&result, (unsigned) num_items) );
+    }
+    for (uint64_t i = 0; i < num_items; i++) {{
+        UwValue item = decode_item(in, depth + 1);
+        uw_return_if_error(&item);
+        uw_expect_ok( uw_array_append_va(&result, uw_move(&item)) );
+    }}
+    return uw_move(&result);
+}
+
+static UwResult decode_map_item(_UwBinaryInput* in, UwValuePtr map, unsigned depth)
+{
+    UwValue key = decode_item(in, depth + 1);
+    uw_return_if_error(&key);
+    UwValue value = decode_item(in, depth + 1);
+    uw_return_if_error(&value);
+    return uw_map_update_va(map, uw_move(&key), uw_move(&value));
+}
+
+static UwResult decode_map(_UwBinaryInput* in, uint8_t info, uint64_t num_items, unsigned depth)
+{
+    UwValue result = UwMap();
+    uw_return_if_error(&result);
+
+    if (info == INFO_INDEFINITE) {
+        while (!at_break(in)) {
+            uw_expect_ok( decode_map_item(in, &result, depth) );
+        }
+        return uw_move(&result);
+    }
+    // each key and value take at least one byte
+    if (num_items > (in->size - in->position) / 2) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    for (uint64_t i = 0; i < num_items; i++) {
+        uw_expect_ok( decode_map_item(in, &result, depth) );
+    }
+    return uw_move(&result);
+}
+
+static UwResult decode_datetime_string(_UwBinaryInput* in)
+{
+    size_t position = in->position;
+    uint8_t major, info;
+    uint64_t size;
+    uw_expect_ok( read_head(in, &major, &info, &size) );
+    if (major != MAJOR_TEXT || info == INFO_INDEFINITE) {
+        return _uw_binary_error(in, position, "date/time string expected");
+    }
+    if (size > in->size - in->position) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    UwValue result = UwNull();
+    if (!_uw_binary_parse_datetime(in->data + in->position, size, &result)) {
+        return _uw_binary_error(in, position, "bad date/time string");
+    }
+    in->position += size;
+    return uw_move(&result);
+}
+
+static UwResult decode_epoch_datetime(_UwBinaryInput* in, unsigned depth)
+{
+    size_t position = in->position;
+    UwValue value = decode_item(in, depth + 1);
+    uw_return_if_error(&value);
+
+    UwValue result = UwTimestamp();
+    if (uw_is_signed(&value) && value.signed_value >= 0) {
+        result.ts_seconds = value.signed_value;
+    } else if (uw_is_unsigned(&value)) {
+        result.ts_seconds = value.unsigned_value;
+    } else if (uw_is_float(&value) && value.float_value >= 0 && value.float_value < 0x1p64) {
+        double seconds = floor(value.float_value);
+        double nanoseconds = round((value.float_value - seconds) * 1e9);
+        result.ts_seconds = (uint64_t) seconds;
+        result.ts_nanoseconds = (nanoseconds > 999'999'999)? 999'999'999 : (uint32_t) nanoseconds;
+    } else {
+        return _uw_binary_error(in, position, "bad epoch date/time");
+    }
+    return uw_move(&result);
+}
+
+static UwResult decode_extended_time(_UwBinaryInput* in, unsigned depth)
+{
+    size_t position = in->position;
+    UwValue value = decode_item(in, depth + 1);
+    uw_return_if_error(&value);
+    if (!uw_is_map(&value)) {
+        return _uw_binary_error(in, position, "extended time must be a map");
+    }
+    UwValue seconds = uw_map_get(&value, ETIME_SECONDS);
+    if (!uw_is_signed(&seconds) || seconds.signed_value < 0) {
+        return _uw_binary_error(in, position, "bad extended time seconds");
+    }
+    UwValue result = UwTimestamp();
+    result.ts_seconds = seconds.signed_value;
+
+    static const struct { int key; unsigned max; unsigned multiplier; } fractions[] = {
+        { ETIME_MILLISECONDS, 999,         1000'000 },
+        { ETIME_MICROSECONDS, 999'999,     1000 },
+        { ETIME_NANOSECONDS,  999'999'999, 1 }
+    };
+    for (unsigned i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++) {{
+        UwValue fraction = uw_map_get(&value, fractions[i].key);
+        if (uw_error(&fraction)) {
+            continue;
+        }
+        if (!uw_is_signed(&fraction) || fraction.signed_value < 0
+            || fraction.signed_value > fractions[i].max) {
+            return _uw_binary_error(in, position, "bad extended time fraction");
+        }
+        result.ts_nanoseconds = fraction.signed_value * fractions[i].multiplier;
+    }}
+    return uw_move(&result);
+}
+
+static UwResult decode_simple(_UwBinaryInput* in, uint8_t info, uint64_t argument)
+{
+    switch (info) {
+        case SIMPLE_FALSE:
+            return UwBool(false);
+        case SIMPLE_TRUE:
+            return UwBool(true);
+        case SIMPLE_NULL:
+        case SIMPLE_UNDEFINED:
+            return UwNull();
+        case SIMPLE_FLOAT16: {
+            // half precision: 1 sign bit, 5 exponent bits, 10 mantissa bits
+            unsigned exponent = (argument >> 10) & 0x1F;
+            unsigned mantissa = argument & 0x3FF;
+            double f;
+            if (exponent == 0) {
+                f = ldexp(mantissa, -24);
+            } else if (exponent == 31) {
+                f = mantissa? NAN : INFINITY;
+            } else {
+                f = ldexp(mantissa + 1024, exponent - 25);
+            }
+            return UwFloat((argument & 0x8000)? -f : f);
+        }
+        case SIMPLE_FLOAT32: {
+            uint32_t bits = (uint32_t) argument;
+            float f;
+            memcpy(&f, &bits, 4);
+            return UwFloat(f);
+        }
+        case SIMPLE_FLOAT64: {
+            double f;
+            memcpy(&f, &argument, 8);
+            return UwFloat(f);
+        }
+        case INFO_INDEFINITE:
+            return _uw_binary_error(in, in->position - 1, "unexpected break");
+        default:
+            return _uw_binary_error(in, in->position - 1, "unsupported simple value");
+    }
+}
+
+static UwResult decode_item(_UwBinaryInput* in, unsigned depth)
+{
+    if (depth > UW_BINARY_MAX_DEPTH) {
+        return _uw_binary_error(in, in->position, "nesting is too deep");
+    }
+    size_t position = in->position;
+    uint8_t major, info;
+    uint64_t argument;
+    uw_expect_ok( read_head(in, &major, &info, &argument) );
+
+    if (info == INFO_INDEFINITE && (major < MAJOR_BYTES || major == MAJOR_TAG)) {
+        return _uw_binary_error(in, position, "indefinite length is not allowed");
+    }
+    switch (major) {
+        case MAJOR_UNSIGNED:
+            if (argument <= INT64_MAX) {
+                return UwSigned((int64_t) argument);
+            }
+            return UwUnsigned(argument);
+
+        case MAJOR_NEGATIVE:
+            if (argument > INT64_MAX) {
+                return _uw_binary_error(in, position, "negative integer is out of range");
+            }
+            return UwSigned(-1 - (int64_t) argument);
+
+        case MAJOR_BYTES:
+            return _uw_binary_error(in, position, "byte strings are not supported");
+
+        case MAJOR_TEXT:
+            if (info == INFO_INDEFINITE) {
+                return decode_indefinite_text(in);
+            }
+            return decode_text(in, argument);
+
+        case MAJOR_ARRAY:
+            return decode_array(in, info, argument, depth);
+
+        case MAJOR_MAP:
+            return decode_map(in, info, argument, depth);
+
+        case MAJOR_TAG:
+            switch (argument) {
+                case TAG_DATETIME_STRING: return decode_datetime_string(in);
+                case TAG_EPOCH_DATETIME:  return decode_epoch_datetime(in, depth);
+                case TAG_EXTENDED_TIME:   return decode_extended_time(in, depth);
+                default:                  return decode_item(in, depth + 1);
+            }
+
+        default:
+            return decode_simple(in, info, argument);
+    }
+}
+
+UwResult uw_from_cbor_buffer(uint8_t* data, size_t size)
+{
+    _UwBinaryInput input = {
+        .data = data,
+        .size = size
+    };
+    UwValue result = decode_item(&input, 1);
+    uw_return_if_error(&result);
+
+    if (input.position != input.size) {
+        return _uw_binary_error(&input, input.position, "extra data after CBOR data item");
+    }
+    return uw_move(&result);
+}
+
+UwResult uw_from_cbor(UwValuePtr file)
+{
+    if (!uw_is_file(file)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    return _uw_binary_decode_file(file, uw_from_cbor_buffer);
+}
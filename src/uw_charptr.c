@@ -98,33 +98,41 @@ static void charptr_dump(UwValuePtr self, FILE* fp, int first_indent, int next_i
         case UW_CHARPTR: {
             fputs("char8_t*: ", fp);
             char8_t* ptr = self->charptr;
+            char buffer[81 * 4 + 4];
+            char* p = buffer;
             for (unsigned i = 0;; i++) {
                 char32_t c = read_utf8_char(&ptr);
                 if (c == 0) {
                     break;
                 }
-                _uw_putchar32_utf8(fp, c);
+                p = uw_char32_to_utf8(c, p);
                 if (i == 80) {
-                    fprintf(fp, "...");
+                    memcpy(p, "...", 3);
+                    p += 3;
                     break;
                 }
             }
+            fwrite(buffer, 1, p - buffer, fp);
             break;
         }
         case UW_CHAR32PTR: {
             fputs("char32_t*: ", fp);
             char32_t* ptr = self->char32ptr;
+            char buffer[81 * 4 + 4];
+            char* p = buffer;
             for (unsigned i = 0;; i++) {
                 char32_t c = *ptr++;
                 if (c == 0) {
                     break;
                 }
-                _uw_putchar32_utf8(fp, c);
+                p = uw_char32_to_utf8(c, p);
                 if (i == 80) {
-                    fprintf(fp, "...");
+                    memcpy(p, "...", 3);
+                    p += 3;
                     break;
                 }
             }
+            fwrite(buffer, 1, p - buffer, fp);
             break;
         }
         default:
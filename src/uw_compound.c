@@ -48,9 +48,14 @@ bool _uw_adopt(UwValuePtr parent, UwValuePtr child)
     _UwCompoundData* parent_cdata = _uw_compound_data_ptr(parent);
     _UwCompoundData* child_cdata = _uw_compound_data_ptr(child);
 
+    if (_uw_refcount_load(&child_cdata->struct_data.refcount) == UW_REFCOUNT_IMMORTAL || _uw_in_arena(child_cdata)) {
+        // immortal values are never destroyed and cannot refer to mortal parents,
+        // arena values are destroyed all at once
+        return true;
+    }
     if (parent_cdata == child_cdata) {
 success:
-        child_cdata->struct_data.refcount--;
+        _uw_refcount_dec(&child_cdata->struct_data.refcount);
         return true;;
     }
     if (child_cdata->using_parents_list) {
@@ -178,7 +183,8 @@ bool _uw_abandon(UwValuePtr parent, UwValuePtr child)
     _UwCompoundData* parent_cdata = _uw_compound_data_ptr(parent);
     _UwCompoundData* child_cdata = _uw_compound_data_ptr(child);
 
-    if (parent_cdata == child_cdata) {
+    if (parent_cdata == child_cdata || _uw_refcount_load(&child_cdata->struct_data.refcount) == UW_REFCOUNT_IMMORTAL
+        || _uw_in_arena(child_cdata)) {
         return true;
     }
     if (child_cdata->using_parents_list) {
@@ -235,7 +241,7 @@ static unsigned check_parent_link(_UwCompoundData* first, _UwCompoundData* paren
 {
     unsigned result = 0;  // bit flags: HAVE_CYCLIC_REFS and NONZERO_REFCOUNT
 
-    if (parent->struct_data.refcount) {
+    if (_uw_refcount_load(&parent->struct_data.refcount)) {
         result |= NONZERO_REFCOUNT;
     }
     if (parent == first) {
@@ -331,10 +337,12 @@ void _uw_compound_destroy(UwValuePtr self)
     if (!struct_data) {
         return;
     }
-    if (struct_data->refcount) {
-        struct_data->refcount--;
+    unsigned refcount = _uw_refcount_load(&struct_data->refcount);
+    if (refcount == UW_REFCOUNT_IMMORTAL || _uw_in_arena(struct_data)) {
+        // arena data is released with the arena
+        return;
     }
-    if (struct_data->refcount) {
+    if (refcount && _uw_refcount_dec(&struct_data->refcount)) {
         return;
     }
 
@@ -396,7 +404,7 @@ UwType _uw_compound_type = {
     .id             = UwTypeId_Compound,
     .ancestor_id    = UwTypeId_Struct,
     .name           = "Compound",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
     .create         = _uw_struct_create,
     .destroy        = _uw_compound_destroy,
     .clone          = _uw_struct_clone,
@@ -15,8 +15,8 @@ void _uw_dump_start(FILE* fp, UwValuePtr value, int indent)
 
 void _uw_print_indent(FILE* fp, int indent)
 {
-    for (int i = 0; i < indent; i++ ) {
-        fputc(' ', fp);
+    if (indent > 0) {
+        fprintf(fp, "%*s", indent, "");
     }
 }
 
@@ -1,6 +1,11 @@
 #include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "include/uw.h"
@@ -9,6 +14,32 @@
 #include "src/uw_struct_internal.h"
 
 #define LINE_READER_BUFFER_SIZE  4096  // typical filesystem block size
+#define READAHEAD_NUM_BUFFERS    2     // the consumer decodes one buffer while the helper thread fills another
+
+typedef struct {
+    char8_t  data[LINE_READER_BUFFER_SIZE];
+    unsigned data_size;
+    int      error;  // errno
+} _UwReadaheadBuffer;
+
+typedef struct {
+    /*
+     * Single producer, single consumer ring of buffers.
+     * Counters grow monotonically, the index in the ring is counter % READAHEAD_NUM_BUFFERS.
+     * Waiting is done with futexes on the counters.
+     */
+    _Atomic uint32_t head;  // buffers released by the consumer
+    _Atomic uint32_t tail;  // buffers filled by the producer
+    _Atomic bool consumer_waiting;
+    _Atomic bool producer_waiting;
+    _Atomic bool stop;
+    bool holding;  // the consumer holds the buffer at head
+    pthread_t thread;
+    int fd;
+    uint64_t read_offset;
+    uint64_t range_end;
+    _UwReadaheadBuffer buffers[READAHEAD_NUM_BUFFERS];
+} _UwReadahead;
 
 typedef struct {
     int fd;               // file descriptor
@@ -24,7 +55,13 @@ typedef struct {
     char8_t  partial_utf8[4];  // UTF-8 sequence may span adjacent reads
     unsigned partial_utf8_len;
     _UwValue pushback;  // for unread_line
+    _UwValue view_line; // for read_line_view, when the line can't be referenced in the buffer
     unsigned line_number;
+    uint64_t range_start;  // range of bytes for line reader
+    uint64_t range_end;    // zero means the end of file
+    uint64_t read_offset;  // file offset of the next chunk to read
+    bool readahead;        // use helper thread for line reader
+    _UwReadahead* readahead_state;
 } _UwFile;
 
 #define get_data_ptr(value)  ((_UwFile*) _uw_get_data_ptr((value), UwTypeId_File))
@@ -45,6 +82,7 @@ static UwResult file_init(UwValuePtr self, void* ctor_args)
     f->fd = -1;
     f->name = UwNull();
     f->pushback = UwNull();
+    f->view_line = UwNull();
     return UwOK();
 }
 
@@ -217,6 +255,11 @@ static bool file_set_name(UwValuePtr self, UwValuePtr file_name)
     return true;
 }
 
+static int file_get_fd(UwValuePtr self)
+{
+    return get_data_ptr(self)->fd;
+}
+
 /****************************************************************
  * FileReader interface
  */
@@ -242,6 +285,42 @@ static UwResult file_read(UwValuePtr self, void* buffer, unsigned buffer_size, u
     }
 }
 
+static UwResult file_pread(UwValuePtr self, void* buffer, unsigned buffer_size, uint64_t offset, unsigned* bytes_read)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    ssize_t result;
+    do {
+        result = pread(f->fd, buffer, buffer_size, (off_t) offset);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        return UwErrno(errno);
+    } else {
+        *bytes_read = (unsigned) result;
+        return UwOK();
+    }
+}
+
+static void file_set_line_range(UwValuePtr self, uint64_t start, uint64_t end)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    // XXX check if iteration is in progress
+
+    f->range_start = start;
+    f->range_end = end;
+}
+
+static void file_set_readahead(UwValuePtr self, bool enable)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    // XXX check if iteration is in progress
+
+    f->readahead = enable;
+}
+
 /****************************************************************
  * FileWriter interface
  */
@@ -267,17 +346,188 @@ static UwResult file_write(UwValuePtr self, void* data, unsigned size, unsigned*
     }
 }
 
+/****************************************************************
+ * Readahead
+ */
+
+static unsigned next_chunk_size(uint64_t read_offset, uint64_t range_end)
+{
+    if (range_end) {
+        uint64_t remaining = (read_offset < range_end)? range_end - read_offset : 0;
+        if (remaining < LINE_READER_BUFFER_SIZE) {
+            return (unsigned) remaining;
+        }
+    }
+    return LINE_READER_BUFFER_SIZE;
+}
+
+static void futex_wait(_Atomic uint32_t* addr, uint32_t expected)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+static void* readahead_thread(void* arg)
+{
+    _UwReadahead* ra = arg;
+
+    for (;;) {
+        uint32_t tail = atomic_load_explicit(&ra->tail, memory_order_relaxed);
+
+        // wait for free buffer
+        for (;;) {
+            uint32_t head = atomic_load(&ra->head);
+            if (atomic_load(&ra->stop)) {
+                return nullptr;
+            }
+            if (tail - head < READAHEAD_NUM_BUFFERS) {
+                break;
+            }
+            atomic_store(&ra->producer_waiting, true);
+            if (atomic_load(&ra->head) == head && !atomic_load(&ra->stop)) {
+                futex_wait(&ra->head, head);
+            }
+            atomic_store(&ra->producer_waiting, false);
+        }
+
+        _UwReadaheadBuffer* buffer = &ra->buffers[tail % READAHEAD_NUM_BUFFERS];
+        unsigned chunk_size = next_chunk_size(ra->read_offset, ra->range_end);
+        ssize_t result = 0;
+        if (chunk_size) {
+            do {
+                result = read(ra->fd, buffer->data, chunk_size);
+            } while (result < 0 && errno == EINTR);
+        }
+        if (result < 0) {
+            buffer->data_size = 0;
+            buffer->error = errno;
+        } else {
+            buffer->data_size = (unsigned) result;
+            buffer->error = 0;
+            ra->read_offset += result;
+        }
+
+        // publish the buffer
+        atomic_store(&ra->tail, tail + 1);
+        if (atomic_load(&ra->consumer_waiting)) {
+            futex_wake(&ra->tail);
+        }
+
+        if (buffer->error || buffer->data_size == 0) {
+            // end of file, end of range, or error: nothing to read ahead anymore
+            return nullptr;
+        }
+    }
+}
+
+static void stop_readahead(_UwFile* f)
+{
+    _UwReadahead* ra = f->readahead_state;
+    if (!ra) {
+        return;
+    }
+    atomic_store(&ra->stop, true);
+    // change head to make sure the producer does not fall asleep after checking the stop flag
+    atomic_fetch_add(&ra->head, READAHEAD_NUM_BUFFERS);
+    futex_wake(&ra->head);
+    pthread_join(ra->thread, nullptr);
+
+    release((void**) &f->readahead_state, sizeof(_UwReadahead));
+    f->readahead_state = nullptr;
+    f->buffer = nullptr;
+}
+
+static UwResult start_readahead(_UwFile* f)
+{
+    _UwReadahead* ra = allocate(sizeof(_UwReadahead), true);
+    if (!ra) {
+        return UwOOM();
+    }
+    ra->fd = f->fd;
+    ra->read_offset = f->read_offset;
+    ra->range_end = f->range_end;
+
+    int rc = pthread_create(&ra->thread, nullptr, readahead_thread, ra);
+    if (rc) {
+        release((void**) &ra, sizeof(_UwReadahead));
+        return UwErrno(rc);
+    }
+    f->readahead_state = ra;
+
+    // the line reader needs non-null buffer, the actual one will be set by read_chunk
+    f->buffer = ra->buffers[0].data;
+    return UwOK();
+}
+
+static UwResult readahead_next_chunk(_UwFile* f)
+{
+    _UwReadahead* ra = f->readahead_state;
+
+    uint32_t head = atomic_load_explicit(&ra->head, memory_order_relaxed);
+    if (ra->holding) {
+        // release current buffer to the producer
+        head++;
+        atomic_store(&ra->head, head);
+        ra->holding = false;
+        if (atomic_load(&ra->producer_waiting)) {
+            futex_wake(&ra->head);
+        }
+    }
+
+    // wait for filled buffer
+    for (;;) {
+        uint32_t tail = atomic_load(&ra->tail);
+        if (tail != head) {
+            break;
+        }
+        atomic_store(&ra->consumer_waiting, true);
+        if (atomic_load(&ra->tail) == tail) {
+            futex_wait(&ra->tail, tail);
+        }
+        atomic_store(&ra->consumer_waiting, false);
+    }
+
+    _UwReadaheadBuffer* buffer = &ra->buffers[head % READAHEAD_NUM_BUFFERS];
+    ra->holding = true;
+    if (buffer->error) {
+        f->data_size = 0;
+        return UwErrno(buffer->error);
+    }
+    f->buffer = buffer->data;
+    f->data_size = buffer->data_size;
+    f->read_offset += buffer->data_size;
+    return UwOK();
+}
+
 /****************************************************************
  * LineReader interface methods
  */
 
+static void release_line_reader_buffers(_UwFile* f)
+{
+    if (f->readahead_state) {
+        stop_readahead(f);
+    } else {
+        release((void**) &f->buffer, LINE_READER_BUFFER_SIZE);
+        f->buffer = nullptr;
+    }
+}
+
 static UwResult start_read_lines(UwValuePtr self)
 {
     _UwFile* f = get_data_ptr(self);
 
     uw_destroy(&f->pushback);
 
-    if (f->buffer == nullptr) {
+    if (f->readahead_state || (f->buffer && f->readahead)) {
+        // restart helper thread or switch to readahead mode
+        release_line_reader_buffers(f);
+    }
+    if (f->buffer == nullptr && !f->readahead) {
         f->buffer = allocate(LINE_READER_BUFFER_SIZE, false);
         if (!f->buffer) {
             return UwOOM();
@@ -290,10 +540,89 @@ static UwResult start_read_lines(UwValuePtr self)
     f->data_size = LINE_READER_BUFFER_SIZE;
 
     // reset file position
-    if (lseek(f->fd, 0, SEEK_SET) == -1) {
+    if (lseek(f->fd, (off_t) f->range_start, SEEK_SET) == -1) {
         return UwErrno(errno);
     }
+    f->read_offset = f->range_start;
     f->line_number = 0;
+
+    if (f->readahead) {
+        uw_expect_ok( start_readahead(f) );
+    }
+    return UwOK();
+}
+
+static UwResult read_chunk(UwValuePtr self)
+/*
+ * Read next chunk of file into the buffer.
+ * Short read means end of file or end of range.
+ */
+{
+    _UwFile* f = get_data_ptr(self);
+
+    if (f->readahead_state) {
+        return readahead_next_chunk(f);
+    }
+
+    unsigned chunk_size = next_chunk_size(f->read_offset, f->range_end);
+    if (chunk_size == 0) {
+        f->data_size = 0;
+        return UwOK();
+    }
+    uw_expect_ok( file_read(self, f->buffer, chunk_size, &f->data_size) );
+    f->read_offset += f->data_size;
+    return UwOK();
+}
+
+static UwResult next_chunk(UwValuePtr self, UwValuePtr dest)
+/*
+ * Read next chunk of file and complete partial UTF-8 sequence
+ * carried over from the previous chunk, appending decoded character to `dest`.
+ *
+ * Return UW_ERROR_EOF if no more data.
+ */
+{
+    _UwFile* f = get_data_ptr(self);
+
+    f->position = 0;
+
+    uw_expect_ok( read_chunk(self) );
+    if (f->data_size == 0) {
+        return UwError(UW_ERROR_EOF);
+    }
+
+    if (f->partial_utf8_len) {
+        // process partial UTF-8 sequence
+        while (f->partial_utf8_len < 4) {
+
+            if (f->position == f->data_size) {
+                // premature end of file
+                // XXX warn?
+                return UwError(UW_ERROR_EOF);
+            }
+
+            char8_t c = f->buffer[f->position];
+            if (c < 0x80 || ((c & 0xC0) != 0x80)) {
+                // malformed UTF-8 sequence
+                break;
+            }
+            f->position++;
+            f->partial_utf8[f->partial_utf8_len++] = c;
+
+            char8_t* ptr = f->partial_utf8;
+            unsigned bytes_remaining = f->partial_utf8_len;
+            char32_t chr;
+            if (read_utf8_buffer(&ptr, &bytes_remaining, &chr)) {
+                if (chr != 0xFFFFFFFF) {
+                    if (!uw_string_append(dest, chr)) {
+                        return UwOOM();
+                    }
+                }
+                break;
+            }
+        }
+        f->partial_utf8_len = 0;
+    }
     return UwOK();
 }
 
@@ -324,51 +653,8 @@ static UwResult read_line_inplace(UwValuePtr self, UwValuePtr line)
 
     do {
         if (f->position == f->data_size) {
-
             // reached end of data scanning for line break
-
-            f->position = 0;
-
-            // read next chunk of file
-            {
-                uw_expect_ok( file_read(self, f->buffer, LINE_READER_BUFFER_SIZE, &f->data_size) );
-                if (f->data_size == 0) {
-                    return UwError(UW_ERROR_EOF);
-                }
-            }
-
-            if (f->partial_utf8_len) {
-                // process partial UTF-8 sequence
-                while (f->partial_utf8_len < 4) {
-
-                    if (f->position == f->data_size) {
-                        // premature end of file
-                        // XXX warn?
-                        return UwError(UW_ERROR_EOF);
-                    }
-
-                    char8_t c = f->buffer[f->position];
-                    if (c < 0x80 || ((c & 0xC0) != 0x80)) {
-                        // malformed UTF-8 sequence
-                        break;
-                    }
-                    f->position++;
-                    f->partial_utf8[f->partial_utf8_len++] = c;
-
-                    char8_t* ptr = f->partial_utf8;
-                    unsigned bytes_remaining = f->partial_utf8_len;
-                    char32_t chr;
-                    if (read_utf8_buffer(&ptr, &bytes_remaining, &chr)) {
-                        if (chr != 0xFFFFFFFF) {
-                            if (!uw_string_append(line, chr)) {
-                                return UwOOM();
-                            }
-                        }
-                        break;
-                    }
-                }
-                f->partial_utf8_len = 0;
-            }
+            uw_expect_ok( next_chunk(self, line) );
         }
 
         char8_t* ptr = f->buffer + f->position;
@@ -416,6 +702,77 @@ static UwResult read_line(UwValuePtr self)
     return uw_move(&result);
 }
 
+static bool is_ascii(char8_t* ptr, unsigned size)
+{
+    while (size >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            return false;
+        }
+        ptr += sizeof(uint64_t);
+        size -= sizeof(uint64_t);
+    }
+    while (size--) {
+        if (*ptr++ & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static UwResult read_line_view(UwValuePtr self, UwLineView* view)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    if (f->buffer == nullptr) {
+        uw_expect_ok( start_read_lines(self) );
+    }
+
+    if (uw_is_null(&f->pushback) && f->partial_utf8_len == 0 && (f->position || f->data_size)) {
+
+        if (f->position == f->data_size) {
+            // no partial UTF-8 sequence, so next_chunk does not append anything to dest
+            uw_expect_ok( next_chunk(self, nullptr) );
+        }
+
+        // fast path: ASCII line that lies entirely in the buffer
+
+        char8_t* start = f->buffer + f->position;
+        unsigned bytes_remaining = f->data_size - f->position;
+        char8_t* lf = memchr(start, '\n', bytes_remaining);
+        unsigned length = lf? (unsigned) (lf - start) + 1 : bytes_remaining;
+
+        if ((lf || f->data_size < LINE_READER_BUFFER_SIZE) && is_ascii(start, length)) {
+            view->ptr = start;
+            view->length = length;
+            view->char_size = 1;
+            if (lf) {
+                f->position += length;
+            } else {
+                // last line without line break, set EOF state;
+                // buffer content remains intact until next read
+                f->position = 0;
+                f->data_size = 0;
+            }
+            f->line_number++;
+            return UwOK();
+        }
+    }
+
+    // slow path: decode line into internal string
+
+    if (!uw_is_string(&f->view_line)) {
+        f->view_line = UwString();
+        uw_return_if_error(&f->view_line);
+    }
+    uw_expect_ok( read_line_inplace(self, &f->view_line) );
+
+    view->ptr = _uw_string_start_length(&f->view_line, &view->length);
+    view->char_size = _uw_string_char_size(&f->view_line);
+    return UwOK();
+}
+
 static bool unread_line(UwValuePtr self, UwValuePtr line)
 {
     _UwFile* f = get_data_ptr(self);
@@ -438,9 +795,161 @@ static void stop_read_lines(UwValuePtr self)
 {
     _UwFile* f = get_data_ptr(self);
 
-    release((void**) &f->buffer, LINE_READER_BUFFER_SIZE);
-    f->buffer = nullptr;
+    release_line_reader_buffers(f);
     uw_destroy(&f->pushback);
+    uw_destroy(&f->view_line);
+}
+
+/****************************************************************
+ * ByteReader interface methods
+ *
+ * Byte reader shares the buffer with line reader.
+ */
+
+static UwResult read_bytes(UwValuePtr self, void* buffer, unsigned buffer_size, unsigned* bytes_read)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    *bytes_read = 0;
+
+    if (f->buffer == nullptr) {
+        uw_expect_ok( start_read_lines(self) );
+    }
+    if ( ! (f->position || f->data_size)) {
+        return UwError(UW_ERROR_EOF);
+    }
+
+    char8_t* dest = buffer;
+
+    // incomplete UTF-8 sequence left by line or char reader goes first
+    if (f->partial_utf8_len) {
+        unsigned n = (f->partial_utf8_len < buffer_size)? f->partial_utf8_len : buffer_size;
+        memcpy(dest, f->partial_utf8, n);
+        f->partial_utf8_len -= n;
+        memmove(f->partial_utf8, f->partial_utf8 + n, f->partial_utf8_len);
+        dest += n;
+        buffer_size -= n;
+    }
+
+    while (buffer_size) {
+        if (f->position == f->data_size) {
+            if (buffer_size >= LINE_READER_BUFFER_SIZE && !f->readahead_state) {
+                // read directly to the caller's buffer
+                uint64_t chunk_size = buffer_size - buffer_size % LINE_READER_BUFFER_SIZE;
+                if (f->range_end) {
+                    uint64_t remaining = (f->read_offset < f->range_end)? f->range_end - f->read_offset : 0;
+                    if (remaining < chunk_size) {
+                        chunk_size = remaining;
+                    }
+                }
+                unsigned n = 0;
+                if (chunk_size) {
+                    uw_expect_ok( file_read(self, dest, (unsigned) chunk_size, &n) );
+                }
+                f->read_offset += n;
+                dest += n;
+                buffer_size -= n;
+                if (n == 0) {
+                    // set EOF state
+                    f->position = 0;
+                    f->data_size = 0;
+                    break;
+                }
+                continue;
+            }
+            f->position = 0;
+            uw_expect_ok( read_chunk(self) );
+            if (f->data_size == 0) {
+                // EOF state
+                break;
+            }
+            continue;
+        }
+        unsigned n = f->data_size - f->position;
+        if (n > buffer_size) {
+            n = buffer_size;
+        }
+        memcpy(dest, f->buffer + f->position, n);
+        f->position += n;
+        dest += n;
+        buffer_size -= n;
+    }
+
+    *bytes_read = dest - (char8_t*) buffer;
+    if (*bytes_read == 0) {
+        return UwError(UW_ERROR_EOF);
+    }
+    return UwOK();
+}
+
+/****************************************************************
+ * CharReader interface methods
+ *
+ * Char reader shares the buffer with line reader.
+ */
+
+static unsigned utf8_prefix_size(char8_t* buffer, unsigned size, unsigned max_chars)
+/*
+ * Return the size of leading part of buffer that contains at most `max_chars` characters.
+ */
+{
+    for (unsigned i = 0; i < size; i++) {
+        if ((buffer[i] & 0xC0) != 0x80) {
+            // not a continuation byte
+            if (max_chars == 0) {
+                return i;
+            }
+            max_chars--;
+        }
+    }
+    return size;
+}
+
+static UwResult read_chars(UwValuePtr self, UwValuePtr dest, unsigned max_chars)
+{
+    _UwFile* f = get_data_ptr(self);
+
+    uw_string_truncate(dest, 0);
+
+    if (f->buffer == nullptr) {
+        uw_expect_ok( start_read_lines(self) );
+    }
+    if ( ! (f->position || f->data_size)) {
+        return UwError(UW_ERROR_EOF);
+    }
+
+    unsigned length = 0;
+    while (length < max_chars) {
+        if (f->position == f->data_size) {
+            UwValue status = next_chunk(self, dest);
+            if (uw_eof(&status)) {
+                f->position = 0;
+                f->data_size = 0;
+                break;
+            }
+            uw_return_if_error(&status);
+            length = uw_strlen(dest);
+            continue;
+        }
+        char8_t* ptr = f->buffer + f->position;
+        unsigned size = utf8_prefix_size(ptr, f->data_size - f->position, max_chars - length);
+        unsigned bytes_processed = 0;
+        if (!uw_string_append_utf8(dest, ptr, size, &bytes_processed)) {
+            return UwOOM();
+        }
+        f->position += bytes_processed;
+        if (bytes_processed < size) {
+            // incomplete UTF-8 sequence can be at the end of buffer only
+            while (f->position < f->data_size) {
+                f->partial_utf8[f->partial_utf8_len++] = f->buffer[f->position++];
+            }
+        }
+        length = uw_strlen(dest);
+    }
+    if (length == 0) {
+        return UwError(UW_ERROR_EOF);
+    }
+    return UwOK();
 }
 
 /****************************************************************
@@ -454,11 +963,15 @@ static UwInterface_File file_interface = {
     .close    = file_close,
     .set_fd   = file_set_fd,
     .get_name = file_get_name,
-    .set_name = file_set_name
+    .set_name = file_set_name,
+    .get_fd   = file_get_fd
 };
 
 static UwInterface_FileReader file_reader_interface = {
-    .read = file_read
+    .read           = file_read,
+    .pread          = file_pread,
+    .set_line_range = file_set_line_range,
+    .set_readahead  = file_set_readahead
 };
 
 static UwInterface_FileWriter file_writer_interface = {
@@ -469,16 +982,29 @@ static UwInterface_LineReader line_reader_interface = {
     .start             = start_read_lines,
     .read_line         = read_line,
     .read_line_inplace = read_line_inplace,
+    .read_line_view    = read_line_view,
     .get_line_number   = get_line_number,
     .unread_line       = unread_line,
     .stop              = stop_read_lines
 };
 
+static UwInterface_ByteReader byte_reader_interface = {
+    .start      = start_read_lines,
+    .read_bytes = read_bytes,
+    .stop       = stop_read_lines
+};
+
+static UwInterface_CharReader char_reader_interface = {
+    .start      = start_read_lines,
+    .read_chars = read_chars,
+    .stop       = stop_read_lines
+};
+
 static UwType file_type = {
     .id             = 0,
     .ancestor_id    = UwTypeId_Struct,
     .name           = "File",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_struct_destroy,
@@ -515,7 +1041,9 @@ static void init_file_type()
         UwInterfaceId_File,       &file_interface,
         UwInterfaceId_FileReader, &file_reader_interface,
         UwInterfaceId_FileWriter, &file_writer_interface,
-        UwInterfaceId_LineReader, &line_reader_interface
+        UwInterfaceId_LineReader, &line_reader_interface,
+        UwInterfaceId_ByteReader, &byte_reader_interface,
+        UwInterfaceId_CharReader, &char_reader_interface
     );
 }
 
@@ -0,0 +1,98 @@
+#include "include/uw.h"
+#include "include/uw_freeze.h"
+#include "src/uw_map_internal.h"
+
+/*
+ * Reference counts are saved before freezing to roll back on error.
+ * Frozen reference count also marks data as visited,
+ * this takes care of circular references.
+ */
+
+typedef struct {
+    unsigned* refcount;
+    unsigned  saved_refcount;
+} FrozenRefcount;
+
+typedef struct {
+    FrozenRefcount* items;
+    unsigned length;
+    unsigned capacity;
+} FreezeLog;
+
+#define FREEZE_LOG_INCREMENT  256
+
+static bool mark_frozen(FreezeLog* log, unsigned* refcount)
+{
+    if (log->length == log->capacity) {
+        unsigned old_size = log->capacity * sizeof(FrozenRefcount);
+        unsigned new_size = old_size + FREEZE_LOG_INCREMENT * sizeof(FrozenRefcount);
+        if (!default_allocator.reallocate((void**) &log->items, old_size, new_size, false, nullptr)) {
+            return false;
+        }
+        log->capacity += FREEZE_LOG_INCREMENT;
+    }
+    log->items[log->length].refcount = refcount;
+    log->items[log->length].saved_refcount = *refcount;
+    log->length++;
+    *refcount = UW_REFCOUNT_IMMORTAL;
+    return true;
+}
+
+static UwResult freeze_items(FreezeLog* log, UwValuePtr items, unsigned n);
+
+static UwResult freeze(FreezeLog* log, UwValuePtr value)
+{
+    if (uw_is_string(value)) {
+        if (value->str_embedded || value->string_data->refcount == UW_REFCOUNT_IMMORTAL) {
+            return UwOK();
+        }
+        if (!mark_frozen(log, &value->string_data->refcount)) {
+            return UwOOM();
+        }
+        return UwOK();
+    }
+    if (!uw_is_struct(value)) {
+        // integral types have no allocated data
+        return UwOK();
+    }
+    if (!(uw_is_array(value) || uw_is_map(value))) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    if (_uw_is_immortal(value)) {
+        return UwOK();
+    }
+    if (!mark_frozen(log, &value->struct_data->refcount)) {
+        return UwOOM();
+    }
+    if (uw_is_map(value)) {
+        _UwMap* map = _uw_get_data_ptr(value, UwTypeId_Map);
+        return freeze_items(log, map->kv_pairs.items, map->kv_pairs.length);
+    } else {
+        _UwArray* array_data = get_array_data_ptr(value);
+        return freeze_items(log, array_data->items, array_data->length);
+    }
+}
+
+static UwResult freeze_items(FreezeLog* log, UwValuePtr items, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        uw_expect_ok( freeze(log, &items[i]) );
+    }
+    return UwOK();
+}
+
+UwResult uw_freeze(UwValuePtr value)
+{
+    FreezeLog log = {};
+    UwValue status = freeze(&log, value);
+    if (uw_error(&status)) {
+        // roll back
+        for (unsigned i = log.length; i--;) {
+            *log.items[i].refcount = log.items[i].saved_refcount;
+        }
+    }
+    if (log.items) {
+        default_allocator.release((void**) &log.items, log.capacity * sizeof(FrozenRefcount));
+    }
+    return uw_move(&status);
+}
@@ -0,0 +1,205 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/uw_from_json.h"
+
+#include "src/uw_json_internal.h"
+#include "src/uw_string_internal.h"
+
+// forward declaration
+static UwResult parse_value(_UwJsonScanner* scanner, size_t position, unsigned depth);
+
+static inline UwResult next_token(_UwJsonScanner* scanner, size_t* position)
+{
+    if (!_uw_json_next(scanner, position)) {
+        return _uw_json_error(&scanner->input, scanner->input.size, "unexpected end of data");
+    }
+    return UwOK();
+}
+
+static UwResult parse_array(_UwJsonScanner* scanner, unsigned depth)
+{
+    UwValue result = uw_create(UwTypeId_Array);
+    uw_return_if_error(&result);
+
+    size_t position;
+    uw_expect_ok( next_token(scanner, &position) );
+    if (scanner->input.data[position] == ']') {
+        return uw_move(&result);
+    }
+    for (;;) {{
+        UwValue item = parse_value(scanner, position, depth + 1);
+        uw_return_if_error(&item);
+        uw_expect_ok( uw_array_append_va(&result, uw_move(&item)) );
+
+        uw_expect_ok( next_token(scanner, &position) );
+        char8_t c = scanner->input.data[position];
+        if (c == ']') {
+            return uw_move(&result);
+        }
+        if (c != ',') {
+            return _uw_json_error(&scanner->input, position, "expected , or ]");
+        }
+        uw_expect_ok( next_token(scanner, &position) );
+    }}
+}
+
+static UwResult parse_object(_UwJsonScanner* scanner, unsigned depth)
+{
+    UwValue result = uw_create(UwTypeId_Map);
+    uw_return_if_error(&result);
+
+    size_t position;
+    uw_expect_ok( next_token(scanner, &position) );
+    if (scanner->input.data[position] == '}') {
+        return uw_move(&result);
+    }
+    for (;;) {{
+        if (scanner->input.data[position] != '"') {
+            return _uw_json_error(&scanner->input, position, "expected string key");
+        }
+        UwValue key = _uw_json_parse_string(&scanner->input, &position);
+        uw_return_if_error(&key);
+
+        uw_expect_ok( next_token(scanner, &position) );
+        if (scanner->input.data[position] != ':') {
+            return _uw_json_error(&scanner->input, position, "expected :");
+        }
+        uw_expect_ok( next_token(scanner, &position) );
+
+        UwValue value = parse_value(scanner, position, depth + 1);
+        uw_return_if_error(&value);
+        uw_expect_ok( uw_map_update_va(&result, uw_move(&key), uw_move(&value)) );
+
+        uw_expect_ok( next_token(scanner, &position) );
+        char8_t c = scanner->input.data[position];
+        if (c == '}') {
+            return uw_move(&result);
+        }
+        if (c != ',') {
+            return _uw_json_error(&scanner->input, position, "expected , or }");
+        }
+        uw_expect_ok( next_token(scanner, &position) );
+    }}
+}
+
+static UwResult parse_value(_UwJsonScanner* scanner, size_t position, unsigned depth)
+{
+    char8_t c = scanner->input.data[position];
+    switch (c) {
+        case '{':
+        case '[':
+            if (depth > UW_JSON_MAX_DEPTH) {
+                return _uw_json_error(&scanner->input, position, "nesting is too deep");
+            }
+            return (c == '{')? parse_object(scanner, depth) : parse_array(scanner, depth);
+        case '"':
+            return _uw_json_parse_string(&scanner->input, &position);
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return _uw_json_parse_number(&scanner->input, position);
+        default:
+            return _uw_json_parse_literal(&scanner->input, position);
+    }
+}
+
+UwResult uw_from_json_buffer(char8_t* data, size_t size)
+{
+    return _uw_json_parse_buffer(data, size, 1);
+}
+
+UwResult _uw_json_parse_buffer(char8_t* data, size_t size, unsigned line)
+{
+    _UwJsonScanner scanner;
+    _uw_json_scanner_init(&scanner, data, size);
+    scanner.input.line = line;
+
+    size_t position;
+    if (!_uw_json_next(&scanner, &position)) {
+        return _uw_json_error(&scanner.input, scanner.input.size, "no data");
+    }
+    UwValue result = parse_value(&scanner, position, 1);
+    uw_return_if_error(&result);
+
+    if (_uw_json_next(&scanner, &position)) {
+        return _uw_json_error(&scanner.input, position, "extra data after JSON value");
+    }
+    return uw_move(&result);
+}
+
+static UwResult from_json_file(UwValuePtr file)
+{
+    int fd = uw_file_get_fd(file);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return UwErrno(errno);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return UwError(UW_ERROR_NOT_REGULAR_FILE);
+    }
+    if (st.st_size == 0) {
+        return uw_from_json_buffer(nullptr, 0);
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return UwErrno(errno);
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    UwValue result = uw_from_json_buffer(data, st.st_size);
+    munmap(data, st.st_size);
+    return uw_move(&result);
+}
+
+static UwResult from_json_string(UwValuePtr str)
+{
+    unsigned length;
+    uint8_t* ptr = _uw_string_start_length(str, &length);
+
+    if (_uw_string_char_size(str) == 1) {
+        // ASCII strings are valid UTF-8, parse them in place
+        bool ascii = true;
+        for (unsigned i = 0; i < length; i++) {
+            if (ptr[i] >= 0x80) {
+                ascii = false;
+                break;
+            }
+        }
+        if (ascii) {
+            return uw_from_json_buffer(ptr, length);
+        }
+    }
+
+    unsigned size = uw_strlen_in_utf8(str);
+    char8_t* data = allocate(size, false);
+    if (!data) {
+        return UwOOM();
+    }
+    unsigned data_size = _uw_string_to_utf8(str, data);
+    UwValue result = uw_from_json_buffer(data, data_size);
+    release((void**) &data, size);
+    return uw_move(&result);
+}
+
+UwResult _uw_from_json(UwValuePtr input)
+{
+    if (uw_is_string(input)) {
+        return from_json_string(input);
+    }
+    if (uw_is_charptr(input)) {
+        if (input->charptr_subtype == UW_CHARPTR) {
+            return uw_from_json_buffer(input->charptr, strlen((char*) input->charptr));
+        }
+        UwValue str = uw_clone(input);  // this converts CharPtr to string
+        uw_return_if_error(&str);
+        return from_json_string(&str);
+    }
+    if (uw_is_file(input)) {
+        return from_json_file(input);
+    }
+    return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+}
@@ -26,6 +26,9 @@ void _uw_panic_no_interface(UwTypeId type_id, unsigned interface_id)
 #define MAX_INTERFACES  (UINT_MAX - 1)  // UINT_MAX equals to -1 which is used as terminator
                                         // in uw_add_type and uw_subtype, that's why UINT_MAX - 1
 
+// interfaces with greater ids are placed in hash table
+#define MAX_DIRECT_INTERFACE_ID  63
+
 [[ gnu::constructor ]]
 void _uw_init_interfaces()
 {
@@ -43,6 +46,8 @@ void _uw_init_interfaces()
     // register built-ion interfaces
 
     uw_assert(UwInterfaceId_LineReader == uw_register_interface("LineReader", UwInterface_LineReader));
+    uw_assert(UwInterfaceId_ByteReader == uw_register_interface("ByteReader", UwInterface_ByteReader));
+    uw_assert(UwInterfaceId_CharReader == uw_register_interface("CharReader", UwInterface_CharReader));
 }
 
 unsigned _uw_register_interface(char* name, unsigned num_methods)
@@ -137,6 +142,72 @@ static void** make_interface_methods(unsigned interface_id, void** methods)
     return interface_methods;
 }
 
+static _UwInterface* find_interface(UwType* type, unsigned interface_id)
+/*
+ * Linear lookup for types which dispatch tables are not built yet.
+ */
+{
+    for (unsigned i = 0; i < type->num_interfaces; i++) {
+        if (type->interfaces[i].interface_id == interface_id) {
+            return &type->interfaces[i];
+        }
+    }
+    return nullptr;
+}
+
+static void build_dispatch_tables(UwType* type)
+/*
+ * Build dispatch tables from type->interfaces.
+ */
+{
+    type->interface_table_size = 0;
+    type->interface_table = nullptr;
+    type->interface_hash_mask = 0;
+    type->interface_hash = nullptr;
+
+    unsigned num_hashed = 0;
+    for (unsigned i = 0; i < type->num_interfaces; i++) {
+        unsigned interface_id = type->interfaces[i].interface_id;
+        if (interface_id > MAX_DIRECT_INTERFACE_ID) {
+            num_hashed++;
+        } else if (interface_id >= type->interface_table_size) {
+            type->interface_table_size = interface_id + 1;
+        }
+    }
+    if (type->interface_table_size) {
+        type->interface_table = arena_alloc(arena, type->interface_table_size, void**);
+        if (!type->interface_table) {
+            uw_panic("%s: cannot allocate dispatch table for type %s\n", __func__, type->name);
+        }
+        bzero(type->interface_table, type->interface_table_size * sizeof(void**));
+    }
+    if (num_hashed) {
+        // keep at least half of slots empty to terminate probing
+        unsigned capacity = 4;
+        while (capacity < num_hashed * 2) {
+            capacity *= 2;
+        }
+        type->interface_hash = arena_alloc(arena, capacity, _UwInterface);
+        if (!type->interface_hash) {
+            uw_panic("%s: cannot allocate interface hash table for type %s\n", __func__, type->name);
+        }
+        bzero(type->interface_hash, capacity * sizeof(_UwInterface));
+        type->interface_hash_mask = capacity - 1;
+    }
+    for (unsigned i = 0; i < type->num_interfaces; i++) {
+        _UwInterface* iface = &type->interfaces[i];
+        if (iface->interface_id < type->interface_table_size) {
+            type->interface_table[iface->interface_id] = iface->interface_methods;
+        } else {
+            unsigned j = iface->interface_id & type->interface_hash_mask;
+            while (type->interface_hash[j].interface_methods) {
+                j = (j + 1) & type->interface_hash_mask;
+            }
+            type->interface_hash[j] = *iface;
+        }
+    }
+}
+
 void _uw_create_interfaces(UwType* type, va_list ap)
 {
     // count interface argument pairs
@@ -155,6 +226,7 @@ void _uw_create_interfaces(UwType* type, va_list ap)
 
     if (type->num_interfaces == 0) {
         type->interfaces = nullptr;
+        build_dispatch_tables(type);
         return;
     }
 
@@ -165,6 +237,7 @@ void _uw_create_interfaces(UwType* type, va_list ap)
         iface->interface_id = va_arg(ap, unsigned);
         iface->interface_methods = make_interface_methods(iface->interface_id, va_arg(ap, void**));
     }
+    build_dispatch_tables(type);
 }
 
 void _uw_update_interfaces(UwType* type, UwType* ancestor, va_list ap)
@@ -187,6 +260,7 @@ void _uw_update_interfaces(UwType* type, UwType* ancestor, va_list ap)
 
     if (type->num_interfaces == 0) {
         type->interfaces = nullptr;
+        build_dispatch_tables(type);
         return;
     }
 
@@ -201,14 +275,14 @@ void _uw_update_interfaces(UwType* type, UwType* ancestor, va_list ap)
         if (((int) interface_id) == -1) {
             break;
         }
-        _UwInterface* src_iface = _uw_lookup_interface(ancestor->id, interface_id);
-        if (src_iface) {
+        void** src_methods = _uw_lookup_interface(ancestor->id, interface_id);
+        if (src_methods) {
             // update existing interface
-            _UwInterface* dest_iface = _uw_lookup_interface(type->id, interface_id);
+            _UwInterface* dest_iface = find_interface(type, interface_id);
             void** new_methods = va_arg(ap, void**);
             unsigned num_methods = _uw_get_num_interface_methods(interface_id);
             void** interface_methods = alloc_methods(num_methods);
-            memcpy(interface_methods, src_iface->interface_methods, methods_memsize(num_methods));
+            memcpy(interface_methods, src_methods, methods_memsize(num_methods));
 
             for (unsigned i = 0; i < num_methods; i++) {
                 void* meth = new_methods[i];
@@ -224,4 +298,5 @@ void _uw_update_interfaces(UwType* type, UwType* ancestor, va_list ap)
             new_iface++;
         }
     }
+    build_dispatch_tables(type);
 }
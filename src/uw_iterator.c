@@ -66,7 +66,7 @@ UwType _uw_iterator_type = {
     .id             = UwTypeId_Iterator,
     .ancestor_id    = UwTypeId_Struct,
     .name           = "Iterator",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_struct_destroy,
@@ -0,0 +1,560 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/uw_json_doc.h"
+
+#include "src/uw_json_internal.h"
+#include "src/uw_string_internal.h"
+#include "src/uw_struct_internal.h"
+
+/*
+ * Tape entry has type in the upper 8 bits and payload in the lower 56 bits:
+ *
+ *   '{', '[':       index of the entry past the matching end, i.e. of the next sibling
+ *   '}', ']':       index of the matching start
+ *   '"':            position of the opening quote
+ *   '0':            position of the number
+ *   't', 'f', 'n':  literals, no payload
+ *
+ * Object members are key entries followed by value entries.
+ */
+
+#define TAPE_ENTRY(type, payload)  (((uint64_t) (type) << 56) | (payload))
+#define TAPE_TYPE(entry)           ((char8_t) ((entry) >> 56))
+#define TAPE_PAYLOAD(entry)        ((entry) & ((1ULL << 56) - 1))
+
+#define TAPE_INITIAL_CAPACITY  64
+
+typedef struct {
+    _UwJsonInput input;      // UTF-8 data without BOM
+
+    char8_t*  buffer;        // allocated or mapped data, including BOM
+    size_t    buffer_size;
+    bool      mapped;
+
+    uint64_t* tape;
+    unsigned  tape_length;
+    unsigned  tape_capacity;
+} _UwJsonDocument;
+
+#define get_data_ptr(value)  ((_UwJsonDocument*) _uw_get_data_ptr((value), UwTypeId_JsonDocument))
+
+/****************************************************************
+ * Tape builder
+ */
+
+// forward declaration
+static UwResult build_value(_UwJsonScanner* scanner, _UwJsonDocument* doc, size_t position, unsigned depth);
+
+static bool grow_tape(_UwJsonDocument* doc)
+{
+    if (doc->tape_capacity > UINT_MAX / 2 / sizeof(uint64_t)) {
+        return false;
+    }
+    unsigned new_capacity = doc->tape_capacity * 2;
+    if (!reallocate((void**) &doc->tape, doc->tape_capacity * sizeof(uint64_t),
+                    new_capacity * sizeof(uint64_t), false, nullptr)) {
+        return false;
+    }
+    doc->tape_capacity = new_capacity;
+    return true;
+}
+
+static inline UwResult append_entry(_UwJsonDocument* doc, uint64_t entry)
+{
+    if (doc->tape_length == doc->tape_capacity) {
+        if (!grow_tape(doc)) {
+            return UwOOM();
+        }
+    }
+    doc->tape[doc->tape_length++] = entry;
+    return UwOK();
+}
+
+static inline UwResult next_token(_UwJsonScanner* scanner, size_t* position)
+{
+    if (!_uw_json_next(scanner, position)) {
+        return _uw_json_error(&scanner->input, scanner->input.size, "unexpected end of data");
+    }
+    return UwOK();
+}
+
+static UwResult build_array(_UwJsonScanner* scanner, _UwJsonDocument* doc, unsigned depth)
+{
+    unsigned start = doc->tape_length;
+    uw_expect_ok( append_entry(doc, TAPE_ENTRY('[', 0)) );
+
+    size_t position;
+    uw_expect_ok( next_token(scanner, &position) );
+    if (scanner->input.data[position] != ']') {
+        for (;;) {
+            uw_expect_ok( build_value(scanner, doc, position, depth + 1) );
+
+            uw_expect_ok( next_token(scanner, &position) );
+            char8_t c = scanner->input.data[position];
+            if (c == ']') {
+                break;
+            }
+            if (c != ',') {
+                return _uw_json_error(&scanner->input, position, "expected , or ]");
+            }
+            uw_expect_ok( next_token(scanner, &position) );
+        }
+    }
+    doc->tape[start] = TAPE_ENTRY('[', doc->tape_length + 1);
+    return append_entry(doc, TAPE_ENTRY(']', start));
+}
+
+static UwResult build_object(_UwJsonScanner* scanner, _UwJsonDocument* doc, unsigned depth)
+{
+    unsigned start = doc->tape_length;
+    uw_expect_ok( append_entry(doc, TAPE_ENTRY('{', 0)) );
+
+    size_t position;
+    uw_expect_ok( next_token(scanner, &position) );
+    if (scanner->input.data[position] != '}') {
+        for (;;) {
+            if (scanner->input.data[position] != '"') {
+                return _uw_json_error(&scanner->input, position, "expected string key");
+            }
+            uw_expect_ok( append_entry(doc, TAPE_ENTRY('"', position)) );
+
+            uw_expect_ok( next_token(scanner, &position) );
+            if (scanner->input.data[position] != ':') {
+                return _uw_json_error(&scanner->input, position, "expected :");
+            }
+            uw_expect_ok( next_token(scanner, &position) );
+            uw_expect_ok( build_value(scanner, doc, position, depth + 1) );
+
+            uw_expect_ok( next_token(scanner, &position) );
+            char8_t c = scanner->input.data[position];
+            if (c == '}') {
+                break;
+            }
+            if (c != ',') {
+                return _uw_json_error(&scanner->input, position, "expected , or }");
+            }
+            uw_expect_ok( next_token(scanner, &position) );
+        }
+    }
+    doc->tape[start] = TAPE_ENTRY('{', doc->tape_length + 1);
+    return append_entry(doc, TAPE_ENTRY('}', start));
+}
+
+static UwResult build_value(_UwJsonScanner* scanner, _UwJsonDocument* doc, size_t position, unsigned depth)
+{
+    char8_t c = scanner->input.data[position];
+    switch (c) {
+        case '{':
+        case '[':
+            if (depth > UW_JSON_MAX_DEPTH) {
+                return _uw_json_error(&scanner->input, position, "nesting is too deep");
+            }
+            return (c == '{')? build_object(scanner, doc, depth) : build_array(scanner, doc, depth);
+        case '"':
+            return append_entry(doc, TAPE_ENTRY('"', position));
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return append_entry(doc, TAPE_ENTRY('0', position));
+        default: {
+            UwValue literal = _uw_json_parse_literal(&scanner->input, position);
+            uw_return_if_error(&literal);
+            if (uw_is_null(&literal)) {
+                return append_entry(doc, TAPE_ENTRY('n', 0));
+            }
+            return append_entry(doc, TAPE_ENTRY(literal.bool_value? 't' : 'f', 0));
+        }
+    }
+}
+
+static UwResult build_tape(_UwJsonDocument* doc, size_t size)
+{
+    _UwJsonScanner scanner;
+    _uw_json_scanner_init(&scanner, doc->buffer, size);
+    doc->input = scanner.input;
+
+    // start with a rough estimate, unused capacity is released at the end
+    size_t capacity = size / 16;
+    if (capacity < TAPE_INITIAL_CAPACITY) {
+        capacity = TAPE_INITIAL_CAPACITY;
+    }
+    if (capacity > UINT_MAX / sizeof(uint64_t)) {
+        return UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+    }
+    doc->tape_capacity = (unsigned) capacity;
+    doc->tape = allocate(doc->tape_capacity * sizeof(uint64_t), false);
+    if (!doc->tape) {
+        return UwOOM();
+    }
+
+    size_t position;
+    if (!_uw_json_next(&scanner, &position)) {
+        return _uw_json_error(&scanner.input, scanner.input.size, "no data");
+    }
+    uw_expect_ok( build_value(&scanner, doc, position, 1) );
+
+    if (_uw_json_next(&scanner, &position)) {
+        return _uw_json_error(&scanner.input, position, "extra data after JSON value");
+    }
+
+    // release unused capacity
+    if (reallocate((void**) &doc->tape, doc->tape_capacity * sizeof(uint64_t),
+                   doc->tape_length * sizeof(uint64_t), false, nullptr)) {
+        doc->tape_capacity = doc->tape_length;
+    }
+    return UwOK();
+}
+
+/****************************************************************
+ * Input
+ */
+
+/*
+ * Load functions set buffer and write the size of JSON data to `size`.
+ */
+
+static UwResult load_file(_UwJsonDocument* doc, UwValuePtr file, size_t* size)
+{
+    int fd = uw_file_get_fd(file);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return UwErrno(errno);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return UwError(UW_ERROR_NOT_REGULAR_FILE);
+    }
+    if (st.st_size == 0) {
+        return UwOK();
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return UwErrno(errno);
+    }
+    doc->buffer = data;
+    doc->buffer_size = st.st_size;
+    doc->mapped = true;
+    *size = st.st_size;
+    return UwOK();
+}
+
+static UwResult load_utf8(_UwJsonDocument* doc, char8_t* data, size_t* size)
+{
+    *size = strlen((char*) data);
+    if (*size == 0) {
+        return UwOK();
+    }
+    doc->buffer = allocate(*size, false);
+    if (!doc->buffer) {
+        return UwOOM();
+    }
+    memcpy(doc->buffer, data, *size);
+    doc->buffer_size = *size;
+    return UwOK();
+}
+
+static UwResult load_string(_UwJsonDocument* doc, UwValuePtr str, size_t* size)
+{
+    size_t buffer_size = uw_strlen_in_utf8(str);
+    if (buffer_size == 0) {
+        *size = 0;
+        return UwOK();
+    }
+    doc->buffer = allocate(buffer_size, false);
+    if (!doc->buffer) {
+        return UwOOM();
+    }
+    doc->buffer_size = buffer_size;
+    *size = _uw_string_to_utf8(str, doc->buffer);
+    return UwOK();
+}
+
+static UwResult load_input(_UwJsonDocument* doc, UwValuePtr input, size_t* size)
+{
+    if (uw_is_string(input)) {
+        return load_string(doc, input, size);
+    }
+    if (uw_is_charptr(input)) {
+        if (input->charptr_subtype == UW_CHARPTR) {
+            return load_utf8(doc, input->charptr, size);
+        }
+        UwValue str = uw_clone(input);  // this converts CharPtr to string
+        uw_return_if_error(&str);
+        return load_string(doc, &str, size);
+    }
+    if (uw_is_file(input)) {
+        return load_file(doc, input, size);
+    }
+    return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+}
+
+/****************************************************************
+ * Tape walking
+ */
+
+static inline unsigned next_sibling(_UwJsonDocument* doc, unsigned index)
+{
+    uint64_t entry = doc->tape[index];
+    char8_t type = TAPE_TYPE(entry);
+    if (type == '{' || type == '[') {
+        return (unsigned) TAPE_PAYLOAD(entry);
+    }
+    return index + 1;
+}
+
+static UwResult materialize(_UwJsonDocument* doc, unsigned index)
+{
+    uint64_t entry = doc->tape[index];
+    switch (TAPE_TYPE(entry)) {
+        case '{': {
+            UwValue result = uw_create(UwTypeId_Map);
+            uw_return_if_error(&result);
+            unsigned end = (unsigned) TAPE_PAYLOAD(entry) - 1;
+            for (unsigned i = index + 1; i < end; i = next_sibling(doc, i + 1)) {{
+                UwValue key = materialize(doc, i);
+                uw_return_if_error(&key);
+                UwValue value = materialize(doc, i + 1);
+                uw_return_if_error(&value);
+                uw_expect_ok( uw_map_update_va(&result, uw_move(&key), uw_move(&value)) );
+            }}
+            return uw_move(&result);
+        }
+        case '[': {
+            UwValue result = uw_create(UwTypeId_Array);
+            uw_return_if_error(&result);
+            unsigned end = (unsigned) TAPE_PAYLOAD(entry) - 1;
+            for (unsigned i = index + 1; i < end; i = next_sibling(doc, i)) {{
+                UwValue item = materialize(doc, i);
+                uw_return_if_error(&item);
+                uw_expect_ok( uw_array_append_va(&result, uw_move(&item)) );
+            }}
+            return uw_move(&result);
+        }
+        case '"': {
+            size_t position = TAPE_PAYLOAD(entry);
+            return _uw_json_parse_string(&doc->input, &position);
+        }
+        case '0':
+            return _uw_json_parse_number(&doc->input, TAPE_PAYLOAD(entry));
+        case 't':
+            return UwBool(true);
+        case 'f':
+            return UwBool(false);
+        default:
+            return UwNull();
+    }
+}
+
+static bool is_plain_key(char8_t* key, size_t key_size)
+/*
+ * Check if key can be compared with raw JSON strings,
+ * i.e. it contains nothing that JSON requires to escape.
+ */
+{
+    for (size_t i = 0; i < key_size; i++) {
+        char8_t c = key[i];
+        if (c < 0x20 || c == '"' || c == '\\') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static UwResult key_equal(_UwJsonDocument* doc, unsigned index, char8_t* key, size_t key_size, bool plain)
+/*
+ * Compare key entry with UTF-8 key.
+ * Return Bool or error if key string is malformed.
+ */
+{
+    size_t position = TAPE_PAYLOAD(doc->tape[index]);
+    char8_t* s = doc->input.data + position + 1;
+
+    if (plain) {
+        // the string is terminated, and the key contains no quotes,
+        // so comparison stops at the closing quote at most
+        size_t i = 0;
+        while (i < key_size && s[i] == key[i]) {
+            i++;
+        }
+        if (i == key_size) {
+            return UwBool(s[i] == '"');
+        }
+        if (s[i] != '\\') {
+            // mismatch is not caused by escape sequence
+            return UwBool(false);
+        }
+    }
+    UwValue decoded = _uw_json_parse_string(&doc->input, &position);
+    uw_return_if_error(&decoded);
+    return UwBool(uw_equal(&decoded, key));
+}
+
+static UwResult find_key(_UwJsonDocument* doc, unsigned* index, char8_t* key)
+/*
+ * Find the value for null-terminated UTF-8 `key` in the object at `*index`
+ * and update `*index`.
+ */
+{
+    uint64_t entry = doc->tape[*index];
+    if (TAPE_TYPE(entry) != '{') {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    size_t key_size = strlen((char*) key);
+    bool plain = is_plain_key(key, key_size);
+
+    unsigned found = 0;
+    unsigned end = (unsigned) TAPE_PAYLOAD(entry) - 1;
+    for (unsigned i = *index + 1; i < end; i = next_sibling(doc, i + 1)) {{
+        UwValue match = key_equal(doc, i, key, key_size, plain);
+        uw_return_if_error(&match);
+        if (match.bool_value) {
+            // don't stop, the last duplicate wins
+            found = i + 1;
+        }
+    }}
+    if (found == 0) {
+        return UwError(UW_ERROR_KEY_NOT_FOUND);
+    }
+    *index = found;
+    return UwOK();
+}
+
+static UwResult find_item(_UwJsonDocument* doc, unsigned* index, uint64_t item_index)
+{
+    uint64_t entry = doc->tape[*index];
+    if (TAPE_TYPE(entry) != '[') {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    unsigned end = (unsigned) TAPE_PAYLOAD(entry) - 1;
+    unsigned i = *index + 1;
+    for (; i < end && item_index; item_index--) {
+        i = next_sibling(doc, i);
+    }
+    if (i == end) {
+        return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+    }
+    *index = i;
+    return UwOK();
+}
+
+static UwResult follow_path(_UwJsonDocument* doc, unsigned* index, UwValuePtr path_item)
+{
+    if (uw_is_signed(path_item)) {
+        if (path_item->signed_value < 0) {
+            return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+        }
+        return find_item(doc, index, (uint64_t) path_item->signed_value);
+    }
+    if (uw_is_unsigned(path_item)) {
+        return find_item(doc, index, path_item->unsigned_value);
+    }
+    if (uw_is_charptr(path_item) && path_item->charptr_subtype == UW_CHARPTR) {
+        return find_key(doc, index, path_item->charptr);
+    }
+    if (uw_is_string(path_item) || uw_is_charptr(path_item)) {
+        UwValue str = uw_clone(path_item);  // this converts CharPtr to string
+        uw_return_if_error(&str);
+        UW_CSTRING_LOCAL(key, &str);
+        return find_key(doc, index, (char8_t*) key);
+    }
+    return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+}
+
+/****************************************************************
+ * Basic interface methods
+ */
+
+static void json_document_fini(UwValuePtr self)
+{
+    _UwJsonDocument* doc = get_data_ptr(self);
+
+    if (doc->tape) {
+        release((void**) &doc->tape, doc->tape_capacity * sizeof(uint64_t));
+    }
+    if (doc->buffer) {
+        if (doc->mapped) {
+            munmap(doc->buffer, doc->buffer_size);
+            doc->buffer = nullptr;
+        } else {
+            release((void**) &doc->buffer, doc->buffer_size);
+        }
+    }
+}
+
+static UwResult json_document_init(UwValuePtr self, void* ctor_args)
+{
+    UwJsonDocumentCtorArgs* args = ctor_args;
+    _UwJsonDocument* doc = get_data_ptr(self);
+
+    if (!args || !args->input) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    size_t size = 0;
+    uw_expect_ok( load_input(doc, args->input, &size) );
+    return build_tape(doc, size);
+}
+
+/****************************************************************
+ * JsonDocument type
+ */
+
+static UwType json_document_type;
+
+UwTypeId UwTypeId_JsonDocument = 0;
+
+[[ gnu::constructor ]]
+static void init_json_document_type()
+{
+    if (UwTypeId_JsonDocument == 0) {
+        UwTypeId_JsonDocument = uw_subtype(
+            &json_document_type, "JsonDocument", UwTypeId_Struct, _UwJsonDocument
+        );
+        json_document_type.init = json_document_init;
+        json_document_type.fini = json_document_fini;
+    }
+}
+
+/****************************************************************
+ * JsonDocument functions
+ */
+
+UwResult _uw_json_document(UwValuePtr input)
+{
+    UwJsonDocumentCtorArgs args = { .input = input };
+    return uw_create2(UwTypeId_JsonDocument, &args);
+}
+
+UwResult _uw_json_get(UwValuePtr doc, ...)
+{
+    va_list ap;
+    va_start(ap);
+    UwValue result = uw_json_get_ap(doc, ap);
+    va_end(ap);
+    return uw_move(&result);
+}
+
+UwResult uw_json_get_ap(UwValuePtr doc, va_list ap)
+{
+    _UwJsonDocument* d = get_data_ptr(doc);
+    unsigned index = 0;
+    for (;;) {{
+        UwValue arg = va_arg(ap, _UwValue);
+        if (uw_va_end(&arg)) {
+            return materialize(d, index);
+        }
+        UwValue status = uw_is_status(&arg)? uw_move(&arg) : follow_path(d, &index, &arg);
+        if (uw_error(&status)) {
+            _uw_destroy_args(ap);
+            return uw_move(&status);
+        }
+    }}
+}
+
+unsigned uw_json_tape_length(UwValuePtr doc)
+{
+    return get_data_ptr(doc)->tape_length;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+/*
+ * JSON parsing internals.
+ *
+ * Parsing is done in two interleaved stages.
+ *
+ * Stage 1 is a structural scanner. It classifies 64-byte blocks of input
+ * at once (with SSE2 when available) and produces positions of structural
+ * characters {}[]:, opening quotes of strings, and starts of scalars
+ * (numbers and literals). Strings are skipped entirely, taking escaped
+ * quotes into account.
+ *
+ * Stage 2 walks these positions and decodes tokens.
+ * Positions are produced in batches, so memory use does not depend
+ * on the size of input.
+ */
+
+#include "include/uw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UW_JSON_BLOCK_SIZE      64
+#define UW_JSON_INDEX_CAPACITY  1024  // must be a multiple of UW_JSON_BLOCK_SIZE
+#define UW_JSON_MAX_DEPTH       1024
+
+static inline bool _uw_json_is_whitespace(char8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool _uw_json_is_operator(char8_t c)
+{
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+char8_t* _uw_json_skip_plain_ascii(char8_t* ptr, char8_t* end);
+/*
+ * Skip ASCII characters that need no special handling in strings.
+ * Return pointer to the first quote, backslash, control,
+ * or non-ASCII character.
+ */
+
+typedef struct {
+    /*
+     * Input data for token decoders.
+     */
+    char8_t* data;
+    size_t   size;
+    unsigned line;    // location of data[0], for error reporting
+    unsigned column;
+} _UwJsonInput;
+
+static inline void _uw_json_advance_location(char8_t* data, size_t size, unsigned* line, unsigned* column)
+/*
+ * Update line and column, both 1-based, as if `size` bytes of `data` were consumed.
+ * Column is counted in characters.
+ */
+{
+    for (size_t i = 0; i < size; i++) {
+        char8_t c = data[i];
+        if (c == '\n') {
+            (*line)++;
+            *column = 1;
+        } else if ((c & 0xC0) != 0x80) {
+            (*column)++;
+        }
+    }
+}
+
+typedef struct {
+    _UwJsonInput input;
+
+    // stage 1 state
+    size_t   block_pos;       // position of the next block to scan
+    uint64_t prev_in_string;  // all ones if previous block ended inside string
+    uint64_t prev_escaped;    // 1 if the first character of the next block is escaped
+    uint64_t prev_scalar;     // 1 if previous block ended with a scalar character
+
+    // batch of structural positions
+    unsigned num_indices;
+    unsigned next_index;
+    size_t   index[UW_JSON_INDEX_CAPACITY];
+} _UwJsonScanner;
+
+void _uw_json_scanner_init(_UwJsonScanner* scanner, char8_t* data, size_t size);
+/*
+ * Initialize scanner, skip UTF-8 BOM.
+ */
+
+void _uw_json_scan(_UwJsonScanner* scanner);
+/*
+ * Scan next blocks of input and fill the batch of structural positions.
+ */
+
+static inline bool _uw_json_next(_UwJsonScanner* scanner, size_t* position)
+/*
+ * Get position of the next structural character.
+ * Return false if no more.
+ */
+{
+    if (scanner->next_index == scanner->num_indices) {
+        _uw_json_scan(scanner);
+        if (scanner->num_indices == 0) {
+            return false;
+        }
+    }
+    *position = scanner->index[scanner->next_index++];
+    return true;
+}
+
+UwResult _uw_json_parse_buffer(char8_t* data, size_t size, unsigned line);
+/*
+ * Same as uw_from_json_buffer, but `line` is the number of the first line
+ * of data, for error reporting.
+ */
+
+UwResult _uw_json_error(_UwJsonInput* input, size_t position, char* message);
+/*
+ * Make UW_ERROR_JSON_SYNTAX status with line and column of `position`
+ * in the description.
+ */
+
+UwResult _uw_json_parse_string(_UwJsonInput* input, size_t* position);
+/*
+ * Decode string starting with the opening quote at `*position`.
+ * The closing quote must be within input, otherwise the string is considered unterminated.
+ * On success update `*position` to point past the closing quote.
+ */
+
+UwResult _uw_json_parse_number(_UwJsonInput* input, size_t position);
+/*
+ * Decode number starting at `position`.
+ * The end of input is considered as the end of token.
+ * Return Signed for integers that fit int64, Unsigned for greater ones,
+ * and Float for numbers with fraction or exponent and for integers out of range.
+ */
+
+UwResult _uw_json_parse_literal(_UwJsonInput* input, size_t position);
+/*
+ * Decode true, false, or null starting at `position`.
+ */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,482 @@
+#include <string.h>
+
+#include "include/uw_json_sax.h"
+
+#include "src/uw_json_internal.h"
+
+#define UW_JSON_STREAM_BUFFER_SIZE  65536
+#define UW_JSON_MAX_SCALAR_LENGTH   1024
+
+typedef struct {
+    UwValuePtr reader;
+
+    // the buffer; it grows only if a token does not fit
+    _UwJsonInput input;
+    size_t capacity;
+    size_t position;
+    bool   eof;
+
+    UwJsonEventHandler handler;
+    void*  arg;
+    bool   stopped;
+} JsonStream;
+
+/****************************************************************
+ * Input
+ */
+
+static UwResult refill(JsonStream* stream)
+/*
+ * Discard data before current position and read more.
+ * Set `eof` if no more data.
+ */
+{
+    _UwJsonInput* input = &stream->input;
+
+    size_t consumed = stream->position;
+    if (consumed) {
+        _uw_json_advance_location(input->data, consumed, &input->line, &input->column);
+        input->size -= consumed;
+        memmove(input->data, input->data + consumed, input->size);
+        stream->position = 0;
+    }
+    if (input->size == stream->capacity) {
+        // current token does not fit the buffer
+        size_t new_capacity = stream->capacity * 2;
+        char8_t* new_data = allocate(new_capacity, false);
+        if (!new_data) {
+            return UwOOM();
+        }
+        memcpy(new_data, input->data, input->size);
+        release((void**) &input->data, stream->capacity);
+        input->data = new_data;
+        stream->capacity = new_capacity;
+    }
+    unsigned bytes_read;
+    UwValue status = uw_read_bytes(stream->reader, input->data + input->size, stream->capacity - input->size, &bytes_read);
+    if (uw_eof(&status)) {
+        stream->eof = true;
+        return UwOK();
+    }
+    uw_return_if_error(&status);
+    input->size += bytes_read;
+    return UwOK();
+}
+
+static UwResult skip_whitespace(JsonStream* stream)
+/*
+ * Skip whitespace. Current position is at the end of data only if no more data.
+ */
+{
+    for (;;) {
+        char8_t* data = stream->input.data;
+        size_t size = stream->input.size;
+        while (stream->position < size) {
+            if (!_uw_json_is_whitespace(data[stream->position])) {
+                return UwOK();
+            }
+            stream->position++;
+        }
+        if (stream->eof) {
+            return UwOK();
+        }
+        uw_expect_ok( refill(stream) );
+    }
+}
+
+static UwResult next_char(JsonStream* stream, char8_t* c)
+/*
+ * Skip whitespace and get next character without consuming it.
+ */
+{
+    uw_expect_ok( skip_whitespace(stream) );
+    if (stream->position == stream->input.size) {
+        return _uw_json_error(&stream->input, stream->position, "unexpected end of data");
+    }
+    *c = stream->input.data[stream->position];
+    return UwOK();
+}
+
+/****************************************************************
+ * Tokens
+ */
+
+static UwResult read_string(JsonStream* stream, UwValuePtr result)
+/*
+ * Read string starting with the opening quote at current position.
+ * If `result` is nullptr, skip the string without decoding.
+ */
+{
+    // make sure the entire string is in the buffer
+
+    size_t scan_pos = stream->position + 1;
+    for (;;) {
+        char8_t* data = stream->input.data;
+        char8_t* end = data + stream->input.size;
+        char8_t* p = data + scan_pos;
+        while (p < end) {
+            p = _uw_json_skip_plain_ascii(p, end);
+            if (p == end) {
+                break;
+            }
+            char8_t c = *p;
+            if (c == '"') {
+                if (result) {
+                    size_t position = stream->position;
+                    *result = _uw_json_parse_string(&stream->input, &position);
+                    uw_return_if_error(result);
+                }
+                stream->position = p + 1 - data;
+                return UwOK();
+            }
+            if (c == '\\') {
+                if (p + 1 == end) {
+                    // escaped character is not in the buffer yet
+                    break;
+                }
+                p += 2;
+            } else {
+                p++;
+            }
+        }
+        if (stream->eof) {
+            // the decoder makes proper error
+            size_t position = stream->position;
+            return _uw_json_parse_string(&stream->input, &position);
+        }
+        scan_pos = p - data - stream->position;
+        uw_expect_ok( refill(stream) );
+    }
+}
+
+static UwResult read_scalar(JsonStream* stream, UwValuePtr result)
+/*
+ * Read number or literal at current position.
+ * If `result` is nullptr, the token is validated and discarded.
+ */
+{
+    // make sure the entire token is in the buffer
+
+    size_t scan_pos = stream->position;
+    for (;;) {
+        char8_t* data = stream->input.data;
+        size_t size = stream->input.size;
+        while (scan_pos < size && !_uw_json_is_whitespace(data[scan_pos]) && !_uw_json_is_operator(data[scan_pos])) {
+            scan_pos++;
+        }
+        if (scan_pos < size || stream->eof) {
+            break;
+        }
+        scan_pos -= stream->position;
+        if (scan_pos > UW_JSON_MAX_SCALAR_LENGTH) {
+            char8_t c = data[stream->position];
+            bool is_number = c == '-' || (c >= '0' && c <= '9');
+            return _uw_json_error(&stream->input, stream->position, is_number? "number is too long" : "unexpected character");
+        }
+        uw_expect_ok( refill(stream) );
+    }
+
+    char8_t c = stream->input.data[stream->position];
+    UwValue value = UwNull();
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        value = _uw_json_parse_number(&stream->input, stream->position);
+    } else {
+        value = _uw_json_parse_literal(&stream->input, stream->position);
+    }
+    uw_return_if_error(&value);
+    stream->position = scan_pos;
+    if (result) {
+        *result = uw_move(&value);
+    }
+    return UwOK();
+}
+
+/****************************************************************
+ * Building and skipping values
+ */
+
+// forward declaration
+static UwResult parse_value(JsonStream* stream, unsigned depth, UwValuePtr result);
+
+static UwResult parse_array(JsonStream* stream, unsigned depth, UwValuePtr result)
+/*
+ * Build array starting at current position or skip it if `result` is nullptr.
+ */
+{
+    if (result) {
+        *result = uw_create(UwTypeId_Array);
+        uw_return_if_error(result);
+    }
+    stream->position++;
+
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c == ']') {
+        stream->position++;
+        return UwOK();
+    }
+    for (;;) {
+        if (result) {
+            UwValue item = UwNull();
+            uw_expect_ok( parse_value(stream, depth + 1, &item) );
+            uw_expect_ok( uw_array_append_va(result, uw_move(&item)) );
+        } else {
+            uw_expect_ok( parse_value(stream, depth + 1, nullptr) );
+        }
+        uw_expect_ok( next_char(stream, &c) );
+        stream->position++;
+        if (c == ']') {
+            return UwOK();
+        }
+        if (c != ',') {
+            return _uw_json_error(&stream->input, stream->position - 1, "expected , or ]");
+        }
+    }
+}
+
+static UwResult parse_key(JsonStream* stream, UwValuePtr key)
+/*
+ * Read key and colon. If `key` is nullptr, skip them.
+ */
+{
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c != '"') {
+        return _uw_json_error(&stream->input, stream->position, "expected string key");
+    }
+    uw_expect_ok( read_string(stream, key) );
+
+    uw_expect_ok( next_char(stream, &c) );
+    if (c != ':') {
+        return _uw_json_error(&stream->input, stream->position, "expected :");
+    }
+    stream->position++;
+    return UwOK();
+}
+
+static UwResult parse_object(JsonStream* stream, unsigned depth, UwValuePtr result)
+/*
+ * Build map starting at current position or skip it if `result` is nullptr.
+ */
+{
+    if (result) {
+        *result = uw_create(UwTypeId_Map);
+        uw_return_if_error(result);
+    }
+    stream->position++;
+
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c == '}') {
+        stream->position++;
+        return UwOK();
+    }
+    for (;;) {
+        if (result) {
+            UwValue key = UwNull();
+            UwValue value = UwNull();
+            uw_expect_ok( parse_key(stream, &key) );
+            uw_expect_ok( parse_value(stream, depth + 1, &value) );
+            uw_expect_ok( uw_map_update_va(result, uw_move(&key), uw_move(&value)) );
+        } else {
+            uw_expect_ok( parse_key(stream, nullptr) );
+            uw_expect_ok( parse_value(stream, depth + 1, nullptr) );
+        }
+        uw_expect_ok( next_char(stream, &c) );
+        stream->position++;
+        if (c == '}') {
+            return UwOK();
+        }
+        if (c != ',') {
+            return _uw_json_error(&stream->input, stream->position - 1, "expected , or }");
+        }
+    }
+}
+
+static UwResult parse_value(JsonStream* stream, unsigned depth, UwValuePtr result)
+/*
+ * Build value or skip it if `result` is nullptr.
+ */
+{
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    switch (c) {
+        case '{':
+        case '[':
+            if (depth >= UW_JSON_MAX_DEPTH) {
+                return _uw_json_error(&stream->input, stream->position, "nesting is too deep");
+            }
+            return (c == '{')? parse_object(stream, depth, result) : parse_array(stream, depth, result);
+        case '"':
+            return read_string(stream, result);
+        default:
+            return read_scalar(stream, result);
+    }
+}
+
+/****************************************************************
+ * Events
+ */
+
+static unsigned emit(JsonStream* stream, unsigned event, UwValuePtr value, unsigned depth)
+{
+    unsigned action = stream->handler(event, value, depth, stream->arg);
+    if (action == UW_JSON_STOP) {
+        stream->stopped = true;
+    }
+    return action;
+}
+
+static UwResult materialize(JsonStream* stream, unsigned depth)
+{
+    UwValue value = UwNull();
+    uw_expect_ok( parse_value(stream, depth, &value) );
+    emit(stream, UW_JSON_VALUE, &value, depth);
+    return UwOK();
+}
+
+// forward declaration
+static UwResult emit_value(JsonStream* stream, unsigned depth);
+
+static UwResult emit_array(JsonStream* stream, unsigned depth)
+{
+    stream->position++;
+
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c != ']') {
+        for (;;) {
+            uw_expect_ok( emit_value(stream, depth + 1) );
+            if (stream->stopped) {
+                return UwOK();
+            }
+            uw_expect_ok( next_char(stream, &c) );
+            if (c == ']') {
+                break;
+            }
+            if (c != ',') {
+                return _uw_json_error(&stream->input, stream->position, "expected , or ]");
+            }
+            stream->position++;
+        }
+    }
+    stream->position++;
+    emit(stream, UW_JSON_END_ARRAY, nullptr, depth);
+    return UwOK();
+}
+
+static UwResult emit_object(JsonStream* stream, unsigned depth)
+{
+    stream->position++;
+
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c != '}') {
+        for (;;) {{
+            UwValue key = UwNull();
+            uw_expect_ok( parse_key(stream, &key) );
+            unsigned action = emit(stream, UW_JSON_KEY, &key, depth + 1);
+            if (stream->stopped) {
+                return UwOK();
+            }
+            if (action == UW_JSON_SKIP) {
+                uw_expect_ok( parse_value(stream, depth + 1, nullptr) );
+            } else if (action == UW_JSON_MATERIALIZE) {
+                uw_expect_ok( materialize(stream, depth + 1) );
+            } else {
+                uw_expect_ok( emit_value(stream, depth + 1) );
+            }
+            if (stream->stopped) {
+                return UwOK();
+            }
+            uw_expect_ok( next_char(stream, &c) );
+            if (c == '}') {
+                break;
+            }
+            if (c != ',') {
+                return _uw_json_error(&stream->input, stream->position, "expected , or }");
+            }
+            stream->position++;
+        }}
+    }
+    stream->position++;
+    emit(stream, UW_JSON_END_OBJECT, nullptr, depth);
+    return UwOK();
+}
+
+static UwResult emit_value(JsonStream* stream, unsigned depth)
+{
+    char8_t c;
+    uw_expect_ok( next_char(stream, &c) );
+    if (c != '{' && c != '[') {
+        return materialize(stream, depth);
+    }
+    if (depth >= UW_JSON_MAX_DEPTH) {
+        return _uw_json_error(&stream->input, stream->position, "nesting is too deep");
+    }
+    unsigned action = emit(stream, (c == '{')? UW_JSON_START_OBJECT : UW_JSON_START_ARRAY, nullptr, depth);
+    switch (action) {
+        case UW_JSON_STOP:
+            return UwOK();
+        case UW_JSON_SKIP:
+            return parse_value(stream, depth, nullptr);
+        case UW_JSON_MATERIALIZE:
+            return materialize(stream, depth);
+        default:
+            return (c == '{')? emit_object(stream, depth) : emit_array(stream, depth);
+    }
+}
+
+/****************************************************************
+ * Main function
+ */
+
+static UwResult parse_stream(JsonStream* stream)
+{
+    uw_expect_ok( refill(stream) );
+
+    _UwJsonInput* input = &stream->input;
+    if (input->size >= 3 && input->data[0] == 0xEF && input->data[1] == 0xBB && input->data[2] == 0xBF) {
+        // skip BOM; it will be counted as one character when discarded
+        stream->position = 3;
+        input->column = 0;
+    }
+    uw_expect_ok( skip_whitespace(stream) );
+    if (stream->position == input->size) {
+        return _uw_json_error(input, stream->position, "no data");
+    }
+    uw_expect_ok( emit_value(stream, 0) );
+    if (stream->stopped) {
+        return UwOK();
+    }
+    uw_expect_ok( skip_whitespace(stream) );
+    if (stream->position < input->size) {
+        return _uw_json_error(input, stream->position, "extra data after JSON value");
+    }
+    return UwOK();
+}
+
+UwResult uw_json_parse_events(UwValuePtr reader, UwJsonEventHandler handler, void* arg)
+{
+    if (!_uw_has_interface(reader->type_id, UwInterfaceId_ByteReader)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    JsonStream stream = {
+        .reader   = reader,
+        .input    = { .line = 1, .column = 1 },
+        .capacity = UW_JSON_STREAM_BUFFER_SIZE,
+        .handler  = handler,
+        .arg      = arg
+    };
+    stream.input.data = allocate(stream.capacity, false);
+    if (!stream.input.data) {
+        return UwOOM();
+    }
+    UwValue status = uw_start_read_bytes(reader);
+    if (uw_ok(&status)) {
+        status = parse_stream(&stream);
+        uw_stop_read_bytes(reader);
+    }
+    release((void**) &stream.input.data, stream.capacity);
+    return uw_move(&status);
+}
@@ -0,0 +1,532 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
+#include "src/uw_json_internal.h"
+#include "src/uw_string_internal.h"
+
+/****************************************************************
+ * Stage 1: structural scanner
+ */
+
+static inline unsigned count_trailing_zeros(uint64_t n)
+{
+    return (unsigned) __builtin_ctzll(n);
+}
+
+#ifdef __SSE2__
+
+static inline uint64_t block_mask(__m128i v[4], __m128i (*match)(__m128i))
+{
+    uint64_t r0 = (uint16_t) _mm_movemask_epi8(match(v[0]));
+    uint64_t r1 = (uint16_t) _mm_movemask_epi8(match(v[1]));
+    uint64_t r2 = (uint16_t) _mm_movemask_epi8(match(v[2]));
+    uint64_t r3 = (uint16_t) _mm_movemask_epi8(match(v[3]));
+    return r0 | (r1 << 16) | (r2 << 32) | (r3 << 48);
+}
+
+static inline __m128i match_whitespace(__m128i v)
+{
+    return _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),  _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))
+    );
+}
+
+static inline __m128i match_operator(__m128i v)
+{
+    // setting bit 5 maps [ to { and ] to }
+    __m128i v20 = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v20, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v20, _mm_set1_epi8('}'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),   _mm_cmpeq_epi8(v, _mm_set1_epi8(',')))
+    );
+}
+
+static inline __m128i match_quote(__m128i v)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+}
+
+static inline __m128i match_backslash(__m128i v)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+}
+
+static void classify_block(char8_t* block, uint64_t* whitespace, uint64_t* op, uint64_t* quote, uint64_t* backslash)
+{
+    __m128i v[4];
+    for (unsigned i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128((__m128i*) (block + i * 16));
+    }
+    *whitespace = block_mask(v, match_whitespace);
+    *op         = block_mask(v, match_operator);
+    *quote      = block_mask(v, match_quote);
+    *backslash  = block_mask(v, match_backslash);
+}
+
+#else
+
+static void classify_block(char8_t* block, uint64_t* whitespace, uint64_t* op, uint64_t* quote, uint64_t* backslash)
+{
+    uint64_t ws = 0, o = 0, q = 0, bs = 0;
+    for (unsigned i = 0; i < UW_JSON_BLOCK_SIZE; i++) {
+        char8_t c = block[i];
+        uint64_t bit = 1ULL << i;
+        if (_uw_json_is_whitespace(c)) {
+            ws |= bit;
+        } else if (_uw_json_is_operator(c)) {
+            o |= bit;
+        } else if (c == '"') {
+            q |= bit;
+        } else if (c == '\\') {
+            bs |= bit;
+        }
+    }
+    *whitespace = ws;
+    *op = o;
+    *quote = q;
+    *backslash = bs;
+}
+
+#endif
+
+static inline uint64_t prefix_xor(uint64_t n)
+/*
+ * Each bit of result is the XOR of all bits up to and including this one.
+ */
+{
+    n ^= n << 1;
+    n ^= n << 2;
+    n ^= n << 4;
+    n ^= n << 8;
+    n ^= n << 16;
+    n ^= n << 32;
+    return n;
+}
+
+static inline uint64_t find_escaped(_UwJsonScanner* scanner, uint64_t backslash)
+/*
+ * Return mask of characters preceded by an escaping backslash.
+ * Backslashes are rare, so iterating over them is cheaper than bit tricks.
+ */
+{
+    uint64_t escaped = scanner->prev_escaped;
+    backslash &= ~scanner->prev_escaped;
+    scanner->prev_escaped = 0;
+    while (backslash) {
+        unsigned i = count_trailing_zeros(backslash);
+        if (i == 63) {
+            scanner->prev_escaped = 1;
+            break;
+        }
+        escaped |= 2ULL << i;
+        backslash &= ~(3ULL << i);  // escaped backslash does not escape the next character
+    }
+    return escaped;
+}
+
+static void scan_block(_UwJsonScanner* scanner)
+{
+    char8_t* block = scanner->input.data + scanner->block_pos;
+
+    char8_t padded_block[UW_JSON_BLOCK_SIZE];
+    size_t remaining = scanner->input.size - scanner->block_pos;
+    if (remaining < UW_JSON_BLOCK_SIZE) {
+        // pad the last block with whitespace
+        memcpy(padded_block, block, remaining);
+        memset(padded_block + remaining, ' ', UW_JSON_BLOCK_SIZE - remaining);
+        block = padded_block;
+    }
+
+    uint64_t whitespace, op, quote, backslash;
+    classify_block(block, &whitespace, &op, &quote, &backslash);
+
+    if (backslash | scanner->prev_escaped) {
+        quote &= ~find_escaped(scanner, backslash);
+    }
+
+    // bits are set for opening quotes and string contents, not for closing quotes
+    uint64_t in_string = prefix_xor(quote) ^ scanner->prev_in_string;
+    scanner->prev_in_string = (uint64_t) ((int64_t) in_string >> 63);
+
+    uint64_t scalar = ~(op | whitespace | quote | in_string);
+    uint64_t scalar_start = scalar & ~((scalar << 1) | scanner->prev_scalar);
+    scanner->prev_scalar = scalar >> 63;
+
+    uint64_t structurals = (op & ~in_string) | (quote & in_string) | scalar_start;
+
+    size_t* index = &scanner->index[scanner->num_indices];
+    size_t base = scanner->block_pos;
+    while (structurals) {
+        *index++ = base + count_trailing_zeros(structurals);
+        structurals &= structurals - 1;
+    }
+    scanner->num_indices = index - scanner->index;
+    scanner->block_pos += UW_JSON_BLOCK_SIZE;
+}
+
+void _uw_json_scanner_init(_UwJsonScanner* scanner, char8_t* data, size_t size)
+{
+    scanner->input.data = data;
+    scanner->input.size = size;
+    scanner->input.line = 1;
+    scanner->input.column = 1;
+    scanner->block_pos = 0;
+    scanner->prev_in_string = 0;
+    scanner->prev_escaped = 0;
+    scanner->prev_scalar = 0;
+    scanner->num_indices = 0;
+    scanner->next_index = 0;
+
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        // skip BOM, block positions are relative to data
+        scanner->input.data += 3;
+        scanner->input.size -= 3;
+    }
+}
+
+void _uw_json_scan(_UwJsonScanner* scanner)
+{
+    scanner->num_indices = 0;
+    scanner->next_index = 0;
+    while (scanner->block_pos < scanner->input.size
+           && scanner->num_indices + UW_JSON_BLOCK_SIZE <= UW_JSON_INDEX_CAPACITY) {
+        scan_block(scanner);
+    }
+}
+
+/****************************************************************
+ * Errors
+ */
+
+UwResult _uw_json_error(_UwJsonInput* input, size_t position, char* message)
+{
+    if (position > input->size) {
+        position = input->size;
+    }
+    unsigned line = input->line;
+    unsigned column = input->column;
+    _uw_json_advance_location(input->data, position, &line, &column);
+
+    UwValue status = UwError(UW_ERROR_JSON_SYNTAX);
+    _uw_set_status_desc(&status, "line %u, column %u: %s", line, column, message);
+    return uw_move(&status);
+}
+
+/****************************************************************
+ * Stage 2 helpers: token decoders
+ */
+
+static inline bool is_token_end(_UwJsonInput* input, size_t position)
+{
+    if (position >= input->size) {
+        return true;
+    }
+    char8_t c = input->data[position];
+    return _uw_json_is_whitespace(c) || _uw_json_is_operator(c);
+}
+
+static int hex_digit(char8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static bool read_hex4(char8_t* ptr, char8_t* end, char32_t* result)
+{
+    if (end - ptr < 4) {
+        return false;
+    }
+    char32_t n = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        int d = hex_digit(ptr[i]);
+        if (d < 0) {
+            return false;
+        }
+        n = (n << 4) | d;
+    }
+    *result = n;
+    return true;
+}
+
+static bool read_escape(char8_t** ptr, char8_t* end, char32_t* result)
+/*
+ * Decode escape sequence, `*ptr` points to the character after backslash.
+ */
+{
+    char8_t* p = *ptr;
+    if (p == end) {
+        return false;
+    }
+    switch (*p++) {
+        case '"':  *result = '"';  break;
+        case '\\': *result = '\\'; break;
+        case '/':  *result = '/';  break;
+        case 'b':  *result = '\b'; break;
+        case 'f':  *result = '\f'; break;
+        case 'n':  *result = '\n'; break;
+        case 'r':  *result = '\r'; break;
+        case 't':  *result = '\t'; break;
+        case 'u': {
+            char32_t cp;
+            if (!read_hex4(p, end, &cp)) {
+                return false;
+            }
+            p += 4;
+            if (cp >= 0xDC00 && cp < 0xE000) {
+                // unpaired low surrogate
+                return false;
+            }
+            if (cp >= 0xD800 && cp < 0xDC00) {
+                // high surrogate must be followed by low surrogate
+                char32_t low;
+                if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !read_hex4(p + 2, end, &low)) {
+                    return false;
+                }
+                if (low < 0xDC00 || low >= 0xE000) {
+                    return false;
+                }
+                p += 6;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            *result = cp;
+            break;
+        }
+        default:
+            return false;
+    }
+    *ptr = p;
+    return true;
+}
+
+char8_t* _uw_json_skip_plain_ascii(char8_t* ptr, char8_t* end)
+{
+#ifdef __SSE2__
+    while (end - ptr >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*) ptr);
+        // signed comparison catches both control characters and bytes >= 0x80
+        __m128i special = _mm_or_si128(
+            _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')))
+        );
+        unsigned mask = (unsigned) _mm_movemask_epi8(special);
+        if (mask) {
+            return ptr + __builtin_ctz(mask);
+        }
+        ptr += 16;
+    }
+#endif
+    while (ptr < end) {
+        char8_t c = *ptr;
+        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\') {
+            break;
+        }
+        ptr++;
+    }
+    return ptr;
+}
+
+UwResult _uw_json_parse_string(_UwJsonInput* input, size_t* position)
+{
+    char8_t* start = input->data + *position + 1;
+    char8_t* end = input->data + input->size;
+
+    // pass 1: validate, find closing quote, and calculate length and char size
+
+    unsigned length = 0;
+    uint8_t width = 0;
+    bool plain_ascii = true;
+    char8_t* p = start;
+    for (;;) {
+        char8_t* next = _uw_json_skip_plain_ascii(p, end);
+        length += next - p;
+        p = next;
+        if (p == end) {
+            return _uw_json_error(input, end - input->data, "unterminated string");
+        }
+        char8_t c = *p;
+        if (c == '"') {
+            break;
+        }
+        char32_t chr;
+        if (c == '\\') {
+            p++;
+            if (!read_escape(&p, end, &chr)) {
+                return _uw_json_error(input, p - input->data, "bad escape sequence");
+            }
+            plain_ascii = false;
+        } else if (c < 0x20) {
+            return _uw_json_error(input, p - input->data, "control character in string");
+        } else {
+            char8_t* char_start = p;
+            unsigned remaining = end - p;
+            if (!read_utf8_buffer(&p, &remaining, &chr) || chr == 0xFFFFFFFF) {
+                return _uw_json_error(input, char_start - input->data, "bad UTF-8 sequence");
+            }
+            plain_ascii = false;
+        }
+        width = update_char_width(width, chr);
+        length++;
+    }
+    char8_t* closing_quote = p;
+    *position = closing_quote + 1 - input->data;
+
+    // pass 2: make string of the exact char size and length
+
+    uint8_t char_size = char_width_to_char_size(width);
+    UwValue result = uw_create_empty_string(length, char_size);
+    uw_return_if_error(&result);
+
+    uint8_t* dest = _uw_string_start(&result);
+    if (plain_ascii) {
+        memcpy(dest, start, length);
+    } else {
+        p = start;
+        while (p < closing_quote) {
+            char32_t chr;
+            if (*p == '\\') {
+                p++;
+                read_escape(&p, end, &chr);
+            } else if (*p < 0x80) {
+                chr = *p++;
+            } else {
+                unsigned remaining = end - p;
+                read_utf8_buffer(&p, &remaining, &chr);
+            }
+            _uw_put_char(dest, chr, char_size);
+            dest += char_size;
+        }
+    }
+    _uw_string_set_length(&result, length);
+    return uw_move(&result);
+}
+
+UwResult _uw_json_parse_number(_UwJsonInput* input, size_t position)
+{
+    char8_t* start = input->data + position;
+    char8_t* end = input->data + input->size;
+    char8_t* p = start;
+
+    bool negative = false;
+    if (*p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return _uw_json_error(input, p - input->data, "bad number");
+    }
+
+    // integer part
+
+    uint64_t n = 0;
+    bool overflow = false;
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && *p >= '0' && *p <= '9') {
+            unsigned digit = *p++ - '0';
+            if (n > (UINT64_MAX - digit) / 10) {
+                overflow = true;
+            }
+            n = n * 10 + digit;
+        }
+    }
+    bool is_float = overflow;
+
+    // fraction
+
+    if (p < end && *p == '.') {
+        p++;
+        if (p == end || *p < '0' || *p > '9') {
+            return _uw_json_error(input, p - input->data, "bad number");
+        }
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        is_float = true;
+    }
+
+    // exponent
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9') {
+            return _uw_json_error(input, p - input->data, "bad number");
+        }
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        is_float = true;
+    }
+
+    if (!is_token_end(input, p - input->data)) {
+        return _uw_json_error(input, p - input->data, "bad number");
+    }
+
+    if (!is_float) {
+        if (!negative) {
+            if (n <= INT64_MAX) {
+                return UwSigned((int64_t) n);
+            }
+            return UwUnsigned(n);
+        }
+        if (n <= (uint64_t) INT64_MAX + 1) {
+            return UwSigned((int64_t) (0 - n));
+        }
+    }
+
+    // input is not null-terminated, strtod needs a copy
+    size_t len = p - start;
+    if (len > 1024) {
+        return _uw_json_error(input, position, "number is too long");
+    }
+    char buf[len + 1];
+    memcpy(buf, start, len);
+    buf[len] = 0;
+    return UwFloat(strtod(buf, nullptr));
+}
+
+UwResult _uw_json_parse_literal(_UwJsonInput* input, size_t position)
+{
+    char8_t* p = input->data + position;
+    size_t remaining = input->size - position;
+
+#   define MATCH(literal)  \
+        (remaining >= sizeof(literal) - 1  \
+         && memcmp(p, literal, sizeof(literal) - 1) == 0  \
+         && is_token_end(input, position + sizeof(literal) - 1))
+
+    switch (*p) {
+        case 't':
+            if (MATCH("true")) {
+                return UwBool(true);
+            }
+            break;
+        case 'f':
+            if (MATCH("false")) {
+                return UwBool(false);
+            }
+            break;
+        case 'n':
+            if (MATCH("null")) {
+                return UwNull();
+            }
+            break;
+    }
+    return _uw_json_error(input, position, "unexpected character");
+
+#   undef MATCH
+}
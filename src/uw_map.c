@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "include/uw.h"
+#include "src/uw_arena_internal.h"
 #include "src/uw_charptr_internal.h"
 #include "src/uw_compound_internal.h"
 #include "src/uw_map_internal.h"
@@ -107,28 +108,9 @@ static void set_ht_item(struct _UwHashTable* ht, unsigned index, unsigned value)
  * kv_index = key_index / 2
  */
 
-static bool init_hash_table(UwTypeId type_id, struct _UwHashTable* ht,
-                            unsigned old_capacity, unsigned new_capacity)
+void _uw_hash_table_set_methods(struct _UwHashTable* ht)
 {
-    unsigned old_item_size = get_item_size(old_capacity);
-    unsigned old_memsize = old_item_size * old_capacity;
-
-    unsigned new_item_size = get_item_size(new_capacity);
-    unsigned new_memsize = new_item_size * new_capacity;
-
-    // reallocate items
-    // if map is new, ht is initialized to all zero
-    // if map is doubled, this reallocates the block
-    if (!_uw_types[type_id]->allocator->reallocate((void**) &ht->items, old_memsize, new_memsize, true, nullptr)) {
-        return false;
-    }
-    memset(ht->items, 0, new_memsize);
-
-    ht->item_size    = new_item_size;
-    ht->capacity     = new_capacity;
-    ht->hash_bitmask = new_capacity - 1;
-
-    switch (new_item_size) {
+    switch (ht->item_size) {
         case 1:
             ht->get_item = get_ht_item_uint8_t;
             ht->set_item = set_ht_item_uint8_t;
@@ -152,18 +134,49 @@ static bool init_hash_table(UwTypeId type_id, struct _UwHashTable* ht,
             ht->set_item = set_ht_item;
             break;
     }
+}
+
+static bool init_hash_table(UwTypeId type_id, struct _UwHashTable* ht,
+                            unsigned old_capacity, unsigned new_capacity)
+{
+    unsigned old_item_size = get_item_size(old_capacity);
+    unsigned old_memsize = old_item_size * old_capacity;
+
+    unsigned new_item_size = get_item_size(new_capacity);
+    unsigned new_memsize = new_item_size * new_capacity;
+
+    // reallocate items
+    // if map is new, ht is initialized to all zero
+    // if map is doubled, this reallocates the block
+    if (_uw_in_arena(ht)) {
+        if (!_uw_arena_reallocate(ht, (void**) &ht->items, old_memsize, new_memsize)) {
+            return false;
+        }
+    } else if (!_uw_types[type_id]->allocator->reallocate((void**) &ht->items, old_memsize, new_memsize, true, nullptr)) {
+        return false;
+    }
+    memset(ht->items, 0, new_memsize);
+
+    ht->item_size    = new_item_size;
+    ht->capacity     = new_capacity;
+    ht->hash_bitmask = new_capacity - 1;
+
+    _uw_hash_table_set_methods(ht);
     return true;
 }
 
 static void free_hash_table(UwTypeId type_id, struct _UwHashTable* ht)
 {
+    if (_uw_in_arena(ht->items)) {
+        return;
+    }
     unsigned ht_memsize = get_item_size(ht->capacity) * ht->capacity;
     _uw_types[type_id]->allocator->release((void**) &ht->items, ht_memsize);
 }
 
-static unsigned lookup(_UwMap* map, UwValuePtr key, unsigned* ht_index, unsigned* ht_offset)
+static unsigned lookup_hashed(_UwMap* map, UwValuePtr key, UwType_Hash hash, unsigned* ht_index, unsigned* ht_offset)
 /*
- * Lookup key starting from index = hash(key).
+ * Lookup key starting from index = hash.
  *
  * Return index of key in kv_pairs or UINT_MAX if hash table has no item matching `key`.
  *
@@ -172,7 +185,7 @@ static unsigned lookup(_UwMap* map, UwValuePtr key, unsigned* ht_index, unsigned
  */
 {
     struct _UwHashTable* ht = &map->hash_table;
-    UwType_Hash index = uw_hash(key) & ht->hash_bitmask;
+    UwType_Hash index = hash & ht->hash_bitmask;
     unsigned offset = 0;
     do {
         unsigned kv_index = ht->get_item(ht, index);
@@ -212,6 +225,11 @@ static unsigned lookup(_UwMap* map, UwValuePtr key, unsigned* ht_index, unsigned
     } while (true);
 }
 
+static inline unsigned lookup(_UwMap* map, UwValuePtr key, unsigned* ht_index, unsigned* ht_offset)
+{
+    return lookup_hashed(map, key, uw_hash(key), ht_index, ht_offset);
+}
+
 static unsigned set_hash_table_item(struct _UwHashTable* hash_table, unsigned ht_index, unsigned kv_index)
 /*
  * Assign `kv_index` to `hash_table` at position `ht_index` & hash_bitmask.
@@ -241,6 +259,10 @@ static UwResult _uw_map_expand(UwTypeId type_id, _UwMap* map, unsigned desired_c
     // expand array if necessary
     unsigned array_cap = desired_capacity << 1;
     if (array_cap > _uw_array_capacity(&map->kv_pairs)) {
+        if (array_cap < UWMAP_INITIAL_CAPACITY * 2) {
+            // growing out of inline items
+            array_cap = UWMAP_INITIAL_CAPACITY * 2;
+        }
         uw_expect_ok( _uw_array_resize(type_id, &map->kv_pairs, array_cap) );
     }
 
@@ -293,8 +315,12 @@ static UwResult update_map(UwValuePtr map, UwValuePtr key, UwValuePtr value)
         // found key, update value
         unsigned value_index = key_index + 1;
         UwValuePtr v_ptr = &__map->kv_pairs.items[value_index];
+        if (!_uw_arena_store(map, value)) {
+            return UwOOM();
+        }
         uw_destroy(v_ptr);
         *v_ptr = uw_move(value);
+        _uw_array_note_item(&__map->kv_pairs, v_ptr);
         return UwOK();
     }
 
@@ -304,11 +330,17 @@ static UwResult update_map(UwValuePtr map, UwValuePtr key, UwValuePtr value)
 
     // append key and value
     unsigned kv_index = _uw_array_length(&__map->kv_pairs) >> 1;
-    set_hash_table_item(&__map->hash_table, uw_hash(key), kv_index + 1);
+    UwType_Hash hash = uw_hash(key);
 
     uw_expect_ok( _uw_array_append_item(type_id, &__map->kv_pairs, key, map) );
 
-    return _uw_array_append_item(type_id, &__map->kv_pairs, value, map);
+    UwValue status = _uw_array_append_item(type_id, &__map->kv_pairs, value, map);
+    if (uw_error(&status)) {
+        UwValue k = _uw_array_pop(&__map->kv_pairs);
+        return uw_move(&status);
+    }
+    set_hash_table_item(&__map->hash_table, hash, kv_index + 1);
+    return UwOK();
 }
 
 /****************************************************************
@@ -335,7 +367,7 @@ static UwResult map_init(UwValuePtr self, void* ctor_args)
     if (!init_hash_table(self->type_id, ht, 0, UWMAP_INITIAL_CAPACITY)) {
         return UwOOM();
     }
-    UwValue status = _uw_alloc_array(self->type_id, &map->kv_pairs, UWMAP_INITIAL_CAPACITY * 2);
+    UwValue status = _uw_alloc_array(self->type_id, &map->kv_pairs, UWARRAY_INLINE_CAPACITY);
     if (uw_error(&status)) {
         map_fini(self);
     }
@@ -364,8 +396,12 @@ static UwResult map_deepcopy(UwValuePtr self)
 
     UwValuePtr kv = &src_map->kv_pairs.items[0];
     for (unsigned i = 0; i < map_length; i++) {{
-        UwValue key = uw_clone(kv++);  // okay to clone because keys are already deeply copied
-        UwValue value = uw_clone(kv++);
+        // okay to clone keys because they are already deeply copied, unless allocated in arena
+        UwValue key = uw_in_arena(kv)? uw_deepcopy(kv) : uw_clone(kv);
+        kv++;
+        uw_return_if_error(&key);
+        UwValue value = uw_deepcopy(kv++);
+        uw_return_if_error(&value);
         uw_expect_ok( update_map(&dest, &key, &value) );  // error should not happen because the map already resized
     }}
     return uw_move(&dest);
@@ -487,7 +523,7 @@ UwType _uw_map_type = {
     .id             = UwTypeId_Map,
     .ancestor_id    = UwTypeId_Compound,
     .name           = "Map",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_compound_destroy,
@@ -520,11 +556,14 @@ static_assert((sizeof(_UwCompoundData) & (alignof(_UwMap) - 1)) == 0);
 UwResult uw_map_update(UwValuePtr map, UwValuePtr key, UwValuePtr value)
 {
     uw_assert_map(map);
+    if (_uw_is_immortal(map)) {
+        return UwError(UW_ERROR_READ_ONLY);
+    }
 
     UwValue map_key = UwNull();
-    map_key = uw_deepcopy(key);  // deep copy key for immutability
+    map_key = _uw_deepcopy_into(map, key);  // deep copy key for immutability
     uw_return_if_error(&map_key);
-    UwValue map_value = uw_clone(value);
+    UwValue map_value = _uw_clone_into(map, value);
     return update_map(map, &map_key, &map_value);
 }
 
@@ -542,6 +581,11 @@ UwResult uw_map_update_ap(UwValuePtr map, va_list ap)
     uw_assert_map(map);
     UwValue error = UwOOM();  // default error is OOM unless some arg is a status
     bool done = false;  // for special case when value is missing
+    if (_uw_is_immortal(map)) {
+        uw_destroy(&error);
+        error = UwError(UW_ERROR_READ_ONLY);
+        goto failure;
+    }
     while (!done) {{
         UwValue key = va_arg(ap, _UwValue);
         if (uw_is_status(&key)) {
@@ -552,7 +596,7 @@ UwResult uw_map_update_ap(UwValuePtr map, va_list ap)
             error = uw_move(&key);
             goto failure;
         }
-        if (!uw_charptr_to_string_inplace(&key)) {
+        if (!_uw_charptr_to_string_into(map, &key)) {
             goto failure;
         }
         UwValue value = va_arg(ap, _UwValue);
@@ -567,7 +611,7 @@ UwResult uw_map_update_ap(UwValuePtr map, va_list ap)
                 goto failure;
             }
         }
-        if (!uw_charptr_to_string_inplace(&value)) {
+        if (!_uw_charptr_to_string_into(map, &value)) {
             goto failure;
         }
         UwValue status = update_map(map, &key, &value);
@@ -611,9 +655,24 @@ UwResult _uw_map_get(UwValuePtr self, UwValuePtr key)
     return uw_clone(&map->kv_pairs.items[value_index]);
 }
 
+UwValuePtr _uw_map_get_hashed(UwValuePtr self, UwValuePtr key, UwType_Hash hash)
+{
+    uw_assert_map(self);
+    _UwMap* map = get_data_ptr(self);
+
+    unsigned key_index = lookup_hashed(map, key, hash, nullptr, nullptr);
+    if (key_index == UINT_MAX) {
+        return nullptr;
+    }
+    return &map->kv_pairs.items[key_index + 1];
+}
+
 bool _uw_map_del(UwValuePtr self, UwValuePtr key)
 {
     uw_assert_map(self);
+    if (_uw_is_immortal(self)) {
+        return false;
+    }
 
     _UwMap* map = get_data_ptr(self);
 
@@ -29,10 +29,24 @@ struct _UwHashTable {
 };
 
 typedef struct {
-    _UwArray kv_pairs;        // key-value pairs in the insertion order
     struct _UwHashTable hash_table;
+    _UwArray kv_pairs;        // key-value pairs in the insertion order
+    _UwValue kv_inline_items[UWARRAY_INLINE_CAPACITY];  // must follow kv_pairs
 } _UwMap;
 
+static_assert(offsetof(_UwMap, kv_inline_items) == offsetof(_UwMap, kv_pairs) + sizeof(_UwArray));
+
+void _uw_hash_table_set_methods(struct _UwHashTable* ht);
+/*
+ * Set getter and setter functions for `ht->item_size`.
+ */
+
+UwValuePtr _uw_map_get_hashed(UwValuePtr self, UwValuePtr key, UwType_Hash hash);
+/*
+ * Lookup `key` with precomputed `hash`.
+ * Return pointer to the value, not a clone, or nullptr if key is not found.
+ */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,562 @@
+#include <limits.h>
+#include <string.h>
+
+#include "include/uw_msgpack.h"
+
+#include "src/uw_binary_internal.h"
+
+// format bytes
+#define MP_FIXMAP      0x80
+#define MP_FIXARRAY    0x90
+#define MP_FIXSTR      0xA0
+#define MP_NIL         0xC0
+#define MP_FALSE       0xC2
+#define MP_TRUE        0xC3
+#define MP_BIN8        0xC4
+#define MP_BIN16       0xC5
+#define MP_BIN32       0xC6
+#define MP_EXT8        0xC7
+#define MP_EXT16       0xC8
+#define MP_EXT32       0xC9
+#define MP_FLOAT32     0xCA
+#define MP_FLOAT64     0xCB
+#define MP_UINT8       0xCC
+#define MP_UINT16      0xCD
+#define MP_UINT32      0xCE
+#define MP_UINT64      0xCF
+#define MP_INT8        0xD0
+#define MP_INT16       0xD1
+#define MP_INT32       0xD2
+#define MP_INT64       0xD3
+#define MP_FIXEXT1     0xD4
+#define MP_FIXEXT2     0xD5
+#define MP_FIXEXT4     0xD6
+#define MP_FIXEXT8     0xD7
+#define MP_FIXEXT16    0xD8
+#define MP_STR8        0xD9
+#define MP_STR16       0xDA
+#define MP_STR32       0xDB
+#define MP_ARRAY16     0xDC
+#define MP_ARRAY32     0xDD
+#define MP_MAP16       0xDE
+#define MP_MAP32       0xDF
+
+#define EXT_TIMESTAMP  -1
+
+/****************************************************************
+ * Encoder
+ */
+
+// forward declaration
+static bool encode_value(_UwBinaryOutput* out, UwValuePtr value);
+
+static inline uint8_t* put_uint(uint8_t* p, uint64_t n)
+{
+    if (n < 0x80) {
+        *p++ = (uint8_t) n;
+    } else if (n <= UINT8_MAX) {
+        *p++ = MP_UINT8;
+        *p++ = (uint8_t) n;
+    } else if (n <= UINT16_MAX) {
+        *p++ = MP_UINT16;
+        p = _uw_binary_put_be16(p, (uint16_t) n);
+    } else if (n <= UINT32_MAX) {
+        *p++ = MP_UINT32;
+        p = _uw_binary_put_be32(p, (uint32_t) n);
+    } else {
+        *p++ = MP_UINT64;
+        p = _uw_binary_put_be64(p, n);
+    }
+    return p;
+}
+
+static inline uint8_t* put_negative_int(uint8_t* p, int64_t n)
+{
+    if (n >= -32) {
+        *p++ = (uint8_t) n;  // negative fixint
+    } else if (n >= INT8_MIN) {
+        *p++ = MP_INT8;
+        *p++ = (uint8_t) n;
+    } else if (n >= INT16_MIN) {
+        *p++ = MP_INT16;
+        p = _uw_binary_put_be16(p, (uint16_t) n);
+    } else if (n >= INT32_MIN) {
+        *p++ = MP_INT32;
+        p = _uw_binary_put_be32(p, (uint32_t) n);
+    } else {
+        *p++ = MP_INT64;
+        p = _uw_binary_put_be64(p, (uint64_t) n);
+    }
+    return p;
+}
+
+static inline bool put_header(_UwBinaryOutput* out, uint8_t fix, unsigned fix_limit,
+                              uint8_t format, unsigned n)
+/*
+ * Write header of str, array, or map.
+ * `format` is the code for 8-bit size, followed by codes for 16 and 32 bits,
+ * or the code for 16-bit size if `fix` is for array or map.
+ */
+{
+    if (!_uw_binary_reserve(out, 5)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    if (n < fix_limit) {
+        *p++ = fix | (uint8_t) n;
+    } else if (format == MP_STR8 && n <= UINT8_MAX) {
+        *p++ = MP_STR8;
+        *p++ = (uint8_t) n;
+    } else if (n <= UINT16_MAX) {
+        *p++ = (format == MP_STR8)? MP_STR16 : format;
+        p = _uw_binary_put_be16(p, (uint16_t) n);
+    } else {
+        *p++ = (format == MP_STR8)? MP_STR32 : format + 1;
+        p = _uw_binary_put_be32(p, n);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static inline bool encode_int(_UwBinaryOutput* out, UwValuePtr value)
+{
+    if (!_uw_binary_reserve(out, 9)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    if (uw_is_unsigned(value)) {
+        p = put_uint(p, value->unsigned_value);
+    } else if (value->signed_value < 0) {
+        p = put_negative_int(p, value->signed_value);
+    } else {
+        p = put_uint(p, (uint64_t) value->signed_value);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static bool encode_float(_UwBinaryOutput* out, double f)
+{
+    if (!_uw_binary_reserve(out, 9)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    float f32 = (float) f;
+    if ((double) f32 == f) {
+        uint32_t bits;
+        memcpy(&bits, &f32, 4);
+        *p++ = MP_FLOAT32;
+        p = _uw_binary_put_be32(p, bits);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &f, 8);
+        *p++ = MP_FLOAT64;
+        p = _uw_binary_put_be64(p, bits);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static bool encode_string(_UwBinaryOutput* out, UwValuePtr str)
+{
+    return put_header(out, MP_FIXSTR, 32, MP_STR8, _uw_binary_utf8_size(str))
+        && _uw_binary_write_utf8(out, str);
+}
+
+static bool encode_timestamp(_UwBinaryOutput* out, int64_t seconds, uint32_t nanoseconds)
+/*
+ * Write timestamp extension in the shortest form:
+ * 32 bits for seconds only, 64 bits for 34-bit seconds and nanoseconds,
+ * 96 bits for everything else.
+ */
+{
+    if (!_uw_binary_reserve(out, 15)) {
+        return false;
+    }
+    uint8_t* p = out->data + out->size;
+    if (seconds >= 0 && (seconds >> 34) == 0) {
+        if (nanoseconds == 0 && seconds <= UINT32_MAX) {
+            *p++ = MP_FIXEXT4;
+            *p++ = (uint8_t) EXT_TIMESTAMP;
+            p = _uw_binary_put_be32(p, (uint32_t) seconds);
+        } else {
+            *p++ = MP_FIXEXT8;
+            *p++ = (uint8_t) EXT_TIMESTAMP;
+            p = _uw_binary_put_be64(p, ((uint64_t) nanoseconds << 34) | (uint64_t) seconds);
+        }
+    } else {
+        *p++ = MP_EXT8;
+        *p++ = 12;
+        *p++ = (uint8_t) EXT_TIMESTAMP;
+        p = _uw_binary_put_be32(p, nanoseconds);
+        p = _uw_binary_put_be64(p, (uint64_t) seconds);
+    }
+    out->size = p - out->data;
+    return true;
+}
+
+static bool encode_array(_UwBinaryOutput* out, UwValuePtr value)
+{
+    unsigned num_items = uw_array_length(value);
+    if (!put_header(out, MP_FIXARRAY, 16, MP_ARRAY16, num_items)) {
+        return false;
+    }
+    for (unsigned i = 0; i < num_items; i++) {{
+        UwValue item = uw_array_item(value, i);
+        if (!encode_value(out, &item)) {
+            return false;
+        }
+    }}
+    return true;
+}
+
+static bool encode_map(_UwBinaryOutput* out, UwValuePtr value)
+{
+    unsigned num_items = uw_map_length(value);
+    if (!put_header(out, MP_FIXMAP, 16, MP_MAP16, num_items)) {
+        return false;
+    }
+    for (unsigned i = 0; i < num_items; i++) {{
+        UwValue k = UwNull();
+        UwValue v = UwNull();
+        uw_map_item(value, i, &k, &v);
+        if (!encode_value(out, &k) || !encode_value(out, &v)) {
+            return false;
+        }
+    }}
+    return true;
+}
+
+static bool encode_value(_UwBinaryOutput* out, UwValuePtr value)
+{
+    if (uw_is_null(value)) {
+        if (!_uw_binary_reserve(out, 1)) {
+            return false;
+        }
+        out->data[out->size++] = MP_NIL;
+        return true;
+    }
+    if (uw_is_bool(value)) {
+        if (!_uw_binary_reserve(out, 1)) {
+            return false;
+        }
+        out->data[out->size++] = value->bool_value? MP_TRUE : MP_FALSE;
+        return true;
+    }
+    if (uw_is_int(value)) {
+        return encode_int(out, value);
+    }
+    if (uw_is_float(value)) {
+        return encode_float(out, value->float_value);
+    }
+    if (uw_is_charptr(value) || uw_is_string(value)) {
+        return encode_string(out, value);
+    }
+    if (uw_is_array(value)) {
+        return encode_array(out, value);
+    }
+    if (uw_is_map(value)) {
+        return encode_map(out, value);
+    }
+    if (uw_is_timestamp(value)) {
+        if (value->ts_seconds > INT64_MAX) {
+            out->error = UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+            return false;
+        }
+        return encode_timestamp(out, (int64_t) value->ts_seconds, value->ts_nanoseconds);
+    }
+    if (uw_is_datetime(value)) {
+        return encode_timestamp(out, _uw_binary_datetime_to_epoch(value), value->nanosecond);
+    }
+    out->error = UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    return false;
+}
+
+UwResult uw_to_msgpack_write(UwValuePtr value, UwSink* sink)
+{
+    _UwBinaryOutput out;
+    if (_uw_binary_output_init(&out, sink)
+        && encode_value(&out, value)
+        && _uw_binary_flush(&out)) {
+
+        _uw_binary_output_fini(&out);
+        return UwOK();
+    }
+    UwValue status = uw_move(&out.error);
+    _uw_binary_output_fini(&out);
+    return uw_move(&status);
+}
+
+/****************************************************************
+ * Decoder
+ */
+
+// forward declaration
+static UwResult decode_object(_UwBinaryInput* in, unsigned depth);
+
+static inline bool need(_UwBinaryInput* in, size_t n)
+{
+    return in->size - in->position >= n;
+}
+
+static UwResult read_size(_UwBinaryInput* in, unsigned num_bytes, size_t* size)
+/*
+ * Read big-endian size of 1, 2, or 4 bytes.
+ */
+{
+    if (!need(in, num_bytes)) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    uint8_t* p = in->data + in->position;
+    switch (num_bytes) {
+        case 1: *size = *p; break;
+        case 2: *size = _uw_binary_get_be16(p); break;
+        default: *size = _uw_binary_get_be32(p); break;
+    }
+    in->position += num_bytes;
+    return UwOK();
+}
+
+static UwResult decode_str(_UwBinaryInput* in, size_t size)
+{
+    if (!need(in, size)) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    UwValue result = _uw_binary_decode_string(in, in->position, size);
+    uw_return_if_error(&result);
+    in->position += size;
+    return uw_move(&result);
+}
+
+static UwResult decode_array(_UwBinaryInput* in, size_t num_items, unsigned depth)
+{
+    // each item takes at least one byte
+    if (!need(in, num_items)) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    UwValue result = UwArray();
+    uw_return_if_error(&result);
+    if (num_items) {
+        uw_expect_ok( uw_array_resize(&result, (unsigned) num_items) );
+    }
+    for (size_t i = 0; i < num_items; i++) {{
+        UwValue item = decode_object(in, depth + 1);
+        uw_return_if_error(&item);
+        uw_expect_ok( uw_array_append_va(&result, uw_move(&item)) );
+    }}
+    return uw_move(&result);
+}
+
+static UwResult decode_map(_UwBinaryInput* in, size_t num_items, unsigned depth)
+{
+    // each key and value take at least one byte
+    if (num_items > (in->size - in->position) / 2) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    UwValue result = UwMap();
+    uw_return_if_error(&result);
+    for (size_t i = 0; i < num_items; i++) {{
+        UwValue key = decode_object(in, depth + 1);
+        uw_return_if_error(&key);
+        UwValue value = decode_object(in, depth + 1);
+        uw_return_if_error(&value);
+        uw_expect_ok( uw_map_update_va(&result, uw_move(&key), uw_move(&value)) );
+    }}
+    return uw_move(&result);
+}
+
+static UwResult decode_ext(_UwBinaryInput* in, size_t position, size_t size)
+{
+    if (!need(in, size + 1)) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    uint8_t* p = in->data + in->position;
+    if ((int8_t) *p != EXT_TIMESTAMP) {
+        return _uw_binary_error(in, position, "unsupported extension type");
+    }
+    p++;
+    int64_t seconds;
+    uint32_t nanoseconds;
+    switch (size) {
+        case 4:
+            seconds = _uw_binary_get_be32(p);
+            nanoseconds = 0;
+            break;
+        case 8: {
+            uint64_t n = _uw_binary_get_be64(p);
+            seconds = n & ((1ULL << 34) - 1);
+            nanoseconds = n >> 34;
+            break;
+        }
+        case 12:
+            nanoseconds = _uw_binary_get_be32(p);
+            seconds = (int64_t) _uw_binary_get_be64(p + 4);
+            break;
+        default:
+            return _uw_binary_error(in, position, "bad timestamp size");
+    }
+    if (nanoseconds > 999'999'999) {
+        return _uw_binary_error(in, position, "bad timestamp nanoseconds");
+    }
+    if (seconds < 0) {
+        // Timestamp cannot hold moments before the epoch, use UTC DateTime
+        UwValue result = UwNull();
+        if (!_uw_binary_epoch_to_datetime(seconds, nanoseconds, &result)) {
+            return _uw_binary_error(in, position, "timestamp is out of range");
+        }
+        in->position += size + 1;
+        return uw_move(&result);
+    }
+    in->position += size + 1;
+
+    UwValue result = UwTimestamp();
+    result.ts_seconds = seconds;
+    result.ts_nanoseconds = nanoseconds;
+    return uw_move(&result);
+}
+
+static UwResult decode_object(_UwBinaryInput* in, unsigned depth)
+{
+    if (depth > UW_BINARY_MAX_DEPTH) {
+        return _uw_binary_error(in, in->position, "nesting is too deep");
+    }
+    if (!need(in, 1)) {
+        return _uw_binary_error(in, in->size, "unexpected end of data");
+    }
+    size_t position = in->position;
+    uint8_t format = in->data[in->position++];
+
+    if (format < MP_FIXMAP) {
+        return UwSigned(format);
+    }
+    if (format >= 0xE0) {
+        return UwSigned((int8_t) format);
+    }
+    if (format < MP_FIXARRAY) {
+        return decode_map(in, format & 0x0F, depth);
+    }
+    if (format < MP_FIXSTR) {
+        return decode_array(in, format & 0x0F, depth);
+    }
+    if (format < MP_NIL) {
+        return decode_str(in, format & 0x1F);
+    }
+
+    // fixed size scalars
+    static const uint8_t scalar_sizes[] = {
+        [MP_FLOAT32 - MP_FLOAT32] = 4, [MP_FLOAT64 - MP_FLOAT32] = 8,
+        [MP_UINT8   - MP_FLOAT32] = 1, [MP_UINT16  - MP_FLOAT32] = 2, [MP_UINT32 - MP_FLOAT32] = 4, [MP_UINT64 - MP_FLOAT32] = 8,
+        [MP_INT8    - MP_FLOAT32] = 1, [MP_INT16   - MP_FLOAT32] = 2, [MP_INT32  - MP_FLOAT32] = 4, [MP_INT64  - MP_FLOAT32] = 8
+    };
+    if (format >= MP_FLOAT32 && format <= MP_INT64) {
+        unsigned n = scalar_sizes[format - MP_FLOAT32];
+        if (!need(in, n)) {
+            return _uw_binary_error(in, in->size, "unexpected end of data");
+        }
+        uint8_t* p = in->data + in->position;
+        in->position += n;
+        uint64_t bits;
+        switch (n) {
+            case 1: bits = *p; break;
+            case 2: bits = _uw_binary_get_be16(p); break;
+            case 4: bits = _uw_binary_get_be32(p); break;
+            default: bits = _uw_binary_get_be64(p); break;
+        }
+        switch (format) {
+            case MP_FLOAT32: {
+                uint32_t bits32 = (uint32_t) bits;
+                float f;
+                memcpy(&f, &bits32, 4);
+                return UwFloat(f);
+            }
+            case MP_FLOAT64: {
+                double f;
+                memcpy(&f, &bits, 8);
+                return UwFloat(f);
+            }
+            case MP_UINT64:
+                if (bits > INT64_MAX) {
+                    return UwUnsigned(bits);
+                }
+                return UwSigned((int64_t) bits);
+            case MP_UINT8:
+            case MP_UINT16:
+            case MP_UINT32:
+                return UwSigned((int64_t) bits);
+            case MP_INT8:  return UwSigned((int8_t)  bits);
+            case MP_INT16: return UwSigned((int16_t) bits);
+            case MP_INT32: return UwSigned((int32_t) bits);
+            default:    return UwSigned((int64_t) bits);
+        }
+    }
+
+    size_t size;
+    switch (format) {
+        case MP_NIL:
+            return UwNull();
+        case MP_FALSE:
+            return UwBool(false);
+        case MP_TRUE:
+            return UwBool(true);
+
+        case MP_BIN8:
+        case MP_BIN16:
+        case MP_BIN32:
+            return _uw_binary_error(in, position, "bin format is not supported");
+
+        case MP_EXT8:
+        case MP_EXT16:
+        case MP_EXT32:
+            uw_expect_ok( read_size(in, 1 << (format - MP_EXT8), &size) );
+            return decode_ext(in, position, size);
+
+        case MP_FIXEXT1:
+        case MP_FIXEXT2:
+        case MP_FIXEXT4:
+        case MP_FIXEXT8:
+        case MP_FIXEXT16:
+            return decode_ext(in, position, 1 << (format - MP_FIXEXT1));
+
+        case MP_STR8:
+        case MP_STR16:
+        case MP_STR32:
+            uw_expect_ok( read_size(in, 1 << (format - MP_STR8), &size) );
+            return decode_str(in, size);
+
+        case MP_ARRAY16:
+        case MP_ARRAY32:
+            uw_expect_ok( read_size(in, 2 << (format - MP_ARRAY16), &size) );
+            return decode_array(in, size, depth);
+
+        case MP_MAP16:
+        case MP_MAP32:
+            uw_expect_ok( read_size(in, 2 << (format - MP_MAP16), &size) );
+            return decode_map(in, size, depth);
+
+        default:
+            return _uw_binary_error(in, position, "never used format byte");
+    }
+}
+
+UwResult uw_from_msgpack_buffer(uint8_t* data, size_t size)
+{
+    _UwBinaryInput input = {
+        .data = data,
+        .size = size
+    };
+    UwValue result = decode_object(&input, 1);
+    uw_return_if_error(&result);
+
+    if (input.position != input.size) {
+        return _uw_binary_error(&input, input.position, "extra data after MessagePack object");
+    }
+    return uw_move(&result);
+}
+
+UwResult uw_from_msgpack(UwValuePtr file)
+{
+    if (!uw_is_file(file)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    return _uw_binary_decode_file(file, uw_from_msgpack_buffer);
+}
@@ -0,0 +1,426 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/uw_ndjson.h"
+#include "src/uw_json_internal.h"
+#include "src/uw_struct_internal.h"
+
+#define DEFAULT_BATCH_SIZE  256
+
+typedef struct {
+    // lines in UTF-8, filled by the reading thread
+    char8_t*  data;
+    unsigned  data_size;
+    unsigned  data_capacity;
+    unsigned* offsets;       // start of each line in data, plus the end of the last one
+    unsigned* line_numbers;
+    unsigned  num_lines;
+
+    // parsed lines, filled by worker
+    _UwValue* records;
+    bool      done;
+} Batch;
+
+typedef struct {
+    _UwValue line_reader;
+    UwInterface_LineReader* line_reader_iface;  // looked up once for the reading loop
+    bool     reading_lines;
+    unsigned batch_size;
+    unsigned queue_size;
+
+    // ring of batches, the slot of a batch is its sequence number modulo queue_size
+    Batch*   batches;
+    uint64_t num_submitted;  // batches handed to workers
+    uint64_t num_taken;      // batches taken by workers
+    uint64_t num_delivered;  // batches entirely returned to the caller
+    unsigned next_record;    // in the oldest batch
+    unsigned line_number;    // of the last returned record
+
+    bool     eof;
+    _UwValue read_status;    // fatal error of line reader, returned after all records
+
+    // worker pool
+    pthread_t* threads;
+    unsigned   num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t  submit_cond;
+    pthread_cond_t  done_cond;
+    bool shutdown;
+} _UwNdjsonReader;
+
+#define get_data_ptr(value)  ((_UwNdjsonReader*) _uw_get_data_ptr((value), UwTypeId_NdjsonReader))
+
+/****************************************************************
+ * Workers
+ */
+
+static void parse_batch(Batch* batch)
+{
+    for (unsigned i = 0; i < batch->num_lines; i++) {
+        unsigned start = batch->offsets[i];
+        unsigned end = batch->offsets[i + 1];
+        batch->records[i] = _uw_json_parse_buffer(batch->data + start, end - start, batch->line_numbers[i]);
+    }
+}
+
+static void* worker_thread(void* arg)
+{
+    _UwNdjsonReader* r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (r->num_taken == r->num_submitted && !r->shutdown) {
+            pthread_cond_wait(&r->submit_cond, &r->lock);
+        }
+        if (r->shutdown) {
+            break;
+        }
+        Batch* batch = &r->batches[r->num_taken++ % r->queue_size];
+        pthread_mutex_unlock(&r->lock);
+
+        parse_batch(batch);
+
+        pthread_mutex_lock(&r->lock);
+        batch->done = true;
+        pthread_cond_signal(&r->done_cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return nullptr;
+}
+
+static void pool_fini(_UwNdjsonReader* r)
+{
+    if (!r->threads) {
+        return;
+    }
+    pthread_mutex_lock(&r->lock);
+    r->shutdown = true;
+    pthread_cond_broadcast(&r->submit_cond);
+    pthread_mutex_unlock(&r->lock);
+
+    for (unsigned i = 0; i < r->num_threads; i++) {
+        pthread_join(r->threads[i], nullptr);
+    }
+    release((void**) &r->threads, r->num_threads * sizeof(pthread_t));
+    r->threads = nullptr;
+
+    pthread_cond_destroy(&r->done_cond);
+    pthread_cond_destroy(&r->submit_cond);
+    pthread_mutex_destroy(&r->lock);
+}
+
+static UwResult pool_init(_UwNdjsonReader* r)
+{
+    r->threads = allocate(r->num_threads * sizeof(pthread_t), false);
+    if (!r->threads) {
+        return UwOOM();
+    }
+    pthread_mutex_init(&r->lock, nullptr);
+    pthread_cond_init(&r->submit_cond, nullptr);
+    pthread_cond_init(&r->done_cond, nullptr);
+
+    for (unsigned i = 0; i < r->num_threads; i++) {
+        int rc = pthread_create(&r->threads[i], nullptr, worker_thread, r);
+        if (rc) {
+            // shut down threads created so far
+            r->num_threads = i;
+            pool_fini(r);
+            return UwErrno(rc);
+        }
+    }
+    return UwOK();
+}
+
+/****************************************************************
+ * Batches
+ */
+
+static void reset_batch(Batch* batch)
+{
+    for (unsigned i = 0; i < batch->num_lines; i++) {
+        uw_destroy(&batch->records[i]);
+    }
+    batch->num_lines = 0;
+    batch->data_size = 0;
+    batch->done = false;
+}
+
+static UwResult append_line(Batch* batch, UwLineView* view, unsigned line_number)
+/*
+ * Append line to the batch, converting it to UTF-8.
+ * Skip empty lines.
+ */
+{
+    // reserve space for the worst case
+
+    static const unsigned max_utf8_size[5] = { 0, 2, 3, 4, 4 };
+    unsigned reserve = view->length * max_utf8_size[view->char_size];
+    if (batch->data_capacity - batch->data_size < reserve) {
+        unsigned new_capacity = batch->data_capacity? batch->data_capacity : 4096;
+        while (new_capacity - batch->data_size < reserve) {
+            new_capacity *= 2;
+        }
+        char8_t* new_data = allocate(new_capacity, false);
+        if (!new_data) {
+            return UwOOM();
+        }
+        if (batch->data) {
+            memcpy(new_data, batch->data, batch->data_size);
+            release((void**) &batch->data, batch->data_capacity);
+        }
+        batch->data = new_data;
+        batch->data_capacity = new_capacity;
+    }
+
+    // convert
+
+    char8_t* start = batch->data + batch->data_size;
+    char8_t* p = start;
+    bool empty = true;
+    if (view->char_size == 1) {
+        for (unsigned i = 0; i < view->length; i++) {
+            char8_t c = view->ptr[i];
+            if (c < 0x80) {
+                *p++ = c;
+                empty = empty && _uw_json_is_whitespace(c);
+            } else {
+                p = (char8_t*) uw_char32_to_utf8(c, (char*) p);
+                empty = false;
+            }
+        }
+    } else {
+        uint8_t* ptr = view->ptr;
+        for (unsigned i = 0; i < view->length; i++) {
+            char32_t c = _uw_get_char(ptr, view->char_size);
+            ptr += view->char_size;
+            p = (char8_t*) uw_char32_to_utf8(c, (char*) p);
+            empty = empty && c < 0x80 && _uw_json_is_whitespace((char8_t) c);
+        }
+    }
+    if (empty) {
+        return UwOK();
+    }
+    // strip line terminator to report errors at the end of data within the line
+    while (p > start && (p[-1] == '\n' || p[-1] == '\r')) {
+        p--;
+    }
+    batch->data_size += p - start;
+    batch->line_numbers[batch->num_lines++] = line_number;
+    batch->offsets[batch->num_lines] = batch->data_size;
+    return UwOK();
+}
+
+static void fill_batches(_UwNdjsonReader* r)
+/*
+ * Read lines and submit batches until the queue is full.
+ */
+{
+    while (!r->eof && r->num_submitted - r->num_delivered < r->queue_size) {
+        Batch* batch = &r->batches[r->num_submitted % r->queue_size];
+        batch->offsets[0] = 0;
+        while (batch->num_lines < r->batch_size) {{
+            UwLineView view;
+            UwValue status = r->line_reader_iface->read_line_view(&r->line_reader, &view);
+            if (uw_ok(&status)) {
+                status = append_line(batch, &view, r->line_reader_iface->get_line_number(&r->line_reader));
+            }
+            if (uw_error(&status)) {
+                r->eof = true;
+                if (!uw_eof(&status)) {
+                    r->read_status = uw_move(&status);
+                }
+                break;
+            }
+        }}
+        if (batch->num_lines == 0) {
+            break;
+        }
+        pthread_mutex_lock(&r->lock);
+        r->num_submitted++;
+        pthread_cond_signal(&r->submit_cond);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+/****************************************************************
+ * Basic interface methods
+ */
+
+static void ndjson_reader_fini(UwValuePtr self)
+{
+    _UwNdjsonReader* r = get_data_ptr(self);
+
+    pool_fini(r);
+
+    if (r->batches) {
+        for (unsigned i = 0; i < r->queue_size; i++) {
+            Batch* batch = &r->batches[i];
+            reset_batch(batch);
+            if (batch->data) {
+                release((void**) &batch->data, batch->data_capacity);
+            }
+            release((void**) &batch->offsets, (r->batch_size + 1) * sizeof(unsigned));
+            release((void**) &batch->line_numbers, r->batch_size * sizeof(unsigned));
+            release((void**) &batch->records, r->batch_size * sizeof(_UwValue));
+        }
+        release((void**) &r->batches, r->queue_size * sizeof(Batch));
+    }
+    uw_destroy(&r->read_status);
+
+    if (r->reading_lines) {
+        uw_stop_read_lines(&r->line_reader);
+    }
+    uw_destroy(&r->line_reader);
+}
+
+static UwResult ndjson_reader_init(UwValuePtr self, void* ctor_args)
+{
+    UwNdjsonReaderCtorArgs* args = ctor_args;
+    _UwNdjsonReader* r = get_data_ptr(self);
+
+    if (!args || !args->line_reader || !_uw_has_interface(args->line_reader->type_id, UwInterfaceId_LineReader)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    r->num_threads = args->num_workers;
+    if (r->num_threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        r->num_threads = (n > 0)? (unsigned) n : 1;
+    }
+    r->queue_size = args->queue_size? args->queue_size : 2 * r->num_threads;
+    r->batch_size = args->batch_size? args->batch_size : DEFAULT_BATCH_SIZE;
+
+    r->batches = allocate(r->queue_size * sizeof(Batch), true);
+    if (!r->batches) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < r->queue_size; i++) {
+        Batch* batch = &r->batches[i];
+        batch->offsets = allocate((r->batch_size + 1) * sizeof(unsigned), false);
+        batch->line_numbers = allocate(r->batch_size * sizeof(unsigned), false);
+        batch->records = allocate(r->batch_size * sizeof(_UwValue), true);
+        if (!batch->offsets || !batch->line_numbers || !batch->records) {
+            return UwOOM();
+        }
+    }
+
+    r->line_reader = uw_clone(args->line_reader);
+    r->line_reader_iface = uw_interface(r->line_reader.type_id, LineReader);
+    uw_expect_ok( uw_start_read_lines(&r->line_reader) );
+    r->reading_lines = true;
+
+    return pool_init(r);
+}
+
+/****************************************************************
+ * NdjsonReader type
+ */
+
+static UwType ndjson_reader_type;
+
+UwTypeId UwTypeId_NdjsonReader = 0;
+
+[[ gnu::constructor ]]
+static void init_ndjson_reader_type()
+{
+    if (UwTypeId_NdjsonReader == 0) {
+        UwTypeId_NdjsonReader = uw_subtype(
+            &ndjson_reader_type, "NdjsonReader", UwTypeId_Struct, _UwNdjsonReader
+        );
+        ndjson_reader_type.init = ndjson_reader_init;
+        ndjson_reader_type.fini = ndjson_reader_fini;
+    }
+}
+
+/****************************************************************
+ * NdjsonReader functions
+ */
+
+UwResult uw_create_ndjson_reader(UwValuePtr line_reader)
+{
+    UwNdjsonReaderCtorArgs args = { .line_reader = line_reader };
+    return uw_create2(UwTypeId_NdjsonReader, &args);
+}
+
+UwResult uw_ndjson_read(UwValuePtr reader)
+{
+    _UwNdjsonReader* r = get_data_ptr(reader);
+
+    for (;;) {
+        fill_batches(r);
+
+        if (r->num_delivered == r->num_submitted) {
+            if (uw_error(&r->read_status)) {
+                return uw_move(&r->read_status);
+            }
+            return UwError(UW_ERROR_EOF);
+        }
+
+        Batch* batch = &r->batches[r->num_delivered % r->queue_size];
+        if (r->next_record == 0) {
+            pthread_mutex_lock(&r->lock);
+            while (!batch->done) {
+                pthread_cond_wait(&r->done_cond, &r->lock);
+            }
+            pthread_mutex_unlock(&r->lock);
+        }
+        if (r->next_record < batch->num_lines) {
+            unsigned i = r->next_record++;
+            r->line_number = batch->line_numbers[i];
+            return uw_move(&batch->records[i]);
+        }
+        reset_batch(batch);
+        r->next_record = 0;
+        r->num_delivered++;
+    }
+}
+
+unsigned uw_ndjson_line_number(UwValuePtr reader)
+{
+    return get_data_ptr(reader)->line_number;
+}
+
+UwResult uw_ndjson_read_batch(UwValuePtr reader, unsigned max_records, UwValuePtr errors)
+{
+    UwValue result = uw_create(UwTypeId_Array);
+    uw_return_if_error(&result);
+
+    while (uw_array_length(&result) < max_records) {{
+        UwValue record = uw_ndjson_read(reader);
+        if (uw_error(&record)) {
+            if (uw_eof(&record)) {
+                if (uw_array_length(&result) == 0) {
+                    return uw_move(&record);
+                }
+                break;
+            }
+            if (record.status_code != UW_ERROR_JSON_SYNTAX) {
+                return uw_move(&record);
+            }
+            if (errors) {
+                UwValue line_number = UwUnsigned(uw_ndjson_line_number(reader));
+                UwValue description = uw_clone(&record.status_data->description);
+                uw_expect_ok( uw_map_update_va(errors, uw_move(&line_number), uw_move(&description)) );
+            }
+            continue;
+        }
+        uw_expect_ok( uw_array_append_va(&result, uw_move(&record)) );
+    }}
+    return uw_move(&result);
+}
+
+UwResult uw_ndjson_process(UwValuePtr reader, UwNdjsonHandler handler, void* arg)
+{
+    for (;;) {{
+        UwValue record = uw_ndjson_read(reader);
+        if (uw_error(&record)) {
+            if (uw_eof(&record)) {
+                return UwOK();
+            }
+            if (record.status_code != UW_ERROR_JSON_SYNTAX) {
+                return uw_move(&record);
+            }
+        }
+        uw_expect_ok( handler(&record, uw_ndjson_line_number(reader), arg) );
+    }}
+}
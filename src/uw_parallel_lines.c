@@ -0,0 +1,237 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/uw_parallel_lines.h"
+
+#define SCAN_BUFFER_SIZE  4096
+
+typedef struct {
+    pthread_t thread;
+    bool      started;
+    char*     file_name;
+    uint64_t  start;
+    uint64_t  end;
+    UwParallelLines* params;
+    _UwValue  partial;
+    _UwValue  status;
+} Worker;
+
+/****************************************************************
+ * Splitting
+ */
+
+static UwResult find_line_end(UwValuePtr file, uint64_t offset, uint64_t file_size, uint64_t* line_end)
+/*
+ * Find the end of line the byte at `offset` belongs to
+ * and write the offset of the next line to `line_end`.
+ */
+{
+    char8_t buffer[SCAN_BUFFER_SIZE];
+    while (offset < file_size) {
+        unsigned bytes_read;
+        uw_expect_ok( uw_file_pread(file, buffer, SCAN_BUFFER_SIZE, offset, &bytes_read) );
+        if (bytes_read == 0) {
+            // file truncated?
+            break;
+        }
+        char8_t* lf = memchr(buffer, '\n', bytes_read);
+        if (lf) {
+            *line_end = offset + (lf - buffer) + 1;
+            return UwOK();
+        }
+        offset += bytes_read;
+    }
+    *line_end = file_size;
+    return UwOK();
+}
+
+UwResult uw_file_split_lines(UwValuePtr file_name, unsigned num_chunks)
+{
+    uw_assert(num_chunks > 0);
+
+    UwValue file_size = uw_file_size(file_name);
+    uw_return_if_error(&file_size);
+    uint64_t size = file_size.unsigned_value;
+
+    UwValue file = uw_file_open(file_name, O_RDONLY, 0);
+    uw_return_if_error(&file);
+
+    UwValue result = uw_create(UwTypeId_Array);
+    uw_return_if_error(&result);
+    uw_expect_ok( uw_array_resize(&result, num_chunks + 1) );
+
+    uw_expect_ok( uw_array_append(&result, 0u) );
+
+    uint64_t prev_offset = 0;
+    for (unsigned i = 1; i < num_chunks; i++) {
+        uint64_t offset = size * i / num_chunks;
+        if (offset <= prev_offset) {
+            // previous line is longer than chunk
+            offset = prev_offset;
+        } else {
+            // start scanning from the preceding byte to catch line break right before offset
+            uw_expect_ok( find_line_end(&file, offset - 1, size, &offset) );
+        }
+        uw_expect_ok( uw_array_append(&result, (unsigned long long) offset) );
+        prev_offset = offset;
+    }
+    uw_expect_ok( uw_array_append(&result, (unsigned long long) size) );
+
+    return uw_move(&result);
+}
+
+/****************************************************************
+ * Workers
+ */
+
+static UwResult process_chunk(Worker* worker)
+{
+    // this function runs on a worker thread,
+    // all values it creates must not leak to other threads except partial result
+
+    UwValue file = uw_file_open(worker->file_name, O_RDONLY, 0);
+    uw_return_if_error(&file);
+
+    uw_file_set_line_range(&file, worker->start, worker->end);
+    uw_expect_ok( uw_start_read_lines(&file) );
+
+    UwValue status = worker->params->process_chunk(&file, &worker->partial, worker->params->arg);
+    uw_stop_read_lines(&file);
+    return uw_move(&status);
+}
+
+static void* worker_thread(void* arg)
+{
+    Worker* worker = arg;
+    worker->status = process_chunk(worker);
+    return nullptr;
+}
+
+/****************************************************************
+ * Merging
+ */
+
+static UwResult merge_arrays(UwValuePtr result, UwValuePtr partial)
+{
+    unsigned n = uw_array_length(partial);
+    uw_expect_ok( uw_array_resize(result, uw_array_length(result) + n) );
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue item = uw_array_item(partial, i);
+        uw_expect_ok( uw_array_append(result, &item) );
+    }}
+    return UwOK();
+}
+
+static UwResult merge_maps(UwValuePtr result, UwValuePtr partial, UwParallelLines* params)
+{
+    unsigned n = uw_map_length(partial);
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        uw_map_item(partial, i, &key, &value);
+
+        if (params->merge_values) {
+            UwValue merged_value = uw_map_get(result, &key);
+            if (uw_ok(&merged_value)) {
+                UwValue new_value = params->merge_values(&key, &merged_value, &value, params->arg);
+                uw_return_if_error(&new_value);
+                uw_expect_ok( uw_map_update(result, &key, &new_value) );
+                continue;
+            }
+        }
+        uw_expect_ok( uw_map_update(result, &key, &value) );
+    }}
+    return UwOK();
+}
+
+/****************************************************************
+ * Main function
+ */
+
+UwResult uw_file_process_lines_parallel(UwValuePtr file_name, UwParallelLines* params)
+{
+    unsigned num_workers = params->num_workers;
+    if (num_workers == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        num_workers = (n > 0)? (unsigned) n : 1;
+    }
+    UwTypeId partial_type = params->partial_type;
+    if (partial_type == UwTypeId_Null) {
+        partial_type = UwTypeId_Array;
+    }
+    uw_assert(partial_type == UwTypeId_Array || partial_type == UwTypeId_Map);
+
+    UwValue boundaries = uw_file_split_lines(file_name, num_workers);
+    uw_return_if_error(&boundaries);
+
+    // workers open the file by name, C string is safe to share between threads
+    UwValue name = uw_clone(file_name);  // this converts CharPtr to string
+    UW_CSTRING_LOCAL(c_file_name, &name);
+
+    Worker workers[num_workers];
+    memset(workers, 0, sizeof(workers));
+
+    UwValue status = UwOK();
+    for (unsigned i = 0; i < num_workers; i++) {{
+        Worker* worker = &workers[i];
+        worker->file_name = c_file_name;
+        worker->params = params;
+
+        UwValue start = uw_array_item(&boundaries, i);
+        UwValue end = uw_array_item(&boundaries, i + 1);
+        worker->start = start.unsigned_value;
+        worker->end = end.unsigned_value;
+
+        worker->partial = uw_create(partial_type);
+        if (uw_error(&worker->partial)) {
+            status = uw_move(&worker->partial);
+            break;
+        }
+        if (worker->start == worker->end) {
+            // empty chunk
+            continue;
+        }
+        int rc = pthread_create(&worker->thread, nullptr, worker_thread, worker);
+        if (rc) {
+            status = UwErrno(rc);
+            break;
+        }
+        worker->started = true;
+    }}
+
+    // wait for all workers, even if some of them failed to start
+    for (unsigned i = 0; i < num_workers; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, nullptr);
+        }
+    }
+
+    // merge partial results in order of chunks
+
+    UwValue result = UwNull();
+    for (unsigned i = 0; i < num_workers; i++) {{
+        Worker* worker = &workers[i];
+        UwValue partial = uw_move(&worker->partial);
+        UwValue worker_status = uw_move(&worker->status);
+
+        if (uw_error(&status)) {
+            continue;
+        }
+        if (uw_error(&worker_status)) {
+            status = uw_move(&worker_status);
+            continue;
+        }
+        if (uw_is_null(&result)) {
+            result = uw_move(&partial);
+            continue;
+        }
+        if (partial_type == UwTypeId_Array) {
+            status = merge_arrays(&result, &partial);
+        } else {
+            status = merge_maps(&result, &partial, params);
+        }
+    }}
+    uw_return_if_error(&status);
+    return uw_move(&result);
+}
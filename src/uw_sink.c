@@ -0,0 +1,140 @@
+#ifndef _GNU_SOURCE
+//  for fopencookie
+#   define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "include/uw_sink.h"
+
+#define BUFFER_INITIAL_CAPACITY  4096
+
+/****************************************************************
+ * FileWriter sink
+ */
+
+static UwResult writer_write(UwSink* sink, void* data, unsigned size)
+{
+    char8_t* ptr = data;
+    while (size) {
+        unsigned bytes_written = 0;
+        uw_expect_ok( uw_file_write(sink->writer, ptr, size, &bytes_written) );
+        if (bytes_written == 0) {
+            return UwErrno(EIO);
+        }
+        ptr += bytes_written;
+        size -= bytes_written;
+    }
+    return UwOK();
+}
+
+UwResult uw_sink_init_writer(UwSink* sink, UwValuePtr writer)
+{
+    if (!_uw_has_interface(writer->type_id, UwInterfaceId_FileWriter)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    *sink = (UwSink) {
+        .write  = writer_write,
+        .writer = writer
+    };
+    return UwOK();
+}
+
+/****************************************************************
+ * stdio sink
+ */
+
+static UwResult stdio_write(UwSink* sink, void* data, unsigned size)
+{
+    if (size && fwrite(data, 1, size, sink->fp) != size) {
+        return UwErrno(errno);
+    }
+    return UwOK();
+}
+
+void uw_sink_init_stdio(UwSink* sink, FILE* fp)
+{
+    *sink = (UwSink) {
+        .write = stdio_write,
+        .fp    = fp
+    };
+}
+
+/****************************************************************
+ * Memory buffer sink
+ */
+
+static UwResult buffer_write(UwSink* sink, void* data, unsigned size)
+{
+    if (sink->capacity - sink->size < size) {
+        unsigned new_capacity = sink->capacity? sink->capacity : BUFFER_INITIAL_CAPACITY;
+        while (new_capacity - sink->size < size) {
+            if (new_capacity > UINT_MAX / 2) {
+                return UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+            }
+            new_capacity *= 2;
+        }
+        if (!sink->data) {
+            sink->data = allocate(new_capacity, false);
+            if (!sink->data) {
+                return UwOOM();
+            }
+        } else if (!reallocate((void**) &sink->data, sink->capacity, new_capacity, false, nullptr)) {
+            return UwOOM();
+        }
+        sink->capacity = new_capacity;
+    }
+    memcpy(sink->data + sink->size, data, size);
+    sink->size += size;
+    return UwOK();
+}
+
+void uw_sink_init_buffer(UwSink* sink)
+{
+    *sink = (UwSink) {
+        .write = buffer_write
+    };
+}
+
+void uw_sink_fini(UwSink* sink)
+{
+    if (sink->data) {
+        release((void**) &sink->data, sink->capacity);
+    }
+    sink->size = 0;
+    sink->capacity = 0;
+}
+
+/****************************************************************
+ * Dump
+ */
+
+static ssize_t cookie_write(void* cookie, const char* data, size_t size)
+{
+    UwSink* sink = cookie;
+    if (size > UINT_MAX) {
+        size = UINT_MAX;
+    }
+    UwValue status = uw_sink_write(sink, (void*) data, (unsigned) size);
+    if (uw_error(&status)) {
+        return -1;
+    }
+    return (ssize_t) size;
+}
+
+void uw_dump_sink(UwSink* sink, UwValuePtr value)
+{
+    if (sink->fp) {
+        uw_dump(sink->fp, value);
+        return;
+    }
+    // dump methods write to FILE, wrap the sink with a buffered stream
+    FILE* fp = fopencookie(sink, "w", (cookie_io_functions_t) { .write = cookie_write });
+    if (!fp) {
+        return;
+    }
+    uw_dump(fp, value);
+    fclose(fp);
+}
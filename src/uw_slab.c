@@ -0,0 +1,399 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "include/uw_helpers.h"
+#include "include/uw_slab.h"
+
+typedef struct _FreeBlock {
+    struct _FreeBlock* next;
+} FreeBlock;
+
+struct _ThreadCache;
+
+typedef struct {
+    struct _ThreadCache* owner;
+} SlabHeader;
+
+#define SLAB_HEADER_SIZE  16
+
+static_assert( sizeof(SlabHeader) <= SLAB_HEADER_SIZE );
+
+typedef struct {
+    FreeBlock*          free_list;    // accessed by owner thread only
+    char*               slab_ptr;     // next block to carve from current slab
+    char*               slab_end;
+    _Atomic(FreeBlock*) remote_free;  // blocks released by other threads
+} CacheClass;
+
+/*
+ * Size classes are multiples of granularity up to 128 bytes,
+ * then four classes per power of two.
+ */
+static unsigned class_sizes[] = {
+     16,  32,  48,  64,  80,  96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024
+};
+
+#define NUM_CLASSES  20  // up to UW_STRING_POOL_MAX_BLOCK_SIZE, the slab pool uses 16 of them
+
+static_assert( UW_LENGTH(class_sizes) == NUM_CLASSES );
+
+typedef struct _ThreadCache {
+    struct _ThreadCache* next;            // all caches of the pool
+    struct _ThreadCache* next_abandoned;  // caches of exited threads
+    atomic_size_t num_allocated;          // updated by owner only
+    atomic_size_t num_released;           // including blocks released to other caches
+    CacheClass    classes[NUM_CLASSES];
+} ThreadCache;
+
+typedef struct {
+    unsigned        id;  // index in thread_caches
+    unsigned        max_block_size;
+    pthread_mutex_t lock;
+    ThreadCache*    caches;
+    ThreadCache*    abandoned;
+    atomic_size_t   num_released;  // by threads without cache
+    AllocatorStats  stats;
+} SlabPool;
+
+// size class index by (nbytes - 1) / UW_SLAB_GRANULARITY
+static uint8_t class_index[UW_STRING_POOL_MAX_BLOCK_SIZE / UW_SLAB_GRANULARITY];
+
+[[ gnu::constructor ]]
+static void init_class_index()
+{
+    unsigned index = 0;
+    for (unsigned i = 0; i < UW_LENGTH(class_index); i++) {
+        if ((i + 1) * UW_SLAB_GRANULARITY > class_sizes[index]) {
+            index++;
+        }
+        class_index[i] = index;
+    }
+}
+
+static SlabPool slab_pool = {
+    .id             = 0,
+    .max_block_size = UW_SLAB_MAX_BLOCK_SIZE,
+    .lock           = PTHREAD_MUTEX_INITIALIZER
+};
+
+static SlabPool string_pool = {
+    .id             = 1,
+    .max_block_size = UW_STRING_POOL_MAX_BLOCK_SIZE,
+    .lock           = PTHREAD_MUTEX_INITIALIZER
+};
+
+static SlabPool* pools[] = { &slab_pool, &string_pool };
+
+static inline unsigned size_class_index(unsigned nbytes)
+{
+    return nbytes? class_index[(nbytes - 1) / UW_SLAB_GRANULARITY] : 0;
+}
+
+static inline void count(atomic_size_t* counter)
+/*
+ * Increment counter that has single writer.
+ */
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/****************************************************************
+ * Thread caches
+ *
+ * Each thread allocates blocks from its own cache, which owns slabs
+ * it has carved. Blocks are released to the cache that owns their slab:
+ * directly to the free list if it's the cache of the current thread,
+ * or through lock-free remote queue otherwise. The owner takes
+ * the whole remote queue when its free list is exhausted.
+ *
+ * When thread exits, its cache is abandoned and adopted by the next new thread.
+ */
+
+static thread_local ThreadCache* thread_caches[UW_LENGTH(pools)];
+static thread_local bool thread_caches_registered = false;
+
+static pthread_key_t thread_caches_key;
+static pthread_once_t thread_caches_key_once = PTHREAD_ONCE_INIT;
+
+static void thread_caches_destructor(void* caches)
+/*
+ * Other TLS destructors may run after this one. Blocks they release
+ * go to remote queues, and if they allocate, the new cache is
+ * registered again and abandoned on the next destructor iteration.
+ */
+{
+    thread_caches_registered = false;
+    for (unsigned i = 0; i < UW_LENGTH(pools); i++) {
+        ThreadCache* cache = ((ThreadCache**) caches)[i];
+        if (cache) {
+            // forget the cache before another thread can adopt it
+            ((ThreadCache**) caches)[i] = nullptr;
+            SlabPool* pool = pools[i];
+            pthread_mutex_lock(&pool->lock);
+            cache->next_abandoned = pool->abandoned;
+            pool->abandoned = cache;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+}
+
+static void make_thread_caches_key()
+{
+    pthread_key_create(&thread_caches_key, thread_caches_destructor);
+}
+
+[[ gnu::noinline ]]
+static ThreadCache* create_thread_cache(SlabPool* pool)
+{
+    if (!thread_caches_registered) {
+        // the key is needed only to call destructor
+        pthread_once(&thread_caches_key_once, make_thread_caches_key);
+        pthread_setspecific(thread_caches_key, thread_caches);
+        thread_caches_registered = true;
+    }
+    pthread_mutex_lock(&pool->lock);
+    ThreadCache* cache = pool->abandoned;
+    if (cache) {
+        pool->abandoned = cache->next_abandoned;
+    } else {
+        cache = mmap(nullptr, sizeof(ThreadCache), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (cache == MAP_FAILED) {
+            pthread_mutex_unlock(&pool->lock);
+            return nullptr;
+        }
+        cache->next = pool->caches;
+        pool->caches = cache;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    thread_caches[pool->id] = cache;
+    return cache;
+}
+
+static inline ThreadCache* get_thread_cache(SlabPool* pool)
+{
+    ThreadCache* cache = thread_caches[pool->id];
+    if (cache) {
+        return cache;
+    }
+    return create_thread_cache(pool);
+}
+
+static void* map_slab()
+/*
+ * Map slab aligned to its size, so slab header can be found by block address.
+ */
+{
+    char* region = mmap(nullptr, UW_SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return nullptr;
+    }
+    char* slab = (char*) (((uintptr_t) region + UW_SLAB_SIZE - 1) & ~(uintptr_t) (UW_SLAB_SIZE - 1));
+    if (slab > region) {
+        munmap(region, slab - region);
+    }
+    munmap(slab + UW_SLAB_SIZE, region + UW_SLAB_SIZE - slab);
+    return slab;
+}
+
+static void* carve_block(ThreadCache* cache, CacheClass* cc, unsigned block_size)
+{
+    if (cc->slab_ptr == cc->slab_end) {
+        // slab size is not always a multiple of block size, the tail is not used
+        char* slab = map_slab();
+        if (!slab) {
+            return nullptr;
+        }
+        ((SlabHeader*) slab)->owner = cache;
+
+        cc->slab_ptr = slab + SLAB_HEADER_SIZE;
+        cc->slab_end = cc->slab_ptr + (UW_SLAB_SIZE - SLAB_HEADER_SIZE) / block_size * block_size;
+    }
+    void* block = cc->slab_ptr;
+    cc->slab_ptr += block_size;
+    return block;
+}
+
+static inline void push_remote(CacheClass* cc, FreeBlock* block)
+{
+    FreeBlock* head = atomic_load_explicit(&cc->remote_free, memory_order_relaxed);
+    do {
+        block->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&cc->remote_free, &head, block,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/****************************************************************
+ * Pools
+ */
+
+static inline void* pool_allocate(SlabPool* pool, unsigned nbytes, bool clean)
+{
+    if (nbytes > pool->max_block_size) {
+        return default_allocator.allocate(nbytes, clean);
+    }
+    ThreadCache* cache = get_thread_cache(pool);
+    if (!cache) {
+        return nullptr;
+    }
+    unsigned index = size_class_index(nbytes);
+    CacheClass* cc = &cache->classes[index];
+
+    FreeBlock* block = cc->free_list;
+    if (!block && atomic_load_explicit(&cc->remote_free, memory_order_relaxed)) {
+        // take blocks released by other threads
+        block = atomic_exchange_explicit(&cc->remote_free, nullptr, memory_order_acquire);
+    }
+    if (block) {
+        cc->free_list = block->next;
+    } else {
+        block = carve_block(cache, cc, class_sizes[index]);
+        if (!block) {
+            return nullptr;
+        }
+    }
+    count(&cache->num_allocated);
+    if (clean) {
+        memset(block, 0, nbytes);
+    }
+    return block;
+}
+
+static inline void pool_release(SlabPool* pool, void** addr_ptr, unsigned nbytes)
+{
+    if (!*addr_ptr) {
+        return;
+    }
+    if (nbytes > pool->max_block_size) {
+        default_allocator.release(addr_ptr, nbytes);
+        return;
+    }
+    FreeBlock* block = *addr_ptr;
+    *addr_ptr = nullptr;
+
+    SlabHeader* header = (SlabHeader*) ((uintptr_t) block & ~(uintptr_t) (UW_SLAB_SIZE - 1));
+    CacheClass* cc = &header->owner->classes[size_class_index(nbytes)];
+
+    // no need to create cache for releasing
+    ThreadCache* cache = thread_caches[pool->id];
+    if (cache == header->owner) {
+        block->next = cc->free_list;
+        cc->free_list = block;
+    } else {
+        push_remote(cc, block);
+    }
+    if (cache) {
+        count(&cache->num_released);
+    } else {
+        atomic_fetch_add_explicit(&pool->num_released, 1, memory_order_relaxed);
+    }
+}
+
+static inline bool pool_reallocate(SlabPool* pool, void** addr_ptr,
+                                   unsigned old_nbytes, unsigned new_nbytes, bool clean, unsigned* actual_nbytes)
+{
+    unsigned max_block_size = pool->max_block_size;
+    if (old_nbytes > max_block_size && new_nbytes > max_block_size) {
+        return default_allocator.reallocate(addr_ptr, old_nbytes, new_nbytes, clean, actual_nbytes);
+    }
+    if (*addr_ptr && old_nbytes <= max_block_size && new_nbytes <= max_block_size
+        && size_class_index(old_nbytes) == size_class_index(new_nbytes)) {
+
+        // same size class, nothing to move
+        if (clean && new_nbytes > old_nbytes) {
+            memset((char*) *addr_ptr + old_nbytes, 0, new_nbytes - old_nbytes);
+        }
+    } else {
+        void* new_block = pool_allocate(pool, new_nbytes, false);
+        if (!new_block) {
+            return false;
+        }
+        if (*addr_ptr) {
+            memcpy(new_block, *addr_ptr, (old_nbytes < new_nbytes)? old_nbytes : new_nbytes);
+            pool_release(pool, addr_ptr, old_nbytes);
+        } else {
+            old_nbytes = 0;
+        }
+        if (clean && new_nbytes > old_nbytes) {
+            memset((char*) new_block + old_nbytes, 0, new_nbytes - old_nbytes);
+        }
+        *addr_ptr = new_block;
+    }
+    if (actual_nbytes) {
+        *actual_nbytes = new_nbytes;
+    }
+    return true;
+}
+
+static void update_pool_stats(SlabPool* pool)
+{
+    size_t num_allocated = 0;
+    size_t num_released = atomic_load_explicit(&pool->num_released, memory_order_relaxed);
+    pthread_mutex_lock(&pool->lock);
+    for (ThreadCache* cache = pool->caches; cache; cache = cache->next) {
+        num_allocated += atomic_load_explicit(&cache->num_allocated, memory_order_relaxed);
+        num_released  += atomic_load_explicit(&cache->num_released, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pool->stats.blocks_allocated = num_allocated - num_released;
+}
+
+/****************************************************************
+ * Allocators
+ */
+
+static void* slab_allocate(unsigned nbytes, bool clean)
+{
+    return pool_allocate(&slab_pool, nbytes, clean);
+}
+
+static void slab_release(void** addr_ptr, unsigned nbytes)
+{
+    pool_release(&slab_pool, addr_ptr, nbytes);
+}
+
+static bool slab_reallocate(void** addr_ptr, unsigned old_nbytes, unsigned new_nbytes, bool clean, unsigned* actual_nbytes)
+{
+    return pool_reallocate(&slab_pool, addr_ptr, old_nbytes, new_nbytes, clean, actual_nbytes);
+}
+
+static void* string_pool_allocate(unsigned nbytes, bool clean)
+{
+    return pool_allocate(&string_pool, nbytes, clean);
+}
+
+static void string_pool_release(void** addr_ptr, unsigned nbytes)
+{
+    pool_release(&string_pool, addr_ptr, nbytes);
+}
+
+static bool string_pool_reallocate(void** addr_ptr, unsigned old_nbytes, unsigned new_nbytes, bool clean, unsigned* actual_nbytes)
+{
+    return pool_reallocate(&string_pool, addr_ptr, old_nbytes, new_nbytes, clean, actual_nbytes);
+}
+
+Allocator uw_slab_allocator = {
+    .allocate   = slab_allocate,
+    .release    = slab_release,
+    .reallocate = slab_reallocate,
+    .stats      = &slab_pool.stats
+};
+
+Allocator uw_string_pool_allocator = {
+    .allocate   = string_pool_allocate,
+    .release    = string_pool_release,
+    .reallocate = string_pool_reallocate,
+    .stats      = &string_pool.stats
+};
+
+void uw_slab_update_stats()
+{
+    update_pool_stats(&slab_pool);
+    update_pool_stats(&string_pool);
+}
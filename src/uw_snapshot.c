@@ -0,0 +1,649 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/uw_snapshot.h"
+#include "src/uw_binary_internal.h"
+#include "src/uw_map_internal.h"
+
+/*
+ * File layout:
+ *
+ *   - blocks, starting from offset 0, each block is BlockHeader followed by
+ *     string data, array or map laid out exactly as in memory;
+ *     pointers are absolute, as if the file was mapped at the base address;
+ *   - offsets of maps, their hash tables need getter and setter functions;
+ *   - trailer.
+ *
+ * Blocks are written in the order their offsets are assigned,
+ * containers are traversed breadth-first.
+ */
+
+#define SNAPSHOT_MAGIC       "UWSNAP\r\n"
+#define SNAPSHOT_VERSION     2
+#define SNAPSHOT_BYTE_ORDER  0x0102'0304
+
+#if UINTPTR_MAX > 0xFFFF'FFFF
+#   define SNAPSHOT_BASE_ADDRESS  0x3F00'0000'0000ULL
+#else
+#   define SNAPSHOT_BASE_ADDRESS  0x6000'0000ULL
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+    // old kernels ignore unknown flags and take the address as a hint
+#   define MAP_FIXED_NOREPLACE  0x100000
+#endif
+
+// block kinds
+#define BLOCK_STRING  1
+#define BLOCK_ARRAY   2
+#define BLOCK_MAP     3
+
+typedef struct {
+    uint32_t kind;
+    uint32_t char_size;  // for strings
+} BlockHeader;
+
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t base_address;
+    uint64_t blocks_size;  // offsets of maps follow blocks
+    uint64_t num_maps;
+    uint64_t reserved;
+    _UwValue root;
+} Trailer;
+
+#define ARRAY_HEADER_SIZE  (sizeof(_UwCompoundData) + sizeof(_UwArray))
+#define MAP_HEADER_SIZE    (sizeof(_UwCompoundData) + sizeof(_UwMap))
+
+static_assert( (ARRAY_HEADER_SIZE & 7) == 0 );
+static_assert( (MAP_HEADER_SIZE & 7) == 0 );
+static_assert( sizeof(BlockHeader) == 8 );
+static_assert( sizeof(_UwStringData) == 8 );
+
+static inline uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~7ULL;
+}
+
+/****************************************************************
+ * Writer
+ */
+
+// must be power of two
+#define SEEN_INITIAL_CAPACITY  1024
+
+typedef struct {
+    void*    data;     // string_data or struct_data of the source value
+    unsigned length;   // string length, strings sharing data may have different lengths
+    uint64_t offset;
+} SeenItem;
+
+typedef struct {
+    _UwBinaryOutput out;
+    uint64_t position;     // number of bytes written
+    uint64_t layout_size;  // number of bytes with assigned offsets
+
+    // data already laid out, to keep shared values shared
+    SeenItem* seen;        // open addressing hash table
+    unsigned  seen_capacity;
+    unsigned  seen_used;
+
+    // values with assigned offsets, in the order of offsets
+    _UwValue* queue;
+    unsigned  queue_capacity;
+    unsigned  queue_length;
+
+    // offsets of map blocks
+    uint64_t* maps;
+    unsigned  maps_capacity;
+    unsigned  num_maps;
+
+    _UwValue strings;  // Array of strings converted from CharPtr, keeps them alive while writing
+} Writer;
+
+static bool grow(void** items, unsigned* capacity, unsigned item_size)
+{
+    unsigned new_capacity = *capacity? *capacity * 2 : 256;
+    if (new_capacity > UINT_MAX / item_size) {
+        return false;
+    }
+    if (!reallocate(items, *capacity * item_size, new_capacity * item_size, true, nullptr)) {
+        return false;
+    }
+    *capacity = new_capacity;
+    return true;
+}
+
+static SeenItem* lookup_seen(SeenItem* seen, unsigned capacity, void* data, unsigned length)
+/*
+ * Return item for `data` or free item where it should be added.
+ */
+{
+    unsigned index = (unsigned) (((uintptr_t) data >> 3) * 0x9E37'79B9'7F4A'7C15ULL >> 32);
+    for (;;) {
+        index &= capacity - 1;
+        SeenItem* item = &seen[index];
+        if (item->data == nullptr || (item->data == data && item->length == length)) {
+            return item;
+        }
+        index++;
+    }
+}
+
+static bool add_seen(Writer* w, void* data, unsigned length, uint64_t offset)
+{
+    if (w->seen_used >= w->seen_capacity / 2) {
+        // rehash to the table of double capacity
+        unsigned old_capacity = w->seen_capacity;
+        SeenItem* old_seen = w->seen;
+        unsigned new_capacity = old_capacity * 2;
+        if (new_capacity > UINT_MAX / sizeof(SeenItem)) {
+            return false;
+        }
+        SeenItem* new_seen = allocate(new_capacity * sizeof(SeenItem), true);
+        if (!new_seen) {
+            return false;
+        }
+        for (unsigned i = 0; i < old_capacity; i++) {
+            if (old_seen[i].data) {
+                *lookup_seen(new_seen, new_capacity, old_seen[i].data, old_seen[i].length) = old_seen[i];
+            }
+        }
+        if (old_seen) {
+            release((void**) &old_seen, old_capacity * sizeof(SeenItem));
+        }
+        w->seen = new_seen;
+        w->seen_capacity = new_capacity;
+    }
+    *lookup_seen(w->seen, w->seen_capacity, data, length) = (SeenItem) {
+        .data   = data,
+        .length = length,
+        .offset = offset
+    };
+    w->seen_used++;
+    return true;
+}
+
+static uint64_t block_size(UwValuePtr value)
+{
+    switch (value->type_id) {
+        case UwTypeId_String:
+            return sizeof(BlockHeader)
+                   + align8(sizeof(_UwStringData) + value->str_length * _uw_string_char_size(value));
+
+        case UwTypeId_Array:
+            return sizeof(BlockHeader) + ARRAY_HEADER_SIZE
+                   + get_array_data_ptr(value)->length * sizeof(_UwValue);
+
+        case UwTypeId_Map: {
+            _UwMap* map = _uw_get_data_ptr(value, UwTypeId_Map);
+            return sizeof(BlockHeader) + MAP_HEADER_SIZE
+                   + map->kv_pairs.length * sizeof(_UwValue)
+                   + align8(map->hash_table.item_size * map->hash_table.capacity);
+        }
+        default:
+            uw_panic("Unexpected type %u\n", value->type_id);
+    }
+}
+
+static UwResult layout_block(Writer* w, UwValuePtr value, void* data, unsigned length, void** result)
+/*
+ * Assign offset to the block for `data` unless done already.
+ * Write pointer to the block to `result`.
+ */
+{
+    SeenItem* item = lookup_seen(w->seen, w->seen_capacity, data, length);
+    uint64_t offset = item->offset;
+    if (!item->data) {
+        offset = w->layout_size;
+        if (!add_seen(w, data, length, offset)) {
+            return UwOOM();
+        }
+        if (w->queue_length == w->queue_capacity) {
+            if (!grow((void**) &w->queue, &w->queue_capacity, sizeof(_UwValue))) {
+                return UwOOM();
+            }
+        }
+        w->queue[w->queue_length++] = *value;
+        w->layout_size += block_size(value);
+    }
+    *result = (void*) (SNAPSHOT_BASE_ADDRESS + offset + sizeof(BlockHeader));
+    return UwOK();
+}
+
+static UwResult layout_value(Writer* w, UwValuePtr value, UwValuePtr result)
+/*
+ * Make `result` as `value` will be stored in snapshot.
+ */
+{
+    *result = *value;
+    switch (value->type_id) {
+        case UwTypeId_Null:
+        case UwTypeId_Bool:
+        case UwTypeId_Signed:
+        case UwTypeId_Unsigned:
+        case UwTypeId_Float:
+        case UwTypeId_Timestamp:
+            return UwOK();
+
+        case UwTypeId_DateTime:
+            // zone info cache is per process
+            result->tzindex = 0;
+            return UwOK();
+
+        case UwTypeId_CharPtr: {
+            UwValue str = uw_clone(value);  // this converts CharPtr to string
+            uw_return_if_error(&str);
+            if (!str.str_embedded) {
+                uw_expect_ok( uw_array_append(&w->strings, &str) );
+            }
+            return layout_value(w, &str, result);
+        }
+        case UwTypeId_String:
+            if (value->str_embedded) {
+                return UwOK();
+            }
+            return layout_block(w, value, value->string_data, value->str_length, (void**) &result->string_data);
+
+        case UwTypeId_Array:
+        case UwTypeId_Map:
+            return layout_block(w, value, value->struct_data, 0, (void**) &result->struct_data);
+
+        default:
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+}
+
+static bool put(Writer* w, void* data, unsigned n)
+{
+    w->position += n;
+    return _uw_binary_write(&w->out, data, n);
+}
+
+static bool put_padding(Writer* w)
+{
+    static uint8_t zeros[8] = {};
+    return put(w, zeros, align8(w->position) - w->position);
+}
+
+static bool put_header(Writer* w, uint32_t kind, uint32_t char_size)
+{
+    BlockHeader header = {
+        .kind = kind,
+        .char_size = char_size
+    };
+    return put(w, &header, sizeof(header));
+}
+
+static UwResult put_items(Writer* w, UwValuePtr items, unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        _UwValue item;
+        uw_expect_ok( layout_value(w, &items[i], &item) );
+        if (!put(w, &item, sizeof(_UwValue))) {
+            return uw_move(&w->out.error);
+        }
+    }
+    return UwOK();
+}
+
+static inline void init_compound_data(_UwCompoundData* cdata)
+{
+    memset(cdata, 0, sizeof(_UwCompoundData));
+    cdata->struct_data.refcount = UW_REFCOUNT_IMMORTAL;
+}
+
+static UwResult write_string(Writer* w, UwValuePtr str)
+{
+    uint8_t char_size = _uw_string_char_size(str);
+    _UwStringData sdata = {
+        .refcount = UW_REFCOUNT_IMMORTAL,
+        .capacity = str->str_length
+    };
+    if (!(put_header(w, BLOCK_STRING, char_size) &&
+          put(w, &sdata, sizeof(sdata)) &&
+          put(w, str->string_data->data, str->str_length * char_size) &&
+          put_padding(w))) {
+        return uw_move(&w->out.error);
+    }
+    return UwOK();
+}
+
+static UwResult write_array(Writer* w, UwValuePtr array)
+{
+    _UwArray* src = get_array_data_ptr(array);
+
+    _UwCompoundData cdata;
+    init_compound_data(&cdata);
+
+    _UwArray array_data;
+    memset(&array_data, 0, sizeof(array_data));
+    array_data.items    = (UwValuePtr) (SNAPSHOT_BASE_ADDRESS + w->position + sizeof(BlockHeader) + ARRAY_HEADER_SIZE);
+    array_data.length   = src->length;
+    array_data.capacity = src->length;
+    array_data.trivial_items = src->trivial_items;
+
+    if (!(put_header(w, BLOCK_ARRAY, 0) &&
+          put(w, &cdata, sizeof(cdata)) &&
+          put(w, &array_data, sizeof(array_data)))) {
+        return uw_move(&w->out.error);
+    }
+    return put_items(w, src->items, src->length);
+}
+
+static UwResult write_map(Writer* w, UwValuePtr map)
+{
+    _UwMap* src = _uw_get_data_ptr(map, UwTypeId_Map);
+    struct _UwHashTable* src_ht = &src->hash_table;
+
+    if (w->num_maps == w->maps_capacity) {
+        if (!grow((void**) &w->maps, &w->maps_capacity, sizeof(uint64_t))) {
+            return UwOOM();
+        }
+    }
+    w->maps[w->num_maps++] = w->position + sizeof(BlockHeader);
+
+    _UwCompoundData cdata;
+    init_compound_data(&cdata);
+
+    uint64_t kv_offset = w->position + sizeof(BlockHeader) + MAP_HEADER_SIZE;
+    uint64_t ht_offset = kv_offset + src->kv_pairs.length * sizeof(_UwValue);
+
+    _UwMap map_data;
+    memset(&map_data, 0, sizeof(map_data));
+    map_data.kv_pairs.items    = (UwValuePtr) (SNAPSHOT_BASE_ADDRESS + kv_offset);
+    map_data.kv_pairs.length   = src->kv_pairs.length;
+    map_data.kv_pairs.capacity = src->kv_pairs.length;
+    map_data.kv_pairs.trivial_items = src->kv_pairs.trivial_items;
+
+    // getter and setter functions are set when snapshot is loaded
+    map_data.hash_table.item_size    = src_ht->item_size;
+    map_data.hash_table.hash_bitmask = src_ht->hash_bitmask;
+    map_data.hash_table.items_used   = src_ht->items_used;
+    map_data.hash_table.capacity     = src_ht->capacity;
+    map_data.hash_table.items        = (uint8_t*) (SNAPSHOT_BASE_ADDRESS + ht_offset);
+
+    if (!(put_header(w, BLOCK_MAP, 0) &&
+          put(w, &cdata, sizeof(cdata)) &&
+          put(w, &map_data, sizeof(map_data)))) {
+        return uw_move(&w->out.error);
+    }
+    uw_expect_ok( put_items(w, src->kv_pairs.items, src->kv_pairs.length) );
+
+    if (!(put(w, src_ht->items, src_ht->item_size * src_ht->capacity) && put_padding(w))) {
+        return uw_move(&w->out.error);
+    }
+    return UwOK();
+}
+
+static UwResult write_block(Writer* w, UwValuePtr value)
+{
+    switch (value->type_id) {
+        case UwTypeId_String: return write_string(w, value);
+        case UwTypeId_Array:  return write_array(w, value);
+        case UwTypeId_Map:    return write_map(w, value);
+        default:
+            uw_panic("Unexpected type %u\n", value->type_id);
+    }
+}
+
+static UwResult write_snapshot(Writer* w, UwValuePtr value)
+{
+    Trailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    memcpy(trailer.magic, SNAPSHOT_MAGIC, sizeof(trailer.magic));
+    trailer.version      = SNAPSHOT_VERSION;
+    trailer.byte_order   = SNAPSHOT_BYTE_ORDER;
+    trailer.base_address = SNAPSHOT_BASE_ADDRESS;
+
+    uw_expect_ok( layout_value(w, value, &trailer.root) );
+
+    // the queue grows while blocks are written
+    for (unsigned i = 0; i < w->queue_length; i++) {
+        _UwValue item = w->queue[i];
+        uw_expect_ok( write_block(w, &item) );
+    }
+    uw_assert(w->position == w->layout_size);
+
+    trailer.blocks_size = w->position;
+    trailer.num_maps    = w->num_maps;
+
+    if (!((w->num_maps == 0 || put(w, w->maps, w->num_maps * sizeof(uint64_t))) &&
+          put(w, &trailer, sizeof(trailer)) &&
+          _uw_binary_flush(&w->out))) {
+        return uw_move(&w->out.error);
+    }
+    return UwOK();
+}
+
+UwResult uw_snapshot_write(UwValuePtr value, UwSink* sink)
+{
+    Writer w;
+    memset(&w, 0, sizeof(w));
+    w.strings = UwArray();
+    if (uw_error(&w.strings)) {
+        return uw_move(&w.strings);
+    }
+    if (!_uw_binary_output_init(&w.out, sink)) {
+        uw_destroy(&w.strings);
+        return uw_move(&w.out.error);
+    }
+    UwValue status = UwOOM();
+    w.seen = allocate(SEEN_INITIAL_CAPACITY * sizeof(SeenItem), true);
+    if (w.seen) {
+        w.seen_capacity = SEEN_INITIAL_CAPACITY;
+        uw_destroy(&status);
+        status = write_snapshot(&w, value);
+    }
+    _uw_binary_output_fini(&w.out);
+    uw_destroy(&w.strings);
+    if (w.seen) {
+        release((void**) &w.seen, w.seen_capacity * sizeof(SeenItem));
+    }
+    if (w.queue) {
+        release((void**) &w.queue, w.queue_capacity * sizeof(_UwValue));
+    }
+    if (w.maps) {
+        release((void**) &w.maps, w.maps_capacity * sizeof(uint64_t));
+    }
+    return uw_move(&status);
+}
+
+/****************************************************************
+ * Snapshot type
+ */
+
+typedef struct {
+    uint8_t* data;  // mapped file
+    size_t   size;
+    _UwValue root;
+} _UwSnapshot;
+
+#define get_data_ptr(value)  ((_UwSnapshot*) _uw_get_data_ptr((value), UwTypeId_Snapshot))
+
+static void snapshot_fini(UwValuePtr self)
+{
+    _UwSnapshot* snapshot = get_data_ptr(self);
+    if (snapshot->data) {
+        munmap(snapshot->data, snapshot->size);
+        snapshot->data = nullptr;
+    }
+}
+
+static UwType snapshot_type;
+
+UwTypeId UwTypeId_Snapshot = 0;
+
+[[ gnu::constructor ]]
+static void init_snapshot_type()
+{
+    if (UwTypeId_Snapshot == 0) {
+        UwTypeId_Snapshot = uw_subtype(
+            &snapshot_type, "Snapshot", UwTypeId_Struct, _UwSnapshot
+        );
+        snapshot_type.fini = snapshot_fini;
+    }
+}
+
+/****************************************************************
+ * Loader
+ */
+
+static UwResult malformed(char* message)
+{
+    UwValue status = UwError(UW_ERROR_MALFORMED_DATA);
+    _uw_set_status_desc(&status, "%s", message);
+    return uw_move(&status);
+}
+
+static void relocate_value(UwValuePtr value, ptrdiff_t delta)
+{
+    switch (value->type_id) {
+        case UwTypeId_String:
+            if (!value->str_embedded) {
+                value->string_data = (_UwStringData*) ((uint8_t*) value->string_data + delta);
+            }
+            break;
+        case UwTypeId_Array:
+        case UwTypeId_Map:
+            value->struct_data = (_UwStructData*) ((uint8_t*) value->struct_data + delta);
+            break;
+        default:
+            break;
+    }
+}
+
+static void relocate_array(_UwArray* array_data, ptrdiff_t delta)
+{
+    array_data->items = (UwValuePtr) ((uint8_t*) array_data->items + delta);
+    for (unsigned i = 0; i < array_data->length; i++) {
+        relocate_value(&array_data->items[i], delta);
+    }
+}
+
+static bool relocate(uint8_t* data, uint64_t blocks_size, ptrdiff_t delta)
+/*
+ * Scan all blocks and adjust pointers.
+ */
+{
+    uint8_t* end = data + blocks_size;
+    uint8_t* ptr = data;
+    while (ptr < end) {
+        if ((uint64_t) (end - ptr) < sizeof(BlockHeader) + sizeof(_UwStringData)) {
+            return false;
+        }
+        BlockHeader* header = (BlockHeader*) ptr;
+        ptr += sizeof(BlockHeader);
+        switch (header->kind) {
+            case BLOCK_STRING: {
+                _UwStringData* sdata = (_UwStringData*) ptr;
+                ptr += align8(sizeof(_UwStringData) + (uint64_t) sdata->capacity * header->char_size);
+                break;
+            }
+            case BLOCK_ARRAY: {
+                _UwArray* array_data = (_UwArray*) (ptr + sizeof(_UwCompoundData));
+                relocate_array(array_data, delta);
+                ptr += ARRAY_HEADER_SIZE + array_data->length * sizeof(_UwValue);
+                break;
+            }
+            case BLOCK_MAP: {
+                _UwMap* map = (_UwMap*) (ptr + sizeof(_UwCompoundData));
+                relocate_array(&map->kv_pairs, delta);
+                map->hash_table.items += delta;
+                ptr += MAP_HEADER_SIZE + map->kv_pairs.length * sizeof(_UwValue)
+                       + align8(map->hash_table.item_size * map->hash_table.capacity);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return ptr == end;
+}
+
+UwResult uw_snapshot_open(UwValuePtr file)
+{
+    int fd = uw_file_get_fd(file);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return UwErrno(errno);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return UwError(UW_ERROR_NOT_REGULAR_FILE);
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(Trailer)) {
+        return malformed("not a snapshot");
+    }
+    Trailer trailer;
+    ssize_t bytes_read = pread(fd, &trailer, sizeof(Trailer), size - sizeof(Trailer));
+    if (bytes_read == -1) {
+        return UwErrno(errno);
+    }
+    if (bytes_read != sizeof(Trailer) || memcmp(trailer.magic, SNAPSHOT_MAGIC, sizeof(trailer.magic)) != 0) {
+        return malformed("not a snapshot");
+    }
+    if (trailer.version != SNAPSHOT_VERSION || trailer.byte_order != SNAPSHOT_BYTE_ORDER) {
+        return malformed("incompatible snapshot version");
+    }
+    if (trailer.blocks_size > size || trailer.num_maps > (size - trailer.blocks_size) / sizeof(uint64_t)
+        || trailer.blocks_size + trailer.num_maps * sizeof(uint64_t) + sizeof(Trailer) != size) {
+        return malformed("bad snapshot size");
+    }
+
+    // map the file at its base address, if possible
+
+    uint8_t* base = (uint8_t*) trailer.base_address;
+    uint8_t* data = mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+    if (data == MAP_FAILED) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            return UwErrno(errno);
+        }
+    }
+    UwValue snapshot = uw_create(UwTypeId_Snapshot);
+    if (uw_error(&snapshot)) {
+        munmap(data, size);
+        return uw_move(&snapshot);
+    }
+    _UwSnapshot* snapshot_data = get_data_ptr(&snapshot);
+    snapshot_data->data = data;
+    snapshot_data->size = size;
+    snapshot_data->root = trailer.root;
+
+    ptrdiff_t delta = data - base;
+    if (delta) {
+        if (!relocate(data, trailer.blocks_size, delta)) {
+            return malformed("bad snapshot block");
+        }
+        relocate_value(&snapshot_data->root, delta);
+    }
+
+    // set hash table methods, they are different in every process
+
+    uint64_t* maps = (uint64_t*) (data + trailer.blocks_size);
+    for (uint64_t i = 0; i < trailer.num_maps; i++) {
+        if (maps[i] + MAP_HEADER_SIZE > trailer.blocks_size) {
+            return malformed("bad snapshot block");
+        }
+        _UwMap* map = (_UwMap*) (data + maps[i] + sizeof(_UwCompoundData));
+        _uw_hash_table_set_methods(&map->hash_table);
+    }
+
+    if (mprotect(data, size, PROT_READ) == -1) {
+        return UwErrno(errno);
+    }
+    return uw_move(&snapshot);
+}
+
+UwValuePtr uw_snapshot_root(UwValuePtr snapshot)
+{
+    return &get_data_ptr(snapshot)->root;
+}
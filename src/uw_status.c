@@ -9,6 +9,7 @@
 #include <libpussy/mmarray.h>
 
 #include "include/uw.h"
+#include "src/uw_arena_internal.h"
 #include "src/uw_struct_internal.h"
 
 static char* basic_statuses[] = {
@@ -26,7 +27,12 @@ static char* basic_statuses[] = {
     [UW_ERROR_KEY_NOT_FOUND]         = "KEY_NOT_FOUND",
     [UW_ERROR_FILE_ALREADY_OPENED]   = "FILE_ALREADY_OPENED",
     [UW_ERROR_NOT_REGULAR_FILE]      = "NOT_REGULAR_FILE",
-    [UW_ERROR_UNREAD_FAILED]         = "UNREAD_FAILED"
+    [UW_ERROR_UNREAD_FAILED]         = "UNREAD_FAILED",
+    [UW_ERROR_ASYNC_QUEUE_FULL]      = "ASYNC_QUEUE_FULL",
+    [UW_ERROR_JSON_SYNTAX]           = "JSON_SYNTAX",
+    [UW_ERROR_BAD_PATH]              = "BAD_PATH",
+    [UW_ERROR_MALFORMED_DATA]        = "MALFORMED_DATA",
+    [UW_ERROR_READ_ONLY]             = "READ_ONLY"
 };
 
 static char** statuses = nullptr;
@@ -113,7 +119,10 @@ void _uw_set_status_desc_ap(UwValuePtr status, char* fmt, va_list ap)
     if (vasprintf(&desc, fmt, ap) == -1) {
         return;
     }
+    // status data is never allocated in arena, neither is description
+    struct _UwArena* saved_arena = _uw_switch_arena(status->status_data);
     UwValue s = uw_create_string(desc);
+    _uw_current_arena = saved_arena;
     if (uw_ok(&s)) {
         status->status_data->description = uw_move(&s);
     }
@@ -182,7 +191,7 @@ static UwResult status_deepcopy(UwValuePtr self)
 
     result.status_data->file_name = self->status_data->file_name;
     result.status_data->line_number = self->status_data->line_number;
-    result.status_data->description = uw_deepcopy(&self->status_data->description);
+    result.status_data->description = _uw_deepcopy_into(&result, &self->status_data->description);
     return uw_move(&result);
 }
 
@@ -298,7 +307,7 @@ UwType _uw_status_type = {
     .id             = UwTypeId_Status,
     .ancestor_id    = UwTypeId_Struct,
     .name           = "Status",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
     .create         = status_create,
     .destroy        = status_destroy,
     .clone          = status_clone,
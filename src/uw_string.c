@@ -5,6 +5,7 @@
 #include <libpussy/dump.h>
 
 #include "include/uw.h"
+#include "src/uw_arena_internal.h"
 #include "src/uw_charptr_internal.h"
 #include "src/uw_string_internal.h"
 
@@ -82,7 +83,12 @@ static bool make_empty_string(UwValuePtr result, unsigned capacity, uint8_t char
     unsigned real_capacity;
     unsigned memsize = calc_string_data_size(char_size, capacity, &real_capacity);
 
-    _UwStringData* string_data = uw_typeof(result)->allocator->allocate(memsize, true);
+    _UwStringData* string_data;
+    if (_uw_current_arena) {
+        string_data = _uw_arena_allocate(nullptr, memsize);
+    } else {
+        string_data = uw_typeof(result)->allocator->allocate(memsize, true);
+    }
     if (!string_data) {
         return false;
     }
@@ -92,24 +98,42 @@ static bool make_empty_string(UwValuePtr result, unsigned capacity, uint8_t char
     return true;
 }
 
+static bool make_empty_string_near(UwValuePtr result, unsigned capacity, uint8_t char_size, _UwStringData* orig_sdata)
+/*
+ * Same as make_empty_string, but allocate string data in the arena orig_sdata belongs to,
+ * or outside of arenas if it does not belong to any.
+ */
+{
+    struct _UwArena* saved_arena = _uw_switch_arena(orig_sdata);
+    bool success = make_empty_string(result, capacity, char_size);
+    _uw_current_arena = saved_arena;
+    return success;
+}
+
 static bool _do_clone_string_data(UwValuePtr str)
 /*
  * non-inline helper for clone_string_data
  */
 {
+    _UwValue orig_str = *str;
     _UwStringData* orig_sdata = str->string_data;
     unsigned length = str->str_length;
     uint8_t char_size = _uw_string_char_size(str);
 
     // allocate string
-    if (!make_empty_string(str, length, char_size)) {
+    if (!make_empty_string_near(str, length, char_size, orig_sdata)) {
         return false;
     }
     // copy original string to new string;
     // new string can be embedded, use _uw_string_start
     memcpy(_uw_string_start(str), orig_sdata->data, length * char_size);
     str->str_length = length;
-    orig_sdata->refcount--;
+    if (_uw_refcount_load(&orig_sdata->refcount) != UW_REFCOUNT_IMMORTAL) {
+        if (_uw_refcount_dec(&orig_sdata->refcount) == 0 && !_uw_in_arena(orig_sdata)) {
+            // other holders have released or copied the data meanwhile
+            uw_typeof(&orig_str)->allocator->release((void**) &orig_str.string_data, get_string_data_size(&orig_str));
+        }
+    }
     return true;
 }
 
@@ -127,7 +151,7 @@ static inline bool clone_string_data(UwValuePtr str)
         return true;
     }
     _UwStringData* sdata = str->string_data;
-    if (sdata->refcount > 1) {
+    if (_uw_refcount_load(&sdata->refcount) > 1) {
         return _do_clone_string_data(str);
     }
     return true;
@@ -164,7 +188,7 @@ static bool _do_expand_string(UwValuePtr str, unsigned increment, uint8_t new_ch
         }
         // go copy
 
-    } else if (str->string_data->refcount == 1 && new_char_size <= char_size) {
+    } else if (_uw_refcount_load(&str->string_data->refcount) == 1 && new_char_size <= char_size) {
 
         // expand string inplace
 
@@ -182,8 +206,12 @@ static bool _do_expand_string(UwValuePtr str, unsigned increment, uint8_t new_ch
         unsigned new_memsize = calc_string_data_size(char_size, new_capacity, &str->string_data->capacity);
 
         // reallocate data
-        if (!uw_typeof(str)->allocator->reallocate((void**) &str->string_data,
-                                                    orig_memsize, new_memsize, false, nullptr)) {
+        if (_uw_in_arena(str->string_data)) {
+            if (!_uw_arena_reallocate(str->string_data, (void**) &str->string_data, orig_memsize, new_memsize)) {
+                return false;
+            }
+        } else if (!uw_typeof(str)->allocator->reallocate((void**) &str->string_data,
+                                                           orig_memsize, new_memsize, false, nullptr)) {
             return false;
         }
         return true;
@@ -209,16 +237,22 @@ static bool _do_expand_string(UwValuePtr str, unsigned increment, uint8_t new_ch
         new_char_size = char_size;
     }
 
-    // allocate string
-    if (!make_empty_string(str, new_capacity, new_char_size)) {
+    // allocate string, keeping allocated data where it was
+    bool success;
+    if (orig_str.str_embedded) {
+        success = make_empty_string(str, new_capacity, new_char_size);
+    } else {
+        success = make_empty_string_near(str, new_capacity, new_char_size, orig_str.string_data);
+    }
+    if (!success) {
         return false;
     }
     // copy original string to new string
     get_str_methods(&orig_str)->copy_to(_uw_string_start(&orig_str), str, 0, length);
     str->str_length = length;
 
-    if (!orig_str.str_embedded) {
-        if (--orig_str.string_data->refcount == 0) {
+    if (!orig_str.str_embedded && _uw_refcount_load(&orig_str.string_data->refcount) != UW_REFCOUNT_IMMORTAL) {
+        if (_uw_refcount_dec(&orig_str.string_data->refcount) == 0 && !_uw_in_arena(orig_str.string_data)) {
             // free original string data if reference count is dropped to zero
             uw_typeof(&orig_str)->allocator->release((void**) &orig_str.string_data, get_string_data_size(&orig_str));
         }
@@ -245,7 +279,8 @@ static inline bool expand_string(UwValuePtr str, unsigned increment, uint8_t new
                 return true;
             }
         } else {
-            if (str->str_length + increment <= str->string_data->capacity) {
+            if (_uw_refcount_load(&str->string_data->refcount) == 1
+                && str->str_length + increment <= str->string_data->capacity) {
                 return true;
             }
         }
@@ -268,10 +303,11 @@ static UwResult string_create(UwTypeId type_id, void* ctor_args)
 
 static void string_destroy(UwValuePtr self)
 {
-    if (self->str_embedded) {
+    if (self->str_embedded || _uw_refcount_load(&self->string_data->refcount) == UW_REFCOUNT_IMMORTAL
+        || _uw_in_arena(self->string_data)) {
         return;
     }
-    if (0 == --self->string_data->refcount) {
+    if (0 == _uw_refcount_dec(&self->string_data->refcount)) {
         uw_typeof(self)->allocator->release((void**) &self->string_data, get_string_data_size(self));
     }
 }
@@ -280,8 +316,8 @@ static UwResult string_clone(UwValuePtr self)
 {
     UwValue result = *self;
     if (!result.str_embedded) {
-        if (result.string_data) {
-            result.string_data->refcount++;
+        if (result.string_data && _uw_refcount_load(&result.string_data->refcount) != UW_REFCOUNT_IMMORTAL) {
+            _uw_refcount_inc(&result.string_data->refcount);
         }
     }
     return uw_move(&result);
@@ -339,15 +375,19 @@ void _uw_string_dump_data(FILE* fp, UwValuePtr str, int indent)
         uint8_t* rem_addr;
         uint8_t* start = _uw_string_start_end(str, &rem_addr);
         uint8_t* ptr = start;
+        char buffer[81 * 4 + 5];
+        char* p = buffer;
         for(unsigned i = 0; i < length; i++) {
-            _uw_putchar32_utf8(fp, _uw_get_char(ptr, char_size));
+            p = uw_char32_to_utf8(_uw_get_char(ptr, char_size), p);
             ptr += char_size;
             if (i == 80) {
-                fprintf(fp, "...");
+                memcpy(p, "...", 3);
+                p += 3;
                 break;
             }
         }
-        fputc('\n', fp);
+        *p++ = '\n';
+        fwrite(buffer, 1, p - buffer, fp);
 
         dump_hex(fp, indent, start, length * char_size, (uint8_t*) (((ptrdiff_t) start) & 15), true, true);
         if (length < capacity) {
@@ -411,7 +451,7 @@ UwType _uw_string_type = {
     .id             = UwTypeId_String,
     .ancestor_id    = UwTypeId_Null,  // no ancestor
     .name           = "String",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_string_pool_allocator,
     .create         = string_create,
     .destroy        = string_destroy,
     .clone          = string_clone,
@@ -589,12 +629,9 @@ unsigned uw_strlen_in_utf8(UwValuePtr str)
 
 void _uw_putchar32_utf8(FILE* fp, char32_t codepoint)
 {
-    char buffer[5];
-    char* start = buffer;
+    char buffer[4];
     char* end = uw_char32_to_utf8(codepoint, buffer);
-    while (start < end) {
-        fputc(*start++, fp);
-    }
+    fwrite(buffer, 1, end - buffer, fp);
 }
 
 unsigned u32_strlen(char32_t* str)
@@ -1499,6 +1536,19 @@ void uw_string_to_utf8_buf(UwValuePtr str, char* buffer)
     }
 }
 
+unsigned _uw_string_to_utf8(UwValuePtr str, char8_t* buffer)
+{
+    unsigned length;
+    uint8_t* ptr = _uw_string_start_length(str, &length);
+    uint8_t char_size = _uw_string_char_size(str);
+    char* p = (char*) buffer;
+    for (unsigned i = 0; i < length; i++) {
+        p = uw_char32_to_utf8(_uw_get_char(ptr, char_size), p);
+        ptr += char_size;
+    }
+    return p - (char*) buffer;
+}
+
 void uw_substr_to_utf8_buf(UwValuePtr str, unsigned start_pos, unsigned end_pos, char* buffer)
 {
     if (uw_is_charptr(str)) {
@@ -1823,8 +1873,7 @@ UwResult uw_substr(UwValuePtr str, unsigned start_pos, unsigned end_pos)
 bool uw_string_erase(UwValuePtr str, unsigned start_pos, unsigned end_pos)
 {
     uw_assert_string(str);
-    unsigned length;
-    uint8_t* ptr = _uw_string_start_length(str, &length);
+    unsigned length = _uw_string_length(str);
 
     if (start_pos >= length || start_pos >= end_pos) {
         return true;
@@ -1832,6 +1881,8 @@ bool uw_string_erase(UwValuePtr str, unsigned start_pos, unsigned end_pos)
     if (!clone_string_data(str)) {
         return false;
     }
+    // take pointer after cloning, original data can be shared or read-only
+    uint8_t* ptr = _uw_string_start(str);
     if (end_pos >= length) {
         // truncate
         length = start_pos;
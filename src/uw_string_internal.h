@@ -169,6 +169,16 @@ void _uw_string_dump_data(FILE* fp, UwValuePtr str, int indent);
  * UTF-8 functions
  */
 
+unsigned _uw_string_to_utf8(UwValuePtr str, char8_t* buffer);
+/*
+ * Encode String to UTF-8 without terminating null.
+ * The buffer must have room for uw_strlen_in_utf8(str) bytes.
+ * Unlike uw_string_to_utf8_buf, characters U+0080..U+00FF
+ * of 1-byte strings are encoded as two bytes.
+ *
+ * Return the number of bytes written.
+ */
+
 static inline char32_t read_utf8_char(char8_t** str)
 /*
  * Decode UTF-8 character from null-terminated string, update `*str`.
@@ -200,6 +210,7 @@ static inline char32_t read_utf8_char(char8_t** str)
         APPEND_NEXT
         APPEND_NEXT
     } else if ((c & 0b1111'1000) == 0b1111'0000) {
+        codepoint = c & 0b0000'0111;
         APPEND_NEXT
         APPEND_NEXT
         APPEND_NEXT
@@ -258,13 +269,14 @@ static inline bool read_utf8_buffer(char8_t** ptr, unsigned* bytes_remaining, ch
             APPEND_NEXT
         } else if ((c & 0b1111'1000) == 0b1111'0000) {
             if (remaining < 3) return false;
+            result = c & 0b0000'0111;
             APPEND_NEXT
             APPEND_NEXT
             APPEND_NEXT
         } else {
             goto bad_utf8;
         }
-        if (codepoint == 0) {
+        if (result == 0) {
             // zero codepoint encoded with 2 or more bytes,
             // make it invalid to avoid mixing up with 1-byte null character
 bad_utf8:
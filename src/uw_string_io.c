@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "include/uw.h"
 #include "src/uw_interfaces_internal.h"
 #include "src/uw_string_internal.h"
@@ -7,8 +9,18 @@ typedef struct {
     // line reader iterator data
     _UwValue line;
     _UwValue pushback;
+    _UwValue view_line;  // pushed back line returned by read_line_view
     unsigned line_number;
     unsigned line_position;
+
+    // byte reader data: UTF-8 sequence that did not fit into the caller's buffer
+    char8_t  utf8_tail[4];
+    uint8_t  utf8_tail_len;
+    uint8_t  utf8_tail_pos;
+
+    // file writer data: incomplete UTF-8 sequence from the end of previous write
+    char8_t  write_tail[4];
+    uint8_t  write_tail_len;
 } _UwStringIO;
 
 #define get_data_ptr(value)  ((_UwStringIO*) _uw_get_data_ptr((value), UwTypeId_StringIO))
@@ -60,6 +72,7 @@ static UwResult stringio_init(UwValuePtr self, void* ctor_args)
     _UwStringIO* sio = get_data_ptr(self);
     sio->line = uw_move(&str);
     sio->pushback = UwNull();
+    sio->view_line = UwNull();
     return UwOK();
 }
 
@@ -68,6 +81,7 @@ static void stringio_fini(UwValuePtr self)
     _UwStringIO* sio = get_data_ptr(self);
     uw_destroy(&sio->line);
     uw_destroy(&sio->pushback);
+    uw_destroy(&sio->view_line);
 }
 
 static UwResult stringio_deepcopy(UwValuePtr self)
@@ -146,6 +160,8 @@ static UwResult start_read_lines(UwValuePtr self)
     _UwStringIO* sio = get_data_ptr(self);
     sio->line_position = 0;
     sio->line_number = 0;
+    sio->utf8_tail_len = 0;
+    sio->utf8_tail_pos = 0;
     uw_destroy(&sio->pushback);
     return UwOK();
 }
@@ -186,6 +202,37 @@ static UwResult read_line_inplace(UwValuePtr self, UwValuePtr line)
     return UwOK();
 }
 
+static UwResult read_line_view(UwValuePtr self, UwLineView* view)
+{
+    _UwStringIO* sio = get_data_ptr(self);
+
+    uw_destroy(&sio->view_line);
+
+    if (uw_is_string(&sio->pushback)) {
+        // keep pushed back line until next read
+        sio->view_line = uw_move(&sio->pushback);
+        view->ptr = _uw_string_start_length(&sio->view_line, &view->length);
+        view->char_size = _uw_string_char_size(&sio->view_line);
+        sio->line_number++;
+        return UwOK();
+    }
+
+    if (!uw_string_index_valid(&sio->line, sio->line_position)) {
+        return UwError(UW_ERROR_EOF);
+    }
+
+    unsigned lf_pos;
+    if (!uw_strchr(&sio->line, '\n', sio->line_position, &lf_pos)) {
+        lf_pos = uw_strlen(&sio->line) - 1;
+    }
+    view->ptr = _uw_string_char_ptr(&sio->line, sio->line_position);
+    view->length = lf_pos + 1 - sio->line_position;
+    view->char_size = _uw_string_char_size(&sio->line);
+    sio->line_position = lf_pos + 1;
+    sio->line_number++;
+    return UwOK();
+}
+
 static bool unread_line(UwValuePtr self, UwValuePtr line)
 {
     _UwStringIO* sio = get_data_ptr(self);
@@ -208,6 +255,122 @@ static void stop_read_lines(UwValuePtr self)
 {
     _UwStringIO* sio = get_data_ptr(self);
     uw_destroy(&sio->pushback);
+    uw_destroy(&sio->view_line);
+}
+
+/****************************************************************
+ * ByteReader interface methods
+ */
+
+static UwResult read_bytes(UwValuePtr self, void* buffer, unsigned buffer_size, unsigned* bytes_read)
+{
+    _UwStringIO* sio = get_data_ptr(self);
+
+    char8_t* dest = buffer;
+    char8_t* dest_end = dest + buffer_size;
+
+    // the rest of UTF-8 sequence from previous call goes first
+    while (sio->utf8_tail_pos < sio->utf8_tail_len && dest < dest_end) {
+        *dest++ = sio->utf8_tail[sio->utf8_tail_pos++];
+    }
+
+    uint8_t char_size = _uw_string_char_size(&sio->line);
+    unsigned length;
+    uint8_t* start = _uw_string_start_length(&sio->line, &length);
+    uint8_t* ptr = start + sio->line_position * char_size;
+
+    while (dest < dest_end && sio->line_position < length) {
+        char32_t c = _uw_get_char(ptr, char_size);
+        ptr += char_size;
+        sio->line_position++;
+        if (c < 0x80) {
+            *dest++ = (char8_t) c;
+            continue;
+        }
+        char8_t utf8[4];
+        unsigned n = (char8_t*) uw_char32_to_utf8(c, (char*) utf8) - utf8;
+        unsigned i = 0;
+        while (i < n && dest < dest_end) {
+            *dest++ = utf8[i++];
+        }
+        if (i < n) {
+            memcpy(sio->utf8_tail, utf8, n);
+            sio->utf8_tail_len = n;
+            sio->utf8_tail_pos = i;
+        }
+    }
+
+    *bytes_read = dest - (char8_t*) buffer;
+    if (*bytes_read == 0) {
+        return UwError(UW_ERROR_EOF);
+    }
+    return UwOK();
+}
+
+/****************************************************************
+ * CharReader interface methods
+ */
+
+static UwResult read_chars(UwValuePtr self, UwValuePtr dest, unsigned max_chars)
+{
+    _UwStringIO* sio = get_data_ptr(self);
+
+    uw_string_truncate(dest, 0);
+
+    unsigned length = _uw_string_length(&sio->line);
+    if (sio->line_position >= length) {
+        return UwError(UW_ERROR_EOF);
+    }
+    unsigned end_pos = length;
+    if (max_chars < length - sio->line_position) {
+        end_pos = sio->line_position + max_chars;
+    }
+    if (!uw_string_append_substring(dest, &sio->line, sio->line_position, end_pos)) {
+        return UwOOM();
+    }
+    sio->line_position = end_pos;
+    return UwOK();
+}
+
+/****************************************************************
+ * FileWriter interface methods
+ */
+
+static UwResult write_bytes(UwValuePtr self, void* data, unsigned size, unsigned* bytes_written)
+/*
+ * Append UTF-8 data to the string.
+ * Incomplete sequence at the end of data is kept until next write.
+ */
+{
+    _UwStringIO* sio = get_data_ptr(self);
+
+    char8_t* ptr = data;
+    unsigned remaining = size;
+    unsigned processed;
+
+    // complete the sequence left from previous call
+    while (sio->write_tail_len && remaining) {
+        sio->write_tail[sio->write_tail_len++] = *ptr++;
+        remaining--;
+        if (!uw_string_append_utf8(&sio->line, sio->write_tail, sio->write_tail_len, &processed)) {
+            return UwOOM();
+        }
+        if (processed) {
+            sio->write_tail_len = 0;
+        }
+    }
+
+    if (remaining) {
+        if (!uw_string_append_utf8(&sio->line, ptr, remaining, &processed)) {
+            return UwOOM();
+        }
+        remaining -= processed;
+        memcpy(sio->write_tail, ptr + processed, remaining);
+        sio->write_tail_len = remaining;
+    }
+
+    *bytes_written = size;
+    return UwOK();
 }
 
 /****************************************************************
@@ -220,16 +383,33 @@ static UwInterface_LineReader line_reader_interface = {
     .start             = start_read_lines,
     .read_line         = read_line,
     .read_line_inplace = read_line_inplace,
+    .read_line_view    = read_line_view,
     .get_line_number   = get_line_number,
     .unread_line       = unread_line,
     .stop              = stop_read_lines
 };
 
+static UwInterface_ByteReader byte_reader_interface = {
+    .start      = start_read_lines,
+    .read_bytes = read_bytes,
+    .stop       = stop_read_lines
+};
+
+static UwInterface_CharReader char_reader_interface = {
+    .start      = start_read_lines,
+    .read_chars = read_chars,
+    .stop       = stop_read_lines
+};
+
+static UwInterface_FileWriter file_writer_interface = {
+    .write = write_bytes
+};
+
 static UwType stringio_type = {
     .id             = 0,
     .ancestor_id    = UwTypeId_Struct,
     .name           = "StringIO",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_struct_destroy,
@@ -256,8 +436,13 @@ static_assert((sizeof(_UwStructData) & (alignof(_UwStringIO) - 1)) == 0);
 [[ gnu::constructor ]]
 static void init_stringio_type()
 {
+    if (UwInterfaceId_FileWriter == 0) { UwInterfaceId_FileWriter = uw_register_interface("FileWriter", UwInterface_FileWriter); }
+
     UwTypeId_StringIO = uw_add_type(
         &stringio_type,
-        UwInterfaceId_LineReader, &line_reader_interface
+        UwInterfaceId_LineReader, &line_reader_interface,
+        UwInterfaceId_ByteReader, &byte_reader_interface,
+        UwInterfaceId_CharReader, &char_reader_interface,
+        UwInterfaceId_FileWriter, &file_writer_interface
     );
 }
@@ -0,0 +1,84 @@
+#include "include/uw.h"
+#include "src/uw_interfaces_internal.h"
+#include "src/uw_iterator_internal.h"
+#include "src/uw_string_internal.h"
+#include "src/uw_struct_internal.h"
+
+typedef struct {
+    unsigned position;
+} _UwStringIterator;
+
+#define get_data_ptr(value)  ((_UwStringIterator*) _uw_get_data_ptr((value), UwTypeId_StringIterator))
+
+/****************************************************************
+ * CharReader interface
+ */
+
+static UwResult start_read_chars(UwValuePtr self)
+{
+    _UwStringIterator* data = get_data_ptr(self);
+    data->position = 0;
+    return UwOK();
+}
+
+static UwResult read_chars(UwValuePtr self, UwValuePtr dest, unsigned max_chars)
+{
+    uw_string_truncate(dest, 0);
+
+    _UwStringIterator* data = get_data_ptr(self);
+    _UwIterator* iter_data = get_iterator_data_ptr(self);
+
+    unsigned length = _uw_string_length(&iter_data->iterable);
+    if (data->position >= length) {
+        return UwError(UW_ERROR_EOF);
+    }
+    unsigned end_pos = length;
+    if (max_chars < length - data->position) {
+        end_pos = data->position + max_chars;
+    }
+    if (!uw_string_append_substring(dest, &iter_data->iterable, data->position, end_pos)) {
+        return UwOOM();
+    }
+    data->position = end_pos;
+    return UwOK();
+}
+
+static void stop_read_chars(UwValuePtr self)
+{
+}
+
+static UwInterface_CharReader char_reader_interface = {
+    .start      = start_read_chars,
+    .read_chars = read_chars,
+    .stop       = stop_read_chars
+};
+
+/****************************************************************
+ * StringIterator type
+ */
+
+static UwResult stri_init(UwValuePtr self, void* ctor_args)
+{
+    // iterable is already set by Iterator constructor
+    _UwIterator* iter_data = get_iterator_data_ptr(self);
+    if (!uw_is_string(&iter_data->iterable)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    return UwOK();
+}
+
+static UwType string_iterator_type;
+
+UwTypeId UwTypeId_StringIterator = 0;
+
+[[ gnu::constructor ]]
+static void init_string_iterator_type()
+{
+    if (UwTypeId_StringIterator == 0) {
+        UwTypeId_StringIterator = uw_subtype(
+            &string_iterator_type, "StringIterator", UwTypeId_Iterator, _UwStringIterator,
+            UwInterfaceId_CharReader, &char_reader_interface
+        );
+        string_iterator_type.init = stri_init;
+    }
+}
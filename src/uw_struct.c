@@ -1,3 +1,4 @@
+#include "src/uw_arena_internal.h"
 #include "src/uw_struct_internal.h"
 
 static UwResult call_init(UwValuePtr self, void* ctor_args, UwTypeId type_id)
@@ -38,7 +39,11 @@ UwResult _uw_struct_alloc(UwValuePtr self, void* ctor_args)
     // allocate memory
 
     unsigned memsize = type->data_offset + type->data_size;
-    self->struct_data = type->allocator->allocate(memsize, true);
+    if (_uw_current_arena && (uw_is_array(self) || uw_is_map(self))) {
+        self->struct_data = _uw_arena_allocate(nullptr, memsize);
+    } else {
+        self->struct_data = type->allocator->allocate(memsize, true);
+    }
     if (!self->struct_data) {
         return UwOOM();
     }
@@ -65,8 +70,10 @@ void _uw_struct_release(UwValuePtr self)
 
     type = uw_typeof(self);
 
-    unsigned memsize = type->data_offset + type->data_size;
-    type->allocator->release((void**) &self->struct_data, memsize);
+    if (!_uw_in_arena(self->struct_data)) {
+        unsigned memsize = type->data_offset + type->data_size;
+        type->allocator->release((void**) &self->struct_data, memsize);
+    }
 
     // reset value to Null
     self->type_id = UwTypeId_Null;
@@ -88,10 +95,12 @@ void _uw_struct_destroy(UwValuePtr self)
     if (!struct_data) {
         return;
     }
-    if (struct_data->refcount) {
-        struct_data->refcount--;
+    unsigned refcount = _uw_refcount_load(&struct_data->refcount);
+    if (refcount == UW_REFCOUNT_IMMORTAL || _uw_in_arena(struct_data)) {
+        // arena data is released with the arena
+        return;
     }
-    if (struct_data->refcount) {
+    if (refcount && _uw_refcount_dec(&struct_data->refcount)) {
         return;
     }
     _uw_struct_release(self);
@@ -99,8 +108,8 @@ void _uw_struct_destroy(UwValuePtr self)
 
 UwResult _uw_struct_clone(UwValuePtr self)
 {
-    if (self->struct_data) {
-        self->struct_data->refcount++;
+    if (self->struct_data && _uw_refcount_load(&self->struct_data->refcount) != UW_REFCOUNT_IMMORTAL) {
+        _uw_refcount_inc(&self->struct_data->refcount);
     }
     return *self;
 }
@@ -167,7 +176,7 @@ UwType _uw_struct_type = {
     .id             = UwTypeId_Struct,
     .ancestor_id    = UwTypeId_Null,  // no ancestor
     .name           = "Struct",
-    .allocator      = &default_allocator,
+    .allocator      = &uw_slab_allocator,
 
     .create         = _uw_struct_create,
     .destroy        = _uw_struct_destroy,
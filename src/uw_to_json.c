@@ -1,154 +1,330 @@
+#include <limits.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
 #include "include/uw_to_json.h"
 
 #include "src/uw_charptr_internal.h"
+#include "src/uw_json_internal.h"
+#include "src/uw_map_internal.h"
 #include "src/uw_string_internal.h"
 
-// forward declarations
-static unsigned estimate_length(UwValuePtr value, unsigned indent, unsigned depth, uint8_t* max_char_size);
-static bool value_to_json(UwValuePtr value, unsigned indent, unsigned depth, UwValuePtr result);
+/*
+ * JSON is serialized in a single pass into UTF-8 buffer.
+ *
+ * uw_to_json converts the buffer to string at the end.
+ * uw_to_json_write uses fixed size buffer and flushes it to the sink when full.
+ */
+
+#define INITIAL_CAPACITY  4096
+#define SINK_BUFFER_SIZE  65536
+
+typedef struct {
+    char8_t* data;
+    unsigned size;
+    unsigned capacity;
+    UwSink*  sink;   // nullptr if the whole output is kept in memory
+    _UwValue error;  // set when buffer functions return false
+} JsonOutput;
+
+// forward declaration
+static UwResult value_to_json(JsonOutput* out, UwValuePtr value, unsigned indent, unsigned depth);
+
+/****************************************************************
+ * Output buffer
+ */
+
+static bool grow(JsonOutput* out, unsigned n)
+{
+    unsigned new_capacity = out->capacity? out->capacity : INITIAL_CAPACITY;
+    while (new_capacity - out->size < n) {
+        if (new_capacity > UINT_MAX / 2) {
+            out->error = UwOOM();
+            return false;
+        }
+        new_capacity *= 2;
+    }
+    if (!out->data) {
+        out->data = allocate(new_capacity, false);
+        if (!out->data) {
+            out->error = UwOOM();
+            return false;
+        }
+    } else if (!reallocate((void**) &out->data, out->capacity, new_capacity, false, nullptr)) {
+        out->error = UwOOM();
+        return false;
+    }
+    out->capacity = new_capacity;
+    return true;
+}
+
+static bool flush(JsonOutput* out)
+{
+    if (out->size) {
+        out->error = uw_sink_write(out->sink, out->data, out->size);
+        if (uw_error(&out->error)) {
+            return false;
+        }
+        out->size = 0;
+    }
+    return true;
+}
 
+static bool make_room(JsonOutput* out, unsigned n)
+{
+    if (out->sink) {
+        if (!flush(out)) {
+            return false;
+        }
+        if (out->capacity >= n) {
+            return true;
+        }
+    }
+    return grow(out, n);
+}
 
-static unsigned estimate_escaped_length(UwValuePtr str, uint8_t* char_size)
+static inline bool reserve(JsonOutput* out, unsigned n)
 /*
- * Estimate length of escaped string.
- * Only double quotes and characters with codes < 32 to escape.
+ * Make sure at least `n` bytes can be written.
  */
 {
-#   define INCREMENT_LENGTH  \
-        if (c == '"'  || c == '\\') {  \
-            length += 2;  \
-        } else if (c < 32) {  \
-            if (c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t') {  \
-                length += 2;  \
-            } else {  \
-                length += 6;  \
-            }  \
-        } else {  \
-            length++;  \
-        }  \
-        width = update_char_width(width, c);
-
-    unsigned length = 0;
-    uint8_t  width = 0;
+    if (out->capacity - out->size >= n) {
+        return true;
+    }
+    return make_room(out, n);
+}
 
-    if (uw_is_charptr(str)) {
-        switch (str->charptr_subtype) {
-            case UW_CHARPTR: {
-                char8_t* ptr = str->charptr;
-                while(*ptr != 0) {
-                    char32_t c = read_utf8_char(&ptr);
-                    if (c != 0xFFFFFFFF) {
-                        INCREMENT_LENGTH
-                    }
-                }
-                break;
-            }
-            case UW_CHAR32PTR: {
-                char32_t* ptr = str->char32ptr;
-                for (;;) {
-                    char32_t c = *ptr++;
-                    if (c == 0) {
-                        break;
-                    }
-                    INCREMENT_LENGTH
-                }
-                break;
+static inline UwResult write_bytes(JsonOutput* out, void* data, unsigned n)
+{
+    if (out->capacity - out->size < n) {
+        if (out->sink && n > out->capacity / 2) {
+            // large chunk: bypass the buffer
+            if (!flush(out)) {
+                return uw_move(&out->error);
             }
-            default:
-                _uw_panic_bad_charptr_subtype(str);
+            return uw_sink_write(out->sink, data, n);
         }
-    } else {
-        uw_assert_string(str);
+        if (!make_room(out, n)) {
+            return uw_move(&out->error);
+        }
+    }
+    memcpy(out->data + out->size, data, n);
+    out->size += n;
+    return UwOK();
+}
+
+static inline UwResult write_char(JsonOutput* out, char8_t c)
+{
+    if (!reserve(out, 1)) {
+        return uw_move(&out->error);
+    }
+    out->data[out->size++] = c;
+    return UwOK();
+}
+
+static UwResult write_indent(JsonOutput* out, unsigned width)
+/*
+ * Write line break followed by `width` spaces.
+ */
+{
+    if (!reserve(out, width + 1)) {
+        return uw_move(&out->error);
+    }
+    char8_t* p = out->data + out->size;
+    *p++ = '\n';
+    memset(p, ' ', width);
+    out->size += width + 1;
+    return UwOK();
+}
+
+/****************************************************************
+ * Strings
+ */
 
-        unsigned n = _uw_string_length(str);
-        uint8_t* ptr = _uw_string_start(str);
-        uint8_t chr_sz = _uw_string_char_size(str);
+static char hex_digits[] = "0123456789abcdef";
 
-        for (unsigned i = 0; i < n; i++) {
-            char32_t c = _uw_get_char(ptr, chr_sz);
-            INCREMENT_LENGTH
-            ptr += chr_sz;
+static inline char8_t* put_escaped_char(char8_t* p, char32_t c)
+/*
+ * Write character to `p`, escaping double quotes, backslashes,
+ * and characters with codes < 32.
+ * Up to 6 bytes are written.
+ */
+{
+    if (c == '"' || c == '\\') {
+        *p++ = '\\';
+        *p++ = (char8_t) c;
+    } else if (c < 32) {
+        *p++ = '\\';
+        switch (c) {
+            case '\b': *p++ = 'b'; break;
+            case '\f': *p++ = 'f'; break;
+            case '\n': *p++ = 'n'; break;
+            case '\r': *p++ = 'r'; break;
+            case '\t': *p++ = 't'; break;
+            default:
+                *p++ = 'u';
+                *p++ = '0';
+                *p++ = '0';
+                *p++ = hex_digits[c >> 4];
+                *p++ = hex_digits[c & 15];
         }
+    } else {
+        p = (char8_t*) uw_char32_to_utf8(c, (char*) p);
     }
-    *char_size = char_width_to_char_size(width);
-    return length;
+    return p;
+}
 
-#   undef INCREMENT_LENGTH
+static UwResult write_utf8_string(JsonOutput* out, char8_t* str, char8_t* end)
+/*
+ * Write UTF-8 string, copying runs of plain ASCII in bulk.
+ * Malformed sequences are skipped.
+ */
+{
+    while (str < end) {
+        char8_t* run_end = _uw_json_skip_plain_ascii(str, end);
+        if (run_end > str) {
+            uw_expect_ok( write_bytes(out, str, run_end - str) );
+            str = run_end;
+        }
+        if (str < end) {
+            // escaped character takes up to 6 bytes
+            if (!reserve(out, 6)) {
+                return uw_move(&out->error);
+            }
+            char8_t* p = out->data + out->size;
+            char32_t c;
+            if (*str < 0x80) {
+                c = *str++;
+            } else {
+                unsigned remaining = end - str;
+                if (!read_utf8_buffer(&str, &remaining, &c)) {
+                    // truncated sequence
+                    str = end;
+                    c = 0xFFFFFFFF;
+                }
+            }
+            if (c != 0xFFFFFFFF) {
+                p = put_escaped_char(p, c);
+            }
+            out->size = p - out->data;
+        }
+    }
+    return UwOK();
 }
 
-static UwResult escape_string(UwValuePtr str)
+#ifdef __SSE2__
+static inline unsigned skip_plain_latin1(uint8_t* ptr, unsigned length)
 /*
- * Escape only double quotes and characters with codes < 32
+ * Return the number of leading characters in 1-byte string
+ * that can be copied as is.
  */
 {
-#   define APPEND_ESCAPED_CHAR  \
-        if (c == '"'  || c == '\\') {  \
-            if (!uw_string_append(&result, '\\')) {  \
-                return UwOOM();  \
-            }  \
-            if (!uw_string_append(&result, c)) {  \
-                return UwOOM();  \
-            }  \
-        } else if (c < 32) {  \
-            if (!uw_string_append(&result, '\\')) {  \
-                return UwOOM();  \
-            }  \
-            bool append_ok = false;  \
-            switch (c)  {  \
-                case '\b': append_ok = uw_string_append(&result, 'b'); break;  \
-                case '\f': append_ok = uw_string_append(&result, 'f'); break;  \
-                case '\n': append_ok = uw_string_append(&result, 'n'); break;  \
-                case '\r': append_ok = uw_string_append(&result, 'r'); break;  \
-                case '\t': append_ok = uw_string_append(&result, 't'); break;  \
-                default:  \
-                    if (!uw_string_append(&result, '0')) {  \
-                        return UwOOM();  \
-                    }  \
-                    if (!uw_string_append(&result, '0')) {  \
-                        return UwOOM();  \
-                    }  \
-                    if (!uw_string_append(&result, (c >> 4) + '0')) {  \
-                        return UwOOM();  \
-                    }  \
-                    append_ok = uw_string_append(&result, (c & 15) + '0');  \
-            }  \
-            if (!append_ok) {  \
-                return UwOOM();  \
-            }  \
-        } else {  \
-            if (!uw_string_append(&result, c)) {  \
-                return UwOOM();  \
-            }  \
+    unsigned i = 0;
+    while (length - i >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i*) (ptr + i));
+        __m128i special = _mm_or_si128(
+            _mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')))
+        );
+        unsigned mask = (unsigned) _mm_movemask_epi8(special);
+        if (mask) {
+            return i + __builtin_ctz(mask);
         }
+        i += 16;
+    }
+    return i;
+}
+#endif
 
-    uint8_t char_size;
-    unsigned estimated_length = estimate_escaped_length(str, &char_size);
+static UwResult write_string_chars(JsonOutput* out, UwValuePtr str)
+{
+    unsigned length = _uw_string_length(str);
+    uint8_t* ptr = _uw_string_start(str);
+    uint8_t char_size = _uw_string_char_size(str);
+
+    if (char_size == 1) {
+        // bytes are code points, UTF-8 takes at most 2 bytes for them
+        unsigned i = 0;
+        while (i < length) {
+            unsigned run = 0;
+#ifdef __SSE2__
+            run = skip_plain_latin1(ptr + i, length - i);
+#endif
+            if (run) {
+                uw_expect_ok( write_bytes(out, ptr + i, run) );
+                i += run;
+                continue;
+            }
+            // process up to 16 characters one by one
+            unsigned n = length - i;
+            if (n > 16) {
+                n = 16;
+            }
+            if (!reserve(out, n * 6)) {
+                return uw_move(&out->error);
+            }
+            char8_t* p = out->data + out->size;
+            for (unsigned end = i + n; i < end; i++) {
+                char8_t c = ptr[i];
+                if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+                    *p++ = c;
+                } else {
+                    p = put_escaped_char(p, c);
+                }
+            }
+            out->size = p - out->data;
+        }
+        return UwOK();
+    }
 
-    UwValue result = uw_create_empty_string(estimated_length, char_size);
-    uw_return_if_error(&result);
+    // wider strings: up to 6 bytes per character
+    unsigned i = 0;
+    while (i < length) {
+        unsigned n = length - i;
+        if (n > 1024) {
+            n = 1024;
+        }
+        if (!reserve(out, n * 6)) {
+            return uw_move(&out->error);
+        }
+        char8_t* p = out->data + out->size;
+        for (unsigned end = i + n; i < end; i++) {
+            char32_t c = _uw_get_char(ptr, char_size);
+            ptr += char_size;
+            if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+                *p++ = (char8_t) c;
+            } else {
+                p = put_escaped_char(p, c);
+            }
+        }
+        out->size = p - out->data;
+    }
+    return UwOK();
+}
+
+static UwResult write_string(JsonOutput* out, UwValuePtr str)
+/*
+ * Write quoted and escaped string.
+ */
+{
+    uw_expect_ok( write_char(out, '"') );
 
     if (uw_is_charptr(str)) {
         switch (str->charptr_subtype) {
             case UW_CHARPTR: {
-                char8_t* ptr = str->charptr;
-                while(*ptr != 0) {
-                    char32_t c = read_utf8_char(&ptr);
-                    if (c != 0xFFFFFFFF) {
-                        APPEND_ESCAPED_CHAR
-                    }
-                }
+                char8_t* s = str->charptr;
+                uw_expect_ok( write_utf8_string(out, s, s + strlen((char*) s)) );
                 break;
             }
             case UW_CHAR32PTR: {
-                char32_t* ptr = str->char32ptr;
-                for (;;) {
-                    char32_t c = *ptr++;
-                    if (c == 0) {
-                        break;
+                for (char32_t* s = str->char32ptr; *s; s++) {
+                    if (!reserve(out, 6)) {
+                        return uw_move(&out->error);
                     }
-                    APPEND_ESCAPED_CHAR
+                    out->size = put_escaped_char(out->data + out->size, *s) - out->data;
                 }
                 break;
             }
@@ -156,306 +332,458 @@ static UwResult escape_string(UwValuePtr str)
                 _uw_panic_bad_charptr_subtype(str);
         }
     } else {
-        uw_assert_string(str);
+        uw_expect_ok( write_string_chars(out, str) );
+    }
+    return write_char(out, '"');
+}
 
-        unsigned length = _uw_string_length(str);
-        uint8_t* ptr = _uw_string_start(str);
-        uint8_t char_size = _uw_string_char_size(str);
+/****************************************************************
+ * Values
+ */
 
-        for (unsigned i = 0; i < length; i++) {
-            char32_t c = _uw_get_char(ptr, char_size);
-            APPEND_ESCAPED_CHAR
-            ptr += char_size;
-        }
+static UwResult write_integer(JsonOutput* out, uint64_t n, bool negative)
+{
+    char8_t buf[24];
+    char8_t* p = buf + sizeof(buf);
+    do {
+        *--p = '0' + (n % 10);
+        n /= 10;
+    } while (n);
+    if (negative) {
+        *--p = '-';
     }
-    return uw_move(&result);
+    return write_bytes(out, p, buf + sizeof(buf) - p);
+}
+
+static UwResult write_null(JsonOutput* out, UwValuePtr value)
+{
+    return write_bytes(out, "null", 4);
+}
+
+static UwResult write_bool(JsonOutput* out, UwValuePtr value)
+{
+    return value->bool_value? write_bytes(out, "true", 4) : write_bytes(out, "false", 5);
+}
+
+static UwResult write_signed(JsonOutput* out, UwValuePtr value)
+{
+    bool negative = value->signed_value < 0;
+    return write_integer(out, negative? 0 - (uint64_t) value->signed_value : (uint64_t) value->signed_value, negative);
+}
+
+static UwResult write_unsigned(JsonOutput* out, UwValuePtr value)
+{
+    return write_integer(out, value->unsigned_value, false);
+}
 
-#   undef APPEND_ESCAPED_CHAR
+static UwResult write_float(JsonOutput* out, UwValuePtr value)
+{
+    char buf[320];
+    int n = snprintf(buf, sizeof(buf), "%f", value->float_value);
+    return write_bytes(out, buf, n);
 }
 
-static unsigned estimate_array_length(UwValuePtr value, unsigned indent, unsigned depth, uint8_t* max_char_size)
+static UwResult array_to_json(JsonOutput* out, UwValuePtr value, unsigned indent, unsigned depth)
 {
-    unsigned num_items = uw_array_length(value);
+    // items are borrowed, not cloned
+    _UwArray* array_data = get_array_data_ptr(value);
+    unsigned num_items = array_data->length;
 
-    unsigned length = 2;  // braces
+    uw_expect_ok( write_char(out, '[') );
     if (num_items == 0) {
-        return length;
+        return write_char(out, ']');
     }
     bool multiline = indent && num_items > 1;
-    if (multiline) {
-        length++; // line break after opening brace
-    }
-    for (unsigned i = 0; i < num_items; i++) {{
+    for (unsigned i = 0; i < num_items; i++) {
         if (i) {
-            length += /* comma */ 1;
+            uw_expect_ok( write_char(out, ',') );
         }
         if (multiline) {
-            length += /* line break */ 1 + indent * depth;
+            uw_expect_ok( write_indent(out, indent * depth) );
         }
-        UwValue item = uw_array_item(value, i);
-        unsigned item_length = estimate_length(&item, indent, depth + multiline, max_char_size);
-        if (item_length == 0) {
-            return 0;
-        }
-        length += item_length;
-    }}
+        uw_expect_ok( value_to_json(out, &array_data->items[i], indent, depth + multiline) );
+    }
     if (multiline) {
-        length += /* line break: */ 1 + /* indent before closing brace */ indent * (depth - 1);
+        // dedent closing brace
+        uw_expect_ok( write_indent(out, indent * (depth - 1)) );
     }
-    return length;
+    return write_char(out, ']');
 }
 
-static bool array_to_json(UwValuePtr value, unsigned indent, unsigned depth, UwValuePtr result)
+static UwResult map_to_json(JsonOutput* out, UwValuePtr value, unsigned indent, unsigned depth)
 {
-    unsigned num_items = uw_array_length(value);
+    // keys and values are borrowed, not cloned
+    _UwMap* map = _uw_get_data_ptr(value, UwTypeId_Map);
+    unsigned num_items = map->kv_pairs.length / 2;
 
-    if (!uw_string_append(result, '[')) {
-        return false;
-    }
+    uw_expect_ok( write_char(out, '{') );
     if (num_items == 0) {
-        return uw_string_append(result, ']');
+        return write_char(out, '}');
     }
-    unsigned indent_width = indent * depth;
-    char indent_str[indent_width + 2];
-    indent_str[0] = '\n';
-    memset(&indent_str[1], ' ', indent_width);
-    indent_str[indent_width + 1] = 0;
-
     bool multiline = indent && num_items > 1;
-    for (unsigned i = 0; i < num_items; i++) {{
+    UwValuePtr kv = map->kv_pairs.items;
+    for (unsigned i = 0; i < num_items; i++, kv += 2) {
+        if (!uw_is_string(&kv[0])) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
         if (i) {
-            if (!uw_string_append(result, ',')) {
-                return false;
-            }
+            uw_expect_ok( write_char(out, ',') );
         }
         if (multiline) {
-            if (!uw_string_append(result, indent_str)) {
-                return false;
-            }
+            uw_expect_ok( write_indent(out, indent * depth) );
         }
-        UwValue item = uw_array_item(value, i);
-        if (!value_to_json(&item, indent, depth + multiline, result)) {
-            return false;
+        uw_expect_ok( write_string(out, &kv[0]) );
+        if (indent) {
+            uw_expect_ok( write_bytes(out, ": ", 2) );
+        } else {
+            uw_expect_ok( write_char(out, ':') );
         }
-    }}
+        uw_expect_ok( value_to_json(out, &kv[1], indent, depth + multiline) );
+    }
     if (multiline) {
-        indent_str[indent * (depth - 1) + 1] = 0;  // dedent closing brace
-        if (!uw_string_append(result, indent_str)) {
-            return false;
-        }
+        // dedent closing brace
+        uw_expect_ok( write_indent(out, indent * (depth - 1)) );
+    }
+    return write_char(out, '}');
+}
+
+static UwResult value_to_json(JsonOutput* out, UwValuePtr value, unsigned indent, unsigned depth)
+/*
+ * Append serialized value to `out`.
+ */
+{
+    if (uw_is_null(value)) {
+        return write_null(out, value);
+    }
+    if (uw_is_bool(value)) {
+        return write_bool(out, value);
+    }
+    if (uw_is_signed(value)) {
+        return write_signed(out, value);
+    }
+    if (uw_is_unsigned(value)) {
+        return write_unsigned(out, value);
+    }
+    if (uw_is_float(value)) {
+        return write_float(out, value);
+    }
+    if (uw_is_charptr(value) || uw_is_string(value)) {
+        return write_string(out, value);
+    }
+    if (uw_is_array(value)) {
+        return array_to_json(out, value, indent, depth);
+    }
+    if (uw_is_map(value)) {
+        return map_to_json(out, value, indent, depth);
     }
-    return uw_string_append(result, ']');
+    return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
 }
 
-static unsigned estimate_map_length(UwValuePtr value, unsigned indent, unsigned depth, uint8_t* max_char_size)
+/****************************************************************
+ * Encoder plans
+ */
+
+typedef UwResult (*ValueWriter)(JsonOutput* out, UwValuePtr value);
+
+typedef struct {
+    _UwValue    key;            // String
+    unsigned    fragment_start; // offset of `{"key":` or `,"key":` in fragments
+    unsigned    fragment_size;
+    UwTypeId    type_id;        // type of value in template map
+    ValueWriter write_value;    // writer for type_id, nullptr if none
+} _UwPlanStep;
+
+typedef struct {
+    _UwPlanStep* steps;
+    unsigned     num_steps;
+    JsonOutput   fragments;     // pre-escaped keys
+} _UwJsonPlan;
+
+#define get_plan_ptr(value)  ((_UwJsonPlan*) _uw_get_data_ptr((value), UwTypeId_JsonPlan))
+
+static ValueWriter get_value_writer(UwTypeId type_id)
 {
-    unsigned num_items = uw_map_length(value);
+    switch (type_id) {
+        case UwTypeId_Null:     return write_null;
+        case UwTypeId_Bool:     return write_bool;
+        case UwTypeId_Signed:   return write_signed;
+        case UwTypeId_Unsigned: return write_unsigned;
+        case UwTypeId_Float:    return write_float;
+        case UwTypeId_String:   return write_string;
+        default:                return nullptr;
+    }
+}
 
-    unsigned length = 2;  // braces
-    if (num_items == 0) {
-        return length;
+static UwResult add_plan_step(_UwJsonPlan* plan, UwValuePtr key, UwValuePtr template_value)
+{
+    if (!uw_is_string(key) && !uw_is_charptr(key)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
     }
-    bool multiline = indent && num_items > 1;
-    if (multiline) {
-        length++; // line break after opening brace
+    _UwPlanStep* step = &plan->steps[plan->num_steps];
+    step->key = uw_clone(key);  // this converts CharPtr to string
+    uw_return_if_error(&step->key);
+    plan->num_steps++;
+
+    JsonOutput* fragments = &plan->fragments;
+    step->fragment_start = fragments->size;
+    uw_expect_ok( write_char(fragments, (plan->num_steps == 1)? '{' : ',') );
+    uw_expect_ok( write_string(fragments, &step->key) );
+    uw_expect_ok( write_char(fragments, ':') );
+    step->fragment_size = fragments->size - step->fragment_start;
+
+    if (template_value) {
+        step->type_id = template_value->type_id;
+        step->write_value = get_value_writer(step->type_id);
     }
-    for (unsigned i = 0; i < num_items; i++) {{
-        if (i) {
-            length += /* comma */ 1;
-        }
-        if (multiline) {
-            length += /* line break */ 1 + indent * depth;
-        }
-        UwValue k = UwNull();
-        UwValue v = UwNull();
-        uw_map_item(value, i, &k, &v);
+    return UwOK();
+}
 
-        if (!uw_is_string(&k)) {
-            // bad type
-            return 0;
-        }
-        unsigned k_length = estimate_length(&k, indent, depth, max_char_size);
-        if (k_length == 0) {
-            return 0;
-        }
-        unsigned v_length = estimate_length(&v, indent, depth + multiline, max_char_size);
-        if (v_length == 0) {
-            return 0;
-        }
-        length += k_length + /* separator */ 1 + v_length;
-        if (indent) {
-            length++;  // extra space
+static void json_plan_fini(UwValuePtr self)
+{
+    _UwJsonPlan* plan = get_plan_ptr(self);
+    if (plan->steps) {
+        for (unsigned i = 0; i < plan->num_steps; i++) {
+            uw_destroy(&plan->steps[i].key);
         }
-    }}
-    if (multiline) {
-        length += /* line break: */ 1 + /* indent before closing brace */ indent * (depth - 1);
+        release((void**) &plan->steps, plan->num_steps * sizeof(_UwPlanStep));
+    }
+    if (plan->fragments.data) {
+        release((void**) &plan->fragments.data, plan->fragments.capacity);
     }
-    return length;
 }
 
-static bool map_to_json(UwValuePtr value, unsigned indent, unsigned depth, UwValuePtr result)
+static UwResult json_plan_init(UwValuePtr self, void* ctor_args)
 {
-    unsigned num_items = uw_map_length(value);
+    UwJsonPlanCtorArgs* args = ctor_args;
+    _UwJsonPlan* plan = get_plan_ptr(self);
 
-    if (!uw_string_append(result, '{')) {
-        return false;
+    if (!args || !args->shape) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
     }
-    if (num_items == 0) {
-        return uw_string_append(result, ']');
+    UwValuePtr shape = args->shape;
+    unsigned num_keys;
+    if (uw_is_map(shape)) {
+        num_keys = uw_map_length(shape);
+    } else if (uw_is_array(shape)) {
+        num_keys = uw_array_length(shape);
+    } else {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
     }
-    unsigned indent_width = indent * depth;
-    char indent_str[indent_width + 2];
-    indent_str[0] = '\n';
-    memset(&indent_str[1], ' ', indent_width);
-    indent_str[indent_width + 1] = 0;
-
-    bool multiline = indent && num_items > 1;
-    for (unsigned i = 0; i < num_items; i++) {{
-        UwValue k = UwNull();
-        UwValue v = UwNull();
-        uw_map_item(value, i, &k, &v);
-
-        if (i) {
-            if (!uw_string_append(result, ',')) {
-                return false;
-            }
+    if (num_keys) {
+        plan->steps = allocate(num_keys * sizeof(_UwPlanStep), true);
+        if (!plan->steps) {
+            return UwOOM();
         }
-        if (multiline) {
-            if (!uw_string_append(result, indent_str)) {
-                return false;
-            }
-        }
-        if (!uw_string_append(result, '"')) {
-            return false;
-        }
-        UwValue escaped = escape_string(&k);
-        if (uw_error(&escaped)) {
-            return false;
-        }
-        if (!uw_string_append(result, &escaped)) {
-            return false;
-        }
-        if (!uw_string_append(result, "\":")) {
-            return false;
-        }
-        if (indent) {
-            if (!uw_string_append(result, ' ')) {
-                return false;
-            }
-        }
-        if (!value_to_json(&v, indent, depth + multiline, result)) {
-            return false;
+    }
+    UwValue status = UwOK();
+    if (uw_is_map(shape)) {
+        UwValuePtr kv = ((_UwMap*) _uw_get_data_ptr(shape, UwTypeId_Map))->kv_pairs.items;
+        for (unsigned i = 0; i < num_keys && uw_ok(&status); i++, kv += 2) {
+            status = add_plan_step(plan, &kv[0], &kv[1]);
         }
-    }}
-    if (multiline) {
-        indent_str[indent * (depth - 1) + 1] = 0;  // dedent closing brace
-        if (!uw_string_append(result, indent_str)) {
-            return false;
+    } else {
+        UwValuePtr item = get_array_data_ptr(shape)->items;
+        for (unsigned i = 0; i < num_keys && uw_ok(&status); i++, item++) {
+            status = add_plan_step(plan, item, nullptr);
         }
     }
-    return uw_string_append(result, '}');
+    // on error fini is called by the caller
+    return uw_move(&status);
 }
 
-static unsigned estimate_length(UwValuePtr value, unsigned indent, unsigned depth, uint8_t* max_char_size)
+static UwResult plan_map_to_json(JsonOutput* out, _UwJsonPlan* plan, UwValuePtr value)
 /*
- * Estimate length of JSON representation of result.
- * As a side effect detect incompatible values.
- *
- * Return estimated length on success or zero on error.
+ * Write map using plan if its keys match the plan, in the same order.
+ * Otherwise use generic path.
  */
 {
-    if (uw_is_null(value)) {
-        return 4;
-
-    } else if (uw_is_bool(value)) {
-        return (value->bool_value)? 4 : 5;
-
-    } else if (uw_is_int(value)) {
-        return 20; // max unsigned: 18446744073709551615
+    _UwMap* map = _uw_get_data_ptr(value, UwTypeId_Map);
+    UwValuePtr kv = map->kv_pairs.items;
+    unsigned num_steps = plan->num_steps;
 
-    } else if (uw_is_float(value)) {
-        return 16; // no idea how many to reserve, .f conversion may generate very long string
+    if (map->kv_pairs.length != num_steps * 2 || num_steps == 0) {
+        return map_to_json(out, value, 0, 1);
+    }
+    _UwPlanStep* step = plan->steps;
+    for (unsigned i = 0; i < num_steps; i++, step++) {
+        if (!_uw_equal(&kv[i * 2], &step->key)) {
+            return map_to_json(out, value, 0, 1);
+        }
+    }
+    char8_t* fragments = plan->fragments.data;
+    step = plan->steps;
+    for (unsigned i = 0; i < num_steps; i++, step++, kv += 2) {
+        uw_expect_ok( write_bytes(out, fragments + step->fragment_start, step->fragment_size) );
+        UwValuePtr v = &kv[1];
+        if (v->type_id == step->type_id && step->write_value) {
+            uw_expect_ok( step->write_value(out, v) );
+        } else {
+            uw_expect_ok( value_to_json(out, v, 0, 1) );
+        }
+    }
+    return write_char(out, '}');
+}
 
-    } else if (uw_is_charptr(value) || uw_is_string(value)) {
-        uint8_t char_size;
-        unsigned length = estimate_escaped_length(value, &char_size);
-        if (*max_char_size < char_size) {
-            *max_char_size = char_size;
+static UwResult plan_value_to_json(JsonOutput* out, _UwJsonPlan* plan, UwValuePtr value)
+{
+    if (uw_is_map(value)) {
+        return plan_map_to_json(out, plan, value);
+    }
+    if (!uw_is_array(value)) {
+        return value_to_json(out, value, 0, 1);
+    }
+    // array of records
+    _UwArray* array_data = get_array_data_ptr(value);
+    uw_expect_ok( write_char(out, '[') );
+    for (unsigned i = 0; i < array_data->length; i++) {
+        if (i) {
+            uw_expect_ok( write_char(out, ',') );
         }
-        return length + /* quotes: */ 2;
+        UwValuePtr item = &array_data->items[i];
+        if (uw_is_map(item)) {
+            uw_expect_ok( plan_map_to_json(out, plan, item) );
+        } else {
+            uw_expect_ok( value_to_json(out, item, 0, 1) );
+        }
+    }
+    return write_char(out, ']');
+}
+
+static UwType json_plan_type;
 
-    } else if (uw_is_array(value)) {
-        return estimate_array_length(value, indent, depth, max_char_size);
+UwTypeId UwTypeId_JsonPlan = 0;
 
-    } else if (uw_is_map(value)) {
-        return estimate_map_length(value, indent, depth, max_char_size);
+[[ gnu::constructor ]]
+static void init_json_plan_type()
+{
+    if (UwTypeId_JsonPlan == 0) {
+        UwTypeId_JsonPlan = uw_subtype(
+            &json_plan_type, "JsonPlan", UwTypeId_Struct, _UwJsonPlan
+        );
+        json_plan_type.init = json_plan_init;
+        json_plan_type.fini = json_plan_fini;
     }
-    // bad type
-    return 0;
 }
 
-static bool value_to_json(UwValuePtr value, unsigned indent, unsigned depth, UwValuePtr result)
-/*
- * Append serialized value to `result`.
- *
- * Return false if OOM.
+UwResult uw_json_plan(UwValuePtr shape)
+{
+    UwJsonPlanCtorArgs args = { .shape = shape };
+    return uw_create2(UwTypeId_JsonPlan, &args);
+}
+
+/****************************************************************
+ * Conversion of output to string
  */
+
+static UwResult output_to_string(JsonOutput* out)
 {
-    if (uw_is_null(value)) {
-        return uw_string_append(result, "null");
+    // find max byte to get char size
+    // and count non-continuation bytes to get length
+
+    char8_t* data = out->data;
+    unsigned size = out->size;
+    char8_t max_byte = 0;
+    unsigned num_continuation = 0;
+    for (unsigned i = 0; i < size; i++) {
+        char8_t c = data[i];
+        if (c > max_byte) {
+            max_byte = c;
+        }
+        num_continuation += (c & 0xC0) == 0x80;
     }
-    if (uw_is_bool(value)) {
-        return uw_string_append(result, (value->bool_value)? "true" : "false");
+    if (max_byte < 0x80) {
+        // ASCII
+        UwValue result = uw_create_empty_string(size, 1);
+        uw_return_if_error(&result);
+        memcpy(_uw_string_start(&result), data, size);
+        _uw_string_set_length(&result, size);
+        return uw_move(&result);
     }
-    if (uw_is_signed(value)) {
-        char buf[24];
-        snprintf(buf, sizeof(buf), "%zd", value->signed_value);
-        return uw_string_append(result, buf);
+    uint8_t char_size;
+    if (max_byte < 0xC4) {
+        char_size = 1;  // up to U+00FF
+    } else if (max_byte < 0xF0) {
+        char_size = 2;  // up to U+FFFF
+    } else {
+        char_size = 3;  // up to U+10FFFF
     }
-    if (uw_is_unsigned(value)) {
-        char buf[24];
-        snprintf(buf, sizeof(buf), "%zu", value->unsigned_value);
-        return uw_string_append(result, buf);
+    unsigned length = size - num_continuation;
+    UwValue result = uw_create_empty_string(length, char_size);
+    uw_return_if_error(&result);
+    uint8_t* dest = _uw_string_start(&result);
+    char8_t* end = data + size;
+    while (data < end) {
+        char32_t c;
+        if (*data < 0x80) {
+            c = *data++;
+        } else {
+            unsigned remaining = end - data;
+            read_utf8_buffer(&data, &remaining, &c);
+        }
+        _uw_put_char(dest, c, char_size);
+        dest += char_size;
     }
-    if (uw_is_float(value)) {
-        char buf[320];
-        snprintf(buf, sizeof(buf), "%f", value->float_value);
-        return uw_string_append(result, buf);
+    _uw_string_set_length(&result, length);
+    return uw_move(&result);
+}
+
+static UwResult encode(JsonOutput* out, UwValuePtr value, unsigned indent, UwValuePtr plan)
+{
+    if (plan) {
+        return plan_value_to_json(out, get_plan_ptr(plan), value);
+    } else {
+        return value_to_json(out, value, indent, 1);
     }
-    if (uw_is_charptr(value) || uw_is_string(value)) {
-        UwValue escaped = escape_string(value);
-        if (uw_error(&escaped)) {
-            return false;
-        }
-        if (uw_string_append(result, '"')) {
-            if (uw_string_append(result, &escaped)) {
-                return uw_string_append(result, '"');
-            }
-        }
-        return false;
+}
+
+static UwResult encode_to_string(UwValuePtr value, unsigned indent, UwValuePtr plan)
+{
+    JsonOutput out = {};
+
+    UwValue status = encode(&out, value, indent, plan);
+    if (uw_ok(&status)) {
+        status = output_to_string(&out);
     }
-    if (uw_is_array(value)) {
-        return array_to_json(value, indent, depth, result);
+    if (out.data) {
+        release((void**) &out.data, out.capacity);
     }
-    if (uw_is_map(value)) {
-        return map_to_json(value, indent, depth, result);
+    return uw_move(&status);
+}
+
+static UwResult encode_to_sink(UwValuePtr value, unsigned indent, UwValuePtr plan, UwSink* sink)
+{
+    JsonOutput out = {
+        .data     = allocate(SINK_BUFFER_SIZE, false),
+        .capacity = SINK_BUFFER_SIZE,
+        .sink     = sink
+    };
+    if (!out.data) {
+        return UwOOM();
+    }
+    UwValue status = encode(&out, value, indent, plan);
+    if (uw_ok(&status) && !flush(&out)) {
+        status = uw_move(&out.error);
     }
-    uw_panic("Incompatible type for JSON");
+    release((void**) &out.data, out.capacity);
+    return uw_move(&status);
 }
 
 UwResult uw_to_json(UwValuePtr value, unsigned indent)
 {
-    uint8_t max_char_size = 1;
-    unsigned estimated_len = estimate_length(value, indent, 1, &max_char_size);
-    if (estimated_len == 0) {
-        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
-    }
+    return encode_to_string(value, indent, nullptr);
+}
 
-    UwValue result = uw_create_empty_string(estimated_len, max_char_size);
-    uw_return_if_error(&result);
+UwResult uw_to_json_write(UwValuePtr value, unsigned indent, UwSink* sink)
+{
+    return encode_to_sink(value, indent, nullptr, sink);
+}
 
-    if (!value_to_json(value, indent, 1, &result)) {
-        return UwOOM();
-    }
-    return uw_move(&result);
+UwResult uw_json_plan_to_json(UwValuePtr plan, UwValuePtr value)
+{
+    return encode_to_string(value, 0, plan);
+}
+
+UwResult uw_json_plan_write(UwValuePtr plan, UwValuePtr value, UwSink* sink)
+{
+    return encode_to_sink(value, 0, plan, sink);
 }
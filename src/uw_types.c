@@ -1,4 +1,5 @@
 #include <stdarg.h>
+#include <string.h>
 
 #include <libpussy/mmarray.h>
 
@@ -770,6 +771,31 @@ static UwType* basic_types[] = {
     [UwTypeId_Map]       = &_uw_map_type
 };
 
+static void init_ancestry(UwType* type)
+/*
+ * Initialize ancestry display of `type` from its ancestor.
+ */
+{
+    memset(type->ancestors, 0, sizeof(type->ancestors));
+    if (type->ancestor_id == UwTypeId_Null) {
+        type->depth = 0;
+    } else {
+        UwType* ancestor = _uw_types[type->ancestor_id];
+        type->depth = ancestor->depth + 1;
+        if (type->depth >= UW_MAX_TYPE_DEPTH) {
+            uw_panic("Type %s is nested too deep\n", type->name);
+        }
+        memcpy(type->ancestors, ancestor->ancestors, type->depth * sizeof(UwTypeId));
+    }
+    type->ancestors[type->depth] = type->id;
+}
+
+static void init_traits(UwType* type)
+{
+    type->trivially_destructible = type->destroy == nullptr;
+    type->trivially_clonable = type->clone == nullptr && type->deepcopy == nullptr;
+}
+
 [[ gnu::constructor ]]
 void _uw_init_types()
 {
@@ -789,6 +815,11 @@ void _uw_init_types()
         }
         _uw_types[i] = t;
     }
+    // ancestors of basic types precede them in the list
+    for(UwTypeId i = 0; i < num_uw_types; i++) {
+        init_ancestry(_uw_types[i]);
+        init_traits(_uw_types[i]);
+    }
 }
 
 static UwTypeId add_type(UwType* type)
@@ -799,6 +830,8 @@ static UwTypeId add_type(UwType* type)
     _uw_types = mmarray_append_item(_uw_types, &type);
     UwTypeId type_id = num_uw_types++;
     type->id = type_id;
+    init_ancestry(type);
+    init_traits(type);
     return type_id;
 }
 
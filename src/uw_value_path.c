@@ -0,0 +1,361 @@
+#include <limits.h>
+#include <string.h>
+
+#include "include/uw_value_path.h"
+
+#include "src/uw_array_internal.h"
+#include "src/uw_map_internal.h"
+#include "src/uw_struct_internal.h"
+
+typedef struct {
+    _UwValue    key;    // String, or Null if the step is array index only
+    UwType_Hash hash;   // hash of key
+    unsigned    index;  // array index, or UINT_MAX if the step is map key only
+} _UwPathStep;
+
+typedef struct {
+    _UwPathStep* steps;
+    unsigned     num_steps;
+    unsigned     capacity;
+} _UwValuePath;
+
+#define get_data_ptr(value)  ((_UwValuePath*) _uw_get_data_ptr((value), UwTypeId_ValuePath))
+
+/****************************************************************
+ * Compiler
+ */
+
+static UwResult bad_path(char8_t* expression, char8_t* ptr, char* message)
+{
+    unsigned position = 1;
+    for (char8_t* p = expression; p < ptr; p++) {
+        if ((*p & 0xC0) != 0x80) {
+            position++;
+        }
+    }
+    UwValue status = UwError(UW_ERROR_BAD_PATH);
+    _uw_set_status_desc(&status, "position %u: %s", position, message);
+    return uw_move(&status);
+}
+
+static unsigned parse_index(char8_t* name, unsigned length)
+/*
+ * Return array index if `name` is a decimal number without leading zeros,
+ * UINT_MAX otherwise.
+ */
+{
+    if (length == 0 || (name[0] == '0' && length > 1)) {
+        return UINT_MAX;
+    }
+    unsigned result = 0;
+    for (unsigned i = 0; i < length; i++) {
+        char8_t c = name[i];
+        if (c < '0' || c > '9') {
+            return UINT_MAX;
+        }
+        unsigned digit = c - '0';
+        if (result > (UINT_MAX - 1 - digit) / 10) {
+            return UINT_MAX;
+        }
+        result = result * 10 + digit;
+    }
+    return result;
+}
+
+static UwResult add_step(_UwValuePath* path, char8_t* name, unsigned length, bool is_key, bool is_index)
+{
+    _UwPathStep* step = &path->steps[path->num_steps];
+    step->index = is_index? parse_index(name, length) : UINT_MAX;
+    if (is_key) {
+        UwValue key = UwString();
+        unsigned processed;
+        if (!uw_string_append_utf8(&key, name, length, &processed)) {
+            return UwOOM();
+        }
+        step->hash = uw_hash(&key);
+        step->key = uw_move(&key);
+    }
+    path->num_steps++;
+    return UwOK();
+}
+
+static UwResult compile_pointer(_UwValuePath* path, char8_t* expression, char8_t* name)
+/*
+ * Compile JSON Pointer.
+ * `name` is a buffer for unescaped names.
+ */
+{
+    char8_t* p = expression;
+    while (*p == '/') {
+        p++;
+        unsigned length = 0;
+        while (*p && *p != '/') {
+            if (*p == '~') {
+                if (p[1] == '0') {
+                    name[length++] = '~';
+                } else if (p[1] == '1') {
+                    name[length++] = '/';
+                } else {
+                    return bad_path(expression, p, "bad escape sequence");
+                }
+                p += 2;
+            } else {
+                name[length++] = *p++;
+            }
+        }
+        uw_expect_ok( add_step(path, name, length, true, true) );
+    }
+    return UwOK();
+}
+
+static UwResult compile_dotted(_UwValuePath* path, char8_t* expression, char8_t* name)
+/*
+ * Compile dotted names and brackets.
+ * `name` is a buffer for unescaped names.
+ */
+{
+    char8_t* p = expression;
+    bool first = true;
+    while (*p) {
+        if (*p == '[') {
+            p++;
+            if (*p == '"' || *p == '\'') {
+                // quoted key
+                char8_t quote = *p++;
+                unsigned length = 0;
+                while (*p != quote) {
+                    if (*p == '\\') {
+                        p++;
+                    }
+                    if (*p == 0) {
+                        return bad_path(expression, p, "unterminated string");
+                    }
+                    name[length++] = *p++;
+                }
+                p++;
+                if (*p != ']') {
+                    return bad_path(expression, p, "expected ]");
+                }
+                p++;
+                uw_expect_ok( add_step(path, name, length, true, false) );
+            } else {
+                // index
+                char8_t* start = p;
+                while (*p >= '0' && *p <= '9') {
+                    p++;
+                }
+                if (parse_index(start, p - start) == UINT_MAX) {
+                    return bad_path(expression, start, "bad index");
+                }
+                if (*p != ']') {
+                    return bad_path(expression, p, "expected ]");
+                }
+                uw_expect_ok( add_step(path, start, p - start, false, true) );
+                p++;
+            }
+        } else {
+            if (!first) {
+                if (*p != '.') {
+                    return bad_path(expression, p, "expected . or [");
+                }
+                p++;
+            }
+            char8_t* start = p;
+            while (*p && *p != '.' && *p != '[') {
+                p++;
+            }
+            if (p == start) {
+                return bad_path(expression, p, "empty name");
+            }
+            uw_expect_ok( add_step(path, start, p - start, true, true) );
+        }
+        first = false;
+    }
+    return UwOK();
+}
+
+static UwResult compile(_UwValuePath* path, char8_t* expression)
+{
+    // each step starts with a separator, except the first one
+    size_t size = 0;
+    unsigned max_steps = 1;
+    for (char8_t* p = expression; *p; p++) {
+        size++;
+        max_steps += (*p == '/' || *p == '.' || *p == '[');
+    }
+    if (max_steps > UINT_MAX / sizeof(_UwPathStep)) {
+        return UwError(UW_ERROR_DATA_SIZE_TOO_BIG);
+    }
+    path->steps = allocate(max_steps * sizeof(_UwPathStep), true);
+    if (!path->steps) {
+        return UwOOM();
+    }
+    path->capacity = max_steps;
+
+    char8_t name[size + 1];
+    if (expression[0] == '/') {
+        return compile_pointer(path, expression, name);
+    } else {
+        return compile_dotted(path, expression, name);
+    }
+}
+
+/****************************************************************
+ * Evaluation
+ */
+
+static inline UwValuePtr eval_step(_UwPathStep* step, UwValuePtr node)
+{
+    if (uw_is_map(node)) {
+        if (uw_is_null(&step->key)) {
+            return nullptr;
+        }
+        return _uw_map_get_hashed(node, &step->key, step->hash);
+    }
+    if (uw_is_array(node)) {
+        _UwArray* array_data = get_array_data_ptr(node);
+        if (step->index >= array_data->length) {
+            return nullptr;
+        }
+        return &array_data->items[step->index];
+    }
+    return nullptr;
+}
+
+static inline bool step_equal(_UwPathStep* a, _UwPathStep* b)
+{
+    return a->hash == b->hash && a->index == b->index && _uw_equal(&a->key, &b->key);
+}
+
+/****************************************************************
+ * Basic interface methods
+ */
+
+static void value_path_fini(UwValuePtr self)
+{
+    _UwValuePath* path = get_data_ptr(self);
+
+    if (path->steps) {
+        for (unsigned i = 0; i < path->num_steps; i++) {
+            uw_destroy(&path->steps[i].key);
+        }
+        release((void**) &path->steps, path->capacity * sizeof(_UwPathStep));
+    }
+}
+
+static UwResult value_path_init(UwValuePtr self, void* ctor_args)
+{
+    UwValuePathCtorArgs* args = ctor_args;
+    _UwValuePath* path = get_data_ptr(self);
+
+    if (!args || !args->expression) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    UwValuePtr expression = args->expression;
+    if (uw_is_charptr(expression) && expression->charptr_subtype == UW_CHARPTR) {
+        return compile(path, expression->charptr);
+    }
+    if (!uw_is_string(expression) && !uw_is_charptr(expression)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    UwValue str = uw_clone(expression);  // this converts CharPtr to string
+    uw_return_if_error(&str);
+    UW_CSTRING_LOCAL(expr, &str);
+    return compile(path, (char8_t*) expr);
+}
+
+/****************************************************************
+ * ValuePath type
+ */
+
+static UwType value_path_type;
+
+UwTypeId UwTypeId_ValuePath = 0;
+
+[[ gnu::constructor ]]
+static void init_value_path_type()
+{
+    if (UwTypeId_ValuePath == 0) {
+        UwTypeId_ValuePath = uw_subtype(
+            &value_path_type, "ValuePath", UwTypeId_Struct, _UwValuePath
+        );
+        value_path_type.init = value_path_init;
+        value_path_type.fini = value_path_fini;
+    }
+}
+
+/****************************************************************
+ * ValuePath functions
+ */
+
+UwResult _uw_value_path(UwValuePtr expression)
+{
+    UwValuePathCtorArgs args = { .expression = expression };
+    return uw_create2(UwTypeId_ValuePath, &args);
+}
+
+unsigned uw_value_path_length(UwValuePtr path)
+{
+    return get_data_ptr(path)->num_steps;
+}
+
+UwValuePtr uw_value_path_get(UwValuePtr path, UwValuePtr value)
+{
+    _UwValuePath* p = get_data_ptr(path);
+    UwValuePtr node = value;
+    for (unsigned i = 0; i < p->num_steps && node; i++) {
+        node = eval_step(&p->steps[i], node);
+    }
+    return node;
+}
+
+unsigned uw_value_path_get_many(UwValuePtr paths, UwValuePtr value, UwValuePtr* results)
+{
+    uw_assert_array(paths);
+    _UwArray* array_data = get_array_data_ptr(paths);
+
+    unsigned max_steps = 0;
+    for (unsigned i = 0; i < array_data->length; i++) {
+        unsigned n = get_data_ptr(&array_data->items[i])->num_steps;
+        if (n > max_steps) {
+            max_steps = n;
+        }
+    }
+
+    // nodes reached by the previous path, nodes[0] is the value itself
+    UwValuePtr nodes[max_steps + 1];
+    unsigned num_nodes = 1;
+    nodes[0] = value;
+
+    _UwValuePath* prev = nullptr;
+    unsigned num_found = 0;
+    for (unsigned i = 0; i < array_data->length; i++) {
+        _UwValuePath* path = get_data_ptr(&array_data->items[i]);
+
+        // skip common prefix
+        unsigned depth = 0;
+        if (prev) {
+            unsigned limit = num_nodes - 1;
+            if (limit > path->num_steps) {
+                limit = path->num_steps;
+            }
+            while (depth < limit && step_equal(&prev->steps[depth], &path->steps[depth])) {
+                depth++;
+            }
+        }
+        num_nodes = depth + 1;
+
+        UwValuePtr node = nodes[depth];
+        for (; depth < path->num_steps; depth++) {
+            node = eval_step(&path->steps[depth], node);
+            if (!node) {
+                break;
+            }
+            nodes[num_nodes++] = node;
+        }
+        results[i] = node;
+        num_found += (node != nullptr);
+        prev = path;
+    }
+    return num_found;
+}
@@ -1,11 +1,28 @@
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "include/uw.h"
+#include "include/uw_arena.h"
 #include "include/uw_args.h"
+#include "include/uw_async_read.h"
+#include "include/uw_cbor.h"
 #include "include/uw_datetime.h"
+#include "include/uw_freeze.h"
+#include "include/uw_from_json.h"
+#include "include/uw_json_doc.h"
+#include "include/uw_json_sax.h"
+#include "include/uw_msgpack.h"
+#include "include/uw_ndjson.h"
 #include "include/uw_netutils.h"
+#include "include/uw_parallel_lines.h"
+#include "include/uw_snapshot.h"
 #include "include/uw_to_json.h"
+#include "include/uw_value_path.h"
+#include "src/uw_map_internal.h"
 #include "src/uw_string_internal.h"
 
 int num_tests = 0;
@@ -39,6 +56,516 @@ void test_icu()
 #   endif
 }
 
+void test_slab_allocator()
+{
+    Allocator* a = &uw_slab_allocator;
+    uw_slab_update_stats();
+    size_t num_blocks = a->stats->blocks_allocated;
+
+    // blocks of the same class are reused
+    char* p = a->allocate(40, true);
+    TEST(p != nullptr);
+    for (unsigned i = 0; i < 40; i++) {
+        TEST(p[i] == 0);
+    }
+    memset(p, 'x', 40);
+    char* saved = p;
+    a->release((void**) &p, 40);
+    TEST(p == nullptr);
+    p = a->allocate(33, true);
+    TEST(p == saved);
+    for (unsigned i = 0; i < 33; i++) {
+        TEST(p[i] == 0);
+    }
+
+    // reallocate within the class keeps the block
+    memset(p, 'y', 33);
+    TEST(a->reallocate((void**) &p, 33, 48, true, nullptr));
+    TEST(p == saved);
+    TEST(p[32] == 'y' && p[33] == 0 && p[47] == 0);
+    uw_slab_update_stats();
+    TEST(a->stats->blocks_allocated == num_blocks + 1);
+
+    // to another class and to large block, and back
+    unsigned actual = 0;
+    TEST(a->reallocate((void**) &p, 48, 200, true, &actual));
+    TEST(actual == 200);
+    TEST(p[0] == 'y' && p[47] == 0 && p[199] == 0);
+    TEST(a->reallocate((void**) &p, 200, 5000, true, nullptr));
+    TEST(p[0] == 'y' && p[4999] == 0);
+    TEST(a->reallocate((void**) &p, 5000, 10000, false, nullptr));
+    TEST(p[0] == 'y');
+    TEST(a->reallocate((void**) &p, 10000, 16, false, nullptr));
+    TEST(p[0] == 'y' && p[15] == 'y');
+    a->release((void**) &p, 16);
+    uw_slab_update_stats();
+    TEST(a->stats->blocks_allocated == num_blocks);
+
+    // many blocks span slabs and do not overlap
+    unsigned n = 3 * UW_SLAB_SIZE / 64;
+    uint32_t** blocks = malloc(n * sizeof(uint32_t*));
+    for (unsigned i = 0; i < n; i++) {
+        blocks[i] = a->allocate(64, false);
+        TEST(blocks[i] != nullptr);
+        blocks[i][0] = i;
+        blocks[i][15] = i;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        TEST(blocks[i][0] == i && blocks[i][15] == i);
+        a->release((void**) &blocks[i], 64);
+    }
+    free(blocks);
+    uw_slab_update_stats();
+    TEST(a->stats->blocks_allocated == num_blocks);
+
+    // struct types use slab allocator
+    TEST(_uw_types[UwTypeId_Array]->allocator == a);
+    TEST(_uw_types[UwTypeId_Map]->allocator == a);
+}
+
+void* string_pool_thread(void* arg)
+{
+    // leave free blocks in thread cache, it is adopted by another thread after exit
+    for (unsigned i = 0; i < 100; i++) {{
+        UwValue s = uw_create_string("a string that does not fit into value");
+        uw_string_append(&s, (char*) arg);
+    }}
+    return nullptr;
+}
+
+void test_string_pool()
+{
+    Allocator* a = &uw_string_pool_allocator;
+    uw_slab_update_stats();
+    size_t num_blocks = a->stats->blocks_allocated;
+
+    // realloc within size class does not move
+    char* p = a->allocate(130, false);
+    char* saved = p;
+    TEST(a->reallocate((void**) &p, 130, 160, false, nullptr));
+    TEST(p == saved);
+    TEST(a->reallocate((void**) &p, 160, 161, false, nullptr));
+    TEST(p != saved);
+    saved = p;
+    TEST(a->reallocate((void**) &p, 161, 192, false, nullptr));
+    TEST(p == saved);
+    TEST(a->reallocate((void**) &p, 192, 2000, false, nullptr));
+    a->release((void**) &p, 2000);
+
+    // growing string within size class
+    UwValue grown = uw_create_empty_string(130, 1);  // 144 bytes
+    _UwStringData* sdata = grown.string_data;
+    for (unsigned i = 0; i < 150; i++) {  // 160 bytes
+        uw_string_append(&grown, 'x');
+    }
+    TEST(grown.string_data == sdata);
+    TEST(uw_strlen(&grown) == 150);
+    uw_destroy(&grown);
+
+    // released blocks are reused
+    p = a->allocate(100, false);
+    saved = p;
+    a->release((void**) &p, 100);
+    p = a->allocate(100, false);
+    TEST(p == saved);
+    a->release((void**) &p, 100);
+
+    // many blocks and blocks released by other threads
+    unsigned n = 160;
+    void** blocks = malloc(n * sizeof(void*));
+    for (unsigned i = 0; i < n; i++) {
+        blocks[i] = a->allocate(48, true);
+        TEST(blocks[i] != nullptr);
+    }
+    for (unsigned i = 0; i < n; i++) {
+        a->release(&blocks[i], 48);
+    }
+    free(blocks);
+
+    pthread_t threads[4];
+    for (unsigned i = 0; i < UW_LENGTH(threads); i++) {
+        TEST(pthread_create(&threads[i], nullptr, string_pool_thread, "appended to make it longer") == 0);
+    }
+    for (unsigned i = 0; i < UW_LENGTH(threads); i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    uw_slab_update_stats();
+    TEST(a->stats->blocks_allocated == num_blocks);
+    TEST(_uw_types[UwTypeId_String]->allocator == a);
+}
+
+void* release_block_thread(void* arg)
+{
+    uw_slab_allocator.release((void**) arg, 80);
+    return nullptr;
+}
+
+void* remote_free_thread(void* arg)
+/*
+ * Release block in another thread and return it if it's allocated again.
+ */
+{
+    Allocator* a = &uw_slab_allocator;
+    void* block = a->allocate(80, false);
+    void* saved = block;
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, release_block_thread, &block)) {
+        return nullptr;
+    }
+    pthread_join(thread, nullptr);
+
+    // the block is returned to this thread when its free list is exhausted
+    unsigned max_blocks = 100000;
+    void** blocks = malloc(max_blocks * sizeof(void*));
+    unsigned n = 0;
+    bool found = false;
+    while (n < max_blocks && !found) {
+        blocks[n] = a->allocate(80, false);
+        found = blocks[n++] == saved;
+    }
+    while (n) {
+        a->release(&blocks[--n], 80);
+    }
+    free(blocks);
+    return found? saved : nullptr;
+}
+
+static pthread_key_t late_destructor_key;
+
+void late_destructor(void* block)
+/*
+ * Runs after the destructor of slab thread caches.
+ */
+{
+    Allocator* a = &uw_slab_allocator;
+    a->release(&block, 80);
+    void* another = a->allocate(80, false);
+    a->release(&another, 80);
+}
+
+void* late_destructor_thread(void* arg)
+{
+    pthread_setspecific(late_destructor_key, uw_slab_allocator.allocate(80, false));
+    return nullptr;
+}
+
+void test_remote_free()
+{
+    uw_slab_update_stats();
+    size_t num_blocks = uw_slab_allocator.stats->blocks_allocated;
+
+    pthread_t thread;
+    void* found;
+    TEST(pthread_create(&thread, nullptr, remote_free_thread, nullptr) == 0);
+    pthread_join(thread, &found);
+    TEST(found != nullptr);
+
+    // blocks released and allocated by TLS destructors of exiting thread
+    TEST(pthread_key_create(&late_destructor_key, late_destructor) == 0);
+    for (unsigned i = 0; i < 4; i++) {
+        TEST(pthread_create(&thread, nullptr, late_destructor_thread, nullptr) == 0);
+        pthread_join(thread, nullptr);
+    }
+    pthread_key_delete(late_destructor_key);
+
+    uw_slab_update_stats();
+    TEST(uw_slab_allocator.stats->blocks_allocated == num_blocks);
+}
+
+#ifdef UW_ATOMIC_REFCOUNT
+
+void* clone_destroy_thread(void* arg)
+{
+    UwValuePtr values = arg;
+    for (unsigned i = 0; i < 100000; i++) {{
+        UwValue str = uw_clone(&values[0]);
+        UwValue list = uw_clone(&values[1]);
+    }}
+    return nullptr;
+}
+
+void* upper_thread(void* arg)
+{
+    uw_string_upper((UwValuePtr) arg);
+    return nullptr;
+}
+
+void test_atomic_refcount()
+{
+    _UwValue values[2] = {
+        uw_create_string("this string is too long to be embedded"),
+        UwArray(UwSigned(1), UwSigned(2), UwSigned(3))
+    };
+    pthread_t threads[4];
+    for (unsigned i = 0; i < UW_LENGTH(threads); i++) {
+        TEST(pthread_create(&threads[i], nullptr, clone_destroy_thread, values) == 0);
+    }
+    for (unsigned i = 0; i < UW_LENGTH(threads); i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    TEST(values[0].string_data->refcount == 1);
+    TEST(values[1].struct_data->refcount == 1);
+    uw_destroy(&values[0]);
+    uw_destroy(&values[1]);
+
+    // both holders copy shared string data before modification,
+    // the one that drops the last reference releases the original
+    for (unsigned i = 0; i < 1000; i++) {{
+        UwValue a = uw_create_string("this string is too long to be embedded");
+        UwValue b = uw_clone(&a);
+        pthread_t thread;
+        TEST(pthread_create(&thread, nullptr, upper_thread, &b) == 0);
+        TEST(uw_string_upper(&a));
+        pthread_join(thread, nullptr);
+        TEST(uw_equal(&a, &b));
+    }}
+}
+
+#endif
+
+void test_arena()
+{
+    UwValue outside_str = uw_create_string("this string is too long to be embedded");
+    UwValue outside_list = UwArray(UwSigned(1), UwSigned(2), UwSigned(3));
+    UwValue exported = UwNull();
+    TEST(!uw_in_arena(&outside_str));
+
+    UwValue status = uw_arena_begin();
+    TEST(uw_ok(&status));
+    {
+        UwValue map = UwMap();
+        UwValue list = UwArray();
+        TEST(uw_in_arena(&map));
+        TEST(uw_in_arena(&list));
+
+        // containers grow in the arena
+        for (unsigned i = 0; i < 1000; i++) {
+            UwValue item = uw_create_string("this string is allocated in the arena");
+            TEST(uw_in_arena(&item));
+            TEST(uw_string_append(&item, 'x'));
+            TEST(uw_in_arena(&item));
+            UwValue status = uw_array_append(&list, &item);
+            TEST(uw_ok(&status));
+        }
+        TEST(uw_array_length(&list) == 1000);
+
+        // values from outside are copied
+        UwValue status = uw_array_append(&list, &outside_list);
+        TEST(uw_ok(&status));
+        UwValue last = uw_array_item(&list, -1);
+        TEST(uw_in_arena(&last));
+        TEST(uw_equal(&last, &outside_list));
+        TEST(outside_list.struct_data->refcount == 1);
+
+        status = uw_array_set_item(&list, 0, &outside_str);
+        TEST(uw_ok(&status));
+        UwValue first = uw_array_item(&list, 0);
+        TEST(uw_in_arena(&first));
+        TEST(uw_equal(&first, &outside_str));
+        TEST(outside_str.string_data->refcount == 1);
+
+        status = uw_map_update_va(&map, UwCharPtr("list"), uw_clone(&list), UwCharPtr("number"), UwSigned(42));
+        TEST(uw_ok(&status));
+        status = uw_map_update_va(&map, UwCharPtr("outside"), uw_clone(&outside_list));
+        TEST(uw_ok(&status));
+
+        // values created in nested arena are copied to outer containers
+        status = uw_arena_begin();
+        TEST(uw_ok(&status));
+        {
+            UwValue inner = uw_create_string("this string is allocated in the nested arena");
+            UwValue status = uw_map_update_va(&map, UwCharPtr("inner"), uw_clone(&inner));
+            TEST(uw_ok(&status));
+        }
+        uw_arena_end();
+        UwValue inner = uw_map_get(&map, "inner");
+        TEST(uw_equal(&inner, "this string is allocated in the nested arena"));
+
+        // destroying arena values does nothing
+        UwValue clone = uw_clone(&list);
+        uw_destroy(&clone);
+        TEST(uw_array_length(&list) == 1001);
+
+        exported = uw_arena_export(&map);
+        TEST(!uw_in_arena(&exported));
+        TEST(uw_equal(&exported, &map));
+    }
+    uw_arena_end();
+
+    UwValue exported_list = uw_map_get(&exported, "list");
+    TEST(uw_array_length(&exported_list) == 1001);
+    UwValue item = uw_array_item(&exported_list, 1);
+    TEST(uw_equal(&item, "this string is allocated in the arenax"));
+
+    // memory of ended arena is reused
+    for (unsigned i = 0; i < 2; i++) {
+        UwValue status = uw_arena_begin();
+        TEST(uw_ok(&status));
+        {
+            UwValue list = UwArray();
+            UwValue str = uw_create_string("this string grows in place");
+            for (unsigned j = 0; j < 100; j++) {
+                UwValue status = uw_array_append(&list, j);
+                TEST(uw_ok(&status));
+            }
+            for (unsigned j = 0; j < 100; j++) {
+                TEST(uw_string_append(&str, "0123456789"));
+            }
+            UwValue item = uw_array_item(&list, 50);
+            TEST(uw_equal(&item, 50));
+            TEST(uw_strlen(&str) == 1026);
+            TEST(uw_char_at(&str, 1025) == '9');
+        }
+        uw_arena_end();
+    }
+
+    // copies made for containers from outside are not allocated in arena
+    UwValue outside_map = UwMap();
+    UwValue long_key = uw_create_string("this key is too long to be embedded");
+    UwValue one = UwSigned(1);
+    UwValue error = UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    status = uw_arena_begin();
+    TEST(uw_ok(&status));
+    {
+        UwValue status = uw_map_update(&outside_map, &long_key, &one);
+        TEST(uw_ok(&status));
+        status = uw_map_update_va(&outside_map, UwCharPtr("key made of CharPtr"), UwCharPtr("value made of CharPtr"));
+        TEST(uw_ok(&status));
+        status = uw_array_append(&outside_list, "string made of CharPtr");
+        TEST(uw_ok(&status));
+        status = uw_array_append_va(&outside_list, UwCharPtr("another string made of CharPtr"));
+        TEST(uw_ok(&status));
+        _uw_set_status_desc(&error, "description of status created in arena scope");
+
+        // and copies made for arena containers are allocated in their arena
+        UwValue arena_map = UwMap();
+        status = uw_map_update(&arena_map, &long_key, &one);
+        TEST(uw_ok(&status));
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        TEST(uw_map_item(&arena_map, 0, &key, &value));
+        TEST(uw_in_arena(&key));
+    }
+    uw_arena_end();
+    {
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        TEST(uw_map_item(&outside_map, 0, &key, &value));
+        TEST(!uw_in_arena(&key));
+        TEST(uw_equal(&key, &long_key));
+        UwValue value2 = uw_map_get(&outside_map, "key made of CharPtr");
+        TEST(!uw_in_arena(&value2));
+        TEST(uw_equal(&value2, "value made of CharPtr"));
+        UwValue item = uw_array_item(&outside_list, -2);
+        TEST(!uw_in_arena(&item));
+        TEST(uw_equal(&item, "string made of CharPtr"));
+        UwValue item2 = uw_array_item(&outside_list, -1);
+        TEST(!uw_in_arena(&item2));
+        TEST(uw_equal(&item2, "another string made of CharPtr"));
+        TEST(!uw_in_arena(&error.status_data->description));
+        TEST(uw_equal(&error.status_data->description, "description of status created in arena scope"));
+    }
+}
+
+typedef struct {
+    unsigned dummy;
+} TestMapData;
+
+static UwType test_map_type;
+static UwType test_submap_type;
+
+void test_subtypes()
+{
+    UwTypeId UwTypeId_TestMap = uw_subtype(&test_map_type, "TestMap", UwTypeId_Map, TestMapData);
+    UwTypeId UwTypeId_TestSubMap = uw_subtype(&test_submap_type, "TestSubMap", UwTypeId_TestMap, TestMapData);
+
+    TEST(test_submap_type.depth == _uw_types[UwTypeId_Map]->depth + 2);
+    TEST(test_submap_type.ancestors[0] == UwTypeId_Struct);
+    TEST(test_submap_type.ancestors[test_submap_type.depth] == UwTypeId_TestSubMap);
+
+    UwValue submap = uw_create(UwTypeId_TestSubMap);
+    TEST(uw_ok(&submap));
+    TEST(uw_is_subtype(&submap, UwTypeId_TestSubMap));
+    TEST(uw_is_subtype(&submap, UwTypeId_TestMap));
+    TEST(uw_is_map(&submap));
+    TEST(uw_is_compound(&submap));
+    TEST(uw_is_struct(&submap));
+    TEST(!uw_is_array(&submap));
+    TEST(!uw_is_string(&submap));
+    TEST(!uw_is_null(&submap));
+    TEST(!uw_is_status(&submap));
+
+    UwValue map = UwMap();
+    TEST(uw_is_map(&map));
+    TEST(!uw_is_subtype(&map, UwTypeId_TestMap));
+    TEST(!uw_is_subtype(&map, UwTypeId_TestSubMap));
+
+    UwValue null = UwNull();
+    TEST(uw_is_null(&null));
+    TEST(!uw_is_struct(&null));
+    UwValue signed_value = UwSigned(1);
+    TEST(uw_is_int(&signed_value));
+    TEST(!uw_is_unsigned(&signed_value));
+    TEST(!uw_is_null(&signed_value));
+}
+
+typedef unsigned (*TestMethodGetNumber)(UwValuePtr self);
+
+typedef struct {
+    TestMethodGetNumber get_number;
+} UwInterface_Test;
+
+static unsigned get_number_1(UwValuePtr self) { return 1; }
+static unsigned get_number_2(UwValuePtr self) { return 2; }
+static unsigned get_number_3(UwValuePtr self) { return 3; }
+
+static UwType test_interfaces_type;
+static UwType test_interfaces_subtype;
+
+void test_interfaces()
+{
+    // register enough interfaces for some of them to be looked up in hash table
+    unsigned ids[100];
+    for (unsigned i = 0; i < UW_LENGTH(ids); i++) {
+        ids[i] = uw_register_interface("Test", UwInterface_Test);
+    }
+    static UwInterface_Test iface_1 = { .get_number = get_number_1 };
+    static UwInterface_Test iface_2 = { .get_number = get_number_2 };
+    static UwInterface_Test iface_3 = { .get_number = get_number_3 };
+
+    UwTypeId type_id = uw_subtype(
+        &test_interfaces_type, "TestInterfaces", UwTypeId_Struct, TestMapData,
+        ids[0],  &iface_1,
+        ids[98], &iface_2,
+        ids[99], &iface_3
+    );
+    UwTypeId subtype_id = uw_subtype(
+        &test_interfaces_subtype, "TestInterfacesSubtype", type_id, TestMapData,
+        ids[98], &iface_3,
+        ids[50], &iface_1
+    );
+    UwValue value = uw_create(type_id);
+    TEST(uw_ok(&value));
+    TEST(((UwInterface_Test*) _uw_get_interface(value.type_id, ids[0]))->get_number(&value) == 1);
+    TEST(((UwInterface_Test*) _uw_get_interface(value.type_id, ids[98]))->get_number(&value) == 2);
+    TEST(((UwInterface_Test*) _uw_get_interface(value.type_id, ids[99]))->get_number(&value) == 3);
+    TEST(!_uw_has_interface(type_id, ids[1]));
+    TEST(!_uw_has_interface(type_id, ids[50]));
+    TEST(!_uw_has_interface(type_id, UwInterfaceId_LineReader));
+    TEST(!_uw_has_interface(type_id, ids[99] + 1000));
+
+    TEST(((UwInterface_Test*) _uw_get_interface(subtype_id, ids[0]))->get_number(&value) == 1);
+    TEST(((UwInterface_Test*) _uw_get_interface(subtype_id, ids[98]))->get_number(&value) == 3);
+    TEST(((UwInterface_Test*) _uw_get_interface(subtype_id, ids[99]))->get_number(&value) == 3);
+    TEST(((UwInterface_Test*) _uw_get_interface(subtype_id, ids[50]))->get_number(&value) == 1);
+    TEST(!_uw_has_interface(subtype_id, ids[51]));
+
+    // built-in types
+    TEST(_uw_has_interface(UwTypeId_File, UwInterfaceId_LineReader));
+    TEST(_uw_has_interface(UwTypeId_File, UwInterfaceId_FileWriter));
+    TEST(!_uw_has_interface(UwTypeId_String, UwInterfaceId_LineReader));
+}
+
 void test_integral_types()
 {
     // generics test
@@ -767,6 +1294,113 @@ void test_array()
         TEST(uw_equal(&v, " first line,second line,  third line"));
         //uw_dump(stderr, &v);
     }
+
+    { // trivial items
+        TEST(_uw_types[UwTypeId_Signed]->trivially_destructible);
+        TEST(_uw_types[UwTypeId_Signed]->trivially_clonable);
+        TEST(!_uw_types[UwTypeId_String]->trivially_destructible);
+        TEST(!_uw_types[UwTypeId_CharPtr]->trivially_clonable);
+        TEST(!_uw_types[UwTypeId_Array]->trivially_destructible);
+
+        UwValue array = UwArray(UwSigned(1), UwFloat(2.5), UwNull(), UwBool(true));
+        TEST(get_array_data_ptr(&array)->trivial_items);
+
+        UwValue copy = uw_deepcopy(&array);
+        TEST(get_array_data_ptr(&copy)->trivial_items);
+        TEST(uw_equal(&copy, &array));
+        UwValue slice = uw_array_slice(&array, 1, 3);
+        TEST(get_array_data_ptr(&slice)->trivial_items);
+        TEST(uw_array_length(&slice) == 2);
+        {
+            UwValue item = uw_array_item(&slice, 0);
+            TEST(uw_equal(&item, 2.5));
+        }
+
+        UwValue str = uw_create_string("this string is too long to be embedded");
+        UwValue status = uw_array_set_item(&array, 2, &str);
+        TEST(uw_ok(&status));
+        TEST(!get_array_data_ptr(&array)->trivial_items);
+        UwValue copy2 = uw_deepcopy(&array);
+        TEST(!get_array_data_ptr(&copy2)->trivial_items);
+        TEST(uw_equal(&copy2, &array));
+        UwValue slice2 = uw_array_slice(&array, 2, 4);
+        TEST(!get_array_data_ptr(&slice2)->trivial_items);
+        TEST(str.string_data->refcount == 3);
+
+        // the flag is restored when array becomes empty
+        uw_array_del(&array, 0, 3);
+        TEST(!get_array_data_ptr(&array)->trivial_items);
+        TEST(str.string_data->refcount == 2);
+        uw_array_clean(&array);
+        TEST(get_array_data_ptr(&array)->trivial_items);
+
+        status = uw_array_insert(&array, 0, &str);
+        TEST(uw_ok(&status));
+        TEST(!get_array_data_ptr(&array)->trivial_items);
+        UwValue popped = uw_array_pop(&array);
+        TEST(get_array_data_ptr(&array)->trivial_items);
+
+        UwValue map = UwMap(UwSigned(1), UwSigned(2));
+        _UwMap* map_data = _uw_get_data_ptr(&map, UwTypeId_Map);
+        TEST(map_data->kv_pairs.trivial_items);
+        status = uw_map_update_va(&map, UwSigned(1), uw_clone(&str));
+        TEST(uw_ok(&status));
+        TEST(!map_data->kv_pairs.trivial_items);
+    }
+
+    { // inline items
+        UwValue array = UwArray();
+        _UwArray* array_data = get_array_data_ptr(&array);
+        TEST(_uw_array_is_inline(array_data));
+        for (unsigned i = 0; i < UWARRAY_INLINE_CAPACITY; i++) {
+            uw_array_append(&array, "this string is too long to be embedded");
+        }
+        TEST(_uw_array_is_inline(array_data));
+        uw_array_append(&array, UWARRAY_INLINE_CAPACITY);
+        TEST(!_uw_array_is_inline(array_data));
+        TEST(uw_array_length(&array) == UWARRAY_INLINE_CAPACITY + 1);
+        {
+            UwValue item = uw_array_item(&array, 0);
+            TEST(uw_equal(&item, "this string is too long to be embedded"));
+            UwValue last = uw_array_item(&array, -1);
+            TEST(uw_equal(&last, UWARRAY_INLINE_CAPACITY));
+        }
+        UwValue copy = uw_deepcopy(&array);
+        TEST(uw_equal(&copy, &array));
+
+        UwValue map = UwMap();
+        _UwMap* map_data = _uw_get_data_ptr(&map, UwTypeId_Map);
+        for (unsigned i = 0; i < UWARRAY_INLINE_CAPACITY / 2; i++) {
+            UwValue status = uw_map_update_va(&map, UwUnsigned(i), UwUnsigned(i + 1));
+            TEST(uw_ok(&status));
+        }
+        TEST(_uw_array_is_inline(&map_data->kv_pairs));
+        UwValue status = uw_map_update_va(&map, UwCharPtr("key"), UwCharPtr("value"));
+        TEST(uw_ok(&status));
+        TEST(!_uw_array_is_inline(&map_data->kv_pairs));
+        TEST(uw_map_length(&map) == UWARRAY_INLINE_CAPACITY / 2 + 1);
+        {
+            UwValue value = uw_map_get(&map, 0);
+            TEST(uw_equal(&value, 1));
+            UwValue value2 = uw_map_get(&map, "key");
+            TEST(uw_equal(&value2, "value"));
+        }
+
+        // arena arrays grow out of inline items too
+        status = uw_arena_begin();
+        TEST(uw_ok(&status));
+        {
+            UwValue arena_array = UwArray();
+            TEST(_uw_array_is_inline(get_array_data_ptr(&arena_array)));
+            for (unsigned i = 0; i < 20; i++) {
+                uw_array_append(&arena_array, i);
+            }
+            TEST(!_uw_array_is_inline(get_array_data_ptr(&arena_array)));
+            UwValue item = uw_array_item(&arena_array, 19);
+            TEST(uw_equal(&item, 19));
+        }
+        uw_arena_end();
+    }
 }
 
 void test_map()
@@ -820,6 +1454,164 @@ void test_map()
     }
 }
 
+bool test_read_bytes(UwValuePtr reader, unsigned batch_size, char* expected, unsigned expected_size)
+/*
+ * Read all bytes from `reader` by batches and compare with `expected`.
+ */
+{
+    UwValue status = uw_start_read_bytes(reader);
+    if (uw_error(&status)) {
+        return false;
+    }
+    char buffer[batch_size];
+    unsigned total = 0;
+    for (;;) {
+        unsigned bytes_read;
+        status = uw_read_bytes(reader, buffer, batch_size, &bytes_read);
+        if (uw_eof(&status)) {
+            break;
+        }
+        if (uw_error(&status) || bytes_read == 0 || total + bytes_read > expected_size) {
+            return false;
+        }
+        if (memcmp(buffer, expected + total, bytes_read) != 0) {
+            return false;
+        }
+        total += bytes_read;
+    }
+    return total == expected_size;
+}
+
+UwResult test_read_chars(UwValuePtr reader, unsigned max_chars)
+/*
+ * Read all characters from `reader` by batches and return them as a single string.
+ */
+{
+    uw_expect_ok( uw_start_read_chars(reader) );
+    UwValue result = UwString();
+    UwValue chars = UwString();
+    for (;;) {
+        UwValue status = uw_read_chars(reader, &chars, max_chars);
+        if (uw_eof(&status)) {
+            break;
+        }
+        uw_return_if_error(&status);
+        if (uw_strlen(&chars) == 0 || uw_strlen(&chars) > max_chars) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+        if (!uw_string_append(&result, &chars)) {
+            return UwOOM();
+        }
+    }
+    return uw_move(&result);
+}
+
+bool line_view_equal(UwLineView* view, UwValuePtr str)
+{
+    if (view->length != uw_strlen(str)) {
+        return false;
+    }
+    for (unsigned i = 0; i < view->length; i++) {
+        if (_uw_get_char(view->ptr + i * view->char_size, view->char_size) != uw_char_at(str, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool path_error_is(UwValuePtr status, char* description)
+{
+    if (!uw_is_status(status) || status->status_code != UW_ERROR_BAD_PATH || !status->has_status_data) {
+        return false;
+    }
+    return uw_equal(&status->status_data->description, description);
+}
+
+void test_value_path()
+{
+    UwValue value = UwMap(
+        UwCharPtr("a"), UwMap(
+            UwCharPtr("b"), UwArray(UwSigned(10), UwSigned(20), UwMap(UwCharPtr("c"), UwCharPtr("x")))
+        ),
+        UwCharPtr("m~n/o"), UwSigned(1),
+        UwCharPtr("p.q"), UwSigned(2),
+        UwCharPtr("0"), UwSigned(3),
+        UwCharPtr(u8"ключ"), UwArray(UwSigned(4))
+    );
+    { // JSON pointer
+        UwValue p1 = uw_value_path("/a/b/2/c");
+        TEST(uw_value_path_length(&p1) == 4);
+        UwValuePtr r1 = uw_value_path_get(&p1, &value);
+        TEST(r1 && uw_equal(r1, "x"));
+        UwValue p2 = uw_value_path("/m~0n~1o");
+        UwValuePtr r2 = uw_value_path_get(&p2, &value);
+        TEST(r2 && uw_equal(r2, 1));
+        UwValue p3 = uw_value_path("/0");
+        UwValuePtr r3 = uw_value_path_get(&p3, &value);
+        TEST(r3 && uw_equal(r3, 3));
+        UwValue p4 = uw_value_path("/a/b/3");
+        TEST(uw_value_path_get(&p4, &value) == nullptr);
+        UwValue p5 = uw_value_path("/a/b/01");
+        TEST(uw_value_path_get(&p5, &value) == nullptr);
+        UwValue p6 = uw_value_path("");
+        TEST(uw_value_path_length(&p6) == 0);
+        TEST(uw_value_path_get(&p6, &value) == &value);
+    }
+    { // dotted
+        UwValue p1 = uw_value_path("a.b[2].c");
+        UwValuePtr r1 = uw_value_path_get(&p1, &value);
+        TEST(r1 && uw_equal(r1, "x"));
+        UwValue p2 = uw_value_path("[\"p.q\"]");
+        UwValuePtr r2 = uw_value_path_get(&p2, &value);
+        TEST(r2 && uw_equal(r2, 2));
+        UwValue p3 = uw_value_path(U"ключ[0]");
+        UwValuePtr r3 = uw_value_path_get(&p3, &value);
+        TEST(r3 && uw_equal(r3, 4));
+        UwValue p4 = uw_value_path("a.b.1");
+        UwValuePtr r4 = uw_value_path_get(&p4, &value);
+        TEST(r4 && uw_equal(r4, 20));
+        UwValue p5 = uw_value_path("[0]");  // index only, not a key
+        TEST(uw_value_path_get(&p5, &value) == nullptr);
+        UwValue p6 = uw_value_path("a['b'][0]");
+        UwValuePtr r6 = uw_value_path_get(&p6, &value);
+        TEST(r6 && uw_equal(r6, 10));
+        UwValue p7 = uw_value_path("a.b.c");
+        TEST(uw_value_path_get(&p7, &value) == nullptr);
+    }
+    { // errors
+        UwValue e1 = uw_value_path("/a~2");
+        TEST(path_error_is(&e1, "position 3: bad escape sequence"));
+        UwValue e2 = uw_value_path("a..b");
+        TEST(path_error_is(&e2, "position 3: empty name"));
+        UwValue e3 = uw_value_path("a[x]");
+        TEST(path_error_is(&e3, "position 3: bad index"));
+        UwValue e4 = uw_value_path("a[1");
+        TEST(path_error_is(&e4, "position 4: expected ]"));
+        UwValue e5 = uw_value_path("a[\"b]");
+        TEST(path_error_is(&e5, "position 6: unterminated string"));
+        UwValue e6 = uw_value_path("a[0]b");
+        TEST(path_error_is(&e6, "position 5: expected . or ["));
+    }
+    { // batch
+        UwValue paths = UwArray(
+            uw_value_path("a.b[0]"),
+            uw_value_path("a.b[2].c"),
+            uw_value_path("a.b[2].d"),
+            uw_value_path("a.x.y"),
+            uw_value_path("a.x"),
+            uw_value_path("/0")
+        );
+        UwValuePtr results[6];
+        TEST(uw_value_path_get_many(&paths, &value, results) == 3);
+        TEST(results[0] && uw_equal(results[0], 10));
+        TEST(results[1] && uw_equal(results[1], "x"));
+        TEST(results[2] == nullptr);
+        TEST(results[3] == nullptr);
+        TEST(results[4] == nullptr);
+        TEST(results[5] && uw_equal(results[5], 3));
+    }
+}
+
 void test_file()
 {
     // UTF-8 crossing read boundary
@@ -852,6 +1644,53 @@ void test_file()
         }
         TEST(uw_equal(&line, c));
 
+        // read by characters, batches cross UTF-8 sequence at buffer boundary
+        {
+            UwValue chars = test_read_chars(&file, 7);
+            TEST(uw_is_string(&chars));
+            UwValue line_reader_chars = UwString();
+            UwValue status = uw_start_read_lines(&file);
+            TEST(uw_ok(&status));
+            for (;;) {{
+                UwValue status = uw_read_line_inplace(&file, &line);
+                if (uw_error(&status)) {
+                    break;
+                }
+                uw_string_append(&line_reader_chars, &line);
+            }}
+            TEST(uw_equal(&chars, &line_reader_chars));
+        }
+
+        // the same with readahead, UTF-8 sequence crosses buffers of the ring
+        {
+            UwValue file = uw_file_open(data_filename, O_RDONLY, 0);
+            TEST(uw_ok(&file));
+            uw_file_set_readahead(&file, true);
+            UwValue status = uw_start_read_lines(&file);
+            TEST(uw_ok(&status));
+            UwValue line = uw_create_string("");
+            UwValue last_line = UwNull();
+            for (;;) {{
+                UwValue status = uw_read_line_inplace(&file, &line);
+                if (uw_eof(&status)) {
+                    break;
+                }
+                TEST(uw_ok(&status));
+                if (uw_error(&status)) {
+                    break;
+                }
+                uw_destroy(&last_line);
+                last_line = uw_clone(&line);
+            }}
+            TEST(uw_equal(&last_line, c));
+
+            // restart reading
+            status = uw_start_read_lines(&file);
+            TEST(uw_ok(&status));
+            status = uw_read_line_inplace(&file, &line);
+            TEST(uw_equal(&line, a));
+        }
+
         { // test path functions
             UwValue s = uw_create_string("/bin/bash");
             UwValue basename = uw_basename(&s);
@@ -916,17 +1755,27 @@ void test_file()
 
             UwValue str_io = uw_create_string_io(data);
 
+            // and with another file in readahead mode
+            UwValue file_ra = uw_file_open(&file_name, O_RDONLY, 0);
+            TEST(uw_ok(&file_ra));
+            uw_file_set_readahead(&file_ra, true);
+
             status = uw_start_read_lines(&file);
             TEST(uw_ok(&status));
             status = uw_start_read_lines(&str_io);
             TEST(uw_ok(&status));
+            status = uw_start_read_lines(&file_ra);
+            TEST(uw_ok(&status));
 
             UwValue line_f = uw_create_string("");
             UwValue line_s = uw_create_string("");
+            UwValue line_ra = uw_create_string("");
             for (;;) {{
                 UwValue status_f = uw_read_line_inplace(&file, &line_f);
                 UwValue status_s = uw_read_line_inplace(&str_io, &line_s);
+                UwValue status_ra = uw_read_line_inplace(&file_ra, &line_ra);
                 TEST(uw_equal(&status_f, &status_s));
+                TEST(uw_equal(&status_ra, &status_s));
                 if (!uw_equal(&status_f, &status_s)) {
                     fprintf(stderr, "%s -- Line number: %u (file), %u (string I/O)\n",
                             sample_files[i],
@@ -946,6 +1795,7 @@ void test_file()
                 if (uw_error(&status_f)) {
                     break;
                 }
+                TEST(uw_equal(&line_ra, &line_s));
                 TEST(uw_equal(&line_f, &line_s));
                 if (!uw_equal(&line_f, &line_s)) {
                     fprintf(stderr, "%s -- Line number: %u (file), %u (string I/O)\n",
@@ -960,6 +1810,44 @@ void test_file()
                 //fprintf(stderr, "Line %u\n", uw_get_line_number(&file));
                 //uw_dump(stderr, &line_f);
             }}
+
+            // byte and char readers
+            unsigned size = file_size.unsigned_value;
+            TEST(test_read_bytes(&file, 1000, data, size));
+            TEST(test_read_bytes(&file, 10000, data, size));  // reads directly to caller's buffer
+            TEST(test_read_bytes(&file_ra, 1000, data, size));
+            TEST(test_read_bytes(&str_io, 3, data, size));
+
+            UwValue data_str = uw_create_string(data);
+            UwValue chars_f = test_read_chars(&file, 5);
+            TEST(uw_equal(&chars_f, &data_str));
+            UwValue chars_ra = test_read_chars(&file_ra, 1000);
+            TEST(uw_equal(&chars_ra, &data_str));
+            UwValue chars_s = test_read_chars(&str_io, 5);
+            TEST(uw_equal(&chars_s, &data_str));
+
+            // line views
+            status = uw_start_read_lines(&file);
+            TEST(uw_ok(&status));
+            status = uw_start_read_lines(&file_ra);
+            TEST(uw_ok(&status));
+            status = uw_start_read_lines(&str_io);
+            TEST(uw_ok(&status));
+            for (;;) {{
+                UwValue status_s = uw_read_line_inplace(&str_io, &line_s);
+                UwLineView view_f;
+                UwLineView view_ra;
+                UwValue status_f = uw_read_line_view(&file, &view_f);
+                UwValue status_ra = uw_read_line_view(&file_ra, &view_ra);
+                TEST(uw_equal(&status_f, &status_s));
+                TEST(uw_equal(&status_ra, &status_s));
+                if (!uw_ok(&status_s) || !uw_equal(&status_f, &status_s)) {
+                    break;
+                }
+                TEST(line_view_equal(&view_f, &line_s));
+                TEST(line_view_equal(&view_ra, &line_s));
+                TEST(uw_get_line_number(&file) == uw_get_line_number(&str_io));
+            }}
         }}
     }
 }
@@ -1009,6 +1897,85 @@ void test_string_io()
         UwValue line = uw_read_line(&sio);
         TEST(uw_equal(&line, "one\n"));
     }
+
+    // line views
+    {
+        UwValue sio = uw_create_string_io(u8"one\nдва\n\nthree");
+        UwLineView view;
+        UwValue status = uw_read_line_view(&sio, &view);
+        TEST(uw_ok(&status));
+        UwValue one = uw_create_string("one\n");
+        TEST(line_view_equal(&view, &one));
+        status = uw_read_line_view(&sio, &view);
+        TEST(uw_ok(&status));
+        UwValue line = UwString();
+        TEST(uw_string_append_substring(&line, u8"два\n", 0, 4));
+        TEST(line_view_equal(&view, &line));
+        TEST(uw_unread_line(&sio, &line));
+        status = uw_read_line_view(&sio, &view);
+        TEST(uw_ok(&status));
+        TEST(line_view_equal(&view, &line));
+        TEST(uw_get_line_number(&sio) == 2);
+        status = uw_read_line_view(&sio, &view);
+        TEST(uw_ok(&status));
+        TEST(view.length == 1 && _uw_get_char(view.ptr, view.char_size) == '\n');
+        status = uw_read_line_view(&sio, &view);
+        TEST(uw_ok(&status));
+        UwValue three = uw_create_string("three");
+        TEST(line_view_equal(&view, &three));
+        status = uw_read_line_view(&sio, &view);
+        TEST(uw_eof(&status));
+    }
+    {
+        UwValue array = UwArray(UwCharPtr("one\n"), UwNull(), UwCharPtr(u8"два\n"));
+        UwValue iter = uw_array_iterator(&array);
+        TEST(uw_ok(&iter));
+        UwValue status = uw_start_read_lines(&iter);
+        TEST(uw_ok(&status));
+        UwLineView view;
+        status = uw_read_line_view(&iter, &view);
+        TEST(uw_ok(&status));
+        TEST(view.length == 4 && memcmp(view.ptr, "one\n", 4) == 0);
+        status = uw_read_line_view(&iter, &view);
+        TEST(uw_ok(&status));
+        UwValue item = uw_array_item(&array, 2);
+        TEST(line_view_equal(&view, &item));
+        status = uw_read_line_view(&iter, &view);
+        TEST(uw_eof(&status));
+        uw_stop_read_lines(&iter);
+    }
+    // byte reader splits UTF-8 sequences between batches
+    {
+        UwValue sio = uw_create_string_io(u8"aĀ😀b");
+        char8_t expected[] = u8"aĀ😀b";
+        TEST(test_read_bytes(&sio, 1, (char*) expected, strlen((char*) expected)));
+        TEST(test_read_bytes(&sio, 3, (char*) expected, strlen((char*) expected)));
+        UwValue chars = test_read_chars(&sio, 2);
+        TEST(uw_equal(&chars, expected));
+    }
+    // string iterator
+    {
+        UwValue str = uw_create_string(u8"สบาย สบาย");
+        UwValue iter = uw_string_iterator(&str);
+        TEST(uw_ok(&iter));
+        UwValue chars = UwString();
+        UwValue status = uw_read_chars(&iter, &chars, 4);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&chars, u8"สบาย"));
+        status = uw_read_chars(&iter, &chars, 100);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&chars, u8" สบาย"));
+        status = uw_read_chars(&iter, &chars, 100);
+        TEST(uw_eof(&status));
+        TEST(uw_strlen(&chars) == 0);
+
+        UwValue all_chars = test_read_chars(&iter, 3);
+        TEST(uw_equal(&all_chars, &str));
+
+        UwValue number = UwUnsigned(1);
+        UwValue bad_iter = uw_string_iterator(&number);
+        TEST(uw_error(&bad_iter));
+    }
 }
 
 void test_netutils()
@@ -1209,7 +2176,1497 @@ void test_json()
         //UW_CSTRING_LOCAL(json, &result);
         //fprintf(stderr, "%s\n", json);
         TEST(uw_equal(&result, &reference));
+
+        // parse it back
+        UwValue parsed = uw_from_json(&result);
+        TEST(uw_equal(&parsed, &value));
+    }
+    { // empty containers, escapes, strings of different char sizes
+        UwValue v = UwArray(
+            UwMap(),
+            UwArray(),
+            UwCharPtr("\x01\x1f long string with \"quotes\" and \\ backslashes \t"),
+            UwCharPtr(u8"latin1 é"),
+            UwCharPtr(u8"кириллица \"ы\"\n"),
+            UwChar32Ptr(U"\U0001F600\x1b")
+        );
+        UwValue result = uw_to_json(&v, 0);
+        TEST(uw_equal(&result,
+            u8"[{},[],\"\\u0001\\u001f long string with \\\"quotes\\\" and \\\\ backslashes \\t\","
+            u8"\"latin1 é\",\"кириллица \\\"ы\\\"\\n\",\"😀\\u001b\"]"));
+        TEST(uw_string_char_size(&result) == 3);
+        UwValue parsed = uw_from_json(&result);
+        TEST(uw_equal(&parsed, &v));
+
+        UwValue bad = UwArray(UwSigned(1), UwMap(UwSigned(1), UwSigned(2)));
+        UwValue status = uw_to_json(&bad, 0);
+        TEST(uw_is_status(&status) && status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+}
+
+void test_json_write()
+{
+    // make document larger than sink buffer, with multibyte characters on chunk boundaries
+    UwValue value = UwArray();
+    for (unsigned i = 0; i < 5000; i++) {{
+        UwValue item = UwMap(
+            UwCharPtr("n"), UwUnsigned(i),
+            UwCharPtr("s"), UwCharPtr(u8"значение \"ы\"\n"),
+            UwCharPtr("e"), UwChar32Ptr(U"\U0001F600")
+        );
+        uw_array_append(&value, &item);
+    }}
+    UwValue expected = uw_to_json(&value, 2);
+    TEST(uw_is_string(&expected));
+
+    UwSink buffer_sink;
+    uw_sink_init_buffer(&buffer_sink);
+    { // memory buffer
+        UwValue status = uw_to_json_write(&value, 2, &buffer_sink);
+        TEST(uw_ok(&status));
+        TEST(buffer_sink.size > 65536);
+        UwValue result = UwString();
+        unsigned processed;
+        TEST(uw_string_append_utf8(&result, buffer_sink.data, buffer_sink.size, &processed));
+        TEST(processed == buffer_sink.size);
+        TEST(uw_equal(&result, &expected));
+    }
+    { // StringIO
+        UwValue sio = uw_create_string_io("");
+        UwSink sink;
+        UwValue status = uw_sink_init_writer(&sink, &sio);
+        TEST(uw_ok(&status));
+        status = uw_to_json_write(&value, 2, &sink);
+        TEST(uw_ok(&status));
+        UwValue result = uw_to_string(&sio);
+        TEST(uw_equal(&result, &expected));
+
+        // UTF-8 sequences split across writes
+        UwValue sio2 = uw_create_string_io("");
+        status = uw_sink_init_writer(&sink, &sio2);
+        for (char8_t* p = u8"ы😀z"; *p; p++) {
+            status = uw_sink_write(&sink, p, 1);
+            TEST(uw_ok(&status));
+        }
+        UwValue result2 = uw_to_string(&sio2);
+        TEST(uw_equal(&result2, u8"ы😀z"));
+    }
+    { // File
+        char* file_name = "/tmp/uw_test_json_write.json";
+        UwValue file = uw_file_open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        TEST(uw_is_file(&file));
+        UwSink sink;
+        UwValue status = uw_sink_init_writer(&sink, &file);
+        TEST(uw_ok(&status));
+        status = uw_to_json_write(&value, 2, &sink);
+        TEST(uw_ok(&status));
+        uw_file_close(&file);
+
+        FILE* fp = fopen(file_name, "r");
+        fseek(fp, 0, SEEK_END);
+        TEST((unsigned) ftell(fp) == buffer_sink.size);
+        rewind(fp);
+        char8_t* data = malloc(buffer_sink.size);
+        TEST(fread(data, 1, buffer_sink.size, fp) == buffer_sink.size);
+        TEST(memcmp(data, buffer_sink.data, buffer_sink.size) == 0);
+        free(data);
+        fclose(fp);
+        unlink(file_name);
+    }
+    { // FILE*
+        FILE* fp = tmpfile();
+        UwSink sink;
+        uw_sink_init_stdio(&sink, fp);
+        UwValue status = uw_to_json_write(&value, 2, &sink);
+        TEST(uw_ok(&status));
+        TEST((unsigned) ftell(fp) == buffer_sink.size);
+        rewind(fp);
+        char buf[4096];
+        size_t n = fread(buf, 1, sizeof(buf), fp);
+        TEST(n == sizeof(buf) && memcmp(buf, buffer_sink.data, n) == 0);
+        fclose(fp);
+    }
+    uw_sink_fini(&buffer_sink);
+    TEST(buffer_sink.data == nullptr);
+
+    { // bad writer
+        UwValue number = UwSigned(1);
+        UwSink sink;
+        UwValue status = uw_sink_init_writer(&sink, &number);
+        TEST(uw_is_status(&status) && status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
     }
+    { // error stops writing
+        UwValue bad = UwArray(UwSigned(1), UwMap(UwSigned(1), UwSigned(2)));
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue status = uw_to_json_write(&bad, 0, &sink);
+        TEST(uw_is_status(&status) && status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+        uw_sink_fini(&sink);
+    }
+    { // dump
+        UwValue str = uw_create_string(u8"dump ы");
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        uw_dump_sink(&sink, &str);
+        TEST(sink.size > 0);
+
+        FILE* fp = tmpfile();
+        uw_dump(fp, &str);
+        TEST((unsigned) ftell(fp) == sink.size);
+        rewind(fp);
+        char buf[4096];
+        TEST(fread(buf, 1, sink.size, fp) == sink.size && memcmp(buf, sink.data, sink.size) == 0);
+        fclose(fp);
+        uw_sink_fini(&sink);
+    }
+}
+
+void test_json_plan()
+{
+    UwValue template = UwMap(
+        UwCharPtr("id"),    UwSigned(0),
+        UwCharPtr("name"),  UwCharPtr(""),
+        UwCharPtr("score"), UwFloat(0),
+        UwCharPtr("ok"),    UwBool(false),
+        UwCharPtr(u8"ключ\"\n"), UwUnsigned(0)
+    );
+    UwValue plan = uw_json_plan(&template);
+    TEST(uw_is_struct(&plan));
+
+    UwValue records = UwArray();
+    for (int i = 0; i < 300; i++) {{
+        UwValue item = UwMap(
+            UwCharPtr("id"),    UwSigned(i - 150),
+            UwCharPtr("name"),  UwCharPtr(u8"имя \"ы\"\t"),
+            UwCharPtr("score"), UwFloat(i / 4.0),
+            UwCharPtr("ok"),    UwBool(i & 1),
+            UwCharPtr(u8"ключ\"\n"), UwUnsigned(i)
+        );
+        uw_array_append(&records, &item);
+    }}
+    { // matching records
+        UwValue expected = uw_to_json(&records, 0);
+        UwValue result = uw_json_plan_to_json(&plan, &records);
+        TEST(uw_is_string(&result));
+        TEST(uw_equal(&result, &expected));
+
+        UwValue first = uw_array_item(&records, 0);
+        UwValue expected_first = uw_to_json(&first, 0);
+        UwValue result_first = uw_json_plan_to_json(&plan, &first);
+        TEST(uw_equal(&result_first, &expected_first));
+
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue status = uw_json_plan_write(&plan, &records, &sink);
+        TEST(uw_ok(&status));
+        UwValue written = UwString();
+        unsigned processed;
+        TEST(uw_string_append_utf8(&written, sink.data, sink.size, &processed));
+        TEST(uw_equal(&written, &expected));
+        uw_sink_fini(&sink);
+    }
+    { // deviating records fall back to the generic path
+        UwValue mixed = UwArray(
+            UwMap(UwCharPtr("id"), UwSigned(1), UwCharPtr("name"), UwCharPtr("a")),
+            UwMap(UwCharPtr("name"), UwCharPtr("b"), UwCharPtr("id"), UwSigned(2),
+                  UwCharPtr("score"), UwFloat(1), UwCharPtr("ok"), UwBool(true),
+                  UwCharPtr(u8"ключ\"\n"), UwUnsigned(3)),
+            UwMap(UwCharPtr("id"), UwCharPtr("text"), UwCharPtr("name"), UwNull(),
+                  UwCharPtr("score"), UwSigned(5), UwCharPtr("ok"), UwArray(UwSigned(1)),
+                  UwCharPtr(u8"ключ\"\n"), UwMap(UwCharPtr("x"), UwSigned(-1))),
+            UwMap(),
+            UwSigned(7),
+            UwArray()
+        );
+        UwValue expected = uw_to_json(&mixed, 0);
+        UwValue result = uw_json_plan_to_json(&plan, &mixed);
+        TEST(uw_equal(&result, &expected));
+    }
+    { // plan from list of keys
+        UwValue keys = UwArray(UwCharPtr("id"), UwCharPtr("name"));
+        UwValue key_plan = uw_json_plan(&keys);
+        TEST(uw_is_struct(&key_plan));
+        UwValue record = UwMap(UwCharPtr("id"), UwUnsigned(9), UwCharPtr("name"), UwChar32Ptr(U"\U0001F600"));
+        UwValue result = uw_json_plan_to_json(&key_plan, &record);
+        TEST(uw_equal(&result, u8"{\"id\":9,\"name\":\"😀\"}"));
+
+        UwValue empty_keys = UwArray();
+        UwValue empty_plan = uw_json_plan(&empty_keys);
+        TEST(uw_is_struct(&empty_plan));
+        UwValue empty = UwMap();
+        UwValue empty_result = uw_json_plan_to_json(&empty_plan, &empty);
+        TEST(uw_equal(&empty_result, "{}"));
+    }
+    { // errors
+        UwValue bad_keys = UwArray(UwCharPtr("id"), UwSigned(1));
+        UwValue bad_plan = uw_json_plan(&bad_keys);
+        TEST(uw_is_status(&bad_plan) && bad_plan.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+
+        UwValue bad_template = UwMap(UwSigned(1), UwSigned(1));
+        UwValue bad_plan2 = uw_json_plan(&bad_template);
+        TEST(uw_is_status(&bad_plan2) && bad_plan2.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+
+        UwValue number = UwSigned(1);
+        UwValue bad_plan3 = uw_json_plan(&number);
+        TEST(uw_is_status(&bad_plan3) && bad_plan3.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+
+        UwValue bad_record = UwMap(UwCharPtr("id"), UwSigned(1), UwCharPtr("name"), UwMap(UwSigned(1), UwSigned(2)),
+                                   UwCharPtr("score"), UwFloat(0), UwCharPtr("ok"), UwBool(false),
+                                   UwCharPtr(u8"ключ\"\n"), UwUnsigned(0));
+        UwValue status = uw_json_plan_to_json(&plan, &bad_record);
+        TEST(uw_is_status(&status) && status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+}
+
+bool json_error_is(UwValuePtr status, char* description)
+{
+    if (!uw_is_status(status) || status->status_code != UW_ERROR_JSON_SYNTAX || !status->has_status_data) {
+        return false;
+    }
+    return uw_equal(&status->status_data->description, description);
+}
+
+void test_from_json()
+{
+    {
+        UwValue result = uw_from_json("  {\"a\": [1, -2, 3.5, true, false, null, \"\"], \"b\": {}, \"c\": []}  ");
+        TEST(uw_is_map(&result));
+        UwValue reference = UwMap(
+            UwCharPtr("a"), UwArray(UwSigned(1), UwSigned(-2), UwFloat(3.5), UwBool(true), UwBool(false), UwNull(), UwCharPtr("")),
+            UwCharPtr("b"), UwMap(),
+            UwCharPtr("c"), UwArray()
+        );
+        TEST(uw_equal(&result, &reference));
+    }
+    { // top-level scalars
+        UwValue s = uw_from_json("\"scalar\"");
+        TEST(uw_equal(&s, "scalar"));
+        UwValue n = uw_from_json("-0");
+        TEST(uw_is_signed(&n) && n.signed_value == 0);
+        UwValue t = uw_from_json("true");
+        TEST(uw_is_bool(&t) && t.bool_value);
+    }
+    { // numbers
+        UwValue max_unsigned = uw_from_json("18446744073709551615");
+        TEST(uw_is_unsigned(&max_unsigned) && max_unsigned.unsigned_value == UINT64_MAX);
+        UwValue max_signed = uw_from_json("9223372036854775807");
+        TEST(uw_is_signed(&max_signed) && max_signed.signed_value == INT64_MAX);
+        UwValue min_signed = uw_from_json("-9223372036854775808");
+        TEST(uw_is_signed(&min_signed) && min_signed.signed_value == INT64_MIN);
+        UwValue big = uw_from_json("18446744073709551616");
+        TEST(uw_is_float(&big) && big.float_value == 18446744073709551616.0);
+        UwValue exp = uw_from_json("[1.5e3, 2E-2, -0.25]");
+        UwValue reference = UwArray(UwFloat(1500.0), UwFloat(0.02), UwFloat(-0.25));
+        TEST(uw_equal(&exp, &reference));
+    }
+    { // round trip of 1-byte string with non-ASCII characters
+        UwValue value = UwMap(UwCharPtr("name"), UwCharPtr(u8"Jos\u00e9"));
+        UwValue json = uw_to_json(&value, 0);
+        TEST(uw_string_char_size(&json) == 1);
+        UwValue result = uw_from_json(&json);
+        TEST(uw_equal(&result, &value));
+
+        UwValue cafe = uw_create_string(u8"[\"caf\u00e9\"]");
+        TEST(uw_string_char_size(&cafe) == 1);
+        UwValue array = uw_from_json(&cafe);
+        UwValue reference = UwArray(UwCharPtr(u8"caf\u00e9"));
+        TEST(uw_equal(&array, &reference));
+    }
+    { // strings of different char sizes and escapes
+        UwValue result = uw_from_json(u8"[\"ascii\", \"latin1 \u00e9\", \"кириллица\", \"\\ud83d\\ude00\", \"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]");
+        TEST(uw_is_array(&result));
+        UwValue s0 = uw_array_item(&result, 0);
+        UwValue s1 = uw_array_item(&result, 1);
+        UwValue s2 = uw_array_item(&result, 2);
+        UwValue s3 = uw_array_item(&result, 3);
+        UwValue s4 = uw_array_item(&result, 4);
+        TEST(uw_equal(&s0, "ascii") && uw_string_char_size(&s0) == 1);
+        TEST(uw_equal(&s1, u8"latin1 é") && uw_string_char_size(&s1) == 1);
+        TEST(uw_equal(&s2, u8"кириллица") && uw_string_char_size(&s2) == 2);
+        TEST(uw_equal(&s3, U"\U0001F600") && uw_string_char_size(&s3) == 3);
+        TEST(uw_equal(&s4, "\"\\/\b\f\n\r\t"));
+    }
+    { // escaped quotes and backslashes across 64-byte blocks
+        for (unsigned i = 55; i < 70; i++) {{
+            char json[200];
+            memset(json, ' ', sizeof(json));
+            json[0] = '[';
+            json[i] = '"';
+            json[i + 1] = '\\';
+            json[i + 2] = '\\';
+            json[i + 3] = '\\';
+            json[i + 4] = '"';
+            json[i + 5] = '"';
+            strcpy(&json[i + 6], ",1]");
+            UwValue result = uw_from_json(json);
+            UwValue reference = UwArray(UwCharPtr("\\\""), UwSigned(1));
+            TEST(uw_equal(&result, &reference));
+        }}
+        // long string
+        char json[300];
+        json[0] = '"';
+        memset(&json[1], 'x', 250);
+        strcpy(&json[251], "\\\"\"");
+        UwValue result = uw_from_json(json);
+        TEST(uw_is_string(&result) && uw_strlen(&result) == 251);
+    }
+    { // string input, non-ASCII
+        UwValue str = uw_create_string(u8"{\"ключ\": \"значение\"}");
+        UwValue result = uw_from_json(&str);
+        UwValue reference = UwMap(UwCharPtr(u8"ключ"), UwCharPtr(u8"значение"));
+        TEST(uw_equal(&result, &reference));
+    }
+    { // file input
+        UwValue file = uw_file_open("./test/data/sample.json", O_RDONLY, 0);
+        TEST(uw_ok(&file));
+        UwValue result = uw_from_json(&file);
+        TEST(uw_is_map(&result));
+        UwValue total_items = uw_map_get(&result, "totalItems");
+        TEST(uw_equal(&total_items, 692));
+        UwValue context = uw_map_get(&result, "@context");
+        TEST(uw_equal(&context, "https://www.w3.org/ns/activitystreams"));
+    }
+    { // errors
+        UwValue e1 = uw_from_json("[1, 2");
+        TEST(json_error_is(&e1, "line 1, column 6: unexpected end of data"));
+        UwValue e2 = uw_from_json("{\n  \"a\": tru\n}");
+        TEST(json_error_is(&e2, "line 2, column 8: unexpected character"));
+        UwValue e3 = uw_from_json(u8"[\"ы\" \"b\"]");
+        TEST(json_error_is(&e3, "line 1, column 6: expected , or ]"));
+        UwValue e4 = uw_from_json("{\"a\" 1}");
+        TEST(json_error_is(&e4, "line 1, column 6: expected :"));
+        UwValue e5 = uw_from_json("1 2");
+        TEST(json_error_is(&e5, "line 1, column 3: extra data after JSON value"));
+        UwValue e6 = uw_from_json("[01]");
+        TEST(json_error_is(&e6, "line 1, column 3: bad number"));
+        UwValue e7 = uw_from_json("\"abc");
+        TEST(json_error_is(&e7, "line 1, column 5: unterminated string"));
+        UwValue e8 = uw_from_json("\"\\x\"");
+        TEST(json_error_is(&e8, "line 1, column 3: bad escape sequence"));
+        UwValue e9 = uw_from_json("\"\t\"");
+        TEST(json_error_is(&e9, "line 1, column 2: control character in string"));
+        UwValue e10 = uw_from_json("{1: 2}");
+        TEST(json_error_is(&e10, "line 1, column 2: expected string key"));
+        UwValue e11 = uw_from_json("   ");
+        TEST(json_error_is(&e11, "line 1, column 4: no data"));
+        UwValue e12 = uw_from_json("[1,]");
+        TEST(json_error_is(&e12, "line 1, column 4: unexpected character"));
+
+        char deep[2100];
+        memset(deep, '[', 2099);
+        deep[2099] = 0;
+        UwValue e13 = uw_from_json(deep);
+        TEST(json_error_is(&e13, "line 1, column 1025: nesting is too deep"));
+    }
+}
+
+typedef struct {
+    _UwValue log;         // events in text form
+    char*    key;         // key to apply key_action to
+    unsigned key_action;
+    unsigned start_depth; // depth to apply start_action to
+    unsigned start_action;
+    unsigned stop_after;  // stop after this number of events if nonzero
+    unsigned num_events;
+} JsonEventLog;
+
+unsigned log_json_event(unsigned event, UwValuePtr value, unsigned depth, void* arg)
+{
+    JsonEventLog* log = arg;
+    if (uw_strlen(&log->log)) {
+        uw_string_append(&log->log, ' ');
+    }
+    unsigned action = UW_JSON_CONTINUE;
+    switch (event) {
+        case UW_JSON_START_OBJECT:
+        case UW_JSON_START_ARRAY:
+            uw_string_append(&log->log, (event == UW_JSON_START_OBJECT)? "{" : "[");
+            if (depth == log->start_depth) {
+                action = log->start_action;
+            }
+            break;
+        case UW_JSON_END_OBJECT:
+            uw_string_append(&log->log, "}");
+            break;
+        case UW_JSON_END_ARRAY:
+            uw_string_append(&log->log, "]");
+            break;
+        case UW_JSON_KEY: {
+            UwValue json = uw_to_json(value, 0);
+            uw_string_append(&log->log, &json);
+            uw_string_append(&log->log, ':');
+            if (log->key && uw_equal(value, log->key)) {
+                action = log->key_action;
+            }
+            break;
+        }
+        case UW_JSON_VALUE: {
+            UwValue json = uw_to_json(value, 0);
+            uw_string_append(&log->log, &json);
+            break;
+        }
+    }
+    if (++log->num_events == log->stop_after) {
+        action = UW_JSON_STOP;
+    }
+    return action;
+}
+
+UwResult json_events(char* json, JsonEventLog* log)
+{
+    uw_destroy(&log->log);
+    log->log = uw_create_string("");
+    log->num_events = 0;
+    UwValue sio = uw_create_string_io(json);
+    return uw_json_parse_events(&sio, log_json_event, log);
+}
+
+void test_json_document()
+{
+    char* json = u8"{\"a\": {\"b\": [10, 20, {\"c\": \"x\"}, 40]}, \"s\": \"ы\\n\", "
+                 u8"\"dup\": 1, \"dup\": 2, \"esc\\u0061pe\": true, \"n\": null, \"f\": 1.5, \"ключ\": false}";
+
+    UwValue doc = uw_json_document(json);
+    TEST(uw_is_subtype(&doc, UwTypeId_JsonDocument));
+    { // leaves
+        UwValue v1 = uw_json_get(&doc, UwCharPtr("a"), UwCharPtr("b"), UwUnsigned(3));
+        TEST(uw_equal(&v1, 40));
+        UwValue v2 = uw_json_get(&doc, UwCharPtr("a"), UwCharPtr("b"), UwSigned(2), UwCharPtr("c"));
+        TEST(uw_equal(&v2, "x"));
+        UwValue v3 = uw_json_get(&doc, UwChar32Ptr(U"s"));
+        TEST(uw_equal(&v3, u8"ы\n"));
+        UwValue v4 = uw_json_get(&doc, UwCharPtr("dup"));
+        TEST(uw_equal(&v4, 2));
+        UwValue v5 = uw_json_get(&doc, uw_create_string("escape"));
+        TEST(uw_is_bool(&v5) && v5.bool_value);
+        UwValue v6 = uw_json_get(&doc, UwCharPtr("n"));
+        TEST(uw_is_null(&v6));
+        UwValue v7 = uw_json_get(&doc, UwCharPtr("f"));
+        TEST(uw_equal(&v7, 1.5));
+        UwValue v8 = uw_json_get(&doc, UwCharPtr(u8"ключ"));
+        TEST(uw_is_bool(&v8) && !v8.bool_value);
+    }
+    { // 1-byte string with non-ASCII characters
+        UwValue str = uw_create_string(u8"{\"caf\u00e9\": \"cr\u00e8me br\u00fbl\u00e9e\"}");
+        TEST(uw_string_char_size(&str) == 1);
+        UwValue latin1_doc = uw_json_document(&str);
+        TEST(uw_is_subtype(&latin1_doc, UwTypeId_JsonDocument));
+        UwValue v = uw_json_get(&latin1_doc, UwCharPtr(u8"caf\u00e9"));
+        TEST(uw_equal(&v, u8"cr\u00e8me br\u00fbl\u00e9e"));
+    }
+    { // subtrees
+        UwValue v1 = uw_json_get(&doc, UwCharPtr("a"), UwCharPtr("b"));
+        UwValue r1 = uw_from_json("[10, 20, {\"c\": \"x\"}, 40]");
+        TEST(uw_equal(&v1, &r1));
+        UwValue v2 = uw_json_get(&doc);
+        UwValue r2 = uw_from_json(json);
+        TEST(uw_equal(&v2, &r2));
+    }
+    { // missing paths
+        UwValue e1 = uw_json_get(&doc, UwCharPtr("b"));
+        TEST(uw_is_status(&e1) && e1.status_code == UW_ERROR_KEY_NOT_FOUND);
+        UwValue e2 = uw_json_get(&doc, UwCharPtr("a"), UwCharPtr("b"), UwUnsigned(4));
+        TEST(uw_is_status(&e2) && e2.status_code == UW_ERROR_INDEX_OUT_OF_RANGE);
+        UwValue e3 = uw_json_get(&doc, UwCharPtr("a"), UwSigned(-1));
+        TEST(uw_is_status(&e3) && e3.status_code == UW_ERROR_INDEX_OUT_OF_RANGE);
+        UwValue e4 = uw_json_get(&doc, UwCharPtr("a"), UwUnsigned(0));
+        TEST(uw_is_status(&e4) && e4.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+        UwValue e5 = uw_json_get(&doc, UwCharPtr("s"), UwCharPtr("x"), uw_create_string("destroyed"));
+        TEST(uw_is_status(&e5) && e5.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    { // tape
+        UwValue d = uw_json_document("[1, [2, 3], {}, \"x\"]");
+        TEST(uw_json_tape_length(&d) == 10);
+        UwValue v = uw_json_get(&d, UwUnsigned(3));
+        TEST(uw_equal(&v, "x"));
+    }
+    { // errors
+        UwValue e1 = uw_json_document("{\"a\" 1}");
+        TEST(json_error_is(&e1, "line 1, column 6: expected :"));
+        UwValue e2 = uw_json_document("[1, 2");
+        TEST(json_error_is(&e2, "line 1, column 6: unexpected end of data"));
+        UwValue e3 = uw_json_document("");
+        TEST(json_error_is(&e3, "line 1, column 1: no data"));
+
+        // scalars are validated when materialized
+        UwValue d = uw_json_document("{\"good\": 1, \"bad\": 01, \"s\": \"\\x\"}");
+        TEST(uw_is_subtype(&d, UwTypeId_JsonDocument));
+        UwValue v1 = uw_json_get(&d, UwCharPtr("good"));
+        TEST(uw_equal(&v1, 1));
+        UwValue v2 = uw_json_get(&d, UwCharPtr("bad"));
+        TEST(json_error_is(&v2, "line 1, column 21: bad number"));
+        UwValue v3 = uw_json_get(&d, UwCharPtr("s"));
+        TEST(uw_is_status(&v3) && v3.status_code == UW_ERROR_JSON_SYNTAX);
+    }
+    { // file
+        UwValue file = uw_file_open("./test/data/sample.json", O_RDONLY, 0);
+        UwValue d = uw_json_document(&file);
+        TEST(uw_is_subtype(&d, UwTypeId_JsonDocument));
+        UwValue v = uw_json_get(&d);
+        UwValue reference = uw_from_json(&file);
+        TEST(uw_equal(&v, &reference));
+    }
+}
+
+void test_json_events()
+{
+    char* json = "{\"a\": [1, \"x\", null], \"b\": {\"c\": true}, \"d\": []}";
+    JsonEventLog log = { .log = UwNull(), .start_depth = UINT_MAX };
+    {
+        UwValue status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ 1 \"x\" null ] \"b\": { \"c\": true } \"d\": [ ] }"));
+    }
+    { // skip and materialize values of a key
+        log.key = "b";
+        log.key_action = UW_JSON_SKIP;
+        UwValue status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ 1 \"x\" null ] \"b\": \"d\": [ ] }"));
+
+        log.key_action = UW_JSON_MATERIALIZE;
+        status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ 1 \"x\" null ] \"b\": {\"c\":true} \"d\": [ ] }"));
+        log.key = nullptr;
+    }
+    { // skip and materialize containers
+        log.start_depth = 1;
+        log.start_action = UW_JSON_SKIP;
+        UwValue status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ \"b\": { \"d\": [ }"));
+
+        log.start_action = UW_JSON_MATERIALIZE;
+        status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ [1,\"x\",null] \"b\": { {\"c\":true} \"d\": [ [] }"));
+        log.start_depth = UINT_MAX;
+    }
+    { // stop
+        log.stop_after = 4;
+        UwValue status = json_events(json, &log);
+        TEST(uw_ok(&status));
+        TEST(uw_equal(&log.log, "{ \"a\": [ 1"));
+        log.stop_after = 0;
+    }
+    { // file input, the entire document is materialized
+        UwValue file = uw_file_open("./test/data/sample.json", O_RDONLY, 0);
+        TEST(uw_ok(&file));
+        log.start_depth = 0;
+        log.start_action = UW_JSON_MATERIALIZE;
+        uw_destroy(&log.log);
+        log.log = uw_create_string("");
+        UwValue status = uw_json_parse_events(&file, log_json_event, &log);
+        TEST(uw_ok(&status));
+        UwValue reference = uw_from_json(&file);
+        UwValue reference_json = uw_to_json(&reference, 0);
+        UwValue expected = uw_create_string("{ ");
+        uw_string_append(&expected, &reference_json);
+        TEST(uw_equal(&log.log, &expected));
+        log.start_depth = UINT_MAX;
+    }
+    { // input much larger than the buffer, tokens crossing buffer boundaries, long strings
+        UwValue value = UwArray();
+        for (unsigned i = 0; i < 30000; i++) {{
+            UwValue item = UwMap(UwCharPtr(u8"ключ"), UwSigned(i * 1000003LL), UwCharPtr("s"), UwCharPtr("a\\\"b"));
+            uw_array_append(&value, &item);
+        }}
+        UwValue long_string = uw_create_empty_string(200000, 2);
+        for (unsigned i = 0; i < 200000; i++) {
+            uw_string_append(&long_string, (i % 1000)? 'x' : 0x416);
+        }
+        uw_array_append(&value, &long_string);
+
+        UwValue json = uw_to_json(&value, 1);
+        UwValue sio = uw_create_string_io(&json);
+        log.start_depth = 0;
+        log.start_action = UW_JSON_MATERIALIZE;
+        uw_destroy(&log.log);
+        log.log = uw_create_string("");
+        UwValue status = uw_json_parse_events(&sio, log_json_event, &log);
+        TEST(uw_ok(&status));
+        UwValue reference_json = uw_to_json(&value, 0);
+        UwValue expected = uw_create_string("[ ");
+        uw_string_append(&expected, &reference_json);
+        TEST(uw_equal(&log.log, &expected));
+        log.start_depth = UINT_MAX;
+
+        // skipping everything
+        log.start_depth = 0;
+        log.start_action = UW_JSON_SKIP;
+        status = uw_json_parse_events(&sio, log_json_event, &log);
+        TEST(uw_ok(&status));
+        log.start_depth = UINT_MAX;
+    }
+    { // errors
+        UwValue e1 = json_events("[1, 2", &log);
+        TEST(json_error_is(&e1, "line 1, column 6: unexpected end of data"));
+        UwValue e2 = json_events("{\n  \"a\": tru\n}", &log);
+        TEST(json_error_is(&e2, "line 2, column 8: unexpected character"));
+        TEST(uw_equal(&log.log, "{ \"a\":"));
+        UwValue e3 = json_events("1 2", &log);
+        TEST(json_error_is(&e3, "line 1, column 3: extra data after JSON value"));
+        UwValue e4 = json_events("\"abc", &log);
+        TEST(json_error_is(&e4, "line 1, column 5: unterminated string"));
+        UwValue e5 = json_events("   ", &log);
+        TEST(json_error_is(&e5, "line 1, column 4: no data"));
+
+        // location after many buffer refills
+        UwValue json = uw_create_string("[");
+        for (unsigned i = 0; i < 50000; i++) {
+            uw_string_append(&json, u8"\"ы\",\n");
+        }
+        uw_string_append(&json, "  x]");
+        UwValue sio = uw_create_string_io(&json);
+        UwValue e6 = uw_json_parse_events(&sio, log_json_event, &log);
+        TEST(json_error_is(&e6, "line 50001, column 3: unexpected character"));
+
+        // skipped values are validated too
+        log.start_depth = 0;
+        log.start_action = UW_JSON_SKIP;
+        UwValue e7 = json_events("[{\"a\": 1 2}]", &log);
+        TEST(json_error_is(&e7, "line 1, column 10: expected , or }"));
+        log.start_depth = UINT_MAX;
+    }
+    uw_destroy(&log.log);
+}
+
+UwResult check_ndjson_record(UwValuePtr record, unsigned line_number, void* arg)
+{
+    unsigned* num_records = arg;
+    if (line_number % 10 == 3) {
+        TEST(uw_is_status(record) && record->status_code == UW_ERROR_JSON_SYNTAX);
+    } else {
+        UwValue n = uw_map_get(record, "n");
+        TEST(uw_is_signed(&n) && n.signed_value == line_number);
+        (*num_records)++;
+    }
+    return UwOK();
+}
+
+void test_ndjson()
+{
+    // make 2000 lines, every 10th line starting from 3rd is bad, every 10th starting from 5th is empty
+    UwValue lines = uw_create_string("");
+    for (unsigned i = 1; i <= 2000; i++) {{
+        if (i % 10 == 3) {
+            uw_string_append(&lines, u8"{\"n\": ы}\n");
+        } else if (i % 10 == 5) {
+            uw_string_append(&lines, " \n");
+        } else {
+            char line[64];
+            sprintf(line, "{\"n\": %u, \"s\": \"", i);
+            uw_string_append(&lines, line);
+            uw_string_append(&lines, (i & 1)? u8"значение\"}\n" : "value\"}\n");
+        }
+    }}
+    { // read one by one with small queue and batches
+        UwValue sio = uw_create_string_io(&lines);
+        UwNdjsonReaderCtorArgs args = { .line_reader = &sio, .num_workers = 3, .queue_size = 2, .batch_size = 7 };
+        UwValue reader = uw_create2(UwTypeId_NdjsonReader, &args);
+        TEST(uw_ok(&reader));
+        unsigned num_records = 0;
+        unsigned num_errors = 0;
+        bool in_order = true;
+        for (;;) {{
+            UwValue record = uw_ndjson_read(&reader);
+            if (uw_eof(&record)) {
+                break;
+            }
+            unsigned line_number = uw_ndjson_line_number(&reader);
+            if (uw_error(&record)) {
+                TEST(record.status_code == UW_ERROR_JSON_SYNTAX);
+                char expected[64];
+                sprintf(expected, "line %u, column 7: unexpected character", line_number);
+                TEST(json_error_is(&record, expected));
+                in_order = in_order && line_number % 10 == 3;
+                num_errors++;
+            } else {
+                UwValue n = uw_map_get(&record, "n");
+                in_order = in_order && n.signed_value == line_number;
+                num_records++;
+            }
+        }}
+        TEST(in_order);
+        TEST(num_records == 1600);
+        TEST(num_errors == 200);
+    }
+    { // batches
+        UwValue sio = uw_create_string_io(&lines);
+        UwValue reader = uw_create_ndjson_reader(&sio);
+        TEST(uw_ok(&reader));
+        UwValue errors = UwMap();
+        unsigned num_records = 0;
+        for (;;) {{
+            UwValue batch = uw_ndjson_read_batch(&reader, 100, &errors);
+            if (uw_eof(&batch)) {
+                break;
+            }
+            TEST(uw_is_array(&batch));
+            UwValue first = uw_array_item(&batch, 0);
+            UwValue n = uw_map_get(&first, "n");
+            // 8 good lines out of each 10
+            static unsigned good_lines[8] = {1, 2, 4, 6, 7, 8, 9, 10};
+            TEST(n.signed_value == num_records / 8 * 10 + good_lines[num_records % 8]);
+            num_records += uw_array_length(&batch);
+        }}
+        TEST(num_records == 1600);
+        TEST(uw_map_length(&errors) == 200);
+        UwValue error = uw_map_get(&errors, 13u);
+        TEST(uw_equal(&error, "line 13, column 7: unexpected character"));
+    }
+    { // callback
+        UwValue sio = uw_create_string_io(&lines);
+        UwValue reader = uw_create_ndjson_reader(&sio);
+        unsigned num_records = 0;
+        UwValue status = uw_ndjson_process(&reader, check_ndjson_record, &num_records);
+        TEST(uw_ok(&status));
+        TEST(num_records == 1600);
+    }
+    { // file, destroyed before all records are read
+        UwValue file = uw_file_open("./test/data/sample.json", O_RDONLY, 0);
+        UwValue reader = uw_create_ndjson_reader(&file);
+        TEST(uw_ok(&reader));
+        UwValue first = uw_ndjson_read(&reader);
+        TEST(json_error_is(&first, "line 1, column 2: unexpected end of data"));
+    }
+    { // not a line reader
+        UwValue reader = uw_create_ndjson_reader(&lines);
+        TEST(uw_is_status(&reader) && reader.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+}
+
+bool malformed_data_is(UwValuePtr status, char* description)
+{
+    if (!uw_is_status(status) || status->status_code != UW_ERROR_MALFORMED_DATA || !status->has_status_data) {
+        return false;
+    }
+    return uw_equal(&status->status_data->description, description);
+}
+
+bool encoded_is(_UwValue value, bool msgpack, char* expected, unsigned expected_size)
+/*
+ * `value` is borrowed.
+ */
+{
+    UwSink sink;
+    uw_sink_init_buffer(&sink);
+    UwValue status = msgpack? uw_to_msgpack_write(&value, &sink) : uw_to_cbor_write(&value, &sink);
+    bool result = uw_ok(&status) && sink.size == expected_size && memcmp(sink.data, expected, expected_size) == 0;
+    uw_sink_fini(&sink);
+    return result;
+}
+
+UwResult random_value(unsigned depth)
+{
+    unsigned kind = rand() % (depth < 4? 12 : 9);
+    switch (kind) {
+        case 0: return UwNull();
+        case 1: return UwBool(rand() & 1);
+        case 2: return UwSigned((int64_t) rand() - RAND_MAX / 2);
+        case 3: return UwSigned((int64_t) (((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 2) ^ -(uint64_t) (rand() & 1)));
+        case 4: return UwUnsigned((1ULL << 63) + rand());
+        case 5: return UwFloat((double) rand() / (rand() + 1) - 1000.0);
+        case 6: {
+            UwValue result = UwTimestamp();
+            result.ts_seconds = rand();
+            result.ts_nanoseconds = (rand() & 1)? 0 : rand() % 1000'000'000;
+            if (rand() & 1) {
+                result = UwDateTime();
+                result.year = 1900 + rand() % 200;
+                result.month = 1 + rand() % 12;
+                result.day = 1 + rand() % 28;
+                result.hour = rand() % 24;
+                result.minute = rand() % 60;
+                result.second = rand() % 60;
+                result.nanosecond = (rand() & 1)? 0 : rand() % 1000'000'000;
+                result.gmt_offset = (rand() % 1440) - 720;
+            }
+            return uw_move(&result);
+        }
+        case 7:
+        case 8: {
+            // string of random char size
+            static const char32_t max_char[] = { 0x80, 0x100, 0xD800, 0x110000 };
+            char32_t limit = max_char[rand() % 4];
+            UwValue result = UwString();
+            unsigned length = rand() % 40;
+            for (unsigned i = 0; i < length; i++) {
+                char32_t c = rand() % limit;
+                if (c >= 0xD800 && c < 0xE000) {
+                    c = 'x';
+                }
+                uw_string_append(&result, c);
+            }
+            return uw_move(&result);
+        }
+        case 9:
+        case 10: {
+            UwValue result = UwArray();
+            unsigned length = rand() % 20;
+            for (unsigned i = 0; i < length; i++) {{
+                UwValue item = random_value(depth + 1);
+                uw_array_append(&result, &item);
+            }}
+            return uw_move(&result);
+        }
+        default: {
+            UwValue result = UwMap();
+            unsigned length = rand() % 20;
+            for (unsigned i = 0; i < length; i++) {{
+                UwValue key = (rand() & 3)? random_value(8) : UwSigned(i);
+                if (uw_map_has_key(&result, &key)) {
+                    continue;
+                }
+                UwValue value = random_value(depth + 1);
+                uw_map_update(&result, &key, &value);
+            }}
+            return uw_move(&result);
+        }
+    }
+}
+
+void test_binary()
+{
+    { // CBOR encoding, examples from RFC 8949
+        TEST(encoded_is(UwSigned(0), false, "\x00", 1));
+        TEST(encoded_is(UwSigned(24), false, "\x18\x18", 2));
+        TEST(encoded_is(UwSigned(1000), false, "\x19\x03\xe8", 3));
+        TEST(encoded_is(UwSigned(-1000), false, "\x39\x03\xe7", 3));
+        TEST(encoded_is(UwUnsigned(18446744073709551615ULL), false, "\x1b\xff\xff\xff\xff\xff\xff\xff\xff", 9));
+        TEST(encoded_is(UwFloat(1.5), false, "\xfa\x3f\xc0\x00\x00", 5));
+        TEST(encoded_is(UwFloat(1.1), false, "\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", 9));
+        TEST(encoded_is(UwBool(true), false, "\xf5", 1));
+        TEST(encoded_is(UwNull(), false, "\xf6", 1));
+        TEST(encoded_is(UwCharPtr(u8"ü"), false, "\x62\xc3\xbc", 3));
+        TEST(encoded_is(UwChar32Ptr(U"水"), false, "\x63\xe6\xb0\xb4", 4));
+        UwValue array = UwArray(UwSigned(1), UwArray(UwSigned(2), UwSigned(3)));
+        TEST(encoded_is(array, false, "\x82\x01\x82\x02\x03", 5));
+        UwValue map = UwMap(UwCharPtr("a"), UwSigned(1), UwSigned(2), UwBool(false));
+        TEST(encoded_is(map, false, "\xa2\x61\x61\x01\x02\xf4", 6));
+
+        UwValue ts = UwTimestamp();
+        ts.ts_seconds = 1363896240;
+        TEST(encoded_is(ts, false, "\xc1\x1a\x51\x4b\x67\xb0", 6));
+        ts.ts_nanoseconds = 500'000'000;
+        TEST(encoded_is(ts, false, "\xd9\x03\xe9\xa2\x01\x1a\x51\x4b\x67\xb0\x28\x1a\x1d\xcd\x65\x00", 16));
+
+        UwValue dt = UwDateTime();
+        dt.year = 2013;
+        dt.month = 3;
+        dt.day = 21;
+        dt.hour = 20;
+        dt.minute = 4;
+        TEST(encoded_is(dt, false, "\xc0\x74" "2013-03-21T20:04:00Z", 22));
+        dt.nanosecond = 500'000'000;
+        dt.gmt_offset = -90;
+        TEST(encoded_is(dt, false, "\xc0\x78\x1b" "2013-03-21T20:04:00.5-01:30", 30));
+
+        UwValue ptr = UwPtr(nullptr);
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue status = uw_to_cbor_write(&ptr, &sink);
+        TEST(status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+        uw_sink_fini(&sink);
+    }
+    { // CBOR decoding
+        UwValue v1 = uw_from_cbor_buffer((uint8_t*) "\xf9\x3c\x00", 3);
+        TEST(uw_equal(&v1, 1.0));
+        UwValue v2 = uw_from_cbor_buffer((uint8_t*) "\xf9\xc4\x00", 3);
+        TEST(uw_equal(&v2, -4.0));
+        UwValue v3 = uw_from_cbor_buffer((uint8_t*) "\x3b\x7f\xff\xff\xff\xff\xff\xff\xff", 9);
+        TEST(uw_is_signed(&v3) && v3.signed_value == INT64_MIN);
+        UwValue v4 = uw_from_cbor_buffer((uint8_t*) "\x9f\x01\x82\x02\x03\x9f\xff\xff", 8);
+        UwValue expected4 = UwArray(UwSigned(1), UwArray(UwSigned(2), UwSigned(3)), UwArray());
+        TEST(uw_equal(&v4, &expected4));
+        UwValue v5 = uw_from_cbor_buffer((uint8_t*) "\xbf\x7f\x61\x61\x62\xd1\x8b\xff\xf5\xff", 10);
+        UwValue expected5 = UwMap(UwCharPtr(u8"aы"), UwBool(true));
+        TEST(uw_equal(&v5, &expected5));
+        UwValue v6 = uw_from_cbor_buffer((uint8_t*) "\xc1\xfb\x41\xd4\x52\xd9\xec\x20\x00\x00", 10);
+        TEST(uw_is_timestamp(&v6) && v6.ts_seconds == 1363896240 && v6.ts_nanoseconds == 500'000'000);
+        UwValue v7 = uw_from_cbor_buffer((uint8_t*) "\xd9\xd9\xf7\xc2\x18\x2a", 6);  // unknown tags
+        TEST(uw_equal(&v7, 42));
+        UwValue v8 = uw_from_cbor_buffer((uint8_t*) "\xc0\x78\x1b" "2013-03-21t20:04:00.1+02:00", 30);
+        TEST(uw_is_datetime(&v8) && v8.nanosecond == 100'000'000 && v8.gmt_offset == 120);
+
+        UwValue e1 = uw_from_cbor_buffer((uint8_t*) "\x83\x01\x02", 3);
+        TEST(malformed_data_is(&e1, "offset 3: unexpected end of data"));
+        UwValue e2 = uw_from_cbor_buffer((uint8_t*) "\x01\x02", 2);
+        TEST(malformed_data_is(&e2, "offset 1: extra data after CBOR data item"));
+        UwValue e3 = uw_from_cbor_buffer((uint8_t*) "\x82\x62\xc3\x28", 4);
+        TEST(malformed_data_is(&e3, "offset 2: bad UTF-8 sequence"));
+        UwValue e4 = uw_from_cbor_buffer((uint8_t*) "\x41\x00", 2);
+        TEST(malformed_data_is(&e4, "offset 0: byte strings are not supported"));
+        UwValue e5 = uw_from_cbor_buffer((uint8_t*) "\xff", 1);
+        TEST(malformed_data_is(&e5, "offset 0: unexpected break"));
+        UwValue e6 = uw_from_cbor_buffer((uint8_t*) "\x9b\xff\xff\xff\xff\xff\xff\xff\xff\x00", 10);
+        TEST(malformed_data_is(&e6, "offset 10: unexpected end of data"));
+        UwValue e7 = uw_from_cbor_buffer((uint8_t*) "\xc0\x6a" "2013-03-21", 12);
+        TEST(malformed_data_is(&e7, "offset 1: bad date/time string"));
+        uint8_t deep[2000];
+        memset(deep, 0x81, sizeof(deep));
+        UwValue e8 = uw_from_cbor_buffer(deep, sizeof(deep));
+        TEST(malformed_data_is(&e8, "offset 1024: nesting is too deep"));
+    }
+    { // MessagePack encoding
+        TEST(encoded_is(UwSigned(127), true, "\x7f", 1));
+        TEST(encoded_is(UwSigned(-32), true, "\xe0", 1));
+        TEST(encoded_is(UwSigned(-33), true, "\xd0\xdf", 2));
+        TEST(encoded_is(UwSigned(200), true, "\xcc\xc8", 2));
+        TEST(encoded_is(UwSigned(-40000), true, "\xd2\xff\xff\x63\xc0", 5));
+        TEST(encoded_is(UwUnsigned(1ULL << 32), true, "\xcf\x00\x00\x00\x01\x00\x00\x00\x00", 9));
+        TEST(encoded_is(UwFloat(1.5), true, "\xca\x3f\xc0\x00\x00", 5));
+        TEST(encoded_is(UwNull(), true, "\xc0", 1));
+        TEST(encoded_is(UwBool(false), true, "\xc2", 1));
+        TEST(encoded_is(UwCharPtr(u8"ы"), true, "\xa2\xd1\x8b", 3));
+        UwValue long_str = uw_create_string("0123456789012345678901234567890123456789");
+        TEST(encoded_is(long_str, true, "\xd9\x28" "0123456789012345678901234567890123456789", 42));
+        UwValue map = UwMap(UwCharPtr("a"), UwArray(UwSigned(1), UwSigned(2)));
+        TEST(encoded_is(map, true, "\x81\xa1\x61\x92\x01\x02", 6));
+
+        UwValue ts = UwTimestamp();
+        ts.ts_seconds = 1363896240;
+        TEST(encoded_is(ts, true, "\xd6\xff\x51\x4b\x67\xb0", 6));
+        ts.ts_nanoseconds = 1;
+        TEST(encoded_is(ts, true, "\xd7\xff\x00\x00\x00\x04\x51\x4b\x67\xb0", 10));
+        ts.ts_seconds = 1ULL << 34;
+        TEST(encoded_is(ts, true, "\xc7\x0c\xff\x00\x00\x00\x01\x00\x00\x00\x04\x00\x00\x00\x00", 15));
+
+        // DateTime is converted to UTC timestamp
+        UwValue dt = UwDateTime();
+        dt.year = 2013;
+        dt.month = 3;
+        dt.day = 21;
+        dt.hour = 22;
+        dt.minute = 4;
+        dt.gmt_offset = 120;
+        TEST(encoded_is(dt, true, "\xd6\xff\x51\x4b\x67\xb0", 6));
+    }
+    { // MessagePack decoding
+        UwValue v1 = uw_from_msgpack_buffer((uint8_t*) "\xdc\x00\x02\xd3\x80\x00\x00\x00\x00\x00\x00\x00\xcb\x3f\xf1\x99\x99\x99\x99\x99\x9a", 21);
+        UwValue expected1 = UwArray(UwSigned(INT64_MIN), UwFloat(1.1));
+        TEST(uw_equal(&v1, &expected1));
+        UwValue v2 = uw_from_msgpack_buffer((uint8_t*) "\xd7\xff\x77\x35\x94\x00\x51\x4b\x67\xb0", 10);
+        TEST(uw_is_timestamp(&v2) && v2.ts_seconds == 1363896240 && v2.ts_nanoseconds == 500'000'000);
+
+        // moments before the epoch are decoded as UTC DateTime
+        UwValue moon = UwDateTime();
+        moon.year = 1969;
+        moon.month = 7;
+        moon.day = 20;
+        moon.hour = 23;
+        moon.minute = 17;
+        moon.second = 40;
+        moon.nanosecond = 250'000'000;
+        moon.gmt_offset = 180;
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue status = uw_to_msgpack_write(&moon, &sink);
+        TEST(uw_ok(&status));
+        TEST(sink.size == 15);
+        UwValue v3 = uw_from_msgpack_buffer(sink.data, sink.size);
+        uw_sink_fini(&sink);
+        TEST(uw_is_datetime(&v3));
+        TEST(v3.year == 1969 && v3.month == 7 && v3.day == 20 && v3.gmt_offset == 0);
+        TEST(v3.hour == 20 && v3.minute == 17 && v3.second == 40 && v3.nanosecond == 250'000'000);
+        UwValue v4 = uw_from_msgpack_buffer((uint8_t*) "\xc7\x0c\xff\x00\x00\x00\x00\xff\xff\xff\xff\xff\xff\xff\xff", 15);
+        TEST(uw_is_datetime(&v4));
+        TEST(v4.year == 1969 && v4.month == 12 && v4.day == 31 && v4.hour == 23 && v4.minute == 59 && v4.second == 59);
+        UwValue e5 = uw_from_msgpack_buffer((uint8_t*) "\xc7\x0c\xff\x00\x00\x00\x00\x80\x00\x00\x00\x00\x00\x00\x00", 15);
+        TEST(malformed_data_is(&e5, "offset 0: timestamp is out of range"));
+
+        UwValue e1 = uw_from_msgpack_buffer((uint8_t*) "\xc1", 1);
+        TEST(malformed_data_is(&e1, "offset 0: never used format byte"));
+        UwValue e2 = uw_from_msgpack_buffer((uint8_t*) "\x92\x01", 2);
+        TEST(malformed_data_is(&e2, "offset 2: unexpected end of data"));
+        UwValue e3 = uw_from_msgpack_buffer((uint8_t*) "\xd4\x01\x00", 3);
+        TEST(malformed_data_is(&e3, "offset 0: unsupported extension type"));
+        UwValue e4 = uw_from_msgpack_buffer((uint8_t*) "\xc4\x00", 2);
+        TEST(malformed_data_is(&e4, "offset 0: bin format is not supported"));
+    }
+    { // round trip of random values
+        srand(12345);
+        for (unsigned i = 0; i < 300; i++) {{
+            bool msgpack = i & 1;
+            UwValue value = random_value(0);
+            UwSink sink;
+            uw_sink_init_buffer(&sink);
+            UwValue status = msgpack? uw_to_msgpack_write(&value, &sink) : uw_to_cbor_write(&value, &sink);
+            TEST(uw_ok(&status));
+            UwValue result = msgpack? uw_from_msgpack_buffer(sink.data, sink.size)
+                                    : uw_from_cbor_buffer(sink.data, sink.size);
+            if (msgpack) {
+                // DateTime comes back as Timestamp or UTC DateTime, compare encoded forms
+                UwSink sink2;
+                uw_sink_init_buffer(&sink2);
+                status = uw_to_msgpack_write(&result, &sink2);
+                TEST(uw_ok(&status));
+                TEST(sink2.size == sink.size && memcmp(sink2.data, sink.data, sink.size) == 0);
+                uw_sink_fini(&sink2);
+            } else {
+                TEST(uw_equal(&result, &value));
+            }
+            uw_sink_fini(&sink);
+        }}
+    }
+    { // File
+        UwValue value = UwArray();
+        for (unsigned i = 0; i < 5000; i++) {{
+            UwValue item = UwMap(
+                UwCharPtr("n"), UwUnsigned(i),
+                UwCharPtr("s"), UwCharPtr(u8"значение"),
+                UwCharPtr("e"), UwChar32Ptr(U"\U0001F600")
+            );
+            uw_array_append(&value, &item);
+        }}
+        char* file_name = "/tmp/uw_test_binary.bin";
+        for (unsigned msgpack = 0; msgpack < 2; msgpack++) {{
+            UwValue file = uw_file_open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            TEST(uw_is_file(&file));
+            UwSink sink;
+            UwValue status = uw_sink_init_writer(&sink, &file);
+            TEST(uw_ok(&status));
+            status = msgpack? uw_to_msgpack_write(&value, &sink) : uw_to_cbor_write(&value, &sink);
+            TEST(uw_ok(&status));
+            uw_file_close(&file);
+
+            UwValue input = uw_file_open(file_name, O_RDONLY, 0);
+            TEST(uw_is_file(&input));
+            UwValue result = msgpack? uw_from_msgpack(&input) : uw_from_cbor(&input);
+            TEST(uw_equal(&result, &value));
+        }}
+        unlink(file_name);
+    }
+}
+
+UwResult snapshot_file(UwValuePtr value, char* file_name)
+/*
+ * Write snapshot of `value` and open it.
+ */
+{
+    {
+        UwValue file = uw_file_open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        uw_return_if_error(&file);
+        UwSink sink;
+        uw_expect_ok( uw_sink_init_writer(&sink, &file) );
+        uw_expect_ok( uw_snapshot_write(value, &sink) );
+    }
+    UwValue file = uw_file_open(file_name, O_RDONLY, 0);
+    uw_return_if_error(&file);
+    return uw_snapshot_open(&file);
+}
+
+void test_snapshot()
+{
+    char* file_name = "/tmp/uw_test_snapshot.bin";
+
+    { // round trip of random values
+        srand(54321);
+        for (unsigned i = 0; i < 100; i++) {{
+            UwValue value = random_value(0);
+            UwValue snapshot = snapshot_file(&value, file_name);
+            TEST(uw_ok(&snapshot));
+            TEST(uw_equal(uw_snapshot_root(&snapshot), &value));
+        }}
+    }
+    { // shared and immortal data
+        UwValue long_str = uw_create_string(u8"строка длиннее двенадцати символов");
+        UwValue value = UwMap(
+            UwCharPtr("first"),  UwArray(UwSigned(1), UwCharPtr("two")),
+            UwCharPtr("second"), UwMap(),
+            UwCharPtr("string"), uw_clone(&long_str),
+            UwCharPtr("long"),   uw_clone(&long_str),
+            UwChar32Ptr(U"ключ"), UwChar32Ptr(U"\U0001F600 wide chars are kept wide"),
+            UwCharPtr("padded"), UwCharPtr("   leading spaces are trimmed")
+        );
+        {
+            // make "first" shared
+            UwValue first = uw_map_get(&value, "first");
+            UwValue second = uw_map_get(&value, "second");
+            UwValue key = UwCharPtr("inner");
+            UwValue status = uw_map_update(&second, &key, &first);
+            TEST(uw_ok(&status));
+        }
+        UwValue snapshot = snapshot_file(&value, file_name);
+        TEST(uw_ok(&snapshot));
+        UwValuePtr root = uw_snapshot_root(&snapshot);
+        TEST(uw_equal(root, &value));
+        TEST(_uw_is_immortal(root));
+
+        UwValue first = uw_map_get(root, "first");
+        UwValue second = uw_map_get(root, "second");
+        UwValue second_inner = uw_map_get(&second, "inner");
+        TEST(uw_is_array(&first));
+        TEST(first.struct_data == second_inner.struct_data);
+        TEST(first.struct_data->refcount == UW_REFCOUNT_IMMORTAL);
+
+        UwValue wide = uw_map_get(root, U"ключ");
+        TEST(_uw_string_char_size(&wide) == 3);
+        TEST(wide.string_data->refcount == UW_REFCOUNT_IMMORTAL);
+
+        // mutators fail
+        UwValue status = uw_array_append(&first, 3);
+        TEST(status.status_code == UW_ERROR_READ_ONLY);
+        status = uw_array_pop(&first);
+        TEST(status.status_code == UW_ERROR_READ_ONLY);
+        status = uw_map_update_va(root, UwCharPtr("third"), UwSigned(3));
+        TEST(status.status_code == UW_ERROR_READ_ONLY);
+        TEST(!uw_map_del(root, "first"));
+        TEST(uw_array_length(&first) == 2);
+
+        // strings are copied before modification
+        UwValue str = uw_map_get(root, "string");
+        UwValue str2 = uw_map_get(root, "long");
+        TEST(str.string_data == str2.string_data);
+        TEST(str.string_data->refcount == UW_REFCOUNT_IMMORTAL);
+        TEST(uw_string_append(&str, "!"));
+        TEST(str.string_data->refcount == 1);
+        UwValue orig_str = uw_map_get(root, "string");
+        TEST(uw_equal(&orig_str, &long_str));
+        UwValue lower = uw_map_get(root, U"ключ");
+        TEST(uw_string_lower(&lower));
+        TEST(uw_equal(&wide, U"\U0001F600 wide chars are kept wide"));
+        UwValue erased = uw_map_get(root, "string");
+        TEST(uw_string_erase(&erased, 0, 7));
+        TEST(uw_equal(&erased, u8"длиннее двенадцати символов"));
+        TEST(uw_equal(&orig_str, &long_str));
+        UwValue trimmed = uw_map_get(root, "padded");
+        TEST(uw_string_ltrim(&trimmed));
+        TEST(uw_equal(&trimmed, "leading spaces are trimmed"));
+        UwValue padded = uw_map_get(root, "padded");
+        TEST(uw_equal(&padded, "   leading spaces are trimmed"));
+
+        // immortal values can be added to mortal ones
+        UwValue array = UwArray();
+        TEST(uw_ok(&array));
+        status = uw_array_append(&array, &first);
+        TEST(uw_ok(&status));
+        uw_destroy(&array);
+
+        // deep copy is mutable
+        UwValue copy = uw_deepcopy(root);
+        TEST(!_uw_is_immortal(&copy));
+        status = uw_map_update_va(&copy, UwCharPtr("third"), UwSigned(3));
+        TEST(uw_ok(&status));
+
+        // same snapshot opened twice is relocated
+        UwValue input = uw_file_open(file_name, O_RDONLY, 0);
+        UwValue snapshot2 = uw_snapshot_open(&input);
+        TEST(uw_ok(&snapshot2));
+        UwValuePtr root2 = uw_snapshot_root(&snapshot2);
+        TEST(root2->struct_data != root->struct_data);
+        TEST(uw_equal(root2, root));
+        UwValue first2 = uw_map_get(root2, "first");
+        TEST(uw_equal(&first2, &first));
+    }
+    { // errors
+        UwValue value = UwArray(UwPtr(nullptr));
+        UwSink sink;
+        uw_sink_init_buffer(&sink);
+        UwValue status = uw_snapshot_write(&value, &sink);
+        TEST(status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+        uw_sink_fini(&sink);
+
+        UwValue file = uw_file_open("./test/data/sample.json", O_RDONLY, 0);
+        UwValue snapshot = uw_snapshot_open(&file);
+        TEST(snapshot.status_code == UW_ERROR_MALFORMED_DATA);
+    }
+    unlink(file_name);
+}
+
+void test_freeze()
+{
+    { // frozen graph
+        UwValue long_str = uw_create_string("this string is too long to be embedded");
+        UwValue padded = uw_create_string("   leading spaces are trimmed");
+        UwValue value = UwMap(
+            UwCharPtr("list"), UwArray(UwSigned(1), uw_clone(&long_str)),
+            UwCharPtr("long"), uw_clone(&long_str),
+            UwCharPtr("padded"), uw_clone(&padded)
+        );
+        TEST(uw_ok(&value));
+        UwValue list = uw_map_get(&value, "list");
+
+        // save reference counts to release the graph at the end
+        unsigned value_refcount = value.struct_data->refcount;
+        unsigned list_refcount = list.struct_data->refcount;
+        unsigned str_refcount = long_str.string_data->refcount;
+        unsigned padded_refcount = padded.string_data->refcount;
+
+        UwValue status = uw_freeze(&value);
+        TEST(uw_ok(&status));
+        TEST(_uw_is_immortal(&value));
+        TEST(_uw_is_immortal(&list));
+        TEST(long_str.string_data->refcount == UW_REFCOUNT_IMMORTAL);
+
+        // freezing again is fine
+        status = uw_freeze(&list);
+        TEST(uw_ok(&status));
+
+        // clone and destroy do nothing
+        {
+            UwValue copy = uw_clone(&list);
+            TEST(copy.struct_data == list.struct_data);
+            TEST(list.struct_data->refcount == UW_REFCOUNT_IMMORTAL);
+        }
+        TEST(list.struct_data->refcount == UW_REFCOUNT_IMMORTAL);
+
+        // mutators fail
+        status = uw_array_append(&list, 2);
+        TEST(status.status_code == UW_ERROR_READ_ONLY);
+        status = uw_map_update_va(&value, UwCharPtr("list"), UwSigned(2));
+        TEST(status.status_code == UW_ERROR_READ_ONLY);
+        TEST(!uw_map_del(&value, "long"));
+        TEST(uw_array_length(&list) == 2);
+
+        // strings are copied before modification
+        UwValue str = uw_map_get(&value, "long");
+        TEST(uw_string_append(&str, "!"));
+        TEST(str.string_data != long_str.string_data);
+        TEST(long_str.string_data->refcount == UW_REFCOUNT_IMMORTAL);
+        TEST(uw_equal(&long_str, "this string is too long to be embedded"));
+        UwValue erased = uw_map_get(&value, "long");
+        TEST(uw_string_erase(&erased, 0, 5));
+        TEST(uw_equal(&erased, "string is too long to be embedded"));
+        TEST(uw_equal(&long_str, "this string is too long to be embedded"));
+        UwValue trimmed = uw_map_get(&value, "padded");
+        TEST(uw_string_ltrim(&trimmed));
+        TEST(uw_equal(&trimmed, "leading spaces are trimmed"));
+        TEST(uw_equal(&padded, "   leading spaces are trimmed"));
+
+        // frozen values can be added to mutable ones and shared by arena containers
+        UwValue array = UwArray();
+        status = uw_array_append(&array, &list);
+        TEST(uw_ok(&status));
+        uw_destroy(&array);
+        status = uw_arena_begin();
+        TEST(uw_ok(&status));
+        {
+            UwValue arena_array = UwArray();
+            status = uw_array_append(&arena_array, &list);
+            TEST(uw_ok(&status));
+            UwValue item = uw_array_item(&arena_array, 0);
+            TEST(item.struct_data == list.struct_data);
+        }
+        uw_arena_end();
+
+        // deep copy is mutable
+        UwValue copy = uw_deepcopy(&value);
+        TEST(!_uw_is_immortal(&copy));
+        TEST(uw_equal(&copy, &value));
+
+        value.struct_data->refcount = value_refcount;
+        list.struct_data->refcount = list_refcount;
+        long_str.string_data->refcount = str_refcount;
+        padded.string_data->refcount = padded_refcount;
+    }
+    { // incompatible types roll back
+        UwValue long_str = uw_create_string("this string is too long to be embedded");
+        UwValue list = UwArray(UwSigned(1), uw_clone(&long_str), UwPtr(nullptr));
+        UwValue status = uw_array_append(&list, &list);  // circular reference
+        TEST(uw_ok(&status));
+        UwValue string_io = uw_create_string_io("");
+        status = uw_array_append(&list, &string_io);
+        TEST(uw_ok(&status));
+        status = uw_freeze(&list);
+        TEST(status.status_code == UW_ERROR_INCOMPATIBLE_TYPE);
+        TEST(!_uw_is_immortal(&list));
+        TEST(long_str.string_data->refcount == 2);
+    }
+}
+
+void test_async_read()
+{
+    char* sample_file = "./test/data/sample.json";
+
+    UwValue file_name = UwCharPtr(sample_file);
+    UwValue file_size = uw_file_size(&file_name);
+    TEST(uw_is_unsigned(&file_size));
+    unsigned size = file_size.unsigned_value;
+
+    // read content to compare with
+    char data[size];
+    {
+        UwValue file = uw_file_open(sample_file, O_RDONLY, 0);
+        TEST(uw_ok(&file));
+        unsigned bytes_read;
+        UwValue status = uw_file_read(&file, data, size, &bytes_read);
+        TEST(uw_ok(&status));
+        TEST(bytes_read == size);
+    }
+
+    for (int use_fallback = 0; use_fallback < 2; use_fallback++) {{
+
+        UwAsyncReaderCtorArgs args = {
+            .queue_depth = 8,
+            .num_threads = 2,
+            .no_io_uring = use_fallback
+        };
+        UwValue reader = uw_create2(UwTypeId_AsyncReader, &args);
+        TEST(uw_ok(&reader));
+        if (use_fallback) {
+            TEST(!uw_async_read_uses_io_uring(&reader));
+        }
+
+        // two files, reads at many offsets, the last one crosses end of file
+        UwValue file1 = uw_file_open(sample_file, O_RDONLY, 0);
+        UwValue file2 = uw_file_open(sample_file, O_RDONLY, 0);
+        TEST(uw_ok(&file1));
+        TEST(uw_ok(&file2));
+
+        unsigned chunk_size = 100;
+        unsigned num_chunks = (size + chunk_size - 1) / chunk_size;
+        char buffers[num_chunks][chunk_size];
+        UwAsyncRead requests[num_chunks];
+        bzero(requests, sizeof(requests));
+
+        unsigned next = 0;
+        unsigned num_done = 0;
+        while (num_done < num_chunks) {
+            // submit as many as possible
+            while (next < num_chunks) {{
+                UwAsyncRead* req = &requests[next];
+                req->buffer = buffers[next];
+                req->size = chunk_size;
+                req->offset = next * chunk_size;
+                req->user_data = (void*) (uintptr_t) next;
+                UwValue status = uw_async_read_submit(&reader, (next & 1)? &file1 : &file2, req);
+                if (uw_error(&status)) {
+                    TEST(status.status_code == UW_ERROR_ASYNC_QUEUE_FULL);
+                    break;
+                }
+                next++;
+            }}
+            TEST(uw_async_read_pending(&reader) <= 8);
+
+            UwAsyncRead* completed[4];
+            unsigned n;
+            UwValue status = uw_async_read_reap(&reader, completed, UW_LENGTH(completed), 1, &n);
+            TEST(uw_ok(&status));
+            TEST(n >= 1);
+            for (unsigned i = 0; i < n; i++) {
+                UwAsyncRead* req = completed[i];
+                unsigned chunk = (unsigned) (uintptr_t) req->user_data;
+                unsigned expected = (chunk == num_chunks - 1)? size - chunk * chunk_size : chunk_size;
+                TEST(req->error == 0);
+                TEST(req->bytes_read == expected);
+                TEST(memcmp(req->buffer, data + chunk * chunk_size, expected) == 0);
+            }
+            num_done += n;
+        }
+        TEST(uw_async_read_pending(&reader) == 0);
+
+        // bad file
+        UwValue closed_file = uw_create(UwTypeId_File);
+        UwAsyncRead req = { .buffer = buffers[0], .size = chunk_size };
+        UwValue status = uw_async_read_submit(&reader, &closed_file, &req);
+        TEST(uw_error(&status));
+    }}
+}
+
+UwResult collect_lines(UwValuePtr line_reader, UwValuePtr partial, void* arg)
+{
+    UwValue line = UwString();
+    for (;;) {
+        UwValue status = uw_read_line_inplace(line_reader, &line);
+        if (uw_eof(&status)) {
+            return UwOK();
+        }
+        uw_return_if_error(&status);
+        uw_expect_ok( uw_array_append(partial, &line) );
+    }
+}
+
+UwResult count_words(UwValuePtr line_reader, UwValuePtr partial, void* arg)
+{
+    UwValue line = UwString();
+    for (;;) {{
+        UwValue status = uw_read_line_inplace(line_reader, &line);
+        if (uw_eof(&status)) {
+            return UwOK();
+        }
+        uw_return_if_error(&status);
+        uw_string_rtrim(&line);
+        UwValue count = uw_map_get(partial, &line);
+        UwValue new_count = UwUnsigned(uw_is_unsigned(&count)? count.unsigned_value + 1 : 1);
+        uw_expect_ok( uw_map_update(partial, &line, &new_count) );
+    }}
+}
+
+UwResult add_counts(UwValuePtr key, UwValuePtr merged_value, UwValuePtr value, void* arg)
+{
+    return UwUnsigned(merged_value->unsigned_value + value->unsigned_value);
+}
+
+void test_parallel_lines()
+{
+    char* sample_file = "./test/data/sample.json";
+    UwValue file_name = UwCharPtr(sample_file);
+
+    // read lines sequentially to compare with
+    UwValue expected_lines = uw_create(UwTypeId_Array);
+    {
+        UwValue file = uw_file_open(sample_file, O_RDONLY, 0);
+        TEST(uw_ok(&file));
+        UwValue status = uw_start_read_lines(&file);
+        TEST(uw_ok(&status));
+        status = collect_lines(&file, &expected_lines, nullptr);
+        TEST(uw_ok(&status));
+    }
+
+    // split
+    {
+        UwValue file_size = uw_file_size(&file_name);
+        UwValue boundaries = uw_file_split_lines(&file_name, 5);
+        TEST(uw_array_length(&boundaries) == 6);
+        UwValue first = uw_array_item(&boundaries, 0);
+        UwValue last = uw_array_item(&boundaries, -1);
+        TEST(first.unsigned_value == 0);
+        TEST(last.unsigned_value == file_size.unsigned_value);
+
+        // each boundary must follow line feed
+        UwValue file = uw_file_open(sample_file, O_RDONLY, 0);
+        for (unsigned i = 1; i < 5; i++) {{
+            UwValue offset = uw_array_item(&boundaries, i);
+            char c = 0;
+            unsigned bytes_read;
+            UwValue status = uw_file_pread(&file, &c, 1, offset.unsigned_value - 1, &bytes_read);
+            TEST(uw_ok(&status));
+            TEST(c == '\n');
+        }}
+    }
+
+    for (unsigned num_workers = 1; num_workers <= 8; num_workers *= 2) {{
+        // collect lines
+        UwParallelLines params = {
+            .num_workers   = num_workers,
+            .process_chunk = collect_lines
+        };
+        UwValue lines = uw_file_process_lines_parallel(&file_name, &params);
+        TEST(uw_is_array(&lines));
+        TEST(uw_equal(&lines, &expected_lines));
+
+        // count lines
+        UwParallelLines params2 = {
+            .num_workers   = num_workers,
+            .partial_type  = UwTypeId_Map,
+            .process_chunk = count_words,
+            .merge_values  = add_counts
+        };
+        UwValue counts = uw_file_process_lines_parallel(&file_name, &params2);
+        TEST(uw_is_map(&counts));
+        UwValue num_braces = uw_map_get(&counts, "}");
+        TEST(uw_is_unsigned(&num_braces));
+        unsigned total = 0;
+        for (unsigned i = 0; i < uw_map_length(&counts); i++) {{
+            UwValue key = UwNull();
+            UwValue value = UwNull();
+            uw_map_item(&counts, i, &key, &value);
+            total += value.unsigned_value;
+        }}
+        TEST(total == uw_array_length(&expected_lines));
+    }}
 }
 
 int main(int argc, char* argv[])
@@ -1226,15 +3683,36 @@ int main(int argc, char* argv[])
     UwValue start_time = uw_monotonic();
 
     test_icu();
+    test_slab_allocator();
+    test_string_pool();
+    test_remote_free();
+    test_arena();
+#ifdef UW_ATOMIC_REFCOUNT
+    test_atomic_refcount();
+#endif
+    test_subtypes();
+    test_interfaces();
     test_integral_types();
     test_string();
     test_array();
     test_map();
+    test_value_path();
     test_file();
+    test_async_read();
+    test_parallel_lines();
     test_string_io();
     test_netutils();
     test_args();
     test_json();
+    test_json_write();
+    test_json_plan();
+    test_from_json();
+    test_json_document();
+    test_json_events();
+    test_ndjson();
+    test_binary();
+    test_snapshot();
+    test_freeze();
 
     UwValue end_time = uw_monotonic();
     UwValue timediff = uw_timestamp_diff(&end_time, &start_time);
@@ -1246,5 +3724,8 @@ int main(int argc, char* argv[])
         fprintf(stderr, "%d test%s OK\n", num_tests, (num_tests == 1)? "" : "s");
     }
 
-    fprintf(stderr, "leaked blocks: %zu\n", default_allocator.stats->blocks_allocated);
+    uw_slab_update_stats();
+    fprintf(stderr, "leaked blocks: %zu\n",
+            default_allocator.stats->blocks_allocated + uw_slab_allocator.stats->blocks_allocated
+            + uw_string_pool_allocator.stats->blocks_allocated);
 }